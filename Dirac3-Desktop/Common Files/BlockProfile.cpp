@@ -0,0 +1,278 @@
+/*
+
+	BlockProfile
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	See BlockProfile.h for a description of the calls implemented here
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Dirac.h"
+#include "BlockProfile.h"
+#include "PhaseTimer.h"
+
+
+// enough for every lambda, quality and a generous number of channel counts
+#define kBlockProfileMaxEntries		512
+
+// rounds per block size, the best one counts. Interleaving the sizes evens out frequency scaling
+#define kBlockProfileTuneRounds		3
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+	#define snprintf _snprintf
+#endif
+
+typedef struct {
+	long sLambda, sQuality, sNumChannels;
+	long sBlockSize;
+	double sFramesPerSecond;
+	float sPeakCpuPercent;			/* 0 if not measured */
+} ProfileEntry;
+
+static ProfileEntry gProfile[kBlockProfileMaxEntries];
+static int gProfileSize = 0;
+
+
+#pragma mark ---- Helpers ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the path of the default profile in path
+ */
+static void defaultPath(char *path, size_t size)
+{
+	const char *env = getenv("DIRAC_BLOCK_PROFILE");
+	if (env && env[0]) {
+		snprintf(path, size, "%s", env);
+		return;
+	}
+#ifdef _WIN32
+	const char *dir = getenv("APPDATA");
+	snprintf(path, size, "%s\\dirac_block_profile.txt", dir ? dir : ".");
+#else
+	const char *dir = getenv("HOME");
+	snprintf(path, size, "%s/.dirac_block_profile", dir ? dir : ".");
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Adds an entry to the profile or replaces the one with the same lambda, quality and channel count
+ */
+static void setEntry(long lambda, long quality, long numChannels, long blockSize, double framesPerSecond, float peakCpuPercent)
+{
+	int e;
+	for (e = 0; e < gProfileSize; e++) {
+		if (gProfile[e].sLambda == lambda && gProfile[e].sQuality == quality && gProfile[e].sNumChannels == numChannels)
+			break;
+	}
+	if (e == kBlockProfileMaxEntries)
+		return;
+	if (e == gProfileSize)
+		gProfileSize++;
+	gProfile[e].sLambda				= lambda;
+	gProfile[e].sQuality			= quality;
+	gProfile[e].sNumChannels		= numChannels;
+	gProfile[e].sBlockSize			= blockSize;
+	gProfile[e].sFramesPerSecond	= framesPerSecond;
+	gProfile[e].sPeakCpuPercent		= peakCpuPercent;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Read callback for tuning: white noise from a fixed seed, so every run measures the same thing
+ */
+static long noiseReadData(float **chdata, long numFrames, void *userData)
+{
+	unsigned long *seed = (unsigned long*)userData;
+	long numChannels = (long)seed[1];
+	for (long c = 0; c < numChannels; c++) {
+		for (long s = 0; s < numFrames; s++) {
+			seed[0] = seed[0] * 1664525UL + 1013904223UL;
+			chdata[c][s] = (float)((seed[0] >> 8) & 0xffff) / 32768.f - 1.f;
+		}
+	}
+	return numFrames;
+}
+
+
+#pragma mark ---- Profile ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int bpLoad(const char *path)
+{
+	char defaultFile[4096], line[256];
+	if (!path) {
+		defaultPath(defaultFile, sizeof(defaultFile));
+		path = defaultFile;
+	}
+	gProfileSize = 0;
+	
+	FILE *f = fopen(path, "r");
+	if (!f)	return 0;
+	while (fgets(line, sizeof(line), f)) {
+		long lambda, quality, numChannels, blockSize;
+		double framesPerSecond = 0.;
+		float peakCpuPercent = 0.f;
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%ld %ld %ld %ld %lf %f", &lambda, &quality, &numChannels, &blockSize, &framesPerSecond, &peakCpuPercent) >= 4 && blockSize > 0)
+			setEntry(lambda, quality, numChannels, blockSize, framesPerSecond, peakCpuPercent);
+	}
+	fclose(f);
+	return gProfileSize;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long bpGetBlockSize(long lambda, long quality, long numChannels, long defaultFrames)
+{
+	long blockSize = defaultFrames, distance = -1;
+	for (int e = 0; e < gProfileSize; e++) {
+		if (gProfile[e].sLambda != lambda || gProfile[e].sQuality != quality)
+			continue;
+		long d = labs(gProfile[e].sNumChannels - numChannels);
+		if (distance < 0 || d < distance) {
+			distance = d;
+			blockSize = gProfile[e].sBlockSize;
+		}
+	}
+	return blockSize;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int bpGetPerformance(long lambda, long quality, long numChannels, double *framesPerSecond, float *peakCpuPercent)
+{
+	for (int e = 0; e < gProfileSize; e++) {
+		if (gProfile[e].sLambda != lambda || gProfile[e].sQuality != quality || gProfile[e].sNumChannels != numChannels)
+			continue;
+		if (gProfile[e].sFramesPerSecond <= 0.)
+			break;
+		if (framesPerSecond)
+			*framesPerSecond = gProfile[e].sFramesPerSecond;
+		if (peakCpuPercent)
+			*peakCpuPercent = gProfile[e].sPeakCpuPercent;
+		return 0;
+	}
+	return -1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int bpSave(const char *path)
+{
+	char defaultFile[4096];
+	if (!path) {
+		defaultPath(defaultFile, sizeof(defaultFile));
+		path = defaultFile;
+	}
+	
+	FILE *f = fopen(path, "w");
+	if (!f)	return -1;
+	fprintf(f, "# Dirac block size profile, see BlockProfile.h\n");
+	fprintf(f, "# lambda quality channels frames-per-call frames-per-second peak-cpu-percent\n");
+	for (int e = 0; e < gProfileSize; e++)
+		fprintf(f, "%ld %ld %ld %ld %.1f %.2f\n", gProfile[e].sLambda, gProfile[e].sQuality, gProfile[e].sNumChannels, 
+				gProfile[e].sBlockSize, gProfile[e].sFramesPerSecond, gProfile[e].sPeakCpuPercent);
+	return fclose(f) == 0 ? 0 : -1;
+}
+
+
+#pragma mark ---- Tuning ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long bpTune(long lambda, long quality, long numChannels, float sampleRate, const long *blockSizes, int numBlockSizes, 
+			double secondsPerSize, double *framesPerSecond)
+{
+	if (!blockSizes || numBlockSizes < 1 || numChannels < 1)	return -1;
+	
+	unsigned long seed[2] = { 1, (unsigned long)numChannels };
+	void *dirac = DiracCreate(lambda, quality, numChannels, sampleRate, &noiseReadData, seed);
+	if (!dirac)	return -1;
+	
+	long maxBlockSize = 0;
+	int b;
+	for (b = 0; b < numBlockSizes; b++) {
+		if (blockSizes[b] > maxBlockSize)
+			maxBlockSize = blockSizes[b];
+	}
+	float **audio = (float**)malloc(numChannels*sizeof(float*));
+	for (long c = 0; c < numChannels; c++)
+		audio[c] = (float*)malloc(maxBlockSize*sizeof(float));
+	double *bestSeconds = (double*)malloc(numBlockSizes*sizeof(double));
+	float *bestPeak = (float*)malloc(numBlockSizes*sizeof(float));
+	for (b = 0; b < numBlockSizes; b++) {
+		bestSeconds[b] = -1.;
+		bestPeak[b] = -1.f;
+	}
+	
+	// DiracStartClock() is one clock for the whole program, a timer of our own is not disturbed
+	// by instances that process on other threads while we tune
+	PhaseTimer timer;
+	long numFrames = (long)(secondsPerSize * sampleRate);
+	for (int round = 0; round < kBlockProfileTuneRounds; round++) {
+		for (b = 0; b < numBlockSizes; b++) {
+			long blockSize = blockSizes[b];
+			if (blockSize < 1)
+				continue;
+			
+			// start every measurement from the same state and let the instance fill up first
+			seed[0] = 1;
+			DiracReset(true, dirac);
+			DiracProcess(audio, blockSize, dirac);
+			DiracPeakCpuUsagePercent(dirac);		/* reading the peak starts a new one */
+			
+			ptInit(&timer, NULL);
+			{
+				PhaseScope dsp(&timer, kPhaseDsp);
+				for (long done = 0; done < numFrames; done += blockSize)
+					DiracProcess(audio, blockSize, dirac);
+			}
+			PhaseTimes times;
+			ptGetTimes(&timer, &times);
+			ptDispose(&timer);
+			double seconds = times.sSeconds[kPhaseDsp];
+			float peak = DiracPeakCpuUsagePercent(dirac);
+			if (bestSeconds[b] < 0. || seconds < bestSeconds[b])
+				bestSeconds[b] = seconds;
+			if (bestPeak[b] < 0.f || peak < bestPeak[b])
+				bestPeak[b] = peak;
+		}
+	}
+	
+	// the sizes process slightly different amounts of audio, so compare frames per second
+	long bestBlockSize = -1;
+	double bestFramesPerSecond = 0.;
+	float bestBlockPeak = 0.f;
+	for (b = 0; b < numBlockSizes; b++) {
+		if (blockSizes[b] < 1)
+			continue;
+		long blocks = (numFrames + blockSizes[b] - 1) / blockSizes[b];
+		double fps = bestSeconds[b] > 0. ? (double)(blocks * blockSizes[b]) / bestSeconds[b] : 0.;
+		if (framesPerSecond)
+			framesPerSecond[b] = fps;
+		if (bestBlockSize < 0 || fps > bestFramesPerSecond) {
+			bestBlockSize = blockSizes[b];
+			bestFramesPerSecond = fps;
+			bestBlockPeak = bestPeak[b] > 0.f ? bestPeak[b] : 0.f;
+		}
+	}
+	if (bestBlockSize > 0)
+		setEntry(lambda, quality, numChannels, bestBlockSize, bestFramesPerSecond, bestBlockPeak);
+	
+	for (long c = 0; c < numChannels; c++)
+		free(audio[c]);
+	free(audio);
+	free(bestSeconds);
+	free(bestPeak);
+	DiracDestroy(dirac);
+	return bestBlockSize;
+}
@@ -0,0 +1,96 @@
+/*
+
+	BlockProfile
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	Abstract: Per machine profile of the number of frames to pass to DiracProcess() per call.
+	Which block size processes fastest depends on the CPU and its caches, so instead of using
+	one constant everywhere, bpTune() measures the throughput of a range of block sizes for a
+	lambda, quality and channel count on this machine, and bpSave() stores the best ones in a
+	profile file. Programs call bpLoad() once at startup and bpGetBlockSize() wherever they
+	used to hardcode their block size, which stays the fallback if there is no profile.
+
+	The profile is a text file with one line per lambda, quality and channel count:
+
+		# lambda quality channels frames-per-call frames-per-second peak-cpu-percent
+		200 300 2 2048 1534520.5 3.10
+
+	The throughput and peak CPU usage at the best block size are kept as well, so programs can
+	tell what a lambda and quality costs on this machine without measuring again.
+
+	Lambda and quality are the kDiracLambda... and kDiracQuality... constants. The loaded
+	profile is shared by the whole program. Load and tune it before starting any threads that
+	look block sizes up.
+
+	This file is provided as source and should be compiled into your project.
+
+*/
+
+#ifndef __BLOCKPROFILE__
+#define __BLOCKPROFILE__
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//	-----------------------------------------------------------------------------------------
+//	Loads the profile at path, replacing the one loaded before. If path is NULL the profile
+//	is loaded from the default location: the file named by the environment variable
+//	DIRAC_BLOCK_PROFILE, or else .dirac_block_profile in the home directory
+//	(dirac_block_profile.txt in %APPDATA% on Windows).
+//	Returns the number of entries loaded, 0 if there is no profile.
+//
+int bpLoad(const char *path);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of frames per DiracProcess() call the profile recommends for lambda,
+//	quality and numChannels. If the profile has no entry for numChannels, the closest channel
+//	count with the same lambda and quality is used. Returns defaultFrames if there is none.
+//
+long bpGetBlockSize(long lambda, long quality, long numChannels, long defaultFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns what bpTune() measured for lambda, quality and exactly numChannels channels at
+//	the best block size: output frames per second in framesPerSecond and the highest
+//	DiracPeakCpuUsagePercent() in peakCpuPercent (0 if the profile predates it). Either
+//	may be NULL.
+//	Returns 0 on success, -1 if the profile has no measurement for them.
+//
+int bpGetPerformance(long lambda, long quality, long numChannels, double *framesPerSecond, float *peakCpuPercent);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Measures how many output frames per second DiracProcess() produces with each of the
+//	numBlockSizes block sizes, processing secondsPerSize seconds of noise per size and
+//	round, and enters the fastest size into the loaded profile together with its throughput
+//	and peak CPU usage. The throughput of every size is returned in framesPerSecond if that
+//	is not NULL.
+//	Returns the fastest block size, or a negative value if no instance could be created.
+//
+long bpTune(long lambda, long quality, long numChannels, float sampleRate, const long *blockSizes, int numBlockSizes, 
+			double secondsPerSize, double *framesPerSecond);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Writes the loaded profile to path, or to the default location if path is NULL.
+//	Returns 0 on success, -1 if the file could not be written.
+//
+int bpSave(const char *path);
+//	-----------------------------------------------------------------------------------------
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __BLOCKPROFILE__ */
@@ -0,0 +1,326 @@
+/*
+
+	CallbackTiming
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	Abstract: How long a realtime callback takes relative to its deadline, the duration of the
+	audio it renders. Each call site owns a CallbackTiming and brackets the callback with
+	ctBegin() and ctEnd(), which record three histograms: the time the call took, the slack
+	it left before the deadline and, for calls that missed it, how far they overran.
+	DiracPeakCpuUsagePercent() is an average and hides exactly the single slow calls that
+	cause dropouts, these show the whole distribution down to the worst call.
+
+	The histograms are log-linear like an HDR histogram: exact below 64 ns, then 32 buckets
+	per power of two, so every value is kept to within about 3%, up to 4.3 seconds.
+
+	The callback is the only writer and never waits: it marks its update with a sequence
+	number that is odd while it writes. Any other thread takes a consistent copy with
+	ctSnapshot(), which retries if the callback wrote in the meantime.
+
+	Recording is off until ctSetEnabled() switches it on, then it costs a test of a flag.
+	Define CALLBACK_TIMING to 0 to compile it out completely.
+
+	This file is header only, include it where you need it.
+
+*/
+
+#ifndef __CALLBACKTIMING__
+#define __CALLBACKTIMING__
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef CALLBACK_TIMING
+	#define CALLBACK_TIMING		1
+#endif
+
+#if defined(__APPLE__)
+	#include <mach/mach_time.h>
+	#define CT_BARRIER()		__sync_synchronize()
+#elif defined(_WIN32)
+	#include <windows.h>
+	#define CT_BARRIER()		MemoryBarrier()
+#else
+	#include <time.h>
+	#define CT_BARRIER()		__sync_synchronize()
+#endif
+
+
+#define kCtSubBucketBits	5						/* 32 buckets per power of two */
+#define kCtSubBuckets		(1 << kCtSubBucketBits)
+#define kCtMaxBits			32						/* values up to 2^32 ns, larger ones are counted as that */
+#define kCtNumBuckets		((kCtMaxBits - kCtSubBucketBits + 1) * kCtSubBuckets)
+
+// the histograms, see CallbackTimingSnapshot::sCounts
+enum {
+	kCtDuration = 0,				/* time the call took */
+	kCtSlack,						/* time left before the deadline, calls that made it */
+	kCtOverrun,						/* time past the deadline, calls that missed it */
+	kCtNumHistograms
+};
+
+
+typedef struct {
+	unsigned long long sCalls;
+	unsigned long long sMisses;						/* calls that took longer than their deadline */
+	unsigned long long sNanos, sDeadlineNanos;		/* sums over all calls */
+	unsigned long long sMaxNanos[kCtNumHistograms];
+	unsigned int sCounts[kCtNumHistograms][kCtNumBuckets];
+} CallbackTimingSnapshot;
+
+
+typedef struct {
+	volatile unsigned int sSequence;	/* odd while the callback writes */
+	volatile int sEnabled;
+	double sNanosPerTick;
+	double sNanosPerFrame;				/* the deadline of a call is its number of frames times this */
+	CallbackTimingSnapshot sData;
+} CallbackTiming;
+
+
+#pragma mark ---- Clock ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline unsigned long long ctTicks()
+{
+#if defined(__APPLE__)
+	return mach_absolute_time();
+#elif defined(_WIN32)
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (unsigned long long)now.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline double ctNanosPerTick()
+{
+#if defined(__APPLE__)
+	mach_timebase_info_data_t timebase;
+	mach_timebase_info(&timebase);
+	return (double)timebase.numer / (double)timebase.denom;
+#elif defined(_WIN32)
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return 1e9 / (double)frequency.QuadPart;
+#else
+	return 1.;
+#endif
+}
+
+
+#pragma mark ---- Histograms ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The bucket of value: values below 2*kCtSubBuckets have one each, above that each power of two
+ is split into kCtSubBuckets
+ */
+static inline int ctBucket(unsigned long long value)
+{
+	if (value >= (1ULL << kCtMaxBits))
+		value = (1ULL << kCtMaxBits) - 1;
+	if (value < 2*kCtSubBuckets)
+		return (int)value;
+	int msb = kCtSubBucketBits + 1;
+	while (value >> (msb + 1))
+		msb++;
+	int shift = msb - kCtSubBucketBits;
+	return shift * kCtSubBuckets + (int)(value >> shift);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The middle of the values that go into bucket
+ */
+static inline double ctBucketValue(int bucket)
+{
+	if (bucket < 2*kCtSubBuckets)
+		return (double)bucket;
+	int shift = bucket / kCtSubBuckets - 1;
+	unsigned long long low = (unsigned long long)(bucket - shift * kCtSubBuckets) << shift;
+	return (double)low + 0.5 * (double)((1ULL << shift) - 1);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline void ctRecord(CallbackTimingSnapshot *data, int histogram, unsigned long long nanos)
+{
+	data->sCounts[histogram][ctBucket(nanos)]++;
+	if (nanos > data->sMaxNanos[histogram])
+		data->sMaxNanos[histogram] = nanos;
+}
+
+
+#pragma mark ---- Recording ----
+
+//	-----------------------------------------------------------------------------------------
+//	Clears timing for callbacks that render audio at sampleRate, with recording off.
+//
+static inline void ctInit(CallbackTiming *timing, double sampleRate)
+{
+	memset(timing, 0, sizeof(CallbackTiming));
+	timing->sNanosPerTick = ctNanosPerTick();
+	timing->sNanosPerFrame = sampleRate > 0. ? 1e9 / sampleRate : 0.;
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Switches recording on or off. Can be called from any thread, a call that is under way
+//	when recording is switched on is not recorded.
+//
+static inline void ctSetEnabled(CallbackTiming *timing, bool enabled)
+{
+	timing->sEnabled = enabled;
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Call first thing in the callback and pass the result on to ctEnd(). Returns 0 if
+//	recording is off.
+//
+static inline unsigned long long ctBegin(CallbackTiming *timing)
+{
+#if CALLBACK_TIMING
+	if (timing && timing->sEnabled)
+		return ctTicks();
+#endif
+	return 0;
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Call last thing in the callback, with the number of frames it rendered. Records how long
+//	it took since ctBegin() returned start, against a deadline of numFrames / sample rate.
+//	Must only be called from one thread at a time.
+//
+static inline void ctEnd(CallbackTiming *timing, unsigned long long start, long numFrames)
+{
+#if CALLBACK_TIMING
+	if (!start)
+		return;
+	unsigned long long now = ctTicks();
+	unsigned long long nanos = now > start ? (unsigned long long)((double)(now - start) * timing->sNanosPerTick) : 0;
+	unsigned long long deadline = (unsigned long long)((double)numFrames * timing->sNanosPerFrame);
+
+	timing->sSequence++;
+	CT_BARRIER();
+	CallbackTimingSnapshot *data = &timing->sData;
+	data->sCalls++;
+	data->sNanos += nanos;
+	data->sDeadlineNanos += deadline;
+	ctRecord(data, kCtDuration, nanos);
+	if (nanos <= deadline)
+		ctRecord(data, kCtSlack, deadline - nanos);
+	else {
+		data->sMisses++;
+		ctRecord(data, kCtOverrun, nanos - deadline);
+	}
+	CT_BARRIER();
+	timing->sSequence++;
+#endif
+}
+//	-----------------------------------------------------------------------------------------
+
+
+#pragma mark ---- Reading ----
+
+//	-----------------------------------------------------------------------------------------
+//	Copies what was recorded so far into *snapshot. Call from any thread but the callback's.
+//	Returns false if the callback kept writing while we copied, which takes a callback that
+//	is called back to back, *snapshot is cleared in that case.
+//
+static inline bool ctSnapshot(const CallbackTiming *timing, CallbackTimingSnapshot *snapshot)
+{
+	for (int attempt = 0; attempt < 100; attempt++) {
+		unsigned int before = timing->sSequence;
+		CT_BARRIER();
+		if (before & 1)
+			continue;
+		memcpy(snapshot, (const void*)&timing->sData, sizeof(CallbackTimingSnapshot));
+		CT_BARRIER();
+		if (timing->sSequence == before)
+			return true;
+	}
+	memset(snapshot, 0, sizeof(CallbackTimingSnapshot));
+	return false;
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Adds snapshot to *sum, e.g. to report all channels of a plug-in together.
+//
+static inline void ctMerge(CallbackTimingSnapshot *sum, const CallbackTimingSnapshot *snapshot)
+{
+	sum->sCalls += snapshot->sCalls;
+	sum->sMisses += snapshot->sMisses;
+	sum->sNanos += snapshot->sNanos;
+	sum->sDeadlineNanos += snapshot->sDeadlineNanos;
+	for (int h = 0; h < kCtNumHistograms; h++) {
+		if (snapshot->sMaxNanos[h] > sum->sMaxNanos[h])
+			sum->sMaxNanos[h] = snapshot->sMaxNanos[h];
+		for (int b = 0; b < kCtNumBuckets; b++)
+			sum->sCounts[h][b] += snapshot->sCounts[h][b];
+	}
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the value in microseconds that percent of the values in the histogram are at or
+//	below, 0 if it is empty. percent = 99.9 gives the duration only one call in a thousand
+//	exceeds, percent = 0.1 the slack only one call in a thousand had less of.
+//
+static inline double ctPercentileMicros(const CallbackTimingSnapshot *snapshot, int histogram, double percent)
+{
+	unsigned long long total = 0, count = 0;
+	for (int b = 0; b < kCtNumBuckets; b++)
+		total += snapshot->sCounts[histogram][b];
+	if (!total)
+		return 0.;
+	unsigned long long rank = (unsigned long long)(percent / 100. * (double)total + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (int b = 0; b < kCtNumBuckets; b++) {
+		count += snapshot->sCounts[histogram][b];
+		if (count >= rank) {
+			double value = ctBucketValue(b);
+			return 1e-3 * (value < (double)snapshot->sMaxNanos[histogram] ? value : (double)snapshot->sMaxNanos[histogram]);
+		}
+	}
+	return 1e-3 * (double)snapshot->sMaxNanos[histogram];
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Describes snapshot in one line of text, for printf() or NSLog().
+//
+static inline void ctDescribe(const CallbackTimingSnapshot *snapshot, char *text, size_t size)
+{
+	if (!snapshot->sCalls) {
+		snprintf(text, size, "no calls recorded");
+		return;
+	}
+	snprintf(text, size, "%llu calls, %llu missed their deadline (%.3f%%), load %.1f%%, duration p50 %.0fus p99 %.0fus p99.9 %.0fus max %.0fus, "
+			 "slack p0.1 %.0fus p1 %.0fus, worst overrun %.0fus", snapshot->sCalls, snapshot->sMisses, 100. * (double)snapshot->sMisses / (double)snapshot->sCalls,
+			 snapshot->sDeadlineNanos ? 100. * (double)snapshot->sNanos / (double)snapshot->sDeadlineNanos : 0.,
+			 ctPercentileMicros(snapshot, kCtDuration, 50.), ctPercentileMicros(snapshot, kCtDuration, 99.), ctPercentileMicros(snapshot, kCtDuration, 99.9),
+			 1e-3 * (double)snapshot->sMaxNanos[kCtDuration], ctPercentileMicros(snapshot, kCtSlack, 0.1), ctPercentileMicros(snapshot, kCtSlack, 1.),
+			 1e-3 * (double)snapshot->sMaxNanos[kCtOverrun]);
+}
+//	-----------------------------------------------------------------------------------------
+
+
+#endif /* __CALLBACKTIMING__ */
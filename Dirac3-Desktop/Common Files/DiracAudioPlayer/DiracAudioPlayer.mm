@@ -10,6 +10,8 @@
 
 #import "DiracAudioPlayer.h"
 #import "Utilities.h"
+#include "PcmConvert.h"
+#include "BlockProfile.h"
 
 
 #pragma mark Callbacks
@@ -170,8 +172,12 @@ long DiracCoreDataProviderCallback(float **chdata, long numFrames, void *userDat
 				exit(-1);
 			}
 			
-			// This is the number of frames each call to Dirac will add to the cache.
-			long numFrames = 512;
+			// This is the number of frames each call to Dirac will add to the cache. We use what DiracCLI --tune
+			// found fastest on this machine, but never more than a quarter of the cache so the player stays responsive
+			bpLoad(NULL);
+			long numFrames = bpGetBlockSize(kDiracLambdaPreview, kDiracQualityPreview, mNumChannels, 512);
+			if (numFrames > kAudioBufferNumFrames/4)
+				numFrames = kAudioBufferNumFrames/4;
 			
 			DiracSetProperty(kDiracPropertyTimeFactor, mTimeFactor, mDirac);
 			DiracSetProperty(kDiracPropertyPitchFactor, mPitchFactor, mDirac);
@@ -224,22 +230,21 @@ long DiracCoreDataProviderCallback(float **chdata, long numFrames, void *userDat
 				// make a note of how many frames we have processed during this pass
 				mTotalFramesGenerated += ret;
 				
-				// add them to the cache
-				for (long v = 0; v < ret; v++) {
-					for (long c = 0; c < mNumChannels; c++) {
-						
-						float value = audio[c][v];
-						
-						// some settings might cause a slight increase in amplitude, make sure we don't cause nasty digital wrapping!
-						if (value > 0.999f) value = 0.999f;
-						else if (value < -1.f) value = -1.f;
-						
-						mAudioBuffer[c][mAudioBufferWritePos] = (SInt16)(value * 32768.f);
-					}
-					mAudioBufferWritePos++;
-					if (mAudioBufferWritePos > kAudioBufferNumFrames-1)
-						mAudioBufferWritePos = 0;
+				// add them to the cache. Some settings might cause a slight increase in amplitude,
+				// pcmFloatToInt() clips so we don't cause nasty digital wrapping!
+				long writePos = mAudioBufferWritePos;
+				for (long v = 0; v < ret; ) {
+					long n = ret-v;
+					if (n > kAudioBufferNumFrames-writePos)
+						n = kAudioBufferNumFrames-writePos;
+					for (long c = 0; c < mNumChannels; c++)
+						pcmFloatToInt(mAudioBuffer[c]+writePos, audio[c]+v, n, 16, false);
+					v += n;
+					writePos += n;
+					if (writePos > kAudioBufferNumFrames-1)
+						writePos = 0;
 				}
+				mAudioBufferWritePos = writePos;
 
 			} // END MAIN PROCESSING LOOP
 			
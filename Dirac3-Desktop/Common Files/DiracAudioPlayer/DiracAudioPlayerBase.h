@@ -13,6 +13,7 @@
 
 #import "EAFRead.h"
 #include "Dirac.h"
+#include "CallbackTiming.h"
 
 //#define DEBUG	1
 
@@ -73,6 +74,8 @@
 	
 	id mDelegate;
 	
+	CallbackTiming *mCallbackTiming;		/* how long PlaybackCallback takes, see CallbackTiming.h */
+	
 }
 
 
@@ -102,6 +105,8 @@
 - (void) stop;
 - (void) dealloc;
 - (void) setCurrentTime:(NSTimeInterval)time;
+- (void) setCallbackTimingEnabled:(BOOL)enabled;
+- (BOOL) callbackTiming:(CallbackTimingSnapshot*)snapshot;
 
 
 
@@ -130,6 +135,7 @@
 @property (readonly) int mNumberOfLoops;
 @property (readwrite) int mLoopCount;
 @property (readonly) int mNumChannels;
+@property (readonly) CallbackTiming *mCallbackTiming;
 
 
 @end
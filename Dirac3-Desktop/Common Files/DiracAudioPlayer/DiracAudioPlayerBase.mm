@@ -35,6 +35,10 @@ static OSStatus PlaybackCallback(void *inRefCon,
 	DiracAudioPlayerBase *Self = (__bridge DiracAudioPlayerBase *)inRefCon;
 	if (!Self) return -1;
 	
+	// time this call against the duration of the frames it plays, see CallbackTiming.h
+	CallbackTiming *timing = Self.mCallbackTiming;
+	unsigned long long timingStart = ctBegin(timing);
+	
 	int numChannels = Self.mNumChannels;
 	
 	// get the actual audio buffer from the ABL	
@@ -80,6 +84,7 @@ static OSStatus PlaybackCallback(void *inRefCon,
 end:
 	Self.mAudioBufferReadPos = audioBufferReadPos;
 	Self.mTotalFramesPlayed = totalFramesPlayed;
+	ctEnd(timing, timingStart, inNumberFrames);
     return noErr;
 }
 
@@ -285,6 +290,11 @@ end:
 	// this is the format we want
 	AudioStreamBasicDescription audioFormat;
 	mSampleRate=audioFormat.mSampleRate			= 44100.00;
+	
+	// off until setCallbackTimingEnabled:
+	mCallbackTiming = new CallbackTiming;
+	ctInit(mCallbackTiming, mSampleRate);
+	
 	audioFormat.mFormatID			= kAudioFormatLinearPCM;
 	audioFormat.mFormatFlags		= kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked;
 	audioFormat.mFramesPerPacket	= 1;
@@ -416,6 +426,26 @@ end:
 //	return (NSTimeInterval)mTotalFramesPlayed / mSampleRate;
 }
 
+// ---------------------------------------------------------------------------------------------------------------------------
+/*
+ Switches timing PlaybackCallback on or off. Off it costs the callback a test of a flag
+ */
+- (void) setCallbackTimingEnabled:(BOOL)enabled
+{
+	ctSetEnabled(mCallbackTiming, enabled);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+/*
+ Copies the duration, deadline slack and deadline misses of PlaybackCallback recorded so far.
+ Call from any thread but the audio thread, e.g. from a timer on the main thread. Returns NO
+ if the snapshot could not be taken and is empty
+ */
+- (BOOL) callbackTiming:(CallbackTimingSnapshot*)snapshot
+{
+	return ctSnapshot(mCallbackTiming, snapshot) ? YES : NO;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------
 - (void) play 
 {
@@ -500,6 +530,7 @@ end:
 	
 	delete[] 	mPeak;
 	delete[]	mPeakOut;
+	delete		mCallbackTiming;
 	
 	DeallocateAudioBuffer(mAudioBuffer, mNumChannels);
 #if __has_feature(objc_arc)
@@ -536,7 +567,7 @@ end:
 // ---------------------------------------------------------------------------------------------------------------------------
 #pragma mark accessors
 
-@synthesize mAudioUnit, mReader, mVolume, mNumberOfLoops, mNumChannels, mAudioBufferReadPos, mAudioBuffer, mDirac, mLoopCount, mPeak, mAudioBufferWritePos, mIsProcessing, mIsPrepared, mTotalFramesGenerated, mTotalFramesPlayed, mFramePositionInInputFile, mLastResetPositionInFile, mTotalFramesInFile, mTotalFramesConsumed;
+@synthesize mAudioUnit, mReader, mVolume, mNumberOfLoops, mNumChannels, mAudioBufferReadPos, mAudioBuffer, mDirac, mLoopCount, mPeak, mAudioBufferWritePos, mIsProcessing, mIsPrepared, mTotalFramesGenerated, mTotalFramesPlayed, mFramePositionInInputFile, mLastResetPositionInFile, mTotalFramesInFile, mTotalFramesConsumed, mCallbackTiming;
 
 @end
 
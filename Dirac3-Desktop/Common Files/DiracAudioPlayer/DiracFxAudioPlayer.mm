@@ -13,6 +13,7 @@
 #import <AudioUnit/AudioUnitProperties.h>
 #include "Dirac.h"
 #include "Utilities.h"
+#include "PcmConvert.h"
 
 
 #pragma mark Callbacks
@@ -154,14 +155,19 @@
 				mTotalFramesGenerated	+= framesOut;
 				
 				// add them to the cache
-				for (long v = 0; v < framesOut; v++) {
-					for (long c = 0; c < mNumChannels; c++) {
-						mAudioBuffer[c][mAudioBufferWritePos] = audioOut[c][v] * mVolume;
-					}
-					mAudioBufferWritePos++;
-					if (mAudioBufferWritePos > kAudioBufferNumFrames-1)
-						mAudioBufferWritePos = 0;
+				long writePos = mAudioBufferWritePos;
+				for (long v = 0; v < framesOut; ) {
+					long n = framesOut-v;
+					if (n > kAudioBufferNumFrames-writePos)
+						n = kAudioBufferNumFrames-writePos;
+					for (long c = 0; c < mNumChannels; c++)
+						pcmGainInt16(mAudioBuffer[c]+writePos, audioOut[c]+v, n, mVolume);
+					v += n;
+					writePos += n;
+					if (writePos > kAudioBufferNumFrames-1)
+						writePos = 0;
 				}
+				mAudioBufferWritePos = writePos;
 			} // END MAIN PROCESSING LOOP
 			mLoopCount++;
 			
@@ -0,0 +1,239 @@
+/*
+
+	DiracFeed
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	See DiracFeed.h for a description of the calls implemented here
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Dirac.h"
+#include "DiracFeed.h"
+
+
+struct DiracFeed {
+	long sNumChannels;
+	dfReadProc sReadProc;
+	void *sUserData;
+	long sInputFrames, sOutputFrames;	/* 0 until attached */
+	float **sPointers;					/* where in Dirac's buffer the next frames go */
+	float **sHeld;						/* one input buffer read ahead for odd sized requests */
+	long sHeldSize;						/* frames allocated per channel in sHeld */
+	long sHeldStart, sHeldFrames;		/* frames in sHeld not handed out yet */
+	bool sEnded;						/* sReadProc has reported the end of the input */
+	unsigned long sDirectReads, sStagedReads;
+};
+
+
+#pragma mark ---- Helpers ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Makes room for numFrames per channel in the buffer for held back frames, keeping those that
+ were not handed out yet. Returns false if out of memory
+ */
+static bool growHeld(DiracFeed *feed, long numFrames)
+{
+	if (numFrames <= feed->sHeldSize)
+		return true;
+
+	for (long c = 0; c < feed->sNumChannels; c++) {
+		float *held = (float*)malloc(numFrames*sizeof(float));
+		if (!held)
+			return false;
+		if (feed->sHeld[c] && feed->sHeldFrames > 0)
+			memcpy(held, feed->sHeld[c]+feed->sHeldStart, feed->sHeldFrames*sizeof(float));
+		free(feed->sHeld[c]);
+		feed->sHeld[c] = held;
+	}
+	feed->sHeldStart = 0;
+	feed->sHeldSize = numFrames;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Calls the read callback for numFrames into data at frame offset. Returns the number of frames
+ read and notes the end of the input if fewer came back
+ */
+static long readFrames(DiracFeed *feed, float **data, long offset, long numFrames)
+{
+	for (long c = 0; c < feed->sNumChannels; c++)
+		feed->sPointers[c] = data[c] + offset;
+	long res = feed->sReadProc(feed->sPointers, numFrames, feed->sUserData);
+	if (res < numFrames)
+		feed->sEnded = true;
+	return res > 0 ? res : 0;
+}
+
+
+#pragma mark ---- Feed ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+DiracFeed *dfCreate(long numChannels, dfReadProc readProc, void *userData)
+{
+	if (numChannels < 1 || !readProc)	return NULL;
+
+	DiracFeed *feed = (DiracFeed*)calloc(1, sizeof(DiracFeed));
+	if (!feed)	return NULL;
+	feed->sNumChannels	= numChannels;
+	feed->sReadProc		= readProc;
+	feed->sUserData		= userData;
+	feed->sPointers		= (float**)malloc(numChannels*sizeof(float*));
+	feed->sHeld			= (float**)calloc(numChannels, sizeof(float*));
+	if (!feed->sPointers || !feed->sHeld) {
+		dfDestroy(feed);
+		return NULL;
+	}
+	return feed;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long dfReadData(float **data, long numFrames, void *userData)
+{
+	DiracFeed *feed = (DiracFeed*)userData;
+	if (!feed || !data || numFrames <= 0)	return 0;
+
+	long inputFrames = feed->sInputFrames;
+	if (inputFrames <= 0) {
+		feed->sDirectReads++;
+		return feed->sReadProc(data, numFrames, feed->sUserData);
+	}
+
+	long done = 0;
+	bool staged = false;
+
+	// what was left over from the last request comes first
+	if (feed->sHeldFrames > 0) {
+		long n = feed->sHeldFrames < numFrames ? feed->sHeldFrames : numFrames;
+		for (long c = 0; c < feed->sNumChannels; c++)
+			memcpy(data[c], feed->sHeld[c]+feed->sHeldStart, n*sizeof(float));
+		feed->sHeldStart += n;
+		feed->sHeldFrames -= n;
+		done += n;
+		staged = true;
+	}
+
+	// whole input buffers are read straight into Dirac's buffer
+	long whole = ((numFrames - done) / inputFrames) * inputFrames;
+	if (whole > 0 && !feed->sEnded)
+		done += readFrames(feed, data, done, whole);
+
+	// for an odd rest we read a whole input buffer of our own and keep what is not needed yet
+	if (done < numFrames && !feed->sEnded) {
+		long read = readFrames(feed, feed->sHeld, 0, inputFrames);
+		long n = read < numFrames - done ? read : numFrames - done;
+		for (long c = 0; c < feed->sNumChannels; c++)
+			memcpy(data[c]+done, feed->sHeld[c], n*sizeof(float));
+		feed->sHeldStart = n;
+		feed->sHeldFrames = read - n;
+		done += n;
+		staged = true;
+	}
+
+	// past the end of the input there is only silence
+	if (done < numFrames) {
+		for (long c = 0; c < feed->sNumChannels; c++)
+			memset(data[c]+done, 0, (numFrames-done)*sizeof(float));
+	}
+
+	if (staged)
+		feed->sStagedReads++;
+	else
+		feed->sDirectReads++;
+	return done;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long dfAttach(DiracFeed *feed, void *dirac)
+{
+	if (!feed)	return 0;
+
+	long inputFrames = DiracGetInputBufferSizeInFrames(dirac);
+	if (inputFrames <= 0) {
+		feed->sInputFrames = feed->sOutputFrames = 0;
+		return 0;
+	}
+	if (!growHeld(feed, inputFrames))
+		return kDiracErrorMemErr;
+
+	long double timeFactor = DiracGetProperty(kDiracPropertyTimeFactor, dirac);
+	if (timeFactor <= 0.)
+		timeFactor = 1.;
+	feed->sInputFrames = inputFrames;
+	feed->sOutputFrames = (long)((long double)inputFrames * timeFactor + 0.5);
+	if (feed->sOutputFrames < 1)
+		feed->sOutputFrames = 1;
+	return inputFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long dfAlignInput(DiracFeed *feed, long numFrames)
+{
+	if (!feed || feed->sInputFrames <= 0)	return numFrames;
+
+	long inputFrames = feed->sInputFrames;
+	if (numFrames < inputFrames)
+		return inputFrames;
+	return ((numFrames + inputFrames - 1) / inputFrames) * inputFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long dfAlignOutput(DiracFeed *feed, long numFrames)
+{
+	if (!feed || feed->sOutputFrames <= 0)	return numFrames;
+
+	long outputFrames = feed->sOutputFrames;
+	long numBuffers = (numFrames + outputFrames/2) / outputFrames;
+	if (numBuffers < 1)
+		numBuffers = 1;
+	return numBuffers * outputFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void dfReset(DiracFeed *feed)
+{
+	if (!feed)	return;
+
+	feed->sHeldStart = feed->sHeldFrames = 0;
+	feed->sEnded = false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void dfGetStats(DiracFeed *feed, DiracFeedStats *stats)
+{
+	if (!stats)	return;
+
+	memset(stats, 0, sizeof(DiracFeedStats));
+	if (!feed)	return;
+	stats->sInputFrames		= feed->sInputFrames;
+	stats->sOutputFrames	= feed->sOutputFrames;
+	stats->sDirectReads		= feed->sDirectReads;
+	stats->sStagedReads		= feed->sStagedReads;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void dfDestroy(DiracFeed *feed)
+{
+	if (!feed)	return;
+
+	if (feed->sHeld) {
+		for (long c = 0; c < feed->sNumChannels; c++)
+			free(feed->sHeld[c]);
+	}
+	free(feed->sHeld);
+	free(feed->sPointers);
+	free(feed);
+}
@@ -0,0 +1,122 @@
+/*
+
+	DiracFeed
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	Abstract: Feeds a Dirac instance in steps of its input buffer, the number of frames
+	DiracGetInputBufferSizeInFrames() reports. Pass dfReadData() and the feed to DiracCreate()
+	instead of your own read callback, which the feed then calls in its place. Whenever Dirac
+	asks for whole input buffers, which is what it normally does, your callback is handed
+	Dirac's own buffer, so the input is decoded straight into it without an intermediate copy.
+	Should Dirac ever ask for an odd number of frames, the feed still only asks your callback
+	for whole input buffers, keeps what is left over and hands it out with the next request.
+
+	The feed also rounds ring buffer sizes and output block sizes to whole input buffers, so
+	a read ahead stage never has to split a request at the end of its ring and every call to
+	DiracProcess() produces whole internal steps.
+
+	This file is provided as source and should be compiled into your project.
+
+*/
+
+#ifndef __DIRACFEED__
+#define __DIRACFEED__
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//	-----------------------------------------------------------------------------------------
+//	Opaque handle to a feed, and the read callback it calls. The callback follows the rules of
+//	a Dirac read callback: it returns the number of frames read, fewer at the end of the input.
+//
+typedef struct DiracFeed DiracFeed;
+typedef long (*dfReadProc)(float **data, long numFrames, void *userData);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	How the reads went
+//
+typedef struct {
+	long sInputFrames;					/* frames per input buffer, 0 if not attached */
+	long sOutputFrames;					/* output frames per input buffer at the time factor */
+	unsigned long sDirectReads;			/* requests decoded straight into Dirac's buffer */
+	unsigned long sStagedReads;			/* requests that needed the feed's own buffer */
+} DiracFeedStats;
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Creates a feed for numChannels channels that reads from readProc. Until dfAttach() is
+//	called every request is passed on to readProc as it is.
+//	Returns NULL if out of memory.
+//
+DiracFeed *dfCreate(long numChannels, dfReadProc readProc, void *userData);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	The read callback to pass to DiracCreate(), with the feed as its userData.
+//
+long dfReadData(float **data, long numFrames, void *feed);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Queries the input buffer size of the Dirac instance the feed reads for. Call it after
+//	setting kDiracPropertyTimeFactor, and again whenever you change it.
+//	Returns the input buffer size in frames, 0 if the instance does not report one (the feed
+//	then passes requests on as they are), or kDiracErrorMemErr if out of memory.
+//
+long dfAttach(DiracFeed *feed, void *dirac);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Rounds numFrames up to whole input buffers. Use it for the size of read ahead rings and
+//	of the chunks they are filled in. Returns numFrames if the feed is not attached.
+//
+long dfAlignInput(DiracFeed *feed, long numFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Rounds numFrames to the closest number of output frames that Dirac makes out of whole
+//	input buffers, at least one. Use it for the number of frames per DiracProcess() call.
+//	Returns numFrames if the feed is not attached.
+//
+long dfAlignOutput(DiracFeed *feed, long numFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Discards the frames the feed holds back. Call it together with DiracReset(), for example
+//	after seeking the input.
+//
+void dfReset(DiracFeed *feed);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Fills in stats for feed.
+//
+void dfGetStats(DiracFeed *feed, DiracFeedStats *stats);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Frees the feed. The Dirac instance must not read from it any more.
+//
+void dfDestroy(DiracFeed *feed);
+//	-----------------------------------------------------------------------------------------
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DIRACFEED__ */
@@ -0,0 +1,405 @@
+/*
+
+	MiniAiffPrefetch
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	See MiniAiffPrefetch.h for a description of the calls implemented here
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <process.h>
+#else
+	#include <pthread.h>
+#endif
+
+#include "MiniAiffPrefetch.h"
+
+
+// error codes, see MiniAiff.h
+enum {
+	kMAiffErrNoErr			= 0,
+	kMAiffErrInternal		= -6,
+	kMAiffErrNoData			= -10,
+	kMAiffErrMem			= -108
+};
+
+
+#pragma mark ---- Threading primitives ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Full memory barrier. The ring counters are published with these, no locks are taken on the data path
+ */
+static inline void memoryBarrier()
+{
+#ifdef _WIN32
+	volatile LONG barrier = 0;
+	InterlockedExchange((LONG*)&barrier, 0);
+#else
+	__sync_synchronize();
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Auto reset event, used only to put one side to sleep while it waits for the other
+ */
+#ifdef _WIN32
+
+typedef HANDLE pfEvent;
+
+static bool eventInit(pfEvent *e)		{ *e = CreateEvent(NULL, FALSE, FALSE, NULL); return *e != NULL; }
+static void eventDestroy(pfEvent *e)	{ CloseHandle(*e); }
+static void eventSignal(pfEvent *e)		{ SetEvent(*e); }
+static void eventWait(pfEvent *e)		{ WaitForSingleObject(*e, INFINITE); }
+
+#else
+
+typedef struct {
+	pthread_mutex_t sLock;
+	pthread_cond_t sCond;
+	bool sSet;
+} pfEvent;
+
+static bool eventInit(pfEvent *e)
+{
+	e->sSet = false;
+	if (pthread_mutex_init(&e->sLock, NULL) != 0)	return false;
+	if (pthread_cond_init(&e->sCond, NULL) != 0) {
+		pthread_mutex_destroy(&e->sLock);
+		return false;
+	}
+	return true;
+}
+
+static void eventDestroy(pfEvent *e)
+{
+	pthread_cond_destroy(&e->sCond);
+	pthread_mutex_destroy(&e->sLock);
+}
+
+static void eventSignal(pfEvent *e)
+{
+	pthread_mutex_lock(&e->sLock);
+	e->sSet = true;
+	pthread_cond_signal(&e->sCond);
+	pthread_mutex_unlock(&e->sLock);
+}
+
+static void eventWait(pfEvent *e)
+{
+	pthread_mutex_lock(&e->sLock);
+	while (!e->sSet)
+		pthread_cond_wait(&e->sCond, &e->sLock);
+	e->sSet = false;
+	pthread_mutex_unlock(&e->sLock);
+}
+
+#endif
+
+
+#pragma mark ---- Prefetcher ----
+
+
+struct mAiffPrefetch {
+	mAiffFile *sFile;
+	long sNumChannels;
+	float **sRing;					/* sRing[channel][frame] */
+	long sRingFrames;
+	long sChunkFrames;
+
+	// frame counters, only ever increased by their owner (except on seek, see below)
+	volatile unsigned long sWriteCount;		/* owned by the background thread */
+	volatile unsigned long sReadCount;		/* owned by the reader */
+	volatile bool sEndOfFile;
+	volatile int sError;
+
+	volatile bool sReaderWaiting, sWriterWaiting;
+	volatile bool sSeekRequested, sExit;
+	unsigned long sSeekFrame;
+	pfEvent sDataAvailable, sSpaceAvailable, sSeekDone;
+
+	long sUnderruns;
+	bool sStarted;
+#ifdef _WIN32
+	HANDLE sThread;
+#else
+	pthread_t sThread;
+#endif
+};
+
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Decodes numFrames frames into the ring at the current write position, wrapping around if needed
+ */
+static int decodeIntoRing(mAiffPrefetch *pf, long numFrames)
+{
+	float *channels[64];
+	float **ptrs = pf->sNumChannels <= 64 ? channels : (float**)malloc(pf->sNumChannels*sizeof(float*));
+	if (!ptrs)	return kMAiffErrMem;
+
+	long pos = (long)(pf->sWriteCount % (unsigned long)pf->sRingFrames);
+	long first = pf->sRingFrames - pos;
+	if (first > numFrames)
+		first = numFrames;
+
+	for (long c = 0; c < pf->sNumChannels; c++)
+		ptrs[c] = pf->sRing[c] + pos;
+	int res = mAiffReadFrames(pf->sFile, ptrs, first, pf->sNumChannels);
+
+	if (res == first && first < numFrames) {
+		for (long c = 0; c < pf->sNumChannels; c++)
+			ptrs[c] = pf->sRing[c];
+		int res2 = mAiffReadFrames(pf->sFile, ptrs, numFrames-first, pf->sNumChannels);
+		res = res2 < 0 ? res2 : res + res2;
+	}
+
+	if (ptrs != channels)
+		free(ptrs);
+	return res;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Background thread: keeps the ring filled ahead of the reader
+ */
+#ifdef _WIN32
+static unsigned __stdcall prefetchThread(void *arg)
+#else
+static void *prefetchThread(void *arg)
+#endif
+{
+	mAiffPrefetch *pf = (mAiffPrefetch*)arg;
+
+	for (;;) {
+		memoryBarrier();
+		if (pf->sExit)
+			break;
+
+		if (pf->sSeekRequested) {
+			// the reader is blocked until we signal sSeekDone, so we may reset its counter too
+			int err = mAiffSeek(pf->sFile, pf->sSeekFrame);
+			pf->sReadCount = pf->sWriteCount = 0;
+			pf->sEndOfFile = (err != kMAiffErrNoErr);
+			pf->sError = err;
+			memoryBarrier();
+			pf->sSeekRequested = false;
+			eventSignal(&pf->sSeekDone);
+			continue;
+		}
+
+		long space = pf->sRingFrames - (long)(pf->sWriteCount - pf->sReadCount);
+		if (pf->sEndOfFile || space < pf->sChunkFrames) {
+			pf->sWriterWaiting = true;
+			memoryBarrier();
+			space = pf->sRingFrames - (long)(pf->sWriteCount - pf->sReadCount);
+			if ((pf->sEndOfFile || space < pf->sChunkFrames) && !pf->sSeekRequested && !pf->sExit)
+				eventWait(&pf->sSpaceAvailable);
+			pf->sWriterWaiting = false;
+			continue;
+		}
+
+		int res = decodeIntoRing(pf, pf->sChunkFrames);
+		if (res < 0) {
+			pf->sError = res;
+			res = 0;
+		}
+
+		// publish the frames, then the end of file flag
+		memoryBarrier();
+		pf->sWriteCount += res;
+		memoryBarrier();
+		if (res < pf->sChunkFrames)
+			pf->sEndOfFile = true;
+		memoryBarrier();
+		if (pf->sReaderWaiting)
+			eventSignal(&pf->sDataAvailable);
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+mAiffPrefetch *mAiffPrefetchCreate(mAiffFile *file, int numChannels, long ringFrames, long chunkFrames)
+{
+	if (!file || numChannels < 1 || chunkFrames < 1 || ringFrames < chunkFrames)
+		return NULL;
+
+	mAiffPrefetch *pf = (mAiffPrefetch*)calloc(1, sizeof(mAiffPrefetch));
+	if (!pf)	return NULL;
+
+	pf->sFile = file;
+	pf->sNumChannels = numChannels;
+	pf->sRingFrames = ringFrames;
+	pf->sChunkFrames = chunkFrames;
+
+	pf->sRing = (float**)calloc(numChannels, sizeof(float*));
+	if (!pf->sRing) {
+		mAiffPrefetchDestroy(pf);
+		return NULL;
+	}
+	for (long c = 0; c < numChannels; c++) {
+		pf->sRing[c] = (float*)malloc(ringFrames*sizeof(float));
+		if (!pf->sRing[c]) {
+			mAiffPrefetchDestroy(pf);
+			return NULL;
+		}
+	}
+
+	if (!eventInit(&pf->sDataAvailable)) {
+		mAiffPrefetchDestroy(pf);
+		return NULL;
+	}
+	if (!eventInit(&pf->sSpaceAvailable)) {
+		eventDestroy(&pf->sDataAvailable);
+		mAiffPrefetchDestroy(pf);
+		return NULL;
+	}
+	if (!eventInit(&pf->sSeekDone)) {
+		eventDestroy(&pf->sSpaceAvailable);
+		eventDestroy(&pf->sDataAvailable);
+		mAiffPrefetchDestroy(pf);
+		return NULL;
+	}
+
+#ifdef _WIN32
+	pf->sThread = (HANDLE)_beginthreadex(NULL, 0, prefetchThread, pf, 0, NULL);
+	pf->sStarted = (pf->sThread != 0);
+#else
+	pf->sStarted = (pthread_create(&pf->sThread, NULL, prefetchThread, pf) == 0);
+#endif
+	if (!pf->sStarted) {
+		eventDestroy(&pf->sSeekDone);
+		eventDestroy(&pf->sSpaceAvailable);
+		eventDestroy(&pf->sDataAvailable);
+		mAiffPrefetchDestroy(pf);
+		return NULL;
+	}
+	return pf;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffPrefetchRead(mAiffPrefetch *pf, float **data, int numFrames)
+{
+	if (!pf || !data)		return kMAiffErrInternal;
+	if (numFrames <= 0)		return kMAiffErrNoData;
+
+	long copied = 0;
+	bool waited = false;
+	while (copied < numFrames) {
+		memoryBarrier();
+		long available = (long)(pf->sWriteCount - pf->sReadCount);
+
+		if (!available) {
+			if (pf->sEndOfFile) {
+				// sEndOfFile is set after the last frames were published, so check once more
+				memoryBarrier();
+				if (pf->sWriteCount == pf->sReadCount)
+					break;
+				continue;
+			}
+			// true underrun: the background thread has not caught up yet
+			waited = true;
+			pf->sReaderWaiting = true;
+			memoryBarrier();
+			if (pf->sWriteCount == pf->sReadCount && !pf->sEndOfFile)
+				eventWait(&pf->sDataAvailable);
+			pf->sReaderWaiting = false;
+			continue;
+		}
+
+		long take = numFrames - copied;
+		if (take > available)
+			take = available;
+		long pos = (long)(pf->sReadCount % (unsigned long)pf->sRingFrames);
+		long first = pf->sRingFrames - pos;
+		if (first > take)
+			first = take;
+		for (long c = 0; c < pf->sNumChannels; c++) {
+			memcpy(data[c]+copied, pf->sRing[c]+pos, first*sizeof(float));
+			if (take > first)
+				memcpy(data[c]+copied+first, pf->sRing[c], (take-first)*sizeof(float));
+		}
+		copied += take;
+
+		// hand the space back to the background thread
+		memoryBarrier();
+		pf->sReadCount += take;
+		memoryBarrier();
+		if (pf->sWriterWaiting)
+			eventSignal(&pf->sSpaceAvailable);
+	}
+
+	if (waited)
+		pf->sUnderruns++;
+
+	for (long c = 0; c < pf->sNumChannels; c++)
+		memset(data[c]+copied, 0, (numFrames-copied)*sizeof(float));
+
+	if (!copied && pf->sError)
+		return pf->sError;
+	return (int)copied;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffPrefetchSeek(mAiffPrefetch *pf, unsigned long startFrame)
+{
+	if (!pf)	return kMAiffErrInternal;
+
+	pf->sSeekFrame = startFrame;
+	memoryBarrier();
+	pf->sSeekRequested = true;
+	memoryBarrier();
+	eventSignal(&pf->sSpaceAvailable);
+	while (pf->sSeekRequested)
+		eventWait(&pf->sSeekDone);
+
+	memoryBarrier();
+	return pf->sError;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long mAiffPrefetchGetUnderruns(mAiffPrefetch *pf)
+{
+	return pf ? pf->sUnderruns : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void mAiffPrefetchDestroy(mAiffPrefetch *pf)
+{
+	if (!pf)	return;
+
+	if (pf->sStarted) {
+		pf->sExit = true;
+		memoryBarrier();
+		eventSignal(&pf->sSpaceAvailable);
+#ifdef _WIN32
+		WaitForSingleObject(pf->sThread, INFINITE);
+		CloseHandle(pf->sThread);
+#else
+		pthread_join(pf->sThread, NULL);
+#endif
+		eventDestroy(&pf->sSeekDone);
+		eventDestroy(&pf->sSpaceAvailable);
+		eventDestroy(&pf->sDataAvailable);
+	}
+
+	if (pf->sRing) {
+		for (long c = 0; c < pf->sNumChannels; c++)
+			free(pf->sRing[c]);
+		free(pf->sRing);
+	}
+	free(pf);
+}
@@ -0,0 +1,87 @@
+/*
+
+	MiniAiffPrefetch
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	Abstract: Read-ahead for files opened with MiniAiffStream. A background thread decodes
+	frames ahead of the read position into a ring buffer of planar float channels. Reading
+	from the prefetcher is a copy out of that ring, so a Dirac read callback no longer waits
+	for the disk. It only blocks if the background thread has fallen behind (an underrun),
+	which is counted so the size of the ring can be adjusted.
+
+	The ring indices are lock free. The background thread and the reading thread only
+	synchronize when one of them has to wait for the other.
+
+	This file is provided as source and should be compiled into your project alongside
+	MiniAiffStream.cpp.
+
+*/
+
+#ifndef __MINIAIFFPREFETCH__
+#define __MINIAIFFPREFETCH__
+
+#include "MiniAiffStream.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//	-----------------------------------------------------------------------------------------
+//	Opaque handle to a prefetcher
+//
+typedef struct mAiffPrefetch mAiffPrefetch;
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Starts prefetching numChannels channels from file, beginning at its current read position.
+//	ringFrames is the number of frames held ahead of the reader, chunkFrames the number of
+//	frames decoded per read from the file. The file must not be used directly until the
+//	prefetcher is destroyed.
+//	Returns NULL if the ring could not be allocated or the thread could not be started.
+//
+mAiffPrefetch *mAiffPrefetchCreate(mAiffFile *file, int numChannels, long ringFrames, long chunkFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Same as mAiffReadFrames(), but copies the frames out of the ring. Waits only if fewer
+//	than numFrames frames have been decoded and the end of the file has not been reached.
+//	Returns the number of frames actually read (0 at the end of the file), or a negative
+//	error code.
+//
+int mAiffPrefetchRead(mAiffPrefetch *prefetch, float **data, int numFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Discards everything prefetched so far and restarts prefetching at startFrame.
+//	Returns 0 on success, or a negative error code.
+//
+int mAiffPrefetchSeek(mAiffPrefetch *prefetch, unsigned long startFrame);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of reads that had to wait for the background thread.
+//
+long mAiffPrefetchGetUnderruns(mAiffPrefetch *prefetch);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Stops the background thread and frees the ring. The file is not closed.
+//
+void mAiffPrefetchDestroy(mAiffPrefetch *prefetch);
+//	-----------------------------------------------------------------------------------------
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __MINIAIFFPREFETCH__ */
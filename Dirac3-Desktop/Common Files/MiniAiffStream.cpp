@@ -0,0 +1,925 @@
+/*
+
+	MiniAiffStream
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	See MiniAiffStream.h for a description of the calls implemented here
+
+*/
+
+// 64 bit file offsets, so files past 2 GB can be read and written by 32 bit programs
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+	#define _FILE_OFFSET_BITS	64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define MAIFF_HAS_MMAP	1
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+#else
+	#define MAIFF_HAS_MMAP	0
+#endif
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <process.h>
+#else
+	#include <pthread.h>
+#endif
+
+#include "MiniAiffStream.h"
+#include "PcmConvert.h"
+
+
+// size of the window we map when reading through mmap(). Kept well below the address space
+// of a 32 bit process; it is moved along the file as the read position advances
+#define kMAiffMapWindowBytes	(64L*1024L*1024L)
+
+// stdio buffer size of files opened for writing, this is the size of our writes to disk
+#define kMAiffWriteBufferBytes	(1024L*1024L)
+
+// size of the header mAiffCreate() writes: FORM, COMM and SSND chunk headers
+#define kMAiffHeaderBytes		54
+
+// number of bytes read from the start of a file in one go when parsing its header. The COMM
+// and SSND chunk headers of almost all files are found in there
+#define kMAiffProbeBytes		4096
+
+
+// error codes, see MiniAiff.h
+enum {
+	kMAiffErrNoErr			= 0,
+	kMAiffErrBadFile		= -3,
+	kMAiffErrRead			= -4,
+	kMAiffErrWrite			= -5,
+	kMAiffErrInternal		= -6,
+	kMAiffErrNoData			= -10,
+	kMAiffErrMem			= -108
+};
+
+
+struct mAiffFile {
+	FILE *sFile;
+	long sNumChannels;
+	unsigned long sNumFrames;
+	long sWordlength;				/* bits per sample */
+	long sBytesPerSample;
+	long sBytesPerFrame;
+	float sSampleRate;
+	long sDataOffset;				/* file offset of the first sample frame */
+	unsigned long sPosition;		/* current read position in frames */
+	unsigned char *sScratch;		/* raw sample data of the last read */
+	long sScratchSize;
+	float *sFloatScratch;			/* interleaved float data of the last read */
+	long sFloatScratchSize;
+
+	bool sMapped;					/* read through mmap() rather than stdio */
+	unsigned long long sFileSize;
+	unsigned char *sMapBase;		/* currently mapped window, NULL if none */
+	unsigned long long sMapOffset;	/* file offset of sMapBase */
+	size_t sMapLength;
+};
+
+
+struct mAiffWriter {
+	FILE *sFile;
+	char *sBuffer;					/* stdio buffer */
+	long sNumChannels;
+	long sBytesPerSample;
+	float sSampleRate;
+	unsigned long sFramesWritten;
+	unsigned char *sScratch;		/* big endian sample data of the current write */
+	long sScratchSize;
+	float *sFloatScratch;			/* interleaved float data of the current write */
+	long sFloatScratchSize;
+};
+
+
+#pragma mark ---- Helpers ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline unsigned long readBigEndian32(const unsigned char *p)
+{
+	return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) | ((unsigned long)p[2] << 8) | (unsigned long)p[3];
+}
+
+static inline unsigned short readBigEndian16(const unsigned char *p)
+{
+	return (unsigned short)((p[0] << 8) | p[1]);
+}
+
+static inline void writeBigEndian32(unsigned char *p, unsigned long v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static inline void writeBigEndian16(unsigned char *p, unsigned short v)
+{
+	p[0] = (unsigned char)(v >> 8);
+	p[1] = (unsigned char)v;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ fseek() and ftell() take a long, which is 32 bit in 32 bit programs and on Windows
+ */
+static int seekFile(FILE *f, unsigned long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(f, (__int64)offset, SEEK_SET);
+#else
+	return fseeko(f, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static long long fileSize(FILE *f)
+{
+#ifdef _WIN32
+	if (_fseeki64(f, 0, SEEK_END) != 0)		return -1;
+	return _ftelli64(f);
+#else
+	if (fseeko(f, 0, SEEK_END) != 0)		return -1;
+	return ftello(f);
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Converts the 80 bit IEEE 754 extended precision number used for the sample rate in the COMM chunk
+ */
+static double readExtended80(const unsigned char *p)
+{
+	int expon = ((p[0] & 0x7F) << 8) | p[1];
+	unsigned long hiMant = readBigEndian32(p+2);
+	unsigned long loMant = readBigEndian32(p+6);
+	double value;
+
+	if (expon == 0 && hiMant == 0 && loMant == 0)
+		value = 0.;
+	else if (expon == 0x7FFF)
+		value = HUGE_VAL;
+	else {
+		expon -= 16383;
+		value  = ldexp((double)hiMant, expon-31);
+		value += ldexp((double)loMant, expon-63);
+	}
+	return (p[0] & 0x80) ? -value : value;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Converts a positive sample rate to the 80 bit IEEE 754 extended precision format used in the COMM chunk
+ */
+static void writeExtended80(unsigned char *p, double value)
+{
+	memset(p, 0, 10);
+	if (value <= 0.)	return;
+
+	int expon;
+	double fraction = frexp(value, &expon);		// value = fraction * 2^expon, 0.5 <= fraction < 1
+	expon += 16382;
+	p[0] = (unsigned char)(expon >> 8);
+	p[1] = (unsigned char)expon;
+
+	fraction = ldexp(fraction, 32);
+	unsigned long hiMant = (unsigned long)floor(fraction);
+	unsigned long loMant = (unsigned long)floor(ldexp(fraction - floor(fraction), 32));
+	writeBigEndian32(p+2, hiMant);
+	writeBigEndian32(p+6, loMant);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Copies numBytes bytes at offset in the file to dst. The start of the file has already been read into
+ head, so on most files the whole header is parsed from there and the file is read only once
+ */
+static int readHeaderBytes(FILE *f, const unsigned char *head, long headBytes, unsigned long long offset, unsigned char *dst, long numBytes)
+{
+	if (offset + numBytes <= (unsigned long long)headBytes) {
+		memcpy(dst, head+offset, numBytes);
+		return kMAiffErrNoErr;
+	}
+	if (seekFile(f, offset) != 0)								return kMAiffErrRead;
+	if (fread(dst, 1, numBytes, f) != (size_t)numBytes)		return kMAiffErrRead;
+	return kMAiffErrNoErr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Walks the chunks in the FORM container and fills in the format and data location of the file
+ */
+static int parseHeader(FILE *f, mAiffInfo *info)
+{
+	unsigned char head[kMAiffProbeBytes];
+	long headBytes = (long)fread(head, 1, kMAiffProbeBytes, f);
+	if (headBytes < 12)											return kMAiffErrBadFile;
+	if (memcmp(head, "FORM", 4) != 0)							return kMAiffErrBadFile;
+
+	bool isAifc = (memcmp(head+8, "AIFC", 4) == 0);
+	if (!isAifc && memcmp(head+8, "AIFF", 4) != 0)				return kMAiffErrBadFile;
+
+	bool haveComm = false, haveSsnd = false;
+	unsigned long long chunkStart = 12;
+
+	while (!(haveComm && haveSsnd)) {
+		unsigned char chunkHeader[8];
+		if (readHeaderBytes(f, head, headBytes, chunkStart, chunkHeader, 8) != kMAiffErrNoErr)	break;
+		unsigned long chunkSize = readBigEndian32(chunkHeader+4);
+
+		if (memcmp(chunkHeader, "COMM", 4) == 0) {
+			unsigned char comm[22];
+			long commSize = isAifc ? 22 : 18;
+			if (chunkSize < (unsigned long)commSize)			return kMAiffErrBadFile;
+			if (readHeaderBytes(f, head, headBytes, chunkStart+8, comm, commSize) != kMAiffErrNoErr)	return kMAiffErrRead;
+
+			// we only read uncompressed data
+			if (isAifc && memcmp(comm+18, "NONE", 4) != 0 && memcmp(comm+18, "twos", 4) != 0)
+				return kMAiffErrBadFile;
+
+			info->sNumChannels	= readBigEndian16(comm);
+			info->sNumFrames	= readBigEndian32(comm+2);
+			info->sWordlength	= readBigEndian16(comm+6);
+			info->sSampleRate	= (float)readExtended80(comm+8);
+			haveComm = true;
+		} else if (memcmp(chunkHeader, "SSND", 4) == 0) {
+			unsigned char ssnd[8];
+			if (readHeaderBytes(f, head, headBytes, chunkStart+8, ssnd, 8) != kMAiffErrNoErr)	return kMAiffErrRead;
+			unsigned long long dataOffset = chunkStart + 16 + readBigEndian32(ssnd);
+			if (dataOffset > 0x7FFFFFFFULL)						return kMAiffErrBadFile;
+			info->sDataOffset = (long)dataOffset;
+			haveSsnd = true;
+		}
+
+		// chunks are padded to an even number of bytes
+		chunkStart += 8 + (((unsigned long long)chunkSize+1) & ~1ULL);
+	}
+
+	if (!haveComm || !haveSsnd)									return kMAiffErrBadFile;
+	if (info->sNumChannels < 1)									return kMAiffErrBadFile;
+	if (info->sWordlength < 1 || info->sWordlength > 32)		return kMAiffErrBadFile;
+
+	return kMAiffErrNoErr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Converts numFrames big endian frames from src into planar float. Channels beyond the number of
+ channels in the file are left untouched
+ */
+static int convertFrames(mAiffFile *file, const unsigned char *src, float **data, long numFrames, long numChannels)
+{
+	long channels = numChannels < file->sNumChannels ? numChannels : file->sNumChannels;
+
+	// mono goes straight into the caller's buffer
+	if (file->sNumChannels == 1) {
+		pcmIntToFloat(data[0], src, numFrames, 8*file->sBytesPerSample, true);
+		return kMAiffErrNoErr;
+	}
+
+	long numSamples = numFrames * file->sNumChannels;
+	if (numSamples > file->sFloatScratchSize) {
+		float *scratch = (float*)realloc(file->sFloatScratch, numSamples*sizeof(float));
+		if (!scratch)	return kMAiffErrMem;
+		file->sFloatScratch = scratch;
+		file->sFloatScratchSize = numSamples;
+	}
+	pcmIntToFloat(file->sFloatScratch, src, numSamples, 8*file->sBytesPerSample, true);
+	pcmDeinterleave(data, file->sFloatScratch, numFrames, file->sNumChannels, channels);
+	return kMAiffErrNoErr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Converts a single channel out of numFrames big endian frames
+ */
+static void convertChannel(mAiffFile *file, const unsigned char *src, float *out, long numFrames, long channel)
+{
+	long bytesPerSample = file->sBytesPerSample;
+	long bytesPerFrame = file->sBytesPerFrame;
+	const unsigned char *p = src + channel*bytesPerSample;
+
+	if (file->sNumChannels == 1) {
+		pcmIntToFloat(out, src, numFrames, 8*bytesPerSample, true);
+		return;
+	}
+	const float scale = 1.f / (float)(1UL << (8*bytesPerSample-1));
+	for (long s = 0; s < numFrames; s++, p += bytesPerFrame)
+		out[s] = (float)pcmReadSample(p, bytesPerSample, true) * scale;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns a pointer to the raw data of the next numFrames frames, either inside the mapped window
+ (which is moved along as needed) or in the scratch buffer after reading from the file. If a window
+ can't be mapped the file falls back to stdio for good
+ */
+static const unsigned char *fetchFrames(mAiffFile *file, long numFrames, long *framesFetched)
+{
+	long numBytes = numFrames * file->sBytesPerFrame;
+	unsigned long long byteOffset = file->sDataOffset + (unsigned long long)file->sPosition * file->sBytesPerFrame;
+	*framesFetched = 0;
+
+#if MAIFF_HAS_MMAP
+	if (file->sMapped) {
+		if (!file->sMapBase || byteOffset < file->sMapOffset || byteOffset+numBytes > file->sMapOffset+file->sMapLength) {
+			if (file->sMapBase)
+				munmap(file->sMapBase, file->sMapLength);
+			file->sMapBase = NULL;
+
+			long pageSize = sysconf(_SC_PAGESIZE);
+			unsigned long long start = byteOffset - byteOffset % pageSize;
+			long length = (long)(byteOffset+numBytes-start);
+			if (length < kMAiffMapWindowBytes)
+				length = kMAiffMapWindowBytes;
+			if (start+length > file->sFileSize)
+				length = (long)(file->sFileSize-start);
+
+			void *base = mmap(NULL, length, PROT_READ, MAP_SHARED, fileno(file->sFile), (off_t)start);
+			if (base != MAP_FAILED) {
+				madvise(base, length, MADV_SEQUENTIAL);
+				file->sMapBase = (unsigned char*)base;
+				file->sMapOffset = start;
+				file->sMapLength = length;
+			}
+			else {
+				// out of address space (a 32 bit process with several files open), read the rest through stdio
+				file->sMapped = false;
+				if (seekFile(file->sFile, byteOffset) != 0)
+					return NULL;
+			}
+		}
+		if (file->sMapped) {
+			*framesFetched = numFrames;
+			return file->sMapBase + (byteOffset - file->sMapOffset);
+		}
+	}
+#endif
+
+	if (numBytes > file->sScratchSize) {
+		unsigned char *scratch = (unsigned char*)realloc(file->sScratch, numBytes);
+		if (!scratch)	return NULL;
+		file->sScratch = scratch;
+		file->sScratchSize = numBytes;
+	}
+	*framesFetched = (long)fread(file->sScratch, file->sBytesPerFrame, numFrames, file->sFile);
+	if (*framesFetched < numFrames && ferror(file->sFile))
+		return NULL;
+	return file->sScratch;
+}
+
+
+#pragma mark ---- API ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+mAiffFile *mAiffOpen(char *filename)
+{
+	if (!filename)	return NULL;
+
+	mAiffFile *file = (mAiffFile*)calloc(1, sizeof(mAiffFile));
+	if (!file)		return NULL;
+
+	mAiffInfo info;
+	memset(&info, 0, sizeof(info));
+	file->sFile = fopen(filename, "rb");
+	if (!file->sFile || parseHeader(file->sFile, &info) != kMAiffErrNoErr) {
+		mAiffClose(file);
+		return NULL;
+	}
+
+	file->sNumChannels		= info.sNumChannels;
+	file->sNumFrames		= info.sNumFrames;
+	file->sWordlength		= info.sWordlength;
+	file->sSampleRate		= info.sSampleRate;
+	file->sDataOffset		= info.sDataOffset;
+	file->sBytesPerSample	= (file->sWordlength+7)/8;
+	file->sBytesPerFrame	= file->sBytesPerSample * file->sNumChannels;
+
+	if (mAiffSeek(file, 0) != kMAiffErrNoErr) {
+		mAiffClose(file);
+		return NULL;
+	}
+	return file;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffProbe(char *filename, mAiffInfo *info)
+{
+	if (!filename || !info)	return kMAiffErrInternal;
+	memset(info, 0, sizeof(mAiffInfo));
+
+	FILE *f = fopen(filename, "rb");
+	if (!f)	return kMAiffErrBadFile;
+
+	// one read of kMAiffProbeBytes is all most files need, so don't let stdio read more than that
+	setvbuf(f, NULL, _IONBF, 0);
+	int err = parseHeader(f, info);
+	fclose(f);
+
+	if (err != kMAiffErrNoErr)
+		memset(info, 0, sizeof(mAiffInfo));
+	return err;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+	char **sFilenames;
+	mAiffInfo *sInfo;
+	long sNumFiles;
+	volatile long sNextFile;
+	volatile long sNumFailed;
+} ProbeJob;
+
+static long atomicIncrement(volatile long *value)
+{
+#ifdef _WIN32
+	return InterlockedIncrement((LONG*)value) - 1;
+#else
+	return __sync_fetch_and_add(value, 1);
+#endif
+}
+
+/*
+ Worker: probes files until all are taken. Each file is handed out to exactly one worker
+ */
+#ifdef _WIN32
+static unsigned __stdcall probeThread(void *arg)
+#else
+static void *probeThread(void *arg)
+#endif
+{
+	ProbeJob *job = (ProbeJob*)arg;
+	for (;;) {
+		long v = atomicIncrement(&job->sNextFile);
+		if (v >= job->sNumFiles)
+			break;
+		if (mAiffProbe(job->sFilenames[v], job->sInfo+v) != kMAiffErrNoErr)
+			atomicIncrement(&job->sNumFailed);
+	}
+	return 0;
+}
+
+long mAiffProbeFiles(char **filenames, long numFiles, mAiffInfo *info, int numThreads)
+{
+	if (!filenames || !info || numFiles < 0)	return kMAiffErrInternal;
+
+	ProbeJob job;
+	job.sFilenames	= filenames;
+	job.sInfo		= info;
+	job.sNumFiles	= numFiles;
+	job.sNextFile	= 0;
+	job.sNumFailed	= 0;
+
+	if (numThreads > numFiles)
+		numThreads = (int)numFiles;
+
+	// the calling thread is one of the workers
+	long numStarted = 0;
+#if defined(_WIN32) && !defined(_MT)
+	// stdio is not thread safe with the single threaded runtime, probe one file after the other
+	probeThread(&job);
+	void *threads = NULL;
+#elif defined(_WIN32)
+	HANDLE *threads = numThreads > 1 ? (HANDLE*)malloc((numThreads-1)*sizeof(HANDLE)) : NULL;
+	for (long t = 0; threads && t < numThreads-1; t++) {
+		threads[numStarted] = (HANDLE)_beginthreadex(NULL, 0, probeThread, &job, 0, NULL);
+		if (threads[numStarted])
+			numStarted++;
+	}
+	probeThread(&job);
+	for (long t = 0; t < numStarted; t++) {
+		WaitForSingleObject(threads[t], INFINITE);
+		CloseHandle(threads[t]);
+	}
+#else
+	pthread_t *threads = numThreads > 1 ? (pthread_t*)malloc((numThreads-1)*sizeof(pthread_t)) : NULL;
+	for (long t = 0; threads && t < numThreads-1; t++) {
+		if (pthread_create(&threads[numStarted], NULL, probeThread, &job) == 0)
+			numStarted++;
+	}
+	probeThread(&job);
+	for (long t = 0; t < numStarted; t++)
+		pthread_join(threads[t], NULL);
+#endif
+	free(threads);
+
+	return job.sNumFailed;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+mAiffFile *mAiffOpenMapped(char *filename)
+{
+	mAiffFile *file = mAiffOpen(filename);
+
+#if MAIFF_HAS_MMAP
+	struct stat st;
+	if (file && fstat(fileno(file->sFile), &st) == 0 && (unsigned long long)st.st_size > (unsigned long long)file->sDataOffset) {
+		file->sMapped = true;
+		file->sFileSize = (unsigned long long)st.st_size;
+
+		// never map beyond the end of a truncated file
+		unsigned long framesInFile = (file->sFileSize - file->sDataOffset) / file->sBytesPerFrame;
+		if (framesInFile < file->sNumFrames)
+			file->sNumFrames = framesInFile;
+	}
+#endif
+
+	return file;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void mAiffClose(mAiffFile *file)
+{
+	if (!file)	return;
+#if MAIFF_HAS_MMAP
+	if (file->sMapBase)
+		munmap(file->sMapBase, file->sMapLength);
+#endif
+	if (file->sFile)
+		fclose(file->sFile);
+	free(file->sScratch);
+	free(file->sFloatScratch);
+	free(file);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffReadFrames(mAiffFile *file, float **data, int numFrames, int numChannels)
+{
+	if (!file || !data)					return kMAiffErrInternal;
+	if (numFrames <= 0)					return kMAiffErrNoData;
+
+	long framesToRead = 0;
+	if (file->sPosition < file->sNumFrames) {
+		unsigned long framesLeft = file->sNumFrames - file->sPosition;
+		framesToRead = framesLeft < (unsigned long)numFrames ? (long)framesLeft : numFrames;
+	}
+
+	long framesRead = 0;
+	if (framesToRead > 0) {
+		const unsigned char *src = fetchFrames(file, framesToRead, &framesRead);
+		if (!src)						return kMAiffErrRead;
+		if (convertFrames(file, src, data, framesRead, numChannels) != kMAiffErrNoErr)
+			return kMAiffErrMem;
+		file->sPosition += framesRead;
+	}
+
+	// zero whatever we could not fill from the file
+	for (long c = 0; c < numChannels; c++) {
+		if (c < file->sNumChannels)
+			memset(data[c]+framesRead, 0, (numFrames-framesRead)*sizeof(float));
+		else
+			memset(data[c], 0, numFrames*sizeof(float));
+	}
+
+	return (int)framesRead;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffReadFramesFromChannel(mAiffFile *file, float *data, int numFrames, int channel)
+{
+	if (!file || !data)					return kMAiffErrInternal;
+	if (numFrames <= 0)					return kMAiffErrNoData;
+
+	long framesToRead = 0;
+	if (file->sPosition < file->sNumFrames && channel >= 0 && channel < file->sNumChannels) {
+		unsigned long framesLeft = file->sNumFrames - file->sPosition;
+		framesToRead = framesLeft < (unsigned long)numFrames ? (long)framesLeft : numFrames;
+	}
+
+	long framesRead = 0;
+	if (framesToRead > 0) {
+		const unsigned char *src = fetchFrames(file, framesToRead, &framesRead);
+		if (!src)						return kMAiffErrRead;
+		convertChannel(file, src, data, framesRead, channel);
+		file->sPosition += framesRead;
+	}
+
+	memset(data+framesRead, 0, (numFrames-framesRead)*sizeof(float));
+
+	return (int)framesRead;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffSeek(mAiffFile *file, unsigned long startFrame)
+{
+	if (!file)	return kMAiffErrInternal;
+
+	file->sPosition = startFrame;
+	if (startFrame >= file->sNumFrames || file->sMapped)
+		return kMAiffErrNoErr;
+
+	if (seekFile(file->sFile, file->sDataOffset + (unsigned long long)startFrame * file->sBytesPerFrame) != 0)
+		return kMAiffErrRead;
+	return kMAiffErrNoErr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+unsigned long mAiffTell(mAiffFile *file)
+{
+	return file ? file->sPosition : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes the FORM/COMM/SSND header for the number of frames written so far
+ */
+static int writeHeader(mAiffWriter *writer)
+{
+	unsigned long dataBytes = (unsigned long)((unsigned long long)writer->sFramesWritten * writer->sNumChannels * writer->sBytesPerSample);
+	unsigned char header[kMAiffHeaderBytes];
+
+	memcpy(header, "FORM", 4);
+	writeBigEndian32(header+4, kMAiffHeaderBytes - 8 + dataBytes + (dataBytes & 1));
+	memcpy(header+8, "AIFF", 4);
+
+	memcpy(header+12, "COMM", 4);
+	writeBigEndian32(header+16, 18);
+	writeBigEndian16(header+20, (unsigned short)writer->sNumChannels);
+	writeBigEndian32(header+22, writer->sFramesWritten);
+	writeBigEndian16(header+26, (unsigned short)(writer->sBytesPerSample*8));
+	writeExtended80(header+28, writer->sSampleRate);
+
+	memcpy(header+38, "SSND", 4);
+	writeBigEndian32(header+42, 8 + dataBytes);
+	writeBigEndian32(header+46, 0);		// offset
+	writeBigEndian32(header+50, 0);		// block size
+
+	if (seekFile(writer->sFile, 0) != 0)										return kMAiffErrWrite;
+	if (fwrite(header, 1, kMAiffHeaderBytes, writer->sFile) != kMAiffHeaderBytes)	return kMAiffErrWrite;
+	return kMAiffErrNoErr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The chunk sizes in the header are 32 bit. Rather than wrap them around, we refuse writes that
+ would take the file past kMAiffMaxDataBytes
+ */
+static bool fitsIntoFile(mAiffWriter *writer, unsigned long endFrame)
+{
+	return (unsigned long long)endFrame * writer->sNumChannels * writer->sBytesPerSample <= kMAiffMaxDataBytes;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+mAiffWriter *mAiffCreate(char *filename, float sampleRate, int sampleSize, int numChannels)
+{
+	if (!filename || numChannels < 1 || sampleSize < 1 || sampleSize > 32)	return NULL;
+
+	mAiffWriter *writer = (mAiffWriter*)calloc(1, sizeof(mAiffWriter));
+	if (!writer)	return NULL;
+
+	writer->sNumChannels = numChannels;
+	writer->sBytesPerSample = (sampleSize+7)/8;
+	writer->sSampleRate = sampleRate;
+
+	writer->sFile = fopen(filename, "wb");
+	if (!writer->sFile) {
+		free(writer);
+		return NULL;
+	}
+	writer->sBuffer = (char*)malloc(kMAiffWriteBufferBytes);
+	if (writer->sBuffer)
+		setvbuf(writer->sFile, writer->sBuffer, _IOFBF, kMAiffWriteBufferBytes);
+
+	if (writeHeader(writer) != kMAiffErrNoErr) {
+		fclose(writer->sFile);
+		free(writer->sBuffer);
+		free(writer);
+		return NULL;
+	}
+	return writer;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffPreallocate(mAiffWriter *writer, unsigned long numFrames)
+{
+	if (!writer)	return kMAiffErrInternal;
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+	off_t numBytes = (off_t)kMAiffHeaderBytes + (off_t)numFrames * writer->sNumChannels * writer->sBytesPerSample;
+	if (fallocate(fileno(writer->sFile), FALLOC_FL_KEEP_SIZE, 0, numBytes) != 0)
+		return kMAiffErrWrite;
+#endif
+	return kMAiffErrNoErr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffWriteFrames(mAiffWriter *writer, float **data, int numFrames, int numChannels)
+{
+	if (!writer || !data)			return kMAiffErrInternal;
+	if (numFrames <= 0)				return kMAiffErrNoData;
+	if (writer->sFramesWritten + (unsigned long)numFrames < writer->sFramesWritten || !fitsIntoFile(writer, writer->sFramesWritten + numFrames))
+		return kMAiffErrWrite;
+
+	long bytesPerSample = writer->sBytesPerSample;
+	long bytesPerFrame = bytesPerSample * writer->sNumChannels;
+	long numBytes = numFrames * bytesPerFrame;
+	if (numBytes > writer->sScratchSize) {
+		unsigned char *scratch = (unsigned char*)realloc(writer->sScratch, numBytes);
+		if (!scratch)				return kMAiffErrMem;
+		writer->sScratch = scratch;
+		writer->sScratchSize = numBytes;
+	}
+	long numSamples = numFrames * writer->sNumChannels;
+	if (numSamples > writer->sFloatScratchSize) {
+		float *scratch = (float*)realloc(writer->sFloatScratch, numSamples*sizeof(float));
+		if (!scratch)				return kMAiffErrMem;
+		writer->sFloatScratch = scratch;
+		writer->sFloatScratchSize = numSamples;
+	}
+
+	pcmInterleave(writer->sFloatScratch, data, numFrames, writer->sNumChannels, numChannels);
+	pcmFloatToInt(writer->sScratch, writer->sFloatScratch, numSamples, 8*bytesPerSample, true);
+
+	if (fwrite(writer->sScratch, bytesPerFrame, numFrames, writer->sFile) != (size_t)numFrames)
+		return kMAiffErrWrite;
+	writer->sFramesWritten += numFrames;
+	return numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffWriteFramesAt(mAiffWriter *writer, unsigned long startFrame, float **data, int numFrames, int numChannels)
+{
+	if (!writer || !data)			return kMAiffErrInternal;
+	if (numFrames <= 0)				return kMAiffErrNoData;
+	if (startFrame + (unsigned long)numFrames < startFrame || !fitsIntoFile(writer, startFrame + numFrames))
+		return kMAiffErrWrite;
+
+	// several threads may be in here at once, so we can't use the writer's scratch buffers
+	long bytesPerSample = writer->sBytesPerSample;
+	long numSamples = numFrames * writer->sNumChannels;
+	float *interleaved = (float*)malloc(numSamples*sizeof(float));
+	unsigned char *raw = (unsigned char*)malloc(numSamples*bytesPerSample);
+	if (!interleaved || !raw) {
+		free(interleaved);
+		free(raw);
+		return kMAiffErrMem;
+	}
+	pcmInterleave(interleaved, data, numFrames, writer->sNumChannels, numChannels);
+	pcmFloatToInt(raw, interleaved, numSamples, 8*bytesPerSample, true);
+
+	long numBytes = numSamples * bytesPerSample;
+	unsigned long long offset = kMAiffHeaderBytes + (unsigned long long)startFrame * writer->sNumChannels * bytesPerSample;
+	int err = kMAiffErrNoErr;
+#if defined(__unix__) || defined(__APPLE__)
+	if (pwrite(fileno(writer->sFile), raw, numBytes, (off_t)offset) != numBytes)
+		err = kMAiffErrWrite;
+#else
+	if (seekFile(writer->sFile, offset) != 0 || fwrite(raw, 1, numBytes, writer->sFile) != (size_t)numBytes)
+		err = kMAiffErrWrite;
+#endif
+	free(interleaved);
+	free(raw);
+	if (err != kMAiffErrNoErr)
+		return err;
+
+	// the file is as long as the furthest write
+	unsigned long endFrame = startFrame + numFrames;
+	for (;;) {
+		unsigned long framesWritten = writer->sFramesWritten;
+		if (endFrame <= framesWritten)
+			break;
+#if defined(_WIN32)
+		if ((unsigned long)InterlockedCompareExchange((LONG*)&writer->sFramesWritten, (LONG)endFrame, (LONG)framesWritten) == framesWritten)
+			break;
+#else
+		if (__sync_bool_compare_and_swap(&writer->sFramesWritten, framesWritten, endFrame))
+			break;
+#endif
+	}
+	return numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffFlush(mAiffWriter *writer)
+{
+	if (!writer)	return kMAiffErrInternal;
+
+	// the header is at the start of the file, appending goes on at the end of the data
+	unsigned long long dataEnd = kMAiffHeaderBytes + (unsigned long long)writer->sFramesWritten * writer->sNumChannels * writer->sBytesPerSample;
+	if (fflush(writer->sFile) != 0)								return kMAiffErrWrite;
+	if (writeHeader(writer) != kMAiffErrNoErr)					return kMAiffErrWrite;
+	if (seekFile(writer->sFile, dataEnd) != 0)					return kMAiffErrWrite;
+	if (fflush(writer->sFile) != 0)								return kMAiffErrWrite;
+#if defined(__unix__) || defined(__APPLE__)
+	if (fsync(fileno(writer->sFile)) != 0)						return kMAiffErrWrite;
+#endif
+	return kMAiffErrNoErr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+mAiffWriter *mAiffReopen(char *filename, unsigned long numFrames)
+{
+	if (!filename)	return NULL;
+
+	// mAiffCreate() always writes the same header, which the data directly follows
+	mAiffInfo info;
+	memset(&info, 0, sizeof(mAiffInfo));
+	FILE *f = fopen(filename, "rb");
+	if (!f)	return NULL;
+	int err = parseHeader(f, &info);
+	long long size = fileSize(f);
+	fclose(f);
+	if (err != kMAiffErrNoErr || info.sDataOffset != kMAiffHeaderBytes)	return NULL;
+
+	long bytesPerSample = (info.sWordlength+7)/8;
+	long long dataEnd = kMAiffHeaderBytes + (long long)numFrames * info.sNumChannels * bytesPerSample;
+	if (size < dataEnd)	return NULL;
+
+	mAiffWriter *writer = (mAiffWriter*)calloc(1, sizeof(mAiffWriter));
+	if (!writer)	return NULL;
+
+	writer->sNumChannels = info.sNumChannels;
+	writer->sBytesPerSample = bytesPerSample;
+	writer->sSampleRate = info.sSampleRate;
+	writer->sFramesWritten = numFrames;
+
+	writer->sFile = fopen(filename, "r+b");
+	if (!writer->sFile) {
+		free(writer);
+		return NULL;
+	}
+	writer->sBuffer = (char*)malloc(kMAiffWriteBufferBytes);
+	if (writer->sBuffer)
+		setvbuf(writer->sFile, writer->sBuffer, _IOFBF, kMAiffWriteBufferBytes);
+
+	// elsewhere the old data past numFrames stays in the file, but outside of the chunks
+#if defined(__unix__) || defined(__APPLE__)
+	if (ftruncate(fileno(writer->sFile), (off_t)dataEnd) != 0)
+		err = kMAiffErrWrite;
+#endif
+	if (err == kMAiffErrNoErr && seekFile(writer->sFile, dataEnd) != 0)
+		err = kMAiffErrWrite;
+	if (err != kMAiffErrNoErr) {
+		fclose(writer->sFile);
+		free(writer->sBuffer);
+		free(writer);
+		return NULL;
+	}
+	return writer;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+unsigned long mAiffGetFramesWritten(mAiffWriter *writer)
+{
+	return writer ? writer->sFramesWritten : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+unsigned long long mAiffGetBytesWritten(mAiffWriter *writer)
+{
+	if (!writer)	return 0;
+	return kMAiffHeaderBytes + (unsigned long long)writer->sFramesWritten * writer->sNumChannels * writer->sBytesPerSample;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int mAiffCloseWriter(mAiffWriter *writer)
+{
+	if (!writer)	return kMAiffErrInternal;
+
+	int err = kMAiffErrNoErr;
+	unsigned long long dataBytes = (unsigned long long)writer->sFramesWritten * writer->sNumChannels * writer->sBytesPerSample;
+	if (dataBytes & 1) {
+		// chunks are padded to an even number of bytes. With mAiffWriteFramesAt() the end of the data
+		// need not be where stdio left off
+		if (seekFile(writer->sFile, kMAiffHeaderBytes + dataBytes) != 0 || fputc(0, writer->sFile) == EOF)
+			err = kMAiffErrWrite;
+	}
+	if (writeHeader(writer) != kMAiffErrNoErr)
+		err = kMAiffErrWrite;
+	if (fclose(writer->sFile) != 0)
+		err = kMAiffErrWrite;
+
+	free(writer->sBuffer);
+	free(writer->sScratch);
+	free(writer->sFloatScratch);
+	free(writer);
+	return err;
+}
@@ -0,0 +1,246 @@
+/*
+
+	MiniAiffStream
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	Abstract: Handle based companion to MiniAiff. The path based calls in MiniAiff.h open the
+	file, parse the FORM/COMM/SSND chunks and seek to the requested position every time they
+	are called. This is fine for the occasional read but expensive when called once per block
+	from a Dirac read callback. The routines below open the file once, cache the parsed header
+	and the current file offset, and then read sequentially from there. Samples are converted
+	with the vectorized routines in PcmConvert.h.
+
+	Return values and sample conversion follow MiniAiff: error codes are the same as listed in
+	MiniAiff.h, samples are converted to float in the range [-1.0, +1.0).
+
+	File offsets are 64 bit, also in 32 bit programs, so files between 2 and 4 GB can be read
+	and written. Beyond that the 32 bit chunk sizes of AIFF itself are the limit.
+
+	This file is provided as source and should be compiled into your project alongside
+	libMiniAiff.
+
+*/
+
+#ifndef __MINIAIFFSTREAM__
+#define __MINIAIFFSTREAM__
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//	-----------------------------------------------------------------------------------------
+//	Opaque handle to an AIFF file opened for reading
+//
+typedef struct mAiffFile mAiffFile;
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Format of an AIFF file as returned by mAiffProbe()
+//
+typedef struct {
+	float sSampleRate;
+	long sNumChannels;
+	unsigned long sNumFrames;
+	long sWordlength;				/* bits per sample */
+	long sDataOffset;				/* file offset of the first sample frame */
+} mAiffInfo;
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Reads the format of the AIFF file specified in *filename into *info. This replaces calls
+//	to mAiffGetSampleRate(), mAiffGetNumberOfChannels(), mAiffGetNumberOfFrames() and
+//	mAiffGetWordlength(), each of which opens and parses the file again. mAiffProbe() opens
+//	the file once and usually reads it once.
+//	Returns 0 on success, or a negative error code. On error *info is set to zero.
+//
+int mAiffProbe(char *filename, mAiffInfo *info);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Same as mAiffProbe() for numFiles files, filling in info[0...numFiles-1]. Up to numThreads
+//	files are probed at the same time, which hides most of the latency of slow or networked
+//	file systems when probing many files. Files that could not be probed have their info set
+//	to zero (a sample rate of 0 marks them as invalid, as with mAiffGetSampleRate()).
+//	Returns the number of files that could not be probed, or a negative error code.
+//
+long mAiffProbeFiles(char **filenames, long numFiles, mAiffInfo *info, int numThreads);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Opens the AIFF file specified in *filename for reading and parses its header. The read
+//	position is set to the first frame in the file.
+//	Returns NULL if the file could not be opened or is not a valid uncompressed AIFF file.
+//
+mAiffFile *mAiffOpen(char *filename);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Same as mAiffOpen(), but the sample data is read through a memory mapped window onto the
+//	SSND chunk instead of being copied into a buffer with read(). Samples are converted straight
+//	from the mapped pages into your buffers. This is the fastest way to read large files
+//	sequentially. On platforms without mmap() this is identical to mAiffOpen().
+//
+mAiffFile *mAiffOpenMapped(char *filename);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Closes a file opened with mAiffOpen() and releases all memory associated with it.
+//
+void mAiffClose(mAiffFile *file);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Reads numFrames frames starting at the current read position, converts them to the range
+//	[-1.0, +1.0) and returns them as float in data[0...numChannels-1][0...numFrames-1]. The
+//	read position is advanced by the number of frames actually read.
+//	If there are fewer channels in the file than you have requested in numChannels, the unused
+//	channel data is set to zero. If the end of the file is reached before numFrames frames
+//	could be read, the remaining frames are set to zero.
+//	Returns the number of frames actually read (0 at the end of the file), or a negative error
+//	code.
+//
+int mAiffReadFrames(mAiffFile *file, float **data, int numFrames, int numChannels);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Same as mAiffReadFrames(), but reads a single channel (0...numChannels-1) into
+//	data[0...numFrames-1]. The read position is advanced for all channels.
+//
+int mAiffReadFramesFromChannel(mAiffFile *file, float *data, int numFrames, int channel);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Sets the read position to the frame startFrame. Positions past the end of the file are
+//	allowed, subsequent reads will return 0.
+//	Returns 0 on success, or a negative error code.
+//
+int mAiffSeek(mAiffFile *file, unsigned long startFrame);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the current read position in frames.
+//
+unsigned long mAiffTell(mAiffFile *file);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Opaque handle to an AIFF file opened for writing
+//
+typedef struct mAiffWriter mAiffWriter;
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	The most bytes of sample data an AIFF file written by mAiffCreate() can hold. Its chunk
+//	sizes are 32 bit, so writes that would go past this fail with kMAiffErrWrite.
+//
+#define kMAiffMaxDataBytes		(0xFFFFFFFFULL - 54)
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Creates (or clears) the AIFF file specified in *filename for writing with the given format.
+//	Unlike mAiffInitFile()/mAiffWriteData(), the file stays open until mAiffCloseWriter() is
+//	called and writes are buffered, so many small appends turn into few large writes. Sample
+//	sizes of 8, 16, 24 and 32 bit are supported.
+//	Returns NULL if the file could not be created.
+//
+mAiffWriter *mAiffCreate(char *filename, float sampleRate, int sampleSize, int numChannels);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Reserves disk space for numFrames frames of audio without changing the size of the file.
+//	This keeps the file contiguous on disk and avoids allocating blocks while writing. Only
+//	has an effect on Linux, elsewhere it does nothing.
+//	Returns 0 on success, or a negative error code.
+//
+int mAiffPreallocate(mAiffWriter *writer, unsigned long numFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Appends the data in data[0...numChannels-1][0...numFrames-1] to the file. Samples are
+//	clipped to [-1.0, +1.0).
+//	Returns the number of frames written, or a negative error code. Nothing is written if the
+//	data would not fit into kMAiffMaxDataBytes.
+//
+int mAiffWriteFrames(mAiffWriter *writer, float **data, int numFrames, int numChannels);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Same as mAiffWriteFrames(), but writes the frames at the frame position startFrame instead
+//	of appending them. The file grows to the end of the furthest write, gaps read as silence.
+//	On Mac and Linux this may be called from several threads at once for ranges that don't
+//	overlap, it must not be mixed with mAiffWriteFrames() on the same writer.
+//	Returns the number of frames written, or a negative error code.
+//
+int mAiffWriteFramesAt(mAiffWriter *writer, unsigned long startFrame, float **data, int numFrames, int numChannels);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Writes all buffered data to the file and updates the header, so the file is a valid AIFF
+//	file of the frames written so far even if mAiffCloseWriter() is never called. On Mac and
+//	Linux the file is synced to the disk as well. Must not be called while another thread
+//	writes to the file.
+//	Returns 0 on success, or a negative error code.
+//
+int mAiffFlush(mAiffWriter *writer);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Opens the AIFF file specified in *filename, written by mAiffCreate(), to continue writing
+//	after its first numFrames frames. Whatever follows them is discarded. Used to pick up an
+//	interrupted render where it left off.
+//	Returns NULL if the file could not be opened, was not written by mAiffCreate() or holds
+//	fewer than numFrames frames.
+//
+mAiffWriter *mAiffReopen(char *filename, unsigned long numFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of frames written to the file so far.
+//
+unsigned long mAiffGetFramesWritten(mAiffWriter *writer);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of bytes written to the file so far, including the header.
+//
+unsigned long long mAiffGetBytesWritten(mAiffWriter *writer);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Flushes all buffered data, writes the final chunk sizes into the header and closes the file.
+//	Returns 0 on success, or a negative error code.
+//
+int mAiffCloseWriter(mAiffWriter *writer);
+//	-----------------------------------------------------------------------------------------
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __MINIAIFFSTREAM__ */
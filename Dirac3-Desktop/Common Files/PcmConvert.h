@@ -0,0 +1,757 @@
+/*
+
+	PcmConvert
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	Abstract: Conversion between integer PCM and float sample data, plus the interleaving,
+	clamping and gain steps that go with it. Every place in the examples that moves samples
+	between a file or device format and the float format Dirac works with uses these
+	routines, so they run on the audio and processing threads of all examples.
+
+	All routines come in a scalar version and SSE2, SSSE3 and AVX2 versions on x86. The
+	fastest version the CPU supports is chosen at run time, so the SIMD code is used even if
+	the rest of the project is built for an older CPU. Interleaving and deinterleaving are
+	specialized at compile time for 1, 2, 4, 6 and 8 channels.
+
+	Integer samples are signed and 8, 16, 24 (packed, 3 bytes) or 32 bits wide, in either
+	byte order. Float samples are in the range [-1.0, +1.0).
+
+	This file is header only, include it where you need it. Building the AVX2 code requires
+	gcc 4.9, clang 3.8 or Visual Studio 2013 or later, older compilers get the scalar code.
+
+*/
+
+#ifndef __PCMCONVERT__
+#define __PCMCONVERT__
+
+#include <string.h>
+#include <math.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+	#define PCM_X86			1
+	#define PCM_TARGET(x)	__attribute__((target(x)))
+	#include <cpuid.h>
+	#include <immintrin.h>
+#elif defined(_MSC_VER) && _MSC_VER >= 1800 && (defined(_M_IX86) || defined(_M_X64))
+	#define PCM_X86			1
+	#define PCM_TARGET(x)
+	#include <intrin.h>
+	#include <immintrin.h>
+#else
+	#define PCM_X86			0
+#endif
+
+
+//	-----------------------------------------------------------------------------------------
+//	CPU features that pcmCpuFeatures() reports
+//
+enum {
+	kPcmCpuSSE2		= 1,
+	kPcmCpuSSSE3	= 2,
+	kPcmCpuAVX2		= 4
+};
+//	-----------------------------------------------------------------------------------------
+
+
+#pragma mark ---- CPU dispatch ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static int pcmDetectCpu()
+{
+	int features = 0;
+#if PCM_X86 && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	if (info[3] & (1 << 26))	features |= kPcmCpuSSE2;
+	if (info[2] & (1 << 9))		features |= kPcmCpuSSSE3;
+	// AVX2 also needs the OS to save the upper halves of the ymm registers
+	bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+	if (osSavesYmm && maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5))	features |= kPcmCpuAVX2;
+	}
+#elif PCM_X86
+	unsigned int a, b, c, d;
+	unsigned int maxLeaf = __get_cpuid_max(0, 0);
+	if (maxLeaf >= 1) {
+		__cpuid(1, a, b, c, d);
+		if (d & (1 << 26))		features |= kPcmCpuSSE2;
+		if (c & (1 << 9))		features |= kPcmCpuSSSE3;
+		bool osSavesYmm = false;
+		if ((c & (1 << 27)) && (c & (1 << 28))) {
+			unsigned int xcr0Lo, xcr0Hi;
+			__asm__ __volatile__ ("xgetbv" : "=a" (xcr0Lo), "=d" (xcr0Hi) : "c" (0));
+			osSavesYmm = ((xcr0Lo & 6) == 6);
+		}
+		if (osSavesYmm && maxLeaf >= 7) {
+			__cpuid_count(7, 0, a, b, c, d);
+			if (b & (1 << 5))	features |= kPcmCpuAVX2;
+		}
+	}
+#endif
+	return features;
+}
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the kPcmCpu... flags of the CPU we are running on. The CPU is only queried once.
+//
+static inline int pcmCpuFeatures()
+{
+	static int features = -1;
+	if (features < 0)
+		features = pcmDetectCpu();
+	return features;
+}
+//	-----------------------------------------------------------------------------------------
+
+
+#pragma mark ---- Scalar ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline long pcmReadSample(const unsigned char *p, long bytesPerSample, bool bigEndian)
+{
+	switch (bytesPerSample) {
+		case 1:		return (signed char)p[0];
+		case 2:		return bigEndian ? (short)((p[0] << 8) | p[1]) : (short)((p[1] << 8) | p[0]);
+		case 3:		return bigEndian ? (((long)(signed char)p[0] << 16) | ((long)p[1] << 8) | (long)p[2])
+								 : (((long)(signed char)p[2] << 16) | ((long)p[1] << 8) | (long)p[0]);
+		case 4:		return bigEndian ? (long)(int)(((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3])
+								 : (long)(int)(((unsigned int)p[3] << 24) | ((unsigned int)p[2] << 16) | ((unsigned int)p[1] << 8) | p[0]);
+	}
+	return 0;
+}
+
+static inline void pcmWriteSample(unsigned char *p, long v, long bytesPerSample, bool bigEndian)
+{
+	for (long b = 0; b < bytesPerSample; b++) {
+		long shift = 8*(bigEndian ? bytesPerSample-1-b : b);
+		p[b] = (unsigned char)(v >> shift);
+	}
+}
+
+// rounds to nearest with ties to even, as _mm_cvtps_epi32() does, so scalar and SIMD code agree
+static inline long pcmRound(float x)
+{
+#if defined(_MSC_VER) && _MSC_VER < 1800
+	double r = floor((double)x);
+	double d = (double)x - r;
+	if (d > .5 || (d == .5 && fmod(r, 2.) != 0.))
+		r += 1.;
+	return (long)r;
+#else
+	return lrintf(x);
+#endif
+}
+
+static void pcmIntToFloatScalar(float *dst, const unsigned char *src, long numSamples, long bytesPerSample, bool bigEndian)
+{
+	const float scale = 1.f / (float)(1UL << (8*bytesPerSample-1));
+	for (long s = 0; s < numSamples; s++, src += bytesPerSample)
+		dst[s] = (float)pcmReadSample(src, bytesPerSample, bigEndian) * scale;
+}
+
+// largest float below 1.0 that still maps to the largest integer after scaling
+static inline float pcmFullScaleLimit(long bytesPerSample)
+{
+	return bytesPerSample == 4 ? 1.f - 1.f/16777216.f : 1.f - 1.f/(float)(1UL << (8*bytesPerSample-1));
+}
+
+static void pcmFloatToIntScalar(unsigned char *dst, const float *src, long numSamples, long bytesPerSample, bool bigEndian)
+{
+	const float scale = (float)ldexp(1., (int)(8*bytesPerSample-1));
+	const float hi = pcmFullScaleLimit(bytesPerSample);
+	for (long s = 0; s < numSamples; s++, dst += bytesPerSample) {
+		float x = src[s];
+		if (!(x > -1.f))	x = -1.f;		// also catches NaN
+		if (x > hi)			x = hi;
+		pcmWriteSample(dst, pcmRound(x * scale), bytesPerSample, bigEndian);
+	}
+}
+
+
+#if PCM_X86
+#pragma mark ---- SSE2 ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+PCM_TARGET("sse2") static inline __m128i pcmSwap16SSE2(__m128i x)
+{
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+PCM_TARGET("sse2") static inline __m128i pcmSwap32SSE2(__m128i x)
+{
+	x = pcmSwap16SSE2(x);
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+}
+
+// clamps to [-1.0, hi], scales and rounds to nearest
+PCM_TARGET("sse2") static inline __m128i pcmQuantizeSSE2(__m128 x, __m128 hi, __m128 scale)
+{
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.f)), hi);
+	return _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+}
+
+PCM_TARGET("sse2") static long pcmIntToFloatSSE2(float *dst, const unsigned char *src, long numSamples, long bytesPerSample, bool bigEndian)
+{
+	long s = 0;
+	const __m128i zero = _mm_setzero_si128();
+	switch (bytesPerSample) {
+		case 1: {
+			// move each byte to the top of a 32 bit lane so the sign comes for free
+			const __m128 scale = _mm_set1_ps(1.f/2147483648.f);
+			for (; s+16 <= numSamples; s += 16) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(src+s));
+				__m128i lo = _mm_unpacklo_epi8(zero, x), hi = _mm_unpackhi_epi8(zero, x);
+				_mm_storeu_ps(dst+s,    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, lo)), scale));
+				_mm_storeu_ps(dst+s+4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, lo)), scale));
+				_mm_storeu_ps(dst+s+8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, hi)), scale));
+				_mm_storeu_ps(dst+s+12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, hi)), scale));
+			}
+			break;
+		}
+		case 2: {
+			const __m128 scale = _mm_set1_ps(1.f/32768.f);
+			for (; s+8 <= numSamples; s += 8) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(src+2*s));
+				if (bigEndian)
+					x = pcmSwap16SSE2(x);
+				__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+				__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+				_mm_storeu_ps(dst+s,   _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+				_mm_storeu_ps(dst+s+4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+			}
+			break;
+		}
+		case 4: {
+			const __m128 scale = _mm_set1_ps(1.f/2147483648.f);
+			for (; s+4 <= numSamples; s += 4) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(src+4*s));
+				if (bigEndian)
+					x = pcmSwap32SSE2(x);
+				_mm_storeu_ps(dst+s, _mm_mul_ps(_mm_cvtepi32_ps(x), scale));
+			}
+			break;
+		}
+	}
+	return s;
+}
+
+PCM_TARGET("sse2") static long pcmFloatToIntSSE2(unsigned char *dst, const float *src, long numSamples, long bytesPerSample, bool bigEndian)
+{
+	long s = 0;
+	const __m128 hi = _mm_set1_ps(pcmFullScaleLimit(bytesPerSample));
+	const __m128 scale = _mm_set1_ps((float)(1UL << (8*bytesPerSample-1)));
+	switch (bytesPerSample) {
+		case 1:
+			for (; s+16 <= numSamples; s += 16) {
+				__m128i a = pcmQuantizeSSE2(_mm_loadu_ps(src+s),    hi, scale);
+				__m128i b = pcmQuantizeSSE2(_mm_loadu_ps(src+s+4),  hi, scale);
+				__m128i c = pcmQuantizeSSE2(_mm_loadu_ps(src+s+8),  hi, scale);
+				__m128i d = pcmQuantizeSSE2(_mm_loadu_ps(src+s+12), hi, scale);
+				_mm_storeu_si128((__m128i*)(dst+s), _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+			}
+			break;
+		case 2:
+			for (; s+8 <= numSamples; s += 8) {
+				__m128i a = pcmQuantizeSSE2(_mm_loadu_ps(src+s),   hi, scale);
+				__m128i b = pcmQuantizeSSE2(_mm_loadu_ps(src+s+4), hi, scale);
+				__m128i x = _mm_packs_epi32(a, b);
+				if (bigEndian)
+					x = pcmSwap16SSE2(x);
+				_mm_storeu_si128((__m128i*)(dst+2*s), x);
+			}
+			break;
+		case 4: {
+			// 1.0 does not fit into 32 bits, the limit is the largest float below 1.0
+			const __m128 scale32 = _mm_set1_ps(2147483648.f);
+			for (; s+4 <= numSamples; s += 4) {
+				__m128i x = pcmQuantizeSSE2(_mm_loadu_ps(src+s), hi, scale32);
+				if (bigEndian)
+					x = pcmSwap32SSE2(x);
+				_mm_storeu_si128((__m128i*)(dst+4*s), x);
+			}
+			break;
+		}
+	}
+	return s;
+}
+
+PCM_TARGET("sse2") static long pcmGainSSE2(float *dst, const float *src, long numSamples, float gain)
+{
+	long s = 0;
+	const __m128 g = _mm_set1_ps(gain);
+	for (; s+4 <= numSamples; s += 4)
+		_mm_storeu_ps(dst+s, _mm_mul_ps(_mm_loadu_ps(src+s), g));
+	return s;
+}
+
+PCM_TARGET("sse2") static long pcmGainInt16SSE2(short *dst, const short *src, long numSamples, float gain)
+{
+	long s = 0;
+	const __m128 g = _mm_set1_ps(gain);
+	const __m128 minimum = _mm_set1_ps(-32768.f), maximum = _mm_set1_ps(32767.f);
+	for (; s+8 <= numSamples; s += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(src+s));
+		__m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), g);
+		__m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), g);
+		// clamped before converting, so products beyond the 32 bit range saturate as in the scalar code
+		lo = _mm_min_ps(_mm_max_ps(lo, minimum), maximum);
+		hi = _mm_min_ps(_mm_max_ps(hi, minimum), maximum);
+		_mm_storeu_si128((__m128i*)(dst+s), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+	}
+	return s;
+}
+
+PCM_TARGET("sse2") static long pcmClampSSE2(float *dst, const float *src, long numSamples, float lo, float hi)
+{
+	long s = 0;
+	const __m128 l = _mm_set1_ps(lo), h = _mm_set1_ps(hi);
+	for (; s+4 <= numSamples; s += 4)
+		_mm_storeu_ps(dst+s, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src+s), l), h));
+	return s;
+}
+
+PCM_TARGET("sse2") static long pcmDeinterleave2SSE2(float **dst, const float *src, long numFrames)
+{
+	long s = 0;
+	float *l = dst[0], *r = dst[1];
+	for (; s+4 <= numFrames; s += 4) {
+		__m128 a = _mm_loadu_ps(src+2*s);
+		__m128 b = _mm_loadu_ps(src+2*s+4);
+		_mm_storeu_ps(l+s, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)));
+		_mm_storeu_ps(r+s, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1)));
+	}
+	return s;
+}
+
+PCM_TARGET("sse2") static long pcmInterleave2SSE2(float *dst, float **src, long numFrames)
+{
+	long s = 0;
+	const float *l = src[0], *r = src[1];
+	for (; s+4 <= numFrames; s += 4) {
+		__m128 a = _mm_loadu_ps(l+s);
+		__m128 b = _mm_loadu_ps(r+s);
+		_mm_storeu_ps(dst+2*s,   _mm_unpacklo_ps(a, b));
+		_mm_storeu_ps(dst+2*s+4, _mm_unpackhi_ps(a, b));
+	}
+	return s;
+}
+
+PCM_TARGET("sse2") static long pcmDeinterleave4SSE2(float **dst, const float *src, long numFrames)
+{
+	long s = 0;
+	for (; s+4 <= numFrames; s += 4) {
+		__m128 a = _mm_loadu_ps(src+4*s),   b = _mm_loadu_ps(src+4*s+4);
+		__m128 c = _mm_loadu_ps(src+4*s+8), d = _mm_loadu_ps(src+4*s+12);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		_mm_storeu_ps(dst[0]+s, a);
+		_mm_storeu_ps(dst[1]+s, b);
+		_mm_storeu_ps(dst[2]+s, c);
+		_mm_storeu_ps(dst[3]+s, d);
+	}
+	return s;
+}
+
+PCM_TARGET("sse2") static long pcmInterleave4SSE2(float *dst, float **src, long numFrames)
+{
+	long s = 0;
+	for (; s+4 <= numFrames; s += 4) {
+		__m128 a = _mm_loadu_ps(src[0]+s), b = _mm_loadu_ps(src[1]+s);
+		__m128 c = _mm_loadu_ps(src[2]+s), d = _mm_loadu_ps(src[3]+s);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		_mm_storeu_ps(dst+4*s,    a);
+		_mm_storeu_ps(dst+4*s+4,  b);
+		_mm_storeu_ps(dst+4*s+8,  c);
+		_mm_storeu_ps(dst+4*s+12, d);
+	}
+	return s;
+}
+
+
+#pragma mark ---- SSSE3 ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ 24 bit samples: byte shuffles move the three sample bytes of each sample into a 32 bit lane
+ */
+PCM_TARGET("ssse3") static long pcmIntToFloatSSSE3(float *dst, const unsigned char *src, long numSamples, long bytesPerSample, bool bigEndian)
+{
+	if (bytesPerSample != 3)
+		return pcmIntToFloatSSE2(dst, src, numSamples, bytesPerSample, bigEndian);
+
+	long s = 0;
+	// place the sample bytes in the upper 24 bits of each lane, then shift down with sign
+	const __m128i shuffle = bigEndian ? _mm_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9)
+									  : _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+	const __m128 scale = _mm_set1_ps(1.f/8388608.f);
+	// each load touches 16 bytes but only consumes 12
+	for (; s+6 <= numSamples; s += 4) {
+		__m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src+3*s)), shuffle);
+		_mm_storeu_ps(dst+s, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(x, 8)), scale));
+	}
+	return s;
+}
+
+PCM_TARGET("ssse3") static long pcmFloatToIntSSSE3(unsigned char *dst, const float *src, long numSamples, long bytesPerSample, bool bigEndian)
+{
+	if (bytesPerSample != 3)
+		return pcmFloatToIntSSE2(dst, src, numSamples, bytesPerSample, bigEndian);
+
+	long s = 0;
+	const __m128 hi = _mm_set1_ps(pcmFullScaleLimit(3));
+	const __m128 scale = _mm_set1_ps(8388608.f);
+	// pack the low three bytes of each lane into the first 12 bytes
+	const __m128i shuffle = bigEndian ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+									  : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	for (; s+4 <= numSamples; s += 4) {
+		__m128i x = _mm_shuffle_epi8(pcmQuantizeSSE2(_mm_loadu_ps(src+s), hi, scale), shuffle);
+		_mm_storel_epi64((__m128i*)(dst+3*s), x);
+		int last = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+		memcpy(dst+3*s+8, &last, 4);
+	}
+	return s;
+}
+
+
+#pragma mark ---- AVX2 ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+PCM_TARGET("avx2") static long pcmIntToFloatAVX2(float *dst, const unsigned char *src, long numSamples, long bytesPerSample, bool bigEndian)
+{
+	long s = 0;
+	switch (bytesPerSample) {
+		case 1: {
+			const __m256 scale = _mm256_set1_ps(1.f/128.f);
+			for (; s+8 <= numSamples; s += 8) {
+				__m256i x = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(src+s)));
+				_mm256_storeu_ps(dst+s, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+			}
+			break;
+		}
+		case 2: {
+			const __m256 scale = _mm256_set1_ps(1.f/32768.f);
+			for (; s+8 <= numSamples; s += 8) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(src+2*s));
+				if (bigEndian)
+					x = pcmSwap16SSE2(x);
+				_mm256_storeu_ps(dst+s, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x)), scale));
+			}
+			break;
+		}
+		case 3: {
+			// bytes 0-11 go to the low lane, bytes 12-23 to the high lane, then the same shuffle as SSSE3
+			const __m256i permute = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+			const __m256i shuffle = bigEndian ? _mm256_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9,
+																 -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9)
+											  : _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+																 -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+			const __m256 scale = _mm256_set1_ps(1.f/8388608.f);
+			// each load touches 32 bytes but only consumes 24
+			for (; s+11 <= numSamples; s += 8) {
+				__m256i x = _mm256_loadu_si256((const __m256i*)(src+3*s));
+				x = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(x, permute), shuffle);
+				_mm256_storeu_ps(dst+s, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(x, 8)), scale));
+			}
+			break;
+		}
+		case 4: {
+			const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+												  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+			const __m256 scale = _mm256_set1_ps(1.f/2147483648.f);
+			for (; s+8 <= numSamples; s += 8) {
+				__m256i x = _mm256_loadu_si256((const __m256i*)(src+4*s));
+				if (bigEndian)
+					x = _mm256_shuffle_epi8(x, swap);
+				_mm256_storeu_ps(dst+s, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+			}
+			break;
+		}
+	}
+	return s;
+}
+
+PCM_TARGET("avx2") static inline __m256i pcmQuantizeAVX2(__m256 x, __m256 hi, __m256 scale)
+{
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.f)), hi);
+	return _mm256_cvtps_epi32(_mm256_mul_ps(x, scale));
+}
+
+PCM_TARGET("avx2") static long pcmFloatToIntAVX2(unsigned char *dst, const float *src, long numSamples, long bytesPerSample, bool bigEndian)
+{
+	long s = 0;
+	const __m256 hi = _mm256_set1_ps(pcmFullScaleLimit(bytesPerSample));
+	switch (bytesPerSample) {
+		case 2: {
+			const __m256 scale = _mm256_set1_ps(32768.f);
+			for (; s+16 <= numSamples; s += 16) {
+				__m256i a = pcmQuantizeAVX2(_mm256_loadu_ps(src+s),   hi, scale);
+				__m256i b = pcmQuantizeAVX2(_mm256_loadu_ps(src+s+8), hi, scale);
+				// packs works per 128 bit lane, put the quarters back in order
+				__m256i x = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3,1,2,0));
+				if (bigEndian)
+					x = _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8));
+				_mm256_storeu_si256((__m256i*)(dst+2*s), x);
+			}
+			break;
+		}
+		case 4: {
+			const __m256 scale = _mm256_set1_ps(2147483648.f);
+			const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+												  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+			for (; s+8 <= numSamples; s += 8) {
+				__m256i x = pcmQuantizeAVX2(_mm256_loadu_ps(src+s), hi, scale);
+				if (bigEndian)
+					x = _mm256_shuffle_epi8(x, swap);
+				_mm256_storeu_si256((__m256i*)(dst+4*s), x);
+			}
+			break;
+		}
+		default:
+			return pcmFloatToIntSSSE3(dst, src, numSamples, bytesPerSample, bigEndian);
+	}
+	return s;
+}
+
+PCM_TARGET("avx2") static long pcmGainAVX2(float *dst, const float *src, long numSamples, float gain)
+{
+	long s = 0;
+	const __m256 g = _mm256_set1_ps(gain);
+	for (; s+8 <= numSamples; s += 8)
+		_mm256_storeu_ps(dst+s, _mm256_mul_ps(_mm256_loadu_ps(src+s), g));
+	return s;
+}
+
+PCM_TARGET("avx2") static long pcmGainInt16AVX2(short *dst, const short *src, long numSamples, float gain)
+{
+	long s = 0;
+	const __m256 g = _mm256_set1_ps(gain);
+	const __m256 minimum = _mm256_set1_ps(-32768.f), maximum = _mm256_set1_ps(32767.f);
+	for (; s+16 <= numSamples; s += 16) {
+		__m256 a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src+s))));
+		__m256 b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src+s+8))));
+		a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(a, g), minimum), maximum);
+		b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(b, g), minimum), maximum);
+		__m256i x = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+		_mm256_storeu_si256((__m256i*)(dst+s), _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3,1,2,0)));
+	}
+	return s;
+}
+
+PCM_TARGET("avx2") static long pcmClampAVX2(float *dst, const float *src, long numSamples, float lo, float hi)
+{
+	long s = 0;
+	const __m256 l = _mm256_set1_ps(lo), h = _mm256_set1_ps(hi);
+	for (; s+8 <= numSamples; s += 8)
+		_mm256_storeu_ps(dst+s, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src+s), l), h));
+	return s;
+}
+
+#endif /* PCM_X86 */
+
+
+#pragma mark ---- Channel layouts ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Frame loops with the channel count known at compile time. The compiler unrolls the inner loop
+ */
+template <int kChannels> static void pcmDeinterleaveN(float **dst, const float *src, long start, long numFrames)
+{
+	float *out[kChannels];
+	for (int c = 0; c < kChannels; c++)
+		out[c] = dst[c];
+	src += start*kChannels;
+	for (long f = start; f < numFrames; f++, src += kChannels)
+		for (int c = 0; c < kChannels; c++)
+			out[c][f] = src[c];
+}
+
+template <int kChannels> static void pcmInterleaveN(float *dst, float **src, long start, long numFrames)
+{
+	const float *in[kChannels];
+	for (int c = 0; c < kChannels; c++)
+		in[c] = src[c];
+	dst += start*kChannels;
+	for (long f = start; f < numFrames; f++, dst += kChannels)
+		for (int c = 0; c < kChannels; c++)
+			dst[c] = in[c][f];
+}
+
+
+#pragma mark ---- API ----
+
+//	-----------------------------------------------------------------------------------------
+//	Converts numSamples integer samples of wordlength bits (8, 16, 24 or 32) in src to float
+//	in the range [-1.0, +1.0) in dst. bigEndian selects the byte order of src.
+//
+static inline void pcmIntToFloat(float *dst, const void *src, long numSamples, int wordlength, bool bigEndian)
+{
+	const unsigned char *p = (const unsigned char*)src;
+	long bytesPerSample = (wordlength+7)/8;
+	if (bytesPerSample < 1 || bytesPerSample > 4)	return;
+	long s = 0;
+#if PCM_X86
+	int cpu = pcmCpuFeatures();
+	if (cpu & kPcmCpuAVX2)			s = pcmIntToFloatAVX2(dst, p, numSamples, bytesPerSample, bigEndian);
+	else if (cpu & kPcmCpuSSSE3)	s = pcmIntToFloatSSSE3(dst, p, numSamples, bytesPerSample, bigEndian);
+	else if (cpu & kPcmCpuSSE2)		s = pcmIntToFloatSSE2(dst, p, numSamples, bytesPerSample, bigEndian);
+#endif
+	pcmIntToFloatScalar(dst+s, p+s*bytesPerSample, numSamples-s, bytesPerSample, bigEndian);
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Converts numSamples float samples in src to integer samples of wordlength bits in dst.
+//	Samples are clipped to [-1.0, +1.0), so values that are slightly out of range never wrap
+//	around, and rounded to the nearest integer with ties to even by all versions alike.
+//
+static inline void pcmFloatToInt(void *dst, const float *src, long numSamples, int wordlength, bool bigEndian)
+{
+	unsigned char *p = (unsigned char*)dst;
+	long bytesPerSample = (wordlength+7)/8;
+	if (bytesPerSample < 1 || bytesPerSample > 4)	return;
+	long s = 0;
+#if PCM_X86
+	int cpu = pcmCpuFeatures();
+	if (cpu & kPcmCpuAVX2)			s = pcmFloatToIntAVX2(p, src, numSamples, bytesPerSample, bigEndian);
+	else if (cpu & kPcmCpuSSSE3)	s = pcmFloatToIntSSSE3(p, src, numSamples, bytesPerSample, bigEndian);
+	else if (cpu & kPcmCpuSSE2)		s = pcmFloatToIntSSE2(p, src, numSamples, bytesPerSample, bigEndian);
+#endif
+	pcmFloatToIntScalar(p+s*bytesPerSample, src+s, numSamples-s, bytesPerSample, bigEndian);
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	dst[i] = src[i] * gain. dst may be the same as src.
+//
+static inline void pcmGain(float *dst, const float *src, long numSamples, float gain)
+{
+	long s = 0;
+#if PCM_X86
+	int cpu = pcmCpuFeatures();
+	if (cpu & kPcmCpuAVX2)			s = pcmGainAVX2(dst, src, numSamples, gain);
+	else if (cpu & kPcmCpuSSE2)		s = pcmGainSSE2(dst, src, numSamples, gain);
+#endif
+	for (; s < numSamples; s++)
+		dst[s] = src[s] * gain;
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Same as pcmGain() for 16 bit samples. Results are rounded and saturate at the 16 bit range.
+//
+static inline void pcmGainInt16(short *dst, const short *src, long numSamples, float gain)
+{
+	long s = 0;
+#if PCM_X86
+	int cpu = pcmCpuFeatures();
+	if (cpu & kPcmCpuAVX2)			s = pcmGainInt16AVX2(dst, src, numSamples, gain);
+	else if (cpu & kPcmCpuSSE2)		s = pcmGainInt16SSE2(dst, src, numSamples, gain);
+#endif
+	for (; s < numSamples; s++) {
+		float v = (float)src[s] * gain;
+		if (!(v > -32768.f))	v = -32768.f;		// also catches NaN, as the SIMD code does
+		if (v > 32767.f)		v = 32767.f;
+		dst[s] = (short)pcmRound(v);
+	}
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Limits src to [lo, hi] and stores the result in dst. dst may be the same as src.
+//
+static inline void pcmClamp(float *dst, const float *src, long numSamples, float lo, float hi)
+{
+	long s = 0;
+#if PCM_X86
+	int cpu = pcmCpuFeatures();
+	if (cpu & kPcmCpuAVX2)			s = pcmClampAVX2(dst, src, numSamples, lo, hi);
+	else if (cpu & kPcmCpuSSE2)		s = pcmClampSSE2(dst, src, numSamples, lo, hi);
+#endif
+	for (; s < numSamples; s++) {
+		float x = src[s];
+		dst[s] = x < lo ? lo : (x > hi ? hi : x);
+	}
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Splits numFrames interleaved frames of srcChannels channels in src into the planar
+//	buffers dst[0...numChannels-1]. numChannels must not be larger than srcChannels, channels
+//	beyond numChannels are skipped.
+//
+static inline void pcmDeinterleave(float **dst, const float *src, long numFrames, long srcChannels, long numChannels)
+{
+	if (numChannels == srcChannels) {
+		long s = 0;
+		switch (srcChannels) {
+			case 1:	memcpy(dst[0], src, numFrames*sizeof(float));	return;
+#if PCM_X86
+			case 2:	if (pcmCpuFeatures() & kPcmCpuSSE2)	s = pcmDeinterleave2SSE2(dst, src, numFrames);
+					pcmDeinterleaveN<2>(dst, src, s, numFrames);	return;
+			case 4:	if (pcmCpuFeatures() & kPcmCpuSSE2)	s = pcmDeinterleave4SSE2(dst, src, numFrames);
+					pcmDeinterleaveN<4>(dst, src, s, numFrames);	return;
+#else
+			case 2:	pcmDeinterleaveN<2>(dst, src, 0, numFrames);	return;
+			case 4:	pcmDeinterleaveN<4>(dst, src, 0, numFrames);	return;
+#endif
+			case 6:	pcmDeinterleaveN<6>(dst, src, 0, numFrames);	return;
+			case 8:	pcmDeinterleaveN<8>(dst, src, 0, numFrames);	return;
+		}
+	}
+	for (long c = 0; c < numChannels; c++) {
+		const float *p = src + c;
+		float *out = dst[c];
+		for (long f = 0; f < numFrames; f++, p += srcChannels)
+			out[f] = *p;
+	}
+}
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Merges the planar buffers src[0...numChannels-1] into numFrames interleaved frames of
+//	dstChannels channels in dst. Channels beyond numChannels are set to zero.
+//
+static inline void pcmInterleave(float *dst, float **src, long numFrames, long dstChannels, long numChannels)
+{
+	if (numChannels >= dstChannels) {
+		long s = 0;
+		switch (dstChannels) {
+			case 1:	memcpy(dst, src[0], numFrames*sizeof(float));	return;
+#if PCM_X86
+			case 2:	if (pcmCpuFeatures() & kPcmCpuSSE2)	s = pcmInterleave2SSE2(dst, src, numFrames);
+					pcmInterleaveN<2>(dst, src, s, numFrames);		return;
+			case 4:	if (pcmCpuFeatures() & kPcmCpuSSE2)	s = pcmInterleave4SSE2(dst, src, numFrames);
+					pcmInterleaveN<4>(dst, src, s, numFrames);		return;
+#else
+			case 2:	pcmInterleaveN<2>(dst, src, 0, numFrames);		return;
+			case 4:	pcmInterleaveN<4>(dst, src, 0, numFrames);		return;
+#endif
+			case 6:	pcmInterleaveN<6>(dst, src, 0, numFrames);		return;
+			case 8:	pcmInterleaveN<8>(dst, src, 0, numFrames);		return;
+		}
+	}
+	for (long c = 0; c < dstChannels; c++) {
+		float *p = dst + c;
+		const float *in = c < numChannels ? src[c] : NULL;
+		for (long f = 0; f < numFrames; f++, p += dstChannels)
+			*p = in ? in[f] : 0.f;
+	}
+}
+//	-----------------------------------------------------------------------------------------
+
+
+#endif /* __PCMCONVERT__ */
@@ -0,0 +1,257 @@
+/*
+
+	PhaseTimer
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	See PhaseTimer.h for a description of the calls implemented here
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CallbackTiming.h"
+#include "PhaseTimer.h"
+
+
+#if defined(_MSC_VER)
+	#define PT_THREAD_LOCAL		__declspec(thread)
+#else
+	#define PT_THREAD_LOCAL		__thread
+#endif
+
+// what one thread timed for one PhaseTimer. Only that thread writes it. The counters are doubles
+// at offsets that are multiples of 8, which x86 loads and stores in one piece even on 32 bit, so
+// readers never see half an update; a 64 bit integer takes two 32 bit stores there
+struct PhaseSlot {
+	PhaseSlot *sNext;
+	unsigned long sThread;
+	double sTicks[kPhaseNumPhases];
+	double sScopes[kPhaseNumPhases];		/* exact up to 2^53 scopes */
+};
+
+static volatile long gNextSerial = 0;
+static volatile long gNextThread = 0;
+static double gSecondsPerTick = 0.;
+
+static PT_THREAD_LOCAL PhaseScopeState *tScope = NULL;		/* innermost open scope of this thread */
+static PT_THREAD_LOCAL unsigned long tThread = 0;
+static PT_THREAD_LOCAL unsigned long tCachedSerial = 0;		/* the PhaseTimer this thread timed last */
+static PT_THREAD_LOCAL PhaseSlot *tCachedSlot = NULL;
+
+
+#pragma mark ---- Helpers ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the next of a counter shared by all threads, starting at 1
+ */
+static unsigned long nextId(volatile long *counter)
+{
+#if defined(_MSC_VER)
+	return (unsigned long)InterlockedIncrement(counter);
+#else
+	return (unsigned long)__sync_add_and_fetch(counter, 1);
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the slot of the calling thread in timer, adding it on first use. Slots are only ever
+ added at the head of the list, so readers can walk it while threads add theirs
+ */
+static PhaseSlot *threadSlot(PhaseTimer *timer)
+{
+	if (tCachedSerial == timer->sSerial)
+		return tCachedSlot;
+
+	if (!tThread)
+		tThread = nextId(&gNextThread);
+
+	PhaseSlot *slot;
+	for (slot = timer->sSlots; slot; slot = slot->sNext) {
+		if (slot->sThread == tThread)
+			break;
+	}
+	if (!slot) {
+		slot = (PhaseSlot*)calloc(1, sizeof(PhaseSlot));
+		if (!slot)
+			return NULL;
+		slot->sThread = tThread;
+		PhaseSlot *head;
+		do {
+			head = timer->sSlots;
+			slot->sNext = head;
+#if defined(_MSC_VER)
+		} while (InterlockedCompareExchangePointer((PVOID volatile*)&timer->sSlots, slot, head) != head);
+#else
+		} while (!__sync_bool_compare_and_swap(&timer->sSlots, head, slot));
+#endif
+	}
+
+	tCachedSerial = timer->sSerial;
+	tCachedSlot = slot;
+	return slot;
+}
+
+
+#pragma mark ---- Timing ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ptInit(PhaseTimer *timer, const char *name)
+{
+	memset(timer->sName, 0, sizeof(timer->sName));
+	if (name)
+		strncpy(timer->sName, name, sizeof(timer->sName)-1);
+	timer->sSerial = nextId(&gNextSerial);
+	timer->sSlots = NULL;
+	if (gSecondsPerTick == 0.)
+		gSecondsPerTick = 1e-9 * ctNanosPerTick();
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ptDispose(PhaseTimer *timer)
+{
+	PhaseSlot *slot = timer->sSlots;
+	while (slot) {
+		PhaseSlot *next = slot->sNext;
+		free(slot);
+		slot = next;
+	}
+	timer->sSlots = NULL;
+	timer->sSerial = 0;		/* no thread caches serial 0 */
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ptBegin(PhaseScopeState *scope, PhaseTimer *timer, int phase)
+{
+	scope->sSlot = timer ? threadSlot(timer) : NULL;
+	if (!scope->sSlot || phase < 0 || phase >= kPhaseNumPhases) {
+		scope->sSlot = NULL;
+		return;
+	}
+	unsigned long long now = ctTicks();
+
+	// pause the scope we are nested in
+	PhaseScopeState *parent = tScope;
+	if (parent)
+		parent->sSlot->sTicks[parent->sPhase] += (double)(now - parent->sStart);
+
+	scope->sPhase = phase;
+	scope->sParent = parent;
+	scope->sStart = now;
+	tScope = scope;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ptEnd(PhaseScopeState *scope)
+{
+	if (!scope->sSlot)
+		return;
+	unsigned long long now = ctTicks();
+	scope->sSlot->sTicks[scope->sPhase] += (double)(now - scope->sStart);
+	scope->sSlot->sScopes[scope->sPhase]++;
+
+	// resume the scope we paused
+	tScope = scope->sParent;
+	if (tScope)
+		tScope->sStart = now;
+}
+
+
+#pragma mark ---- Results ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ptGetTimes(const PhaseTimer *timer, PhaseTimes *times)
+{
+	memset(times, 0, sizeof(PhaseTimes));
+	for (const PhaseSlot *slot = timer->sSlots; slot; slot = slot->sNext) {
+		for (int p = 0; p < kPhaseNumPhases; p++) {
+			times->sSeconds[p] += gSecondsPerTick * slot->sTicks[p];
+			times->sScopes[p] += (unsigned long long)slot->sScopes[p];
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ptMergeTimes(PhaseTimes *sum, const PhaseTimes *times)
+{
+	for (int p = 0; p < kPhaseNumPhases; p++) {
+		sum->sSeconds[p] += times->sSeconds[p];
+		sum->sScopes[p] += times->sScopes[p];
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+const char *ptPhaseName(int phase)
+{
+	switch (phase) {
+		case kPhaseRead:		return "read";
+		case kPhaseDsp:			return "DSP";
+		case kPhaseWrite:		return "write";
+		case kPhaseConvert:		return "convert";
+	}
+	return "?";
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Prints one row of ptPrintBreakdown()
+ */
+static void printRow(const char *name, const PhaseTimes *times, double audioSeconds)
+{
+	double total = 0.;
+	int p;
+	for (p = 0; p < kPhaseNumPhases; p++)
+		total += times->sSeconds[p];
+
+	printf("%-20.20s", name);
+	for (p = 0; p < kPhaseNumPhases; p++)
+		printf(" %9.3fs %4.0f%%", times->sSeconds[p], total > 0. ? 100. * times->sSeconds[p] / total : 0.);
+	if (audioSeconds > 0. && times->sSeconds[kPhaseDsp] > 0.)
+		printf(" %9.2f : 1", audioSeconds / times->sSeconds[kPhaseDsp]);
+	printf("\n");
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ptPrintBreakdown(const PhaseTimer *const *timers, const double *audioSeconds, int numTimers)
+{
+	int p;
+	printf("%-20s", "instance");
+	for (p = 0; p < kPhaseNumPhases; p++)
+		printf(" %16s", ptPhaseName(p));
+	if (audioSeconds)
+		printf(" %13s", "DSP speed");
+	printf("\n");
+
+	PhaseTimes sum;
+	memset(&sum, 0, sizeof(sum));
+	double audioSum = 0.;
+	for (int t = 0; t < numTimers; t++) {
+		PhaseTimes times;
+		ptGetTimes(timers[t], &times);
+		ptMergeTimes(&sum, &times);
+
+		char name[32];
+		if (timers[t]->sName[0])
+			strncpy(name, timers[t]->sName, sizeof(name));
+		else
+			sprintf(name, "#%d", t+1);
+		name[sizeof(name)-1] = 0;
+		printRow(name, &times, audioSeconds ? audioSeconds[t] : 0.);
+		if (audioSeconds)
+			audioSum += audioSeconds[t];
+	}
+	if (numTimers > 1)
+		printRow("total", &sum, audioSum);
+}
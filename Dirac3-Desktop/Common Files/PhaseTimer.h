@@ -0,0 +1,162 @@
+/*
+
+	PhaseTimer
+	(c) 2003-2012 Stephan M. Bernsee
+	http://www.dspdimension.com
+
+	Abstract: Thread safe timing of the phases of processing (reading input, DSP, writing
+	output, converting formats) per instance. DiracStartClock() and DiracClockTimeSeconds()
+	are one stopwatch for the whole program, so they give wrong numbers as soon as two
+	instances run on two threads. A PhaseTimer belongs to one instance, e.g. one Dirac
+	instance or one file of a batch, and is timed with scopes:
+
+		{
+			PhaseScope dsp(&timer, kPhaseDsp);
+			ret = DiracProcess(audio, numFrames, dirac);
+		}
+
+	and in the read callback of that instance
+
+		PhaseScope read(state->sTimer, kPhaseRead);
+
+	A scope that opens while another one is open on the same thread pauses it, so every
+	phase gets only its own time: above, DSP does not include reading, which used to be done
+	by stopping and restarting the global clock in the read callback.
+
+	Each thread adds to its own counters for each PhaseTimer and never waits. ptGetTimes()
+	sums them per instance; ptMergeTimes() and ptPrintBreakdown() sum instances. Both are
+	exact once the threads that time the instance are done, and close to it before.
+
+	This file is provided as source and should be compiled into your project.
+
+*/
+
+#ifndef __PHASETIMER__
+#define __PHASETIMER__
+
+// the phases, see PhaseTimes::sSeconds
+enum {
+	kPhaseRead = 0,					/* the read callback: disk, decoding, copying input */
+	kPhaseDsp,						/* DiracProcess(), DiracFxProcessFloat() and the like */
+	kPhaseWrite,					/* writing the output */
+	kPhaseConvert,					/* converting between sample formats */
+	kPhaseNumPhases
+};
+
+
+typedef struct {
+	double sSeconds[kPhaseNumPhases];				/* without the time of scopes opened inside */
+	unsigned long long sScopes[kPhaseNumPhases];	/* how many scopes were timed */
+} PhaseTimes;
+
+
+typedef struct PhaseSlot PhaseSlot;
+
+typedef struct {
+	char sName[64];
+	unsigned long sSerial;				/* unique over the life of the program */
+	PhaseSlot *volatile sSlots;			/* one per thread that timed this instance */
+} PhaseTimer;
+
+
+// an open scope, see PhaseScope
+typedef struct PhaseScopeState {
+	PhaseSlot *sSlot;
+	int sPhase;
+	unsigned long long sStart;
+	struct PhaseScopeState *sParent;
+} PhaseScopeState;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//	-----------------------------------------------------------------------------------------
+//	Initializes timer with all phases at zero. name identifies the instance in
+//	ptPrintBreakdown(), it may be NULL.
+//
+void ptInit(PhaseTimer *timer, const char *name);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Frees what timer allocated. No thread may time it any longer.
+//
+void ptDispose(PhaseTimer *timer);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Opens scope for phase of timer on the calling thread, pausing the scope that is open on
+//	this thread, if any. Scopes must be closed with ptEnd() in reverse order on the thread
+//	that opened them; PhaseScope below does that for you.
+//
+void ptBegin(PhaseScopeState *scope, PhaseTimer *timer, int phase);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Closes scope, adds its time to its phase and resumes the scope it paused.
+//
+void ptEnd(PhaseScopeState *scope);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Sums the times of timer over all threads into times.
+//
+void ptGetTimes(const PhaseTimer *timer, PhaseTimes *times);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Adds times to sum, to combine instances.
+//
+void ptMergeTimes(PhaseTimes *sum, const PhaseTimes *times);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the name of phase, e.g. "DSP".
+//
+const char *ptPhaseName(int phase);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Prints a table to stdout with one row per instance and a total, and one column per
+//	phase in seconds and as a share of the time of the row. If audioSeconds is not NULL
+//	it holds the duration of the audio each instance processed, and the speed of DSP as
+//	a multiple of realtime is added to every row.
+//
+void ptPrintBreakdown(const PhaseTimer *const *timers, const double *audioSeconds, int numTimers);
+//	-----------------------------------------------------------------------------------------
+
+
+#ifdef __cplusplus
+}
+
+
+//	-----------------------------------------------------------------------------------------
+//	Times phase of timer from here to the end of the enclosing block.
+//
+class PhaseScope
+{
+public:
+	PhaseScope(PhaseTimer *timer, int phase) { ptBegin(&mState, timer, phase); }
+	~PhaseScope() { ptEnd(&mState); }
+
+private:
+	PhaseScope(const PhaseScope &);
+	PhaseScope &operator=(const PhaseScope &);
+
+	PhaseScopeState mState;
+};
+//	-----------------------------------------------------------------------------------------
+
+#endif
+
+
+#endif /* __PHASETIMER__ */
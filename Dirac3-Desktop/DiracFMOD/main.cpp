@@ -42,13 +42,8 @@
 #endif
 
 #include "Dirac.h"
-
-/* ****************************************************************************
-	Set up some handy constants
- **************************************************************************** */
-const float div8 = 0.0078125f;			//1./pow(2., 8.-1.);
-const double div16 = 0.00003051757812;	//1./pow(2., 16.-1.);
-const double div32 = 0.00000000046566;	//1./pow(2., 32.-1.);
+#include "PcmConvert.h"
+#include "CallbackTiming.h"
 
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -63,6 +58,12 @@ typedef struct {
 	FMOD::Sound *sSound;
 } userDataStruct;
 
+/* ****************************************************************************
+	How long our DSP callback takes compared to the audio it renders. Written
+	by the mixer thread, read by the main loop (press 't')
+ **************************************************************************** */
+static CallbackTiming gDSPTiming;
+
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 void ERRCHECK(FMOD_RESULT result)
@@ -82,53 +83,8 @@ void ERRCHECK(FMOD_RESULT result)
  **************************************************************************** */
 static void intToFloat(float *dest, void *src, long size, int wordlength)
 {
-	long wordlengthInBytes = wordlength / 8;
-	long numElementsInBuffer = size / wordlengthInBytes;
-	long i;
-	switch (wordlength) {
-		case 8:
-		{
-			signed char *v = (signed char *)src;
-			for ( i = 0; i < numElementsInBuffer; i++)	
-				dest[i]=(float)v[i] * div8;
-		}
-			break;
-		case 16:
-		{
-			signed short *v = (signed short *)src;	
-			for ( i = 0; i < numElementsInBuffer; i++) {
-				dest[i]=(float)v[i] * div16;
-			}
-		}
-			break;
-		case 24:
-		{
-			unsigned char *v = (unsigned char *)src;
-			long c = 0;
-			for ( i = 0; i < numElementsInBuffer; i++)	{
-				int32_t value = 0;
-				unsigned char *valuePtr = (unsigned char *)&value;
-
-				valuePtr[0] = 0;
-				valuePtr[1] = v[c]; c++;
-				valuePtr[2] = v[c]; c++;
-				valuePtr[3] = v[c]; c++;
-				
-				dest[i]=(double)value * div32;
-			}
-		}
-			break;
-		case 32:
-		{
-			int32_t *v = (int32_t *)src;	
-			for ( i = 0; i < numElementsInBuffer; i++) {
-				dest[i]=(double)v[i] * div32;
-			}
-		}
-			break;
-		default:
-			break;
-	}
+	long numElementsInBuffer = size / (wordlength / 8);
+	pcmIntToFloat(dest, src, numElementsInBuffer, wordlength, false);
 }
 
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -233,7 +189,9 @@ FMOD_RESULT F_CALLBACK myDSPCallback(FMOD_DSP_STATE *dsp_state, float *inbuffer,
 	if (!userdata)
 		return FMOD_ERR_NOTREADY;
 	
+	unsigned long long timingStart = ctBegin(&gDSPTiming);
 	ret = DiracProcessInterleaved(outbuffer, length, (void*)userdata);
+	ctEnd(&gDSPTiming, timingStart, length);
 	
 	switch (ret) {
 		case kDiracErrorDemoTimeoutReached:
@@ -293,6 +251,7 @@ int main(int argc, char *argv[])
     printf("(c) 2012 The DSP Dimension, Stephan M. Bernsee \n");
     printf("===============================================================================\n");
     printf("Press 'f' to activate, deactivate Dirac\n");
+    printf("Press 't' to show how long the Dirac DSP callback takes\n");
     printf("Press 'Esc' to quit\n");
     printf("\n");
 
@@ -341,6 +300,10 @@ int main(int argc, char *argv[])
 	// Print our settings to the console
 	DiracPrintSettings(dirac);
 	
+	// time our DSP callback against the duration of each block at the output sample rate
+	ctInit(&gDSPTiming, systemSampleRate);
+	ctSetEnabled(&gDSPTiming, true);
+	
 	printf("Running DIRAC version %s\nStarting processing\n", DiracVersion());
 
 	
@@ -400,6 +363,17 @@ int main(int argc, char *argv[])
 					else			printf("\nBYPASS ON\n");
                     break;
                 }
+                case 't' : 
+                case 'T' : 
+                {
+					CallbackTimingSnapshot snapshot;
+					char text[256];
+					if (ctSnapshot(&gDSPTiming, &snapshot)) {
+						ctDescribe(&snapshot, text, sizeof(text));
+						printf("\nDSP callback: %s\n", text);
+					}
+                    break;
+                }
             }
         }
 
@@ -0,0 +1,740 @@
+/*
+ "DiracBench.cpp" DiracBench Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Renders synthetic signals through Dirac (DiracCreate()/DiracProcess()) and DiracFx
+ (DiracFxProcessFloat()) for every combination of lambda, quality, time factor, number of
+ channels and block size asked for, and reports the speed of each combination as JSON lines
+ and CSV. Every combination gets a fresh instance, a warmup and a number of timed repetitions
+ on the same input, so two runs on the same machine can be compared, see DiracBenchCompare.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "Dirac.h"
+
+
+// seconds of each signal we generate up front. The read callback plays it in a loop, so all
+// it costs during the timed calls is a copy
+#define SIGNAL_SECONDS			8.0
+
+// highest number of entries in a list given on the command line
+#define MAX_LIST				32
+
+// sample rate of all signals
+#define BENCH_SAMPLE_RATE		44100.f
+
+enum {
+	kApiCore = 0,
+	kApiFx,
+	kNumApis
+};
+
+enum {
+	kSignalSines = 0,
+	kSignalNoise,
+	kSignalSpeech,
+	kSignalTransients,
+	kNumSignals
+};
+
+static const char *apiNames[kNumApis] = { "core", "fx" };
+static const char *signalNames[kNumSignals] = { "sines", "noise", "speech", "transients" };
+
+
+// A list of values from the command line, e.g. "0,2,4" or "0-6"
+typedef struct {
+	double sValues[MAX_LIST];
+	long sCount;
+} listStruct;
+
+
+// The parameter matrix and how each point of it is measured
+typedef struct {
+	listStruct sApis, sSignals, sLambdas, sQualities, sTimes, sChannels, sBlocks;
+	double sWarmupSeconds;				/* output processed before timing, per combination */
+	double sSeconds;					/* output timed per repetition */
+	long sRepetitions;
+	const char *sLabel;					/* what this run is, e.g. the library version */
+} benchSettingsStruct;
+
+
+// One point of the matrix
+typedef struct {
+	int sApi, sSignal;
+	int sLambda, sQuality;				/* sLambda is -1 for DiracFx, which has none */
+	double sTime;
+	long sNumChannels, sBlockFrames;
+} configStruct;
+
+
+// What a combination measured. The per repetition values are kept for the statistics and so
+// DiracBenchCompare can test the difference between two runs
+typedef struct {
+	double sRealtime[MAX_LIST];			/* seconds of output per second of processing */
+	double sNanosPerFrame[MAX_LIST];	/* nanoseconds of processing per output frame */
+	double sCallP99s[MAX_LIST];			/* 99th percentile of the calls in microseconds */
+	long sRepetitions;
+	unsigned long long sFramesOut;		/* timed output frames, all repetitions */
+	double sCallP50, sCallP99, sCallMax;	/* microseconds per call, all repetitions */
+	double sPeakCpu;					/* DiracPeakCpuUsagePercent(), < 0 if not available */
+	const char *sError;					/* NULL if measured */
+} resultStruct;
+
+
+// Mean, spread and order statistics of a set of repetitions
+typedef struct {
+	double sMean, sStdDev, sMin, sMedian, sMax;
+} summaryStruct;
+
+
+// State of the read callback: the signal, played in a loop
+typedef struct {
+	const float *sSignal;
+	long sSignalFrames;
+	long sNumChannels;
+	long sPosition;
+} playerStruct;
+
+
+#pragma mark ---- Signals ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static double wallClockSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Uniform noise in [-1, 1) from a linear congruential generator, the same sequence on every
+ machine
+ */
+static inline float noise(unsigned long *seed)
+{
+	*seed = (*seed * 1664525UL + 1013904223UL) & 0xffffffffUL;
+	return (float)((*seed >> 8) & 0xffff) / 32768.f - 1.f;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Two pole resonator at freq Hz, used for the formants of the speech-like signal
+ */
+typedef struct {
+	double sY1, sY2;
+} resonatorStruct;
+
+static inline double resonate(resonatorStruct *r, double x, double freq, double bandwidth, double sr)
+{
+	double radius = exp(-M_PI * bandwidth / sr);
+	double y = (1. - radius) * x + 2. * radius * cos(2. * M_PI * freq / sr) * r->sY1 - radius * radius * r->sY2;
+	r->sY2 = r->sY1;
+	r->sY1 = y;
+	return y;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Fills signal[0...numFrames-1] with one of the test signals, mono and peaking around -6 dB:
+
+ sines		three steady partials
+ noise		white noise
+ speech		a glottal pulse train with a wandering pitch through two formants that move from
+			vowel to vowel, four syllables per second and a hiss between them
+ transients	decaying clicks and low thumps at irregular intervals, mostly silence
+ */
+static void makeSignal(int kind, float *signal, long numFrames, float sr)
+{
+	unsigned long seed = 1;
+	static const double formants[5][2] = { {730, 1090}, {270, 2290}, {530, 1840}, {570, 840}, {300, 870} };
+	resonatorStruct f1 = { 0., 0. }, f2 = { 0., 0. };
+	double phase = 0., decay = 0., thump = 0.;
+	long nextHit = 0;
+
+	for (long i = 0; i < numFrames; i++) {
+		double t = (double)i / sr;
+		double x = 0.;
+		switch (kind) {
+			case kSignalSines:
+				x = 0.25 * sin(2. * M_PI * 220. * t) + 0.15 * sin(2. * M_PI * 1375. * t) + 0.1 * sin(2. * M_PI * 4410.5 * t);
+				break;
+			case kSignalNoise:
+				x = 0.5 * noise(&seed);
+				break;
+			case kSignalSpeech: {
+				double f0 = 120. + 25. * sin(2. * M_PI * 0.7 * t);
+				phase += f0 / sr;
+				double pulse = 0.;
+				if (phase >= 1.) {
+					phase -= 1.;
+					pulse = 1.;
+				}
+				long vowel = (long)(t * 4.) % 5;
+				double syllable = 0.5 - 0.5 * cos(2. * M_PI * 4. * t);
+				double voiced = resonate(&f1, pulse, formants[vowel][0], 80., sr) + 0.5 * resonate(&f2, pulse, formants[vowel][1], 120., sr);
+				x = 4. * syllable * voiced + 0.03 * (1. - syllable) * noise(&seed);
+				break;
+			}
+			case kSignalTransients:
+				if (i >= nextHit) {
+					decay = 0.3;
+					thump = 0.2;
+					nextHit = i + (long)(sr * (0.08 + 0.2 * (0.5 + 0.5 * noise(&seed))));
+				}
+				x = decay * noise(&seed) + thump * sin(2. * M_PI * 60. * t);
+				decay *= 0.998;
+				thump *= 0.9995;
+				break;
+		}
+		signal[i] = (float)x;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Copies the next numFrames frames of the looped signal into every channel of data
+ */
+static void play(playerStruct *player, float **data, long numFrames)
+{
+	long done = 0;
+	while (done < numFrames) {
+		long n = player->sSignalFrames - player->sPosition;
+		if (n > numFrames - done)
+			n = numFrames - done;
+		for (long c = 0; c < player->sNumChannels; c++)
+			memcpy(data[c] + done, player->sSignal + player->sPosition, n*sizeof(float));
+		done += n;
+		player->sPosition = (player->sPosition + n) % player->sSignalFrames;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Dirac's read callback
+ */
+static long myReadData(float **chdata, long numFrames, void *userData)
+{
+	play((playerStruct*)userData, chdata, numFrames);
+	return numFrames;
+}
+
+
+#pragma mark ---- Measuring ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void summarize(const double *values, long count, summaryStruct *summary)
+{
+	double sorted[MAX_LIST];
+	double sum = 0., squares = 0.;
+	for (long k = 0; k < count; k++) {
+		sorted[k] = values[k];
+		sum += values[k];
+	}
+	std::sort(sorted, sorted+count);
+	summary->sMean = sum / count;
+	for (long k = 0; k < count; k++)
+		squares += (values[k] - summary->sMean) * (values[k] - summary->sMean);
+	summary->sStdDev = count > 1 ? sqrt(squares / (count - 1)) : 0.;
+	summary->sMin = sorted[0];
+	summary->sMax = sorted[count-1];
+	summary->sMedian = count & 1 ? sorted[count/2] : 0.5 * (sorted[count/2-1] + sorted[count/2]);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Measures one point of the matrix. Processes the warmup, then the repetitions, each timed as a
+ whole and call by call. Only the calls into Dirac are timed with DiracFx, with Dirac the read
+ callback is part of DiracProcess()
+ */
+static void measure(configStruct *config, benchSettingsStruct *settings, const float *signal, long signalFrames, resultStruct *result)
+{
+	float sr = BENCH_SAMPLE_RATE;
+	long numChannels = config->sNumChannels;
+	long blockFrames = config->sBlockFrames;
+	void *dirac = NULL, *fx = NULL;
+	float **in = NULL, **out = NULL;
+	long outFrames = blockFrames;
+	double *callSeconds = NULL;
+	long numCalls = 0;
+
+	memset(result, 0, sizeof(resultStruct));
+	result->sPeakCpu = -1.;
+
+	playerStruct player;
+	player.sSignal = signal;
+	player.sSignalFrames = signalFrames;
+	player.sNumChannels = numChannels;
+	player.sPosition = 0;
+
+	if (config->sApi == kApiCore) {
+		dirac = DiracCreate(kDiracLambdaPreview+config->sLambda, kDiracQualityPreview+config->sQuality, numChannels, sr, &myReadData, (void*)&player);
+		if (!dirac) {
+			result->sError = "could not create instance";
+			return;
+		}
+		DiracSetProperty(kDiracPropertyTimeFactor, config->sTime, dirac);
+	} else {
+		fx = DiracFxCreate(kDiracQualityPreview+config->sQuality, sr, numChannels);
+		if (!fx) {
+			result->sError = "could not create instance";
+			return;
+		}
+		outFrames = DiracFxMaxOutputBufferFramesRequired(config->sTime, 1., blockFrames);
+		in = new float*[numChannels];
+		for (long c = 0; c < numChannels; c++)
+			in[c] = new float[blockFrames];
+	}
+	out = new float*[numChannels];
+	for (long c = 0; c < numChannels; c++)
+		out[c] = new float[outFrames];
+
+	// DiracFx produces about time factor frames per input frame, fewer at first because of its
+	// latency. A repetition is cut short should it produce much less than that
+	double framesPerCall = config->sApi == kApiCore ? (double)blockFrames : blockFrames * config->sTime;
+	long maxCalls = 2 * (long)(settings->sSeconds * sr / framesPerCall) + 2;
+	callSeconds = new double[maxCalls * settings->sRepetitions];
+
+	for (long rep = -1; rep < settings->sRepetitions && !result->sError; rep++) {
+		// the warmup is repetition -1 and not timed
+		double seconds = rep < 0 ? settings->sWarmupSeconds : settings->sSeconds;
+		unsigned long long framesWanted = (unsigned long long)(seconds * sr);
+		unsigned long long framesDone = 0;
+		long calls = 0, callLimit = 2 * (long)(seconds * sr / framesPerCall) + 2;
+		long firstCall = numCalls;
+		double elapsed = 0.;
+
+		while (framesDone < framesWanted && calls < callLimit) {
+			long ret;
+			double start;
+			if (dirac) {
+				start = wallClockSeconds();
+				ret = DiracProcess(out, blockFrames, dirac);
+			} else {
+				play(&player, in, blockFrames);
+				start = wallClockSeconds();
+				ret = DiracFxProcessFloat(config->sTime, 1., in, out, blockFrames, fx);
+			}
+			double callTime = wallClockSeconds() - start;
+			if (ret < 0) {
+				result->sError = "processing failed";
+				break;
+			}
+			framesDone += ret;
+			elapsed += callTime;
+			if (rep >= 0)
+				callSeconds[numCalls++] = callTime;
+			calls++;
+		}
+		if (rep < 0 || result->sError)
+			continue;
+
+		result->sRealtime[rep] = elapsed > 0. ? (double)framesDone / sr / elapsed : 0.;
+		result->sNanosPerFrame[rep] = framesDone ? 1e9 * elapsed / (double)framesDone : 0.;
+		if (numCalls > firstCall) {
+			std::sort(callSeconds+firstCall, callSeconds+numCalls);
+			result->sCallP99s[rep] = 1e6 * callSeconds[firstCall + (long)(0.99*(numCalls-firstCall-1))];
+		}
+		result->sFramesOut += framesDone;
+		result->sRepetitions++;
+	}
+
+	if (numCalls) {
+		std::sort(callSeconds, callSeconds+numCalls);
+		result->sCallP50 = 1e6 * callSeconds[numCalls/2];
+		result->sCallP99 = 1e6 * callSeconds[(long)(0.99*(numCalls-1))];
+		result->sCallMax = 1e6 * callSeconds[numCalls-1];
+	}
+	if (dirac) {
+		result->sPeakCpu = DiracPeakCpuUsagePercent(dirac);
+		DiracDestroy(dirac);
+	}
+	if (fx)
+		DiracFxDestroy(fx);
+
+	delete[] callSeconds;
+	for (long c = 0; c < numChannels; c++) {
+		if (in)
+			delete[] in[c];
+		delete[] out[c];
+	}
+	delete[] in;
+	delete[] out;
+}
+
+
+#pragma mark ---- Output ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes s as a JSON string, with quotes
+ */
+static void writeJsonString(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(out, "\\u%04x", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Copies the model name of the first CPU from /proc/cpuinfo, "unknown" if there is none
+ */
+static void getCpuName(char *name, size_t size)
+{
+	snprintf(name, size, "unknown");
+	FILE *f = fopen("/proc/cpuinfo", "r");
+	if (!f)	return;
+	char line[256];
+	while (fgets(line, sizeof(line), f)) {
+		char *colon = strchr(line, ':');
+		if (strncmp(line, "model name", 10) != 0 || !colon)
+			continue;
+		colon += 1 + strspn(colon+1, " \t");
+		colon[strcspn(colon, "\n")] = 0;
+		snprintf(name, size, "%s", colon);
+		break;
+	}
+	fclose(f);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The first line of the JSON output, describing the run
+ */
+static void writeJsonHeader(FILE *out, benchSettingsStruct *settings, long numConfigs)
+{
+	char cpu[128], started[32];
+	getCpuName(cpu, sizeof(cpu));
+	time_t now = time(NULL);
+	strftime(started, sizeof(started), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+	fprintf(out, "{\"event\":\"bench\",\"tool\":\"DiracBench\",\"label\":");
+	writeJsonString(out, settings->sLabel);
+	fprintf(out, ",\"dirac_version\":");
+	writeJsonString(out, DiracVersion());
+	fprintf(out, ",\"cpu\":");
+	writeJsonString(out, cpu);
+	fprintf(out, ",\"cpus\":%ld,\"bits\":%d,\"started\":\"%s\",\"sample_rate\":%.0f,\"warmup_seconds\":%.3f,\"seconds\":%.3f,\"repetitions\":%ld,\"configs\":%ld}\n",
+			sysconf(_SC_NPROCESSORS_ONLN), (int)(8*sizeof(void*)), started, BENCH_SAMPLE_RATE, settings->sWarmupSeconds, settings->sSeconds,
+			settings->sRepetitions, numConfigs);
+	fflush(out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes one line for a combination: its parameters, the summaries and the values of every
+ repetition
+ */
+static void writeJsonResult(FILE *out, configStruct *config, resultStruct *result)
+{
+	fprintf(out, "{\"event\":\"config\",\"api\":\"%s\",\"signal\":\"%s\",\"lambda\":%d,\"quality\":%d,\"time\":%.4f,\"channels\":%ld,\"block\":%ld",
+			apiNames[config->sApi], signalNames[config->sSignal], config->sLambda, config->sQuality, config->sTime, config->sNumChannels, config->sBlockFrames);
+	if (result->sError || !result->sRepetitions) {
+		fprintf(out, ",\"error\":");
+		writeJsonString(out, result->sError ? result->sError : "no output");
+		fprintf(out, "}\n");
+		fflush(out);
+		return;
+	}
+
+	summaryStruct rt, ns;
+	summarize(result->sRealtime, result->sRepetitions, &rt);
+	summarize(result->sNanosPerFrame, result->sRepetitions, &ns);
+	fprintf(out, ",\"repetitions\":%ld,\"frames_out\":%llu", result->sRepetitions, result->sFramesOut);
+	fprintf(out, ",\"realtime_mean\":%.4f,\"realtime_stddev\":%.4f,\"realtime_min\":%.4f,\"realtime_median\":%.4f,\"realtime_max\":%.4f",
+			rt.sMean, rt.sStdDev, rt.sMin, rt.sMedian, rt.sMax);
+	fprintf(out, ",\"ns_per_frame_mean\":%.2f,\"ns_per_frame_stddev\":%.2f,\"ns_per_frame_min\":%.2f,\"ns_per_frame_median\":%.2f,\"ns_per_frame_max\":%.2f",
+			ns.sMean, ns.sStdDev, ns.sMin, ns.sMedian, ns.sMax);
+	fprintf(out, ",\"call_us_p50\":%.2f,\"call_us_p99\":%.2f,\"call_us_max\":%.2f", result->sCallP50, result->sCallP99, result->sCallMax);
+	if (result->sPeakCpu >= 0.)
+		fprintf(out, ",\"peak_cpu_percent\":%.2f", result->sPeakCpu);
+	else
+		fprintf(out, ",\"peak_cpu_percent\":null");
+	fprintf(out, ",\"realtime\":[");
+	for (long k = 0; k < result->sRepetitions; k++)
+		fprintf(out, "%s%.4f", k ? "," : "", result->sRealtime[k]);
+	fprintf(out, "],\"ns_per_frame\":[");
+	for (long k = 0; k < result->sRepetitions; k++)
+		fprintf(out, "%s%.2f", k ? "," : "", result->sNanosPerFrame[k]);
+	fprintf(out, "],\"call_us_p99_reps\":[");
+	for (long k = 0; k < result->sRepetitions; k++)
+		fprintf(out, "%s%.2f", k ? "," : "", result->sCallP99s[k]);
+	fprintf(out, "]}\n");
+	fflush(out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void writeCsvHeader(FILE *out)
+{
+	fprintf(out, "api,signal,lambda,quality,time,channels,block,repetitions,realtime_mean,realtime_stddev,realtime_min,realtime_median,realtime_max,"
+			"ns_per_frame_mean,ns_per_frame_stddev,ns_per_frame_median,call_us_p50,call_us_p99,call_us_max,peak_cpu_percent,error\n");
+	fflush(out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes one row for a combination. Values that don't apply are left empty
+ */
+static void writeCsvResult(FILE *out, configStruct *config, resultStruct *result)
+{
+	fprintf(out, "%s,%s,", apiNames[config->sApi], signalNames[config->sSignal]);
+	if (config->sLambda >= 0)
+		fprintf(out, "%d", config->sLambda);
+	fprintf(out, ",%d,%.4f,%ld,%ld,", config->sQuality, config->sTime, config->sNumChannels, config->sBlockFrames);
+	if (result->sError || !result->sRepetitions) {
+		fprintf(out, "0,,,,,,,,,,,,,%s\n", result->sError ? result->sError : "no output");
+		fflush(out);
+		return;
+	}
+
+	summaryStruct rt, ns;
+	summarize(result->sRealtime, result->sRepetitions, &rt);
+	summarize(result->sNanosPerFrame, result->sRepetitions, &ns);
+	fprintf(out, "%ld,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,", result->sRepetitions, rt.sMean, rt.sStdDev, rt.sMin, rt.sMedian, rt.sMax,
+			ns.sMean, ns.sStdDev, ns.sMedian, result->sCallP50, result->sCallP99, result->sCallMax);
+	if (result->sPeakCpu >= 0.)
+		fprintf(out, "%.2f", result->sPeakCpu);
+	fprintf(out, ",\n");
+	fflush(out);
+}
+
+
+#pragma mark ---- Main program ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Parses a comma separated list of numbers, where integer lists may also have ranges like 0-6.
+ Returns false if the list is empty, too long or not made of numbers
+ */
+static bool parseList(const char *text, listStruct *list, bool ranges)
+{
+	list->sCount = 0;
+	while (*text) {
+		char *end;
+		double from = strtod(text, &end), to = from;
+		if (end == text)
+			return false;
+		if (ranges && *end == '-') {
+			text = end+1;
+			to = strtod(text, &end);
+			if (end == text || to < from)
+				return false;
+		}
+		for (double v = from; v <= to; v += 1.) {
+			if (list->sCount >= MAX_LIST)
+				return false;
+			list->sValues[list->sCount++] = v;
+		}
+		if (*end && *end != ',')
+			return false;
+		text = *end ? end+1 : end;
+	}
+	return list->sCount > 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Parses a comma separated list of names into their indices in names[]
+ */
+static bool parseNames(const char *text, const char **names, int numNames, listStruct *list)
+{
+	list->sCount = 0;
+	while (*text) {
+		size_t length = strcspn(text, ",");
+		int found = -1;
+		for (int k = 0; k < numNames; k++)
+			if (strlen(names[k]) == length && strncmp(text, names[k], length) == 0)
+				found = k;
+		if (found < 0 || list->sCount >= MAX_LIST)
+			return false;
+		list->sValues[list->sCount++] = found;
+		text += length;
+		if (*text)
+			text++;
+	}
+	return list->sCount > 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void usage(char *s)
+{
+	printf("%s -{options}\n", s);
+	printf(" options, lists are comma separated, integer lists may have ranges like 0-6\n");
+	printf("   -L     <list>         : Lambda values (0-6) of Dirac, default=0-6\n");
+	printf("   -Q     <list>         : Qualities (0-3), default=0-3\n");
+	printf("   -T     <list>         : Time stretch factors, default=0.5,0.8,1.25,2\n");
+	printf("   -C     <list>         : Numbers of channels, default=1,2\n");
+	printf("   -B     <list>         : Frames per call, default=256,1024,4096\n");
+	printf("   -S     <float>        : Seconds of output timed per repetition, default=2\n");
+	printf("   -W     <float>        : Seconds of output processed before timing, default=1\n");
+	printf("   -R     <int>          : Repetitions per combination, default=5, at most %d\n", MAX_LIST);
+	printf("   --api <list>          : core (DiracProcess) and/or fx (DiracFxProcessFloat),\n");
+	printf("                           default=core,fx\n");
+	printf("   --signals <list>      : sines, noise, speech and/or transients, default=all\n");
+	printf("   --json <string>       : Write the results as JSON lines to this file, - = stdout\n");
+	printf("   --csv <string>        : Write the results as CSV to this file, - = stdout\n");
+	printf("   --label <string>      : Name of this run in the JSON output, e.g. the library\n");
+	printf("                           version under test\n");
+	printf("\n");
+	printf("   -h                    : print this message.\n\n");
+	exit(1);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main (int argc, char **argv)
+{
+	benchSettingsStruct settings;
+	parseList("0-1", &settings.sApis, true);
+	parseList("0-3", &settings.sSignals, true);
+	parseList("0-6", &settings.sLambdas, true);
+	parseList("0-3", &settings.sQualities, true);
+	parseList("0.5,0.8,1.25,2", &settings.sTimes, false);
+	parseList("1,2", &settings.sChannels, false);
+	parseList("256,1024,4096", &settings.sBlocks, false);
+	settings.sWarmupSeconds = 1.;
+	settings.sSeconds = 2.;
+	settings.sRepetitions = 5;
+	settings.sLabel = "";
+	const char *jsonPath = NULL, *csvPath = NULL;
+
+	for (long i = 1; i < argc; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == 'h' || i+1 >= argc)
+			usage(argv[0]);
+		const char *option = argv[i], *value = argv[++i];
+		bool ok = true;
+		if (strcmp(option, "-L") == 0)				ok = parseList(value, &settings.sLambdas, true);
+		else if (strcmp(option, "-Q") == 0)			ok = parseList(value, &settings.sQualities, true);
+		else if (strcmp(option, "-T") == 0)			ok = parseList(value, &settings.sTimes, false);
+		else if (strcmp(option, "-C") == 0)			ok = parseList(value, &settings.sChannels, true);
+		else if (strcmp(option, "-B") == 0)			ok = parseList(value, &settings.sBlocks, false);
+		else if (strcmp(option, "-S") == 0)			settings.sSeconds = atof(value);
+		else if (strcmp(option, "-W") == 0)			settings.sWarmupSeconds = atof(value);
+		else if (strcmp(option, "-R") == 0)			settings.sRepetitions = atol(value);
+		else if (strcmp(option, "--api") == 0)		ok = parseNames(value, apiNames, kNumApis, &settings.sApis);
+		else if (strcmp(option, "--signals") == 0)	ok = parseNames(value, signalNames, kNumSignals, &settings.sSignals);
+		else if (strcmp(option, "--json") == 0)		jsonPath = value;
+		else if (strcmp(option, "--csv") == 0)		csvPath = value;
+		else if (strcmp(option, "--label") == 0)	settings.sLabel = value;
+		else										ok = false;
+		if (!ok)
+			usage(argv[0]);
+	}
+	if (settings.sSeconds <= 0. || settings.sWarmupSeconds < 0. || settings.sRepetitions < 1 || settings.sRepetitions > MAX_LIST)
+		usage(argv[0]);
+	for (long k = 0; k < settings.sLambdas.sCount; k++)
+		if (settings.sLambdas.sValues[k] < 0 || settings.sLambdas.sValues[k] > 6)		usage(argv[0]);
+	for (long k = 0; k < settings.sQualities.sCount; k++)
+		if (settings.sQualities.sValues[k] < 0 || settings.sQualities.sValues[k] > 3)	usage(argv[0]);
+	for (long k = 0; k < settings.sTimes.sCount; k++)
+		if (settings.sTimes.sValues[k] <= 0.)											usage(argv[0]);
+	for (long k = 0; k < settings.sChannels.sCount; k++)
+		if (settings.sChannels.sValues[k] < 1)											usage(argv[0]);
+	for (long k = 0; k < settings.sBlocks.sCount; k++)
+		if (settings.sBlocks.sValues[k] < 1)											usage(argv[0]);
+
+	// with results on stdout our own messages go to stderr
+	FILE *json = NULL, *csv = NULL;
+	if (jsonPath)
+		json = strcmp(jsonPath, "-") == 0 ? stdout : fopen(jsonPath, "w");
+	if (csvPath)
+		csv = strcmp(csvPath, "-") == 0 ? stdout : fopen(csvPath, "w");
+	if ((jsonPath && !json) || (csvPath && !csv)) {
+		printf("!!! Could not create %s\n", (jsonPath && !json) ? jsonPath : csvPath);
+		return -1;
+	}
+	FILE *log = (json == stdout || csv == stdout) ? stderr : stdout;
+
+	// DiracFx has no lambda, so it only goes through the other parameters
+	long numConfigs = 0;
+	for (long a = 0; a < settings.sApis.sCount; a++)
+		numConfigs += (settings.sApis.sValues[a] == kApiCore ? settings.sLambdas.sCount : 1) * settings.sSignals.sCount * settings.sQualities.sCount *
+					  settings.sTimes.sCount * settings.sChannels.sCount * settings.sBlocks.sCount;
+	fprintf(log, "DiracBench: Dirac %s, %ld combinations, %ld x %.1fs each after %.1fs of warmup\n", DiracVersion(), numConfigs,
+			settings.sRepetitions, settings.sSeconds, settings.sWarmupSeconds);
+	if (json)
+		writeJsonHeader(json, &settings, numConfigs);
+	if (csv)
+		writeCsvHeader(csv);
+
+	long signalFrames = (long)(SIGNAL_SECONDS * BENCH_SAMPLE_RATE);
+	float *signal = new float[signalFrames];
+	long numDone = 0, numFailed = 0;
+	double start = wallClockSeconds();
+
+	for (long a = 0; a < settings.sApis.sCount; a++) {
+		int api = (int)settings.sApis.sValues[a];
+		long numLambdas = api == kApiCore ? settings.sLambdas.sCount : 1;
+		for (long s = 0; s < settings.sSignals.sCount; s++) {
+			int kind = (int)settings.sSignals.sValues[s];
+			makeSignal(kind, signal, signalFrames, BENCH_SAMPLE_RATE);
+			for (long l = 0; l < numLambdas; l++)
+			for (long q = 0; q < settings.sQualities.sCount; q++)
+			for (long t = 0; t < settings.sTimes.sCount; t++)
+			for (long c = 0; c < settings.sChannels.sCount; c++)
+			for (long b = 0; b < settings.sBlocks.sCount; b++) {
+				configStruct config;
+				config.sApi				= api;
+				config.sSignal			= kind;
+				config.sLambda			= api == kApiCore ? (int)settings.sLambdas.sValues[l] : -1;
+				config.sQuality			= (int)settings.sQualities.sValues[q];
+				config.sTime			= settings.sTimes.sValues[t];
+				config.sNumChannels		= (long)settings.sChannels.sValues[c];
+				config.sBlockFrames		= (long)settings.sBlocks.sValues[b];
+
+				resultStruct result;
+				measure(&config, &settings, signal, signalFrames, &result);
+				if (json)
+					writeJsonResult(json, &config, &result);
+				if (csv)
+					writeCsvResult(csv, &config, &result);
+
+				numDone++;
+				fprintf(log, "[%ld/%ld] %s %s L%d Q%d T%.3f C%ld B%ld: ", numDone, numConfigs, apiNames[api], signalNames[kind],
+						config.sLambda, config.sQuality, config.sTime, config.sNumChannels, config.sBlockFrames);
+				if (result.sError || !result.sRepetitions) {
+					numFailed++;
+					fprintf(log, "!!! %s\n", result.sError ? result.sError : "no output");
+				} else {
+					summaryStruct rt, ns;
+					summarize(result.sRealtime, result.sRepetitions, &rt);
+					summarize(result.sNanosPerFrame, result.sRepetitions, &ns);
+					fprintf(log, "%.2fx realtime (+/- %.1f%%), %.1f ns/frame, 99%% of calls within %.1fus\n", rt.sMean,
+							rt.sMean > 0. ? 100. * rt.sStdDev / rt.sMean : 0., ns.sMean, result.sCallP99);
+				}
+				fflush(log);
+			}
+		}
+	}
+
+	fprintf(log, "\nDone: %ld combinations in %.1fs, %ld failed\n", numDone, wallClockSeconds() - start, numFailed);
+	delete[] signal;
+	if (json && json != stdout)
+		fclose(json);
+	if (csv && csv != stdout)
+		fclose(csv);
+	return numFailed ? 1 : 0;
+}
@@ -0,0 +1,654 @@
+/*
+ "DiracBenchCompare.cpp" DiracBench Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Compares a baseline with a candidate, typically the same benchmark run against two drops of
+ the library on the same machine. Takes the JSON lines of DiracBench and the output of the
+ example programs, which print their speed from the DSP time PhaseTimer measured
+ (times.sSeconds[kPhaseDsp]).
+ Every combination found in both is tested with a Mann-Whitney U test, for its speed and for
+ the 99th percentile of its calls, and the change of the median is given with a bootstrap
+ confidence interval. Changes that are both significant and larger than a threshold are
+ flagged, and make the program return 1 if they are regressions.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+
+// most samples of one combination on one side. Files of the same side are pooled, so this can
+// be more than the repetitions of one DiracBench run
+#define MAX_SAMPLES				256
+
+// up to this many samples on both sides and without ties the p value is exact
+#define MAX_EXACT_SAMPLES		32
+
+// resamples for the confidence interval of the change
+#define BOOTSTRAP_ROUNDS		2000
+
+enum {
+	kVerdictUntested = 0,			/* too few samples on one side */
+	kVerdictSame,
+	kVerdictImprovement,
+	kVerdictRegression
+};
+
+static const char *verdictNames[] = { "untested", "same", "improvement", "regression" };
+
+
+// The samples of one combination in one set
+typedef struct {
+	char sKey[128];						/* e.g. "core speech L3 Q2 T1.250 C2 B1024" */
+	double sRealtime[MAX_SAMPLES];		/* speed as a multiple of realtime, higher is better */
+	long sNumRealtime;
+	double sCallP99[MAX_SAMPLES];		/* 99th percentile of the calls in microseconds */
+	long sNumCallP99;
+	char sError[64];					/* why the combination was not measured, empty if it was */
+} entryStruct;
+
+
+// All files given for one side
+typedef struct {
+	const char *sName;					/* "baseline" or "candidate" */
+	char sVersion[64], sLabel[64], sCpu[128];	/* from the first DiracBench header, empty if none */
+	entryStruct *sEntries;
+	long sNumEntries, sCapacity;
+	long sNumDropped;					/* samples beyond MAX_SAMPLES */
+} setStruct;
+
+
+// What the test of one metric of one combination found
+typedef struct {
+	double sBaseMedian, sNewMedian;
+	double sChange, sLow, sHigh;		/* relative change of the median and its 95% CI, +0.05 = 5% higher */
+	double sP;							/* two sided p value, 1 if untested */
+	int sVerdict;
+} testStruct;
+
+
+#pragma mark ---- Statistics ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static double median(const double *values, long count)
+{
+	double sorted[MAX_SAMPLES];
+	memcpy(sorted, values, count*sizeof(double));
+	std::sort(sorted, sorted+count);
+	return count & 1 ? sorted[count/2] : 0.5 * (sorted[count/2-1] + sorted[count/2]);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Exact two sided p value of U for samples of nx and ny values without ties. The number of
+ orderings with a given U are the coefficients of the Gaussian binomial [nx+ny choose nx],
+ built up one sample of y at a time from [m+n choose m] = [m+n-1 choose m-1] + q^m [m+n-1 choose m]
+ */
+static double exactP(double u, long nx, long ny)
+{
+	long width = nx*ny + 1;
+	double *prev = new double[(nx+1)*width], *cur = new double[(nx+1)*width];
+	memset(prev, 0, (nx+1)*width*sizeof(double));
+	for (long m = 0; m <= nx; m++)
+		prev[m*width] = 1.;
+
+	for (long n = 1; n <= ny; n++) {
+		for (long m = 0; m <= nx; m++)
+			for (long k = 0; k < width; k++)
+				cur[m*width + k] = (m ? cur[(m-1)*width + k] : 0.) + (k >= m ? prev[m*width + k - m] : 0.);
+		std::swap(prev, cur);
+	}
+
+	const double *count = prev + nx*width;
+	double total = 0., tail = 0., lower = std::min(u, (double)(width-1) - u);
+	for (long k = 0; k < width; k++) {
+		total += count[k];
+		if (k <= lower + 1e-9)
+			tail += count[k];
+	}
+	delete[] prev;
+	delete[] cur;
+	return std::min(1., 2. * tail / total);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct {
+	double sValue;
+	bool sIsX;
+} rankedStruct;
+
+static bool lessThan(const rankedStruct &a, const rankedStruct &b)
+{
+	return a.sValue < b.sValue;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Two sided Mann-Whitney U test of x against y. Exact for small samples without ties, otherwise
+ the normal approximation with continuity and tie correction
+ */
+static double mannWhitney(const double *x, long nx, const double *y, long ny)
+{
+	long n = nx + ny;
+	rankedStruct *pooled = new rankedStruct[n];
+	for (long k = 0; k < n; k++) {
+		pooled[k].sValue = k < nx ? x[k] : y[k-nx];
+		pooled[k].sIsX = k < nx;
+	}
+	std::sort(pooled, pooled+n, lessThan);
+
+	// ties share the mean of their ranks
+	double rankSumX = 0., tieSum = 0.;
+	for (long k = 0; k < n; ) {
+		long end = k + 1;
+		while (end < n && pooled[end].sValue == pooled[k].sValue)
+			end++;
+		double rank = 0.5 * (k + 1 + end);
+		for (long j = k; j < end; j++)
+			if (pooled[j].sIsX)
+				rankSumX += rank;
+		double t = (double)(end - k);
+		tieSum += t*t*t - t;
+		k = end;
+	}
+	delete[] pooled;
+
+	double u = rankSumX - 0.5 * nx * (nx + 1);
+	if (tieSum == 0. && nx <= MAX_EXACT_SAMPLES && ny <= MAX_EXACT_SAMPLES)
+		return exactP(u, nx, ny);
+
+	double variance = nx * ny / 12. * ((n + 1) - tieSum / ((double)n * (n - 1)));
+	if (variance <= 0.)
+		return 1.;
+	double z = std::max(0., fabs(u - 0.5 * nx * ny) - 0.5) / sqrt(variance);
+	return erfc(z / sqrt(2.));
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Percentile bootstrap of the relative change of the median from base to new. Seeded the same
+ every time, so a comparison gives the same interval when run again
+ */
+static void bootstrap(const double *base, long nBase, const double *values, long nNew, double *low, double *high)
+{
+	double *changes = new double[BOOTSTRAP_ROUNDS];
+	double a[MAX_SAMPLES], b[MAX_SAMPLES];
+	unsigned long seed = 1;
+	long count = 0;
+
+	for (long r = 0; r < BOOTSTRAP_ROUNDS; r++) {
+		for (long k = 0; k < nBase; k++) {
+			seed = (seed * 1664525UL + 1013904223UL) & 0xffffffffUL;
+			a[k] = base[(seed >> 8) % nBase];
+		}
+		for (long k = 0; k < nNew; k++) {
+			seed = (seed * 1664525UL + 1013904223UL) & 0xffffffffUL;
+			b[k] = values[(seed >> 8) % nNew];
+		}
+		double m = median(a, nBase);
+		if (m > 0.)
+			changes[count++] = median(b, nNew) / m - 1.;
+	}
+	if (count) {
+		std::sort(changes, changes+count);
+		*low = changes[(long)(0.025 * (count-1))];
+		*high = changes[(long)(0.975 * (count-1))];
+	} else
+		*low = *high = 0.;
+	delete[] changes;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Tests one metric. A change counts if it is significant at alpha and larger than threshold,
+ in which direction is a regression depends on higherIsBetter
+ */
+static void test(const double *base, long nBase, const double *values, long nNew, bool higherIsBetter, double alpha, double threshold, testStruct *result)
+{
+	memset(result, 0, sizeof(testStruct));
+	result->sP = 1.;
+	if (nBase < 1 || nNew < 1)
+		return;
+	result->sBaseMedian = median(base, nBase);
+	result->sNewMedian = median(values, nNew);
+	result->sChange = result->sBaseMedian > 0. ? result->sNewMedian / result->sBaseMedian - 1. : 0.;
+	result->sLow = result->sHigh = result->sChange;
+	if (nBase < 2 || nNew < 2)
+		return;
+
+	bootstrap(base, nBase, values, nNew, &result->sLow, &result->sHigh);
+	result->sP = mannWhitney(base, nBase, values, nNew);
+	result->sVerdict = kVerdictSame;
+	if (result->sP < alpha && fabs(result->sChange) > threshold)
+		result->sVerdict = (result->sChange > 0.) == higherIsBetter ? kVerdictImprovement : kVerdictRegression;
+}
+
+
+#pragma mark ---- Reading results ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the entry for key in set, adding an empty one if there is none
+ */
+static entryStruct *getEntry(setStruct *set, const char *key)
+{
+	for (long k = 0; k < set->sNumEntries; k++)
+		if (strcmp(set->sEntries[k].sKey, key) == 0)
+			return &set->sEntries[k];
+	if (set->sNumEntries == set->sCapacity) {
+		long capacity = set->sCapacity ? 2 * set->sCapacity : 64;
+		entryStruct *entries = (entryStruct*)realloc(set->sEntries, capacity * sizeof(entryStruct));
+		if (!entries)
+			return NULL;
+		set->sEntries = entries;
+		set->sCapacity = capacity;
+	}
+	entryStruct *entry = &set->sEntries[set->sNumEntries++];
+	memset(entry, 0, sizeof(entryStruct));
+	snprintf(entry->sKey, sizeof(entry->sKey), "%s", key);
+	return entry;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void addSamples(setStruct *set, double *samples, long *count, const double *values, long numValues)
+{
+	for (long k = 0; k < numValues; k++) {
+		if (*count < MAX_SAMPLES)
+			samples[(*count)++] = values[k];
+		else
+			set->sNumDropped++;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns where the value of "key" starts in a JSON line, NULL if it has none. DiracBench
+ writes flat objects, one per line, so this is all the parsing it takes
+ */
+static const char *findJsonValue(const char *line, const char *key)
+{
+	char pattern[64];
+	snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+	const char *found = strstr(line, pattern);
+	return found ? found + strlen(pattern) + strspn(found + strlen(pattern), " \t") : NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static bool getJsonString(const char *line, const char *key, char *value, size_t size)
+{
+	const char *p = findJsonValue(line, key);
+	if (!p || *p != '"')
+		return false;
+	size_t length = 0;
+	for (p++; *p && *p != '"'; p++) {
+		if (*p == '\\' && p[1])
+			p++;
+		if (length + 1 < size)
+			value[length++] = *p;
+	}
+	value[length] = 0;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static bool getJsonNumber(const char *line, const char *key, double *value)
+{
+	const char *p = findJsonValue(line, key);
+	char *end;
+	if (!p)
+		return false;
+	*value = strtod(p, &end);
+	return end != p;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads an array of numbers into values[0...max-1], returns how many there were
+ */
+static long getJsonArray(const char *line, const char *key, double *values, long max)
+{
+	const char *p = findJsonValue(line, key);
+	long count = 0;
+	if (!p || *p != '[')
+		return 0;
+	for (p++; *p && *p != ']' && count < max; ) {
+		char *end;
+		values[count] = strtod(p, &end);
+		if (end == p)
+			break;
+		count++;
+		p = end + strspn(end, ", ");
+	}
+	return count;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Adds the lines of a DiracBench JSON file to set. Returns false if it could not be read
+ */
+static bool readBenchFile(FILE *f, setStruct *set)
+{
+	char *line = NULL;
+	size_t size = 0;
+	bool ok = true;
+
+	while (ok && getline(&line, &size, f) > 0) {
+		char event[16], api[16], signal[32], key[128];
+		double lambda, quality, time, channels, block;
+		if (!getJsonString(line, "event", event, sizeof(event)))
+			continue;
+
+		if (strcmp(event, "bench") == 0) {
+			if (!set->sVersion[0]) {
+				getJsonString(line, "dirac_version", set->sVersion, sizeof(set->sVersion));
+				getJsonString(line, "label", set->sLabel, sizeof(set->sLabel));
+				getJsonString(line, "cpu", set->sCpu, sizeof(set->sCpu));
+			}
+			continue;
+		}
+		if (strcmp(event, "config") != 0 || !getJsonString(line, "api", api, sizeof(api)) || !getJsonString(line, "signal", signal, sizeof(signal)) ||
+			!getJsonNumber(line, "lambda", &lambda) || !getJsonNumber(line, "quality", &quality) || !getJsonNumber(line, "time", &time) ||
+			!getJsonNumber(line, "channels", &channels) || !getJsonNumber(line, "block", &block))
+			continue;
+
+		// the same names DiracBench prints its progress with
+		if (lambda >= 0.)
+			snprintf(key, sizeof(key), "%s %s L%d Q%d T%.3f C%ld B%ld", api, signal, (int)lambda, (int)quality, time, (long)channels, (long)block);
+		else
+			snprintf(key, sizeof(key), "%s %s Q%d T%.3f C%ld B%ld", api, signal, (int)quality, time, (long)channels, (long)block);
+		entryStruct *entry = getEntry(set, key);
+		if (!entry) {
+			ok = false;
+			break;
+		}
+
+		double values[MAX_SAMPLES];
+		if (getJsonString(line, "error", entry->sError, sizeof(entry->sError)))
+			continue;
+		long count = getJsonArray(line, "realtime", values, MAX_SAMPLES);
+		addSamples(set, entry->sRealtime, &entry->sNumRealtime, values, count);
+		count = getJsonArray(line, "call_us_p99_reps", values, MAX_SAMPLES);
+		addSamples(set, entry->sCallP99, &entry->sNumCallP99, values, count);
+	}
+	free(line);
+	return ok && !ferror(f);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Adds the output of one run of an example program to set. The examples print the average speed
+ vs. realtime as they go, from the DSP time PhaseTimer has counted so far (times.sSeconds[kPhaseDsp]),
+ the last one is the speed of the whole run. Runs of the same example are told apart by a number at
+ the end of the file name, so timestretch-1.txt, timestretch-2.txt ... are all samples of
+ "example timestretch"
+ */
+static bool readExampleLog(FILE *f, const char *path, setStruct *set)
+{
+	static const char *marker = "speed vs. realtime = ";
+	char line[512], key[128];
+	double speed = -1.;
+
+	while (fgets(line, sizeof(line), f)) {
+		char *found = strstr(line, marker), *end;
+		if (!found)
+			continue;
+		double value = strtod(found + strlen(marker), &end);
+		if (end != found + strlen(marker))
+			speed = value;
+	}
+	if (speed < 0.) {
+		printf("!!! %s: no speed vs. realtime found\n", path);
+		return false;
+	}
+
+	// file name without directory, extension and run number
+	const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	size_t length = strcspn(name, ".");
+	while (length > 0 && name[length-1] >= '0' && name[length-1] <= '9')
+		length--;
+	while (length > 1 && (name[length-1] == '-' || name[length-1] == '_'))
+		length--;
+	if (length == 0)
+		length = strcspn(name, ".");
+	snprintf(key, sizeof(key), "example %.*s", (int)length, name);
+
+	entryStruct *entry = getEntry(set, key);
+	if (!entry)
+		return false;
+	addSamples(set, entry->sRealtime, &entry->sNumRealtime, &speed, 1);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Adds a file to set, DiracBench JSON lines if it starts with '{', the output of an example
+ otherwise
+ */
+static bool readFile(const char *path, setStruct *set)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		printf("!!! Could not open %s\n", path);
+		return false;
+	}
+	int c;
+	while ((c = fgetc(f)) == ' ' || c == '\t' || c == '\r' || c == '\n')
+		;
+	rewind(f);
+	bool ok = c == '{' ? readBenchFile(f, set) : readExampleLog(f, path, set);
+	if (!ok && c == '{')
+		printf("!!! Could not read %s\n", path);
+	fclose(f);
+	return ok;
+}
+
+
+#pragma mark ---- Output ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes s as a JSON string, with quotes
+ */
+static void writeJsonString(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(out, "\\u%04x", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void describeSet(FILE *out, setStruct *set)
+{
+	fprintf(out, "%-10s %ld combinations", set->sName, set->sNumEntries);
+	if (set->sVersion[0])
+		fprintf(out, ", Dirac %s", set->sVersion);
+	if (set->sLabel[0])
+		fprintf(out, " (%s)", set->sLabel);
+	if (set->sCpu[0])
+		fprintf(out, " on %s", set->sCpu);
+	fprintf(out, "\n");
+	if (set->sNumDropped)
+		fprintf(out, "!!! %s: %ld samples beyond %d per combination ignored\n", set->sName, set->sNumDropped, MAX_SAMPLES);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ One column of the table: change, its interval, p value and a mark for what it means
+ */
+static void writeTest(FILE *out, testStruct *t, long numSamples)
+{
+	if (!numSamples) {
+		fprintf(out, "  %-37s", "-");
+		return;
+	}
+	static const char *marks[] = { "?", "", "+", "!!!" };
+	fprintf(out, "  %+6.1f%% [%+6.1f%%,%+6.1f%%] p=%.3f %-3s", 100. * t->sChange, 100. * t->sLow, 100. * t->sHigh, t->sP, marks[t->sVerdict]);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void writeJsonTest(FILE *out, const char *name, testStruct *t)
+{
+	fprintf(out, ",\"%s\":{\"base_median\":%.4f,\"new_median\":%.4f,\"change_percent\":%.2f,\"ci_percent\":[%.2f,%.2f],\"p\":%.5f,\"verdict\":\"%s\"}",
+			name, t->sBaseMedian, t->sNewMedian, 100. * t->sChange, 100. * t->sLow, 100. * t->sHigh, t->sP, verdictNames[t->sVerdict]);
+}
+
+
+#pragma mark ---- Main program ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void usage(char *s)
+{
+	printf("%s -a <file> [-a <file>...] -b <file> [-b <file>...] -{options}\n", s);
+	printf(" files are DiracBench JSON lines or the printout of one run of an example program\n");
+	printf("   -a     <string>       : Baseline, files of the same side are pooled\n");
+	printf("   -b     <string>       : Candidate\n");
+	printf("   --alpha <float>       : Significance level, default=0.05\n");
+	printf("   --threshold <float>   : Smallest change in percent that counts, default=2\n");
+	printf("   --json <string>       : Write the comparison as JSON lines to this file, - = stdout\n");
+	printf("   -q                    : Only list combinations that changed\n");
+	printf("\n");
+	printf("   -h                    : print this message.\n\n");
+	printf(" returns 1 if the candidate has a regression, 0 if not\n\n");
+	exit(-1);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main (int argc, char **argv)
+{
+	setStruct sets[2];
+	memset(sets, 0, sizeof(sets));
+	sets[0].sName = "baseline";
+	sets[1].sName = "candidate";
+	double alpha = 0.05, threshold = 2.;
+	const char *jsonPath = NULL;
+	bool quiet = false, ok = true;
+
+	for (long i = 1; i < argc; i++) {
+		const char *option = argv[i];
+		if (strcmp(option, "-q") == 0) {
+			quiet = true;
+			continue;
+		}
+		if (option[0] != '-' || option[1] == 'h' || i+1 >= argc)
+			usage(argv[0]);
+		const char *value = argv[++i];
+		if (strcmp(option, "-a") == 0)					ok = readFile(value, &sets[0]) && ok;
+		else if (strcmp(option, "-b") == 0)				ok = readFile(value, &sets[1]) && ok;
+		else if (strcmp(option, "--alpha") == 0)		alpha = atof(value);
+		else if (strcmp(option, "--threshold") == 0)	threshold = atof(value);
+		else if (strcmp(option, "--json") == 0)			jsonPath = value;
+		else											usage(argv[0]);
+	}
+	if (!ok)
+		return -1;
+	if (!sets[0].sNumEntries || !sets[1].sNumEntries || alpha <= 0. || alpha >= 1. || threshold < 0.)
+		usage(argv[0]);
+
+	FILE *json = NULL;
+	if (jsonPath) {
+		json = strcmp(jsonPath, "-") == 0 ? stdout : fopen(jsonPath, "w");
+		if (!json) {
+			printf("!!! Could not create %s\n", jsonPath);
+			return -1;
+		}
+	}
+	FILE *log = json == stdout ? stderr : stdout;
+
+	describeSet(log, &sets[0]);
+	describeSet(log, &sets[1]);
+	if (sets[0].sCpu[0] && sets[1].sCpu[0] && strcmp(sets[0].sCpu, sets[1].sCpu) != 0)
+		fprintf(log, "!!! The sets were measured on different CPUs, differences may not be the library's\n");
+	fprintf(log, "\nChange of the median from baseline to candidate with its 95%% CI, Mann-Whitney p, significant at %g and beyond %g%%:\n"
+			"!!! regression, + improvement, ? too few samples to test\n\n", alpha, threshold);
+	fprintf(log, "%-40s  %-37s  %-37s\n", "combination", "speed vs. realtime", "99th percentile call");
+
+	long numCompared = 0, numRegressions = 0, numImprovements = 0, numFailed = 0, numMissing = 0;
+	for (long k = 0; k < sets[0].sNumEntries; k++) {
+		entryStruct *base = &sets[0].sEntries[k], *cand = NULL;
+		for (long j = 0; j < sets[1].sNumEntries && !cand; j++)
+			if (strcmp(sets[1].sEntries[j].sKey, base->sKey) == 0)
+				cand = &sets[1].sEntries[j];
+		if (!cand) {
+			numMissing++;
+			continue;
+		}
+
+		// a combination that worked before and fails now is a regression too
+		if (base->sError[0] || cand->sError[0]) {
+			if (!base->sError[0]) {
+				numRegressions++;
+				fprintf(log, "%-40s  !!! candidate failed: %s\n", base->sKey, cand->sError);
+			} else
+				numFailed++;
+			continue;
+		}
+
+		testStruct speed, latency;
+		test(base->sRealtime, base->sNumRealtime, cand->sRealtime, cand->sNumRealtime, true, alpha, threshold / 100., &speed);
+		test(base->sCallP99, base->sNumCallP99, cand->sCallP99, cand->sNumCallP99, false, alpha, threshold / 100., &latency);
+		numCompared++;
+		bool regression = speed.sVerdict == kVerdictRegression || latency.sVerdict == kVerdictRegression;
+		bool improvement = speed.sVerdict == kVerdictImprovement || latency.sVerdict == kVerdictImprovement;
+		if (regression)
+			numRegressions++;
+		else if (improvement)
+			numImprovements++;
+
+		if (!quiet || regression || improvement) {
+			fprintf(log, "%-40s", base->sKey);
+			writeTest(log, &speed, std::min(base->sNumRealtime, cand->sNumRealtime));
+			writeTest(log, &latency, std::min(base->sNumCallP99, cand->sNumCallP99));
+			fprintf(log, "\n");
+		}
+		if (json) {
+			fprintf(json, "{\"event\":\"compare\",\"config\":");
+			writeJsonString(json, base->sKey);
+			fprintf(json, ",\"base_samples\":%ld,\"new_samples\":%ld", base->sNumRealtime, cand->sNumRealtime);
+			writeJsonTest(json, "realtime", &speed);
+			if (base->sNumCallP99 && cand->sNumCallP99)
+				writeJsonTest(json, "call_us_p99", &latency);
+			fprintf(json, "}\n");
+		}
+	}
+	for (long j = 0; j < sets[1].sNumEntries; j++) {
+		bool found = false;
+		for (long k = 0; k < sets[0].sNumEntries && !found; k++)
+			found = strcmp(sets[0].sEntries[k].sKey, sets[1].sEntries[j].sKey) == 0;
+		if (!found)
+			numMissing++;
+	}
+
+	fprintf(log, "\n%ld combinations compared: %ld regressions, %ld improvements, %ld failed in both, %ld only in one set\n", numCompared,
+			numRegressions, numImprovements, numFailed, numMissing);
+	if (json) {
+		fprintf(json, "{\"event\":\"summary\",\"compared\":%ld,\"regressions\":%ld,\"improvements\":%ld,\"failed\":%ld,\"unmatched\":%ld,\"alpha\":%g,\"threshold_percent\":%g}\n",
+				numCompared, numRegressions, numImprovements, numFailed, numMissing, alpha, threshold);
+		if (json != stdout)
+			fclose(json);
+	}
+	for (long s = 0; s < 2; s++)
+		free(sets[s].sEntries);
+	return numRegressions ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+/*
+ "BridgeBench.cpp" DiracBridge Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Times every DiracProcess() call on a synthetic signal. Built twice from the same source: 32 bit
+ with libDiracLE.a (BridgeBench32, in-process) and 64 bit with libDiracBridge.a (BridgeBench64,
+ through DiracWorker). Running both with the same options shows what bridging costs per call.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#include "Dirac.h"
+
+
+// seconds of audio processed before we start timing, so buffers are primed and caches are warm
+#define WARMUP_SECONDS	1.0
+
+// most frames of a self check call, see selfCheck()
+#define CHECK_MAX_FRAMES	100000
+
+
+// State of the read callback: a few sines and some noise, the same in every run
+typedef struct {
+	long sNumChannels;
+	float sSampleRate;
+	unsigned long sPosition;
+	unsigned long sRandom;
+	long sNumReads;
+} signalStruct;
+
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static double wallClockSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Dirac's read callback
+ */
+static long myReadData(float **chdata, long numFrames, void *userData)
+{
+	signalStruct *signal = (signalStruct*)userData;
+	for (long i = 0; i < numFrames; i++) {
+		double t = (double)(signal->sPosition + i) / signal->sSampleRate;
+		signal->sRandom = signal->sRandom * 1664525UL + 1013904223UL;
+		float noise = (float)((signal->sRandom >> 8) & 0xffff) / 65536.f - 0.5f;
+		for (long c = 0; c < signal->sNumChannels; c++)
+			chdata[c][i] = 0.3f*(float)sin(2.*M_PI*(220.*(c+1))*t) + 0.2f*(float)sin(2.*M_PI*1375.*t) + 0.05f*noise;
+	}
+	signal->sPosition += numFrames;
+	signal->sNumReads++;
+	return numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Makes calls of mixed sizes, small and odd ones followed by ones that fill most of the bridge's
+ rings or are larger than them, and checks that each returns all frames. Every size has to work,
+ wherever the previous calls left the rings. Returns false if one did not
+ */
+static bool selfCheck(void *dirac, long numChannels)
+{
+	static const long sizes[] = { 30000, 40000, 30000, 40000, 1, 65536, 777, 32768, 32769, 100000, 3, 65535, 1024 };
+	float **audio = new float*[numChannels];
+	for (long c = 0; c < numChannels; c++)
+		audio[c] = new float[CHECK_MAX_FRAMES];
+
+	bool ok = true;
+	for (size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]) && ok; k++) {
+		long ret = DiracProcess(audio, sizes[k], dirac);
+		if (ret != sizes[k]) {
+			printf("!!! Self check failed: call #%d of %ld frames returned %ld\n", (int)k+1, sizes[k], ret);
+			ok = false;
+		}
+	}
+
+	for (long c = 0; c < numChannels; c++)
+		delete[] audio[c];
+	delete[] audio;
+	return ok;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void usage(char *s)
+{
+	printf("%s -{options}\n", s);
+	printf(" options\n");
+	printf("   -L     <int>          : Lambda value (0-6), default=0\n");
+	printf("   -Q     <int>          : Quality (0-3), default=0\n");
+	printf("   -T     <long double>  : Time stretch factor, default=1.0\n");
+	printf("   -C     <int>          : Number of channels, default=2\n");
+	printf("   -B     <int>          : Frames per DiracProcess() call, default=1024\n");
+	printf("   -S     <float>        : Seconds of output to time, default=10\n");
+	printf("\n");
+	printf("   -h                    : print this message.\n\n");
+	exit(1);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main (int argc, char **argv)
+{
+	int lambda = 0, quality = 0;
+	long double time = 1.;
+	long numChannels = 2, numFrames = 1024;
+	double seconds = 10.;
+	float sr = 44100.f;
+
+	for (long i = 1; i < argc; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == 'h' || i+1 >= argc)
+			usage(argv[0]);
+		switch (argv[i][1]) {
+			case 'L':	lambda = atoi(argv[++i]);				break;
+			case 'Q':	quality = atoi(argv[++i]);				break;
+			case 'T':	time = strtold(argv[++i], NULL);		break;
+			case 'C':	numChannels = atol(argv[++i]);			break;
+			case 'B':	numFrames = atol(argv[++i]);			break;
+			case 'S':	seconds = atof(argv[++i]);				break;
+			default:	usage(argv[0]);
+		}
+	}
+	if (numChannels < 1 || numFrames < 1 || seconds <= 0.)
+		usage(argv[0]);
+
+	signalStruct signal;
+	signal.sNumChannels	= numChannels;
+	signal.sSampleRate	= sr;
+	signal.sPosition	= 0;
+	signal.sRandom		= 1;
+	signal.sNumReads	= 0;
+
+	void *dirac = DiracCreate(kDiracLambdaPreview+lambda, kDiracQualityPreview+quality, numChannels, sr, &myReadData, (void*)&signal);
+	if (!dirac) {
+		printf("!! ERROR !!\n\n\tCould not create DIRAC instance\n");
+		return -1;
+	}
+	DiracSetProperty(kDiracPropertyTimeFactor, time, dirac);
+
+	printf("BridgeBench: %s (%d bit), Dirac %s\n", sizeof(void*) == 8 ? "bridged" : "in-process", (int)(8*sizeof(void*)), DiracVersion());
+	printf("lambda %d, quality %d, time %.3Lf, %ld channels, %.0f Hz, %ld frames per call, %.1fs of output\n",
+		   lambda, quality, time, numChannels, sr, numFrames, seconds);
+	if (!selfCheck(dirac, numChannels)) {
+		DiracDestroy(dirac);
+		return -1;
+	}
+	printf(" self check of mixed call sizes passed\n");
+
+	float **audio = new float*[numChannels];
+	for (long c = 0; c < numChannels; c++)
+		audio[c] = new float[numFrames];
+
+	long numWarmup = (long)(WARMUP_SECONDS * sr / numFrames) + 1;
+	long numCalls = (long)(seconds * sr / numFrames) + 1;
+	double *callSeconds = new double[numCalls];
+
+	for (long k = 0; k < numWarmup; k++)
+		DiracProcess(audio, numFrames, dirac);
+	long readsBefore = signal.sNumReads;
+
+	double start = wallClockSeconds();
+	for (long k = 0; k < numCalls; k++) {
+		double callStart = wallClockSeconds();
+		DiracProcess(audio, numFrames, dirac);
+		callSeconds[k] = wallClockSeconds() - callStart;
+	}
+	double elapsed = wallClockSeconds() - start;
+
+	std::sort(callSeconds, callSeconds+numCalls);
+	double sum = 0.;
+	for (long k = 0; k < numCalls; k++)
+		sum += callSeconds[k];
+	printf(" calls %ld, read callbacks %ld\n", numCalls, signal.sNumReads - readsBefore);
+	printf(" per call: mean %.1fus, median %.1fus, 99th percentile %.1fus, max %.1fus\n",
+		   1e6*sum/numCalls, 1e6*callSeconds[numCalls/2], 1e6*callSeconds[(long)(0.99*(numCalls-1))], 1e6*callSeconds[numCalls-1]);
+	printf(" overall: %.2fx realtime\n", elapsed > 0. ? (double)numCalls*numFrames/sr/elapsed : 0.);
+
+	delete[] callSeconds;
+	for (long c = 0; c < numChannels; c++)
+		delete[] audio[c];
+	delete[] audio;
+	DiracDestroy(dirac);
+	return 0;
+}
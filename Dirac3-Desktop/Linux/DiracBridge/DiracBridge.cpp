@@ -0,0 +1,558 @@
+/*
+ "DiracBridge.cpp" DiracBridge Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Implements the core calls of Dirac.h for 64 bit programs, which cannot link the 32 bit
+ libDiracLE.a. The first call starts DiracWorker (DIRAC_WORKER, or DiracWorker on the PATH), which
+ runs the actual Dirac instances. Audio goes through shared memory: the read callback writes
+ straight into the input ring, DiracProcess() copies from the output ring into the caller's
+ buffers. See DiracBridgeProtocol.h.
+
+ As with Dirac itself, an instance must only be used by one thread at a time, different instances
+ may be used on different threads at once.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "Dirac.h"
+#include "DiracBridgeProtocol.h"
+
+
+// the worker we start if DIRAC_WORKER does not name one, looked up on the PATH
+#define DEFAULT_WORKER		"DiracWorker"
+
+// number of different error texts DiracErrorToString() keeps
+#define MAX_ERROR_TEXTS		32
+
+
+// What the host knows about one instance in the worker
+typedef struct {
+	int32_t sId;
+	dbShared *sShared;
+	size_t sSize;
+	long sNumChannels;
+	long (*sReadData)(float **data, long numFrames, void *userData);
+	void *sUserData;
+	void (*sProcessingBegan)(unsigned long position, void *userData);
+	void *sBeganUserData;
+	float **sPointers;					/* channel pointers into a ring */
+	uint32_t sSeen;						/* last value of sToHost we acted on */
+} bridgeInstance;
+
+
+typedef struct {
+	long sError;
+	char sText[208];
+} errorTextStruct;
+
+
+// The worker and the socket to it. Control messages are sent under gLock
+static pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+static int gSocket = -1;
+static pid_t gWorker = 0;
+static volatile bool gWorkerGone = false;
+static char gVersion[208] = "DiracBridge: DiracWorker is not running";
+static long gNextShared = 0;
+static long gSpinCount = 0;
+static errorTextStruct gErrorTexts[MAX_ERROR_TEXTS];
+static int gNumErrorTexts = 0;
+static struct timespec gClockStart;
+
+
+#pragma mark ---- Worker ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads or writes a whole control message. Returns false if the socket was closed
+ */
+static bool transfer(int fd, dbControl *message, bool sending)
+{
+	char *bytes = (char*)message;
+	size_t done = 0;
+	while (done < sizeof(dbControl)) {
+		ssize_t ret = sending ? send(fd, bytes+done, sizeof(dbControl)-done, MSG_NOSIGNAL) : recv(fd, bytes+done, sizeof(dbControl)-done, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		done += ret;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Sends a control message and waits for the reply, which replaces it. Called with gLock held.
+ Returns false if the worker is gone
+ */
+static bool controlCall(dbControl *message)
+{
+	if (gSocket < 0)
+		return false;
+	if (transfer(gSocket, message, true) && transfer(gSocket, message, false))
+		return true;
+	close(gSocket);
+	gSocket = -1;
+	gWorkerGone = true;
+	return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns false once the worker has exited. Used while we wait for an instance
+ */
+static bool workerAlive()
+{
+	if (gWorkerGone)
+		return false;
+	pid_t ret = waitpid(gWorker, NULL, WNOHANG);
+	if (ret == gWorker || (ret < 0 && errno == ECHILD))
+		gWorkerGone = true;
+	return !gWorkerGone;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Starts the worker with one end of a socket pair and says hello, unless that has been done
+ already. A worker that died is not started again, its instances are gone. Called with gLock held
+ */
+static bool startWorker()
+{
+	if (gSocket >= 0)
+		return true;
+	if (gWorkerGone)
+		return false;
+
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+		return false;
+	const char *path = getenv("DIRAC_WORKER");
+	if (!path || !path[0])
+		path = DEFAULT_WORKER;
+	char fdText[16];
+	snprintf(fdText, sizeof(fdText), "%d", sockets[1]);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(sockets[0]);
+		execlp(path, path, "--fd", fdText, (char*)NULL);
+		printf("!!! Could not start %s, set DIRAC_WORKER to its path\n", path);
+		fflush(stdout);
+		_exit(127);
+	}
+	close(sockets[1]);
+	if (pid < 0) {
+		close(sockets[0]);
+		return false;
+	}
+	fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+	gSocket = sockets[0];
+	gWorker = pid;
+	gSpinCount = dbSpinCount();
+
+	dbControl message;
+	memset(&message, 0, sizeof(message));
+	message.sCommand = kDbHello;
+	message.sResult = DB_PROTOCOL_VERSION;
+	if (!controlCall(&message)) {
+		waitpid(pid, NULL, 0);
+		return false;
+	}
+	message.sText[sizeof(message.sText)-1] = 0;
+	strcpy(gVersion, message.sText);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The worker asks for input: we run the caller's read callback straight into the input ring
+ */
+static void readInput(bridgeInstance *inst)
+{
+	dbShared *shared = inst->sShared;
+	dbRing *ring = &shared->sInput;
+	uint32_t numFrames = (uint32_t)shared->sFrames;
+
+	bool full;
+	uint32_t position = dbRingBeginWrite(ring, numFrames, &full);
+	if (full || numFrames > dbRingMaxBlock(ring)) {
+		shared->sResult = kDiracErrorUnknownErr;
+		return;
+	}
+	for (long c = 0; c < inst->sNumChannels; c++)
+		inst->sPointers[c] = dbRingFrames(shared, ring, c, position);
+	shared->sResult = inst->sReadData(inst->sPointers, numFrames, inst->sUserData);
+	dbRingEndWrite(ring, position, numFrames);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Hands a call to the instance's thread in the worker and serves its requests until it is done.
+ Returns false if the worker is gone
+ */
+static bool instanceCall(bridgeInstance *inst, int32_t command)
+{
+	dbShared *shared = inst->sShared;
+	shared->sCommand = command;
+	dbPost(&shared->sToWorker, &shared->sWorkerSleeping);
+
+	for (;;) {
+		if (!dbWait(&shared->sToHost, inst->sSeen, &shared->sHostSleeping, gSpinCount)) {
+			if (!workerAlive())
+				return false;
+			continue;
+		}
+		inst->sSeen = shared->sToHost;
+
+		switch (shared->sRequest) {
+			case kDbDone:
+				return true;
+			case kDbRead:
+				readInput(inst);
+				break;
+			case kDbBegan:
+				if (inst->sProcessingBegan)
+					inst->sProcessingBegan((unsigned long)shared->sPosition, inst->sBeganUserData);
+				break;
+		}
+		dbPost(&shared->sToWorker, &shared->sWorkerSleeping);
+	}
+}
+
+
+#pragma mark ---- Dirac core API ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void *DiracCreate(long lambda, long quality, long numChannels, float sampleRateHz, long (*readFromChannelsCallback)(float **data, long numFrames, void *userData), void *userData)
+{
+	if (numChannels < 1 || !readFromChannelsCallback)
+		return NULL;
+
+	bridgeInstance *inst = new bridgeInstance;
+	memset(inst, 0, sizeof(bridgeInstance));
+	inst->sNumChannels	= numChannels;
+	inst->sReadData		= readFromChannelsCallback;
+	inst->sUserData		= userData;
+	inst->sPointers		= new float*[numChannels];
+	inst->sSize			= dbSharedSize(numChannels);
+
+	// The shared memory only has a name until the worker has mapped it
+	pthread_mutex_lock(&gLock);
+	if (startWorker()) {
+		char name[64];
+		snprintf(name, sizeof(name), "/DiracBridge-%d-%ld", (int)getpid(), gNextShared++);
+		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0) {
+			void *memory = MAP_FAILED;
+			if (ftruncate(fd, inst->sSize) == 0)
+				memory = mmap(NULL, inst->sSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (memory != MAP_FAILED) {
+				inst->sShared = (dbShared*)memory;
+				dbSharedInit(inst->sShared, numChannels);
+
+				dbControl message;
+				memset(&message, 0, sizeof(message));
+				message.sCommand		= kDbCreate;
+				message.sLambda			= (int32_t)lambda;
+				message.sQuality		= (int32_t)quality;
+				message.sNumChannels	= (int32_t)numChannels;
+				message.sSampleRate		= sampleRateHz;
+				snprintf(message.sText, sizeof(message.sText), "%s", name);
+				if (controlCall(&message) && message.sResult > 0)
+					inst->sId = message.sInstance;
+			}
+			shm_unlink(name);
+		}
+	}
+	pthread_mutex_unlock(&gLock);
+
+	if (!inst->sId) {
+		if (inst->sShared)
+			munmap(inst->sShared, inst->sSize);
+		delete[] inst->sPointers;
+		delete inst;
+		return NULL;
+	}
+	return (void*)inst;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long DiracSetProperty(long selector, long double value, void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst)	return kDiracErrorParamErr;
+	inst->sShared->sSelector = (int32_t)selector;
+	dbPutLongDouble(inst->sShared->sValue, value);
+	if (!instanceCall(inst, kDbSetProperty))
+		return kDiracErrorUnknownErr;
+	return (long)inst->sShared->sResult;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long double DiracGetProperty(long selector, void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst)	return 0.;
+	inst->sShared->sSelector = (int32_t)selector;
+	if (!instanceCall(inst, kDbGetProperty))
+		return 0.;
+	return dbGetLongDouble(inst->sShared->sValue);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void DiracReset(bool clear, void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst)	return;
+	inst->sShared->sFlag = clear ? 1 : 0;
+	instanceCall(inst, kDbReset);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Calls larger than dbRingMaxBlock() are split, Dirac's output continues seamlessly either way
+ */
+long DiracProcess(float **audioOut, long numFrames, void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst || !audioOut || numFrames < 0)	return kDiracErrorParamErr;
+	dbShared *shared = inst->sShared;
+	dbRing *ring = &shared->sOutput;
+
+	long done = 0;
+	while (done < numFrames) {
+		long n = numFrames - done;
+		if (n > (long)dbRingMaxBlock(ring))
+			n = dbRingMaxBlock(ring);
+		shared->sFrames = n;
+		if (!instanceCall(inst, kDbProcess))
+			return done ? done : (long)kDiracErrorUnknownErr;
+		// the worker publishes no output for a call that failed
+		long ret = (long)shared->sResult;
+		if (ret < 0)
+			return done ? done : ret;
+
+		bool empty;
+		uint32_t position = dbRingBeginRead(ring, (uint32_t)n, &empty);
+		if (empty)
+			return done;
+		long valid = ret < n ? ret : n;
+		for (long c = 0; c < inst->sNumChannels; c++)
+			memcpy(audioOut[c]+done, dbRingFrames(shared, ring, c, position), valid*sizeof(float));
+		dbRingEndRead(ring, position, (uint32_t)n);
+
+		done += valid;
+		if (ret < n)
+			break;
+	}
+	return done;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void DiracDestroy(void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst)	return;
+
+	pthread_mutex_lock(&gLock);
+	dbControl message;
+	memset(&message, 0, sizeof(message));
+	message.sCommand = kDbDestroy;
+	message.sInstance = inst->sId;
+	controlCall(&message);
+	pthread_mutex_unlock(&gLock);
+
+	munmap(inst->sShared, inst->sSize);
+	delete[] inst->sPointers;
+	delete inst;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The worker only makes the round trip to us when there is a callback to call
+ */
+void DiracSetProcessingBeganCallback(void (*processingCallback)(unsigned long position, void *userData), void *userData, void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst)	return;
+	inst->sProcessingBegan = processingCallback;
+	inst->sBeganUserData = userData;
+	inst->sShared->sFlag = processingCallback ? 1 : 0;
+	instanceCall(inst, kDbSetBeganCallback);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long DiracGetInputBufferSizeInFrames(void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst || !instanceCall(inst, kDbInputBufferSize))
+		return 0;
+	return (long)inst->sShared->sResult;
+}
+
+
+#pragma mark ---- Utilities ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+const char *DiracVersion(void)
+{
+	pthread_mutex_lock(&gLock);
+	startWorker();
+	pthread_mutex_unlock(&gLock);
+	return gVersion;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The clock measures time in the calling process, there is nothing to ask the worker
+ */
+void DiracStartClock(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &gClockStart);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long double DiracClockTimeSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long double)(now.tv_sec - gClockStart.tv_sec) + 1e-9L * (long double)(now.tv_nsec - gClockStart.tv_nsec);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+float DiracPeakCpuUsagePercent(void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst || !instanceCall(inst, kDbPeakCpuUsage))
+		return 0.f;
+	return (float)dbGetLongDouble(inst->sShared->sValue);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long double DiracValidateStretchFactor(long double factor)
+{
+	dbControl message;
+	memset(&message, 0, sizeof(message));
+	message.sCommand = kDbValidateStretchFactor;
+	dbPutLongDouble(message.sValue, factor);
+
+	pthread_mutex_lock(&gLock);
+	bool ok = startWorker() && controlCall(&message);
+	pthread_mutex_unlock(&gLock);
+	return ok ? dbGetLongDouble(message.sValue) : factor;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The worker prints to the stdout it inherited from us
+ */
+void DiracPrintSettings(void *dirac)
+{
+	bridgeInstance *inst = (bridgeInstance*)dirac;
+	if (!inst)	return;
+	fflush(stdout);
+	instanceCall(inst, kDbPrintSettings);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The texts are fetched from the worker once and kept, so the pointers we return stay valid
+ */
+const char *DiracErrorToString(long error)
+{
+	const char *text = "DiracBridge: DiracWorker is not running";
+
+	pthread_mutex_lock(&gLock);
+	int e;
+	for (e = 0; e < gNumErrorTexts; e++) {
+		if (gErrorTexts[e].sError == error)
+			break;
+	}
+	if (e < gNumErrorTexts)
+		text = gErrorTexts[e].sText;
+	else if (gNumErrorTexts < MAX_ERROR_TEXTS && startWorker()) {
+		dbControl message;
+		memset(&message, 0, sizeof(message));
+		message.sCommand = kDbErrorToString;
+		message.sResult = error;
+		if (controlCall(&message)) {
+			errorTextStruct *entry = gErrorTexts + gNumErrorTexts++;
+			entry->sError = error;
+			message.sText[sizeof(message.sText)-1] = 0;
+			strcpy(entry->sText, message.sText);
+			text = entry->sText;
+		}
+	}
+	pthread_mutex_unlock(&gLock);
+	return text;
+}
+
+
+#pragma mark ---- Not bridged ----
+
+// Interleaved processing, tuning tables, Retune and FX are not available through the bridge. The
+// calls exist so that programs link, they fail the way Dirac does for a feature it does not have
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void *DiracCreateInterleaved(long, long, long, float, long (*)(float *, long, void *), void *)
+{
+	return NULL;
+}
+
+long DiracProcessInterleaved(float *, long, void *)	{ return kDiracErrorFeatureNotSupported; }
+long DiracSetTuningTable(float *, long, void *)	{ return kDiracErrorFeatureNotSupported; }
+
+void *DiracRetuneCreate(long, float, float)	{ return NULL; }
+void DiracRetuneDestroy(void *)	{}
+void DiracRetuneProcess(short *, short *, long, void *)	{}
+void DiracRetuneProcessFloat(float *, float *, long, void *)	{}
+void DiracRetuneSetKeyList(float *, long, long, void *)	{}
+void DiracRetuneSetProperties(float, float, float, float, void *)	{}
+float DiracRetuneGetPitchHz(void *)	{ return 0.f; }
+bool DiracRetuneGetKeyStatus(long, void *)	{ return false; }
+void DiracRetuneSetKeyStatus(long, bool, void *)	{}
+unsigned long DiracRetuneGetAllowedKeysMask(void *)	{ return 0; }
+void DiracRetuneSetAllowedKeysMask(unsigned long, void *)	{}
+float DiracRetuneGetClosestKeyDetuneCent(bool, void *)	{ return 0.f; }
+long DiracRetuneGetClosestKey(bool, void *)	{ return kDiracErrorFeatureNotSupported; }
+void DiracRetunePrintInternalTuningTable(void *)	{}
+long DiracRetuneLatencyFrames(float)	{ return kDiracErrorFeatureNotSupported; }
+void DiracRetuneSetPitchHz(float, void *)	{}
+void DiracRetuneSetTuningReferenceHz(float, void *)	{}
+void DiracRetuneSetTuningTable(float *, long, void *)	{}
+
+void *DiracFxCreate(long, float, long)	{ return NULL; }
+long DiracFxMaxOutputBufferFramesRequired(long double, long double, long)	{ return kDiracErrorFeatureNotSupported; }
+long DiracFxOutputBufferFramesRequiredNextCall(long double, long double, long, void *)	{ return kDiracErrorFeatureNotSupported; }
+long DiracFxLatencyFrames(float)	{ return kDiracErrorFeatureNotSupported; }
+void DiracFxDestroy(void *)	{}
+long DiracFxProcessFloat(long double, long double, float **, float **, long, void *)	{ return kDiracErrorFeatureNotSupported; }
+long DiracFxProcessFloatInterleaved(long double, long double, float *, float *, long, void *)	{ return kDiracErrorFeatureNotSupported; }
+long DiracFxProcess(long double, long double, short **, short **, long, void *)	{ return kDiracErrorFeatureNotSupported; }
+long DiracFxProcessInterleaved(long double, long double, short *, short *, long, void *)	{ return kDiracErrorFeatureNotSupported; }
+void DiracFxReset(bool, void *)	{}
@@ -0,0 +1,307 @@
+/*
+ "DiracBridgeProtocol.h" DiracBridge Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Abstract: What DiracWorker (32 bit, links libDiracLE.a) and libDiracBridge (64 bit, implements
+ Dirac.h) share. Creating and destroying instances are control messages on a Unix domain socket.
+ Everything an instance does after that goes through a block of POSIX shared memory per instance:
+ a mailbox for the calls and the requests the worker makes while it processes (read callback,
+ processing began callback), and two single producer, single consumer rings for the audio, input
+ from host to worker and output from worker to host. Both sides take turns on the mailbox and
+ wake each other through futexes on its two counters, after spinning briefly.
+
+ Everything in here has the same layout in 32 and 64 bit code: fixed size types only, 64 bit
+ fields on 8 byte offsets, no pointers.
+
+ */
+
+#ifndef __DIRACBRIDGEPROTOCOL__
+#define __DIRACBRIDGEPROTOCOL__
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+
+// bumped whenever anything in this file changes, host and worker must agree
+#define DB_PROTOCOL_VERSION		2
+
+// frames per channel in each ring, a power of 2. Reads and process calls larger than half of it
+// are split, see dbRingMaxBlock()
+#define DB_RING_FRAMES			65536
+
+// times a waiting side checks the mailbox before it goes to sleep on the futex, if there is more
+// than one CPU for the other side to run on, and the longest it sleeps before it checks whether
+// the other side is still there
+#define DB_SPIN_COUNT			4000
+#define DB_WAIT_MS				1000
+
+// long double is the 80 bit x87 format in 32 and 64 bit code, it is sent as its first 10 bytes
+#define DB_LONG_DOUBLE_BYTES	10
+
+// audio data starts this far into the shared memory, channels and rings are 64 byte aligned
+#define DB_HEADER_BYTES			256
+
+
+// Control messages on the socket, from host to worker and back
+enum {
+	kDbHello = 1,					/* sResult = protocol version, reply sText = DiracVersion() */
+	kDbCreate,						/* sText = shared memory name, reply sInstance, sResult < 0 on error */
+	kDbDestroy,						/* sInstance */
+	kDbValidateStretchFactor,		/* sValue, reply sValue */
+	kDbErrorToString				/* sResult = error, reply sText */
+};
+
+// Calls the host makes through the mailbox of an instance
+enum {
+	kDbProcess = 1,					/* sFrames, reply sResult */
+	kDbSetProperty,					/* sSelector, sValue, reply sResult */
+	kDbGetProperty,					/* sSelector, reply sValue */
+	kDbReset,						/* sFlag = clear */
+	kDbPeakCpuUsage,				/* reply sValue */
+	kDbInputBufferSize,				/* reply sResult */
+	kDbPrintSettings,
+	kDbSetBeganCallback,			/* sFlag = host has a callback */
+	kDbQuit							/* sent by the worker's main thread when the instance is destroyed */
+};
+
+// Requests the worker makes through the mailbox while it runs a call
+enum {
+	kDbDone = 1,					/* the call is done, its results are in the mailbox */
+	kDbRead,						/* fill sFrames frames of the input ring, reply sResult */
+	kDbBegan						/* processing began at sPosition */
+};
+
+
+typedef struct {
+	int32_t sCommand;
+	int32_t sInstance;
+	int32_t sLambda, sQuality;
+	int32_t sNumChannels;
+	float sSampleRate;
+	int64_t sResult;
+	unsigned char sValue[16];
+	char sText[208];
+} dbControl;
+
+
+// Frames are counted from the start and wrap at 2^32, a multiple of the capacity. Channel c of
+// the ring starts sOffset + c*sCapacity*sizeof(float) bytes into the shared memory
+typedef struct {
+	volatile uint32_t sWrite;		/* frames the producer has published */
+	volatile uint32_t sRead;		/* frames the consumer is done with */
+	uint32_t sCapacity;
+	uint32_t sOffset;
+} dbRing;
+
+
+typedef struct {
+	volatile uint32_t sToWorker;	/* incremented by the host for every call and every reply to a request */
+	volatile uint32_t sToHost;		/* incremented by the worker for every request */
+	volatile uint32_t sWorkerSleeping, sHostSleeping;
+	int32_t sCommand;
+	int32_t sRequest;
+	int32_t sSelector;
+	int32_t sFlag;
+	int64_t sFrames;
+	int64_t sResult;
+	uint64_t sPosition;
+	unsigned char sValue[16];
+	dbRing sInput;
+	dbRing sOutput;
+	int32_t sNumChannels;
+	int32_t sReserved;
+} dbShared;
+
+// fails to compile if the header outgrows its space
+typedef char dbSharedFitsHeader[sizeof(dbShared) <= DB_HEADER_BYTES ? 1 : -1];
+typedef char dbControlSize[sizeof(dbControl) == 256 ? 1 : -1];
+
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Bytes of shared memory an instance with numChannels channels needs
+ */
+static inline size_t dbSharedSize(long numChannels)
+{
+	return DB_HEADER_BYTES + 2 * (size_t)numChannels * DB_RING_FRAMES * sizeof(float);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Sets up the header of an instance's shared memory. Done by the host before the worker maps it
+ */
+static inline void dbSharedInit(dbShared *shared, long numChannels)
+{
+	memset(shared, 0, sizeof(dbShared));
+	shared->sNumChannels		= (int32_t)numChannels;
+	shared->sInput.sCapacity	= DB_RING_FRAMES;
+	shared->sInput.sOffset		= DB_HEADER_BYTES;
+	shared->sOutput.sCapacity	= DB_RING_FRAMES;
+	shared->sOutput.sOffset		= DB_HEADER_BYTES + (uint32_t)(numChannels * DB_RING_FRAMES * sizeof(float));
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the position numFrames frames go to when they start at position. Blocks are never split at
+ the end of the ring: if they don't fit in before it they start over at its beginning. Producer and
+ consumer see the same block sizes in the same order, so they skip the same frames
+ */
+static inline uint32_t dbRingPlace(dbRing *ring, uint32_t position, uint32_t numFrames)
+{
+	uint32_t offset = position & (ring->sCapacity-1);
+	if (offset + numFrames > ring->sCapacity)
+		position += ring->sCapacity - offset;
+	return position;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the largest block that may go through ring in one piece. Only one block is ever in the
+ ring, but the frames dbRingPlace() skips count as used until the consumer is past them. A block
+ of up to half the capacity fits after any skip, a larger one may not fit into an empty ring
+ */
+static inline uint32_t dbRingMaxBlock(const dbRing *ring)
+{
+	return ring->sCapacity / 2;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns where channel number channel of the frame at position is in the shared memory
+ */
+static inline float *dbRingFrames(dbShared *shared, dbRing *ring, long channel, uint32_t position)
+{
+	return (float*)((char*)shared + ring->sOffset) + (size_t)channel * ring->sCapacity + (position & (ring->sCapacity-1));
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Producer: returns the position to write numFrames frames to, or sets *full if they don't fit yet
+ */
+static inline uint32_t dbRingBeginWrite(dbRing *ring, uint32_t numFrames, bool *full)
+{
+	uint32_t position = dbRingPlace(ring, ring->sWrite, numFrames);
+	uint32_t read = __sync_fetch_and_add(&ring->sRead, 0);
+	*full = (position + numFrames - read > ring->sCapacity);
+	return position;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Producer: publishes the frames written at position
+ */
+static inline void dbRingEndWrite(dbRing *ring, uint32_t position, uint32_t numFrames)
+{
+	__sync_synchronize();
+	ring->sWrite = position + numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Consumer: returns the position of the next numFrames frames, or sets *empty if they aren't there yet
+ */
+static inline uint32_t dbRingBeginRead(dbRing *ring, uint32_t numFrames, bool *empty)
+{
+	uint32_t position = dbRingPlace(ring, ring->sRead, numFrames);
+	uint32_t written = __sync_fetch_and_add(&ring->sWrite, 0);
+	*empty = ((int32_t)(written - position) < (int32_t)numFrames);
+	return position;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Consumer: hands the frames read at position back to the producer
+ */
+static inline void dbRingEndRead(dbRing *ring, uint32_t position, uint32_t numFrames)
+{
+	__sync_synchronize();
+	ring->sRead = position + numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline void dbPause()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns how often dbWait() should spin on this machine. With a single CPU the other side cannot
+ run while we spin, so we go to sleep right away
+ */
+static inline long dbSpinCount()
+{
+	return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? DB_SPIN_COUNT : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Waits until *counter is no longer seen, spinning spinCount times first, then sleeping on the
+ futex for up to DB_WAIT_MS. *sleeping tells the other side that it has to wake us. Returns true
+ if the counter changed, false on timeout
+ */
+static inline bool dbWait(volatile uint32_t *counter, uint32_t seen, volatile uint32_t *sleeping, long spinCount)
+{
+	for (long i = 0; i < spinCount; i++) {
+		if (*counter != seen) {
+			__sync_synchronize();
+			return true;
+		}
+		dbPause();
+	}
+
+	// the other side increments the counter before it looks at *sleeping, we set *sleeping before
+	// we look at the counter, so either it wakes us or the futex sees the new value
+	*sleeping = 1;
+	__sync_synchronize();
+	if (*counter == seen) {
+		struct timespec timeout;
+		timeout.tv_sec = DB_WAIT_MS / 1000;
+		timeout.tv_nsec = (DB_WAIT_MS % 1000) * 1000000L;
+		syscall(SYS_futex, counter, FUTEX_WAIT, seen, &timeout, NULL, 0);
+	}
+	*sleeping = 0;
+	__sync_synchronize();
+	return *counter != seen;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Increments *counter, which publishes everything written to the mailbox before, and wakes the
+ other side if it is asleep
+ */
+static inline void dbPost(volatile uint32_t *counter, volatile uint32_t *sleeping)
+{
+	__sync_fetch_and_add(counter, 1);
+	if (*sleeping)
+		syscall(SYS_futex, counter, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline void dbPutLongDouble(unsigned char *bytes, long double value)
+{
+	memset(bytes, 0, 16);
+	memcpy(bytes, &value, DB_LONG_DOUBLE_BYTES);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline long double dbGetLongDouble(const unsigned char *bytes)
+{
+	long double value = 0.;
+	memcpy(&value, bytes, DB_LONG_DOUBLE_BYTES);
+	return value;
+}
+
+
+#endif /* __DIRACBRIDGEPROTOCOL__ */
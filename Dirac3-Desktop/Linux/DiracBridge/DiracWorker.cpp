@@ -0,0 +1,339 @@
+/*
+ "DiracWorker.cpp" DiracBridge Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Hosts the Dirac instances of a 64 bit process that uses libDiracBridge. Built 32 bit and linked
+ with libDiracLE.a. The host starts it with one end of a socket pair, it serves that host only
+ and exits when the socket is closed. Every instance runs on its own thread, which only ever
+ talks to the host through the instance's shared memory, see DiracBridgeProtocol.h.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Dirac.h"
+#include "DiracBridgeProtocol.h"
+
+
+// One Dirac instance of the host
+typedef struct workerInstance {
+	int32_t sId;
+	dbShared *sShared;
+	size_t sSize;
+	void *sDirac;
+	float **sPointers;					/* channel pointers into a ring */
+	uint32_t sSeen;						/* last value of sToWorker we acted on */
+	pthread_t sThread;
+	struct workerInstance *sNext;
+} workerInstance;
+
+
+static workerInstance *gInstances = NULL;
+static int32_t gNextId = 1;
+static long gSpinCount = 0;
+
+
+#pragma mark ---- Instances ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Hands the mailbox to the host with a request and waits until it hands it back
+ */
+static void askHost(workerInstance *inst, int32_t request)
+{
+	dbShared *shared = inst->sShared;
+	shared->sRequest = request;
+	dbPost(&shared->sToHost, &shared->sHostSleeping);
+	while (!dbWait(&shared->sToWorker, inst->sSeen, &shared->sWorkerSleeping, gSpinCount))
+		;
+	inst->sSeen = shared->sToWorker;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Dirac's read callback. The host runs its own callback straight into the input ring, we copy from
+ there into Dirac's buffer. Reads larger than dbRingMaxBlock() are split
+ */
+static long workerReadData(float **chdata, long numFrames, void *userData)
+{
+	workerInstance *inst = (workerInstance*)userData;
+	dbShared *shared = inst->sShared;
+	dbRing *ring = &shared->sInput;
+	long result = 0;
+
+	for (long done = 0; done < numFrames; ) {
+		long n = numFrames - done;
+		if (n > (long)dbRingMaxBlock(ring))
+			n = dbRingMaxBlock(ring);
+		shared->sFrames = n;
+		askHost(inst, kDbRead);
+		long ret = (long)shared->sResult;
+
+		bool empty;
+		uint32_t position = dbRingBeginRead(ring, (uint32_t)n, &empty);
+		if (empty)
+			return result;
+		for (long c = 0; c < shared->sNumChannels; c++)
+			memcpy(chdata[c]+done, dbRingFrames(shared, ring, c, position), n*sizeof(float));
+		dbRingEndRead(ring, position, (uint32_t)n);
+
+		if (ret > 0)
+			result += ret;
+		done += n;
+	}
+	return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Dirac's processing began callback, only set while the host has one of its own
+ */
+static void workerProcessingBegan(unsigned long position, void *userData)
+{
+	workerInstance *inst = (workerInstance*)userData;
+	inst->sShared->sPosition = position;
+	askHost(inst, kDbBegan);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Processes numFrames frames straight into the output ring. Calls larger than dbRingMaxBlock() are
+ split by the host. The output is only published if Dirac succeeded, the host does not read it
+ otherwise
+ */
+static long workerProcess(workerInstance *inst, long numFrames)
+{
+	dbShared *shared = inst->sShared;
+	dbRing *ring = &shared->sOutput;
+
+	bool full;
+	uint32_t position = dbRingBeginWrite(ring, (uint32_t)numFrames, &full);
+	if (full || numFrames > (long)dbRingMaxBlock(ring))
+		return kDiracErrorParamErr;
+	for (long c = 0; c < shared->sNumChannels; c++)
+		inst->sPointers[c] = dbRingFrames(shared, ring, c, position);
+	long ret = DiracProcess(inst->sPointers, numFrames, inst->sDirac);
+	if (ret >= 0)
+		dbRingEndWrite(ring, position, (uint32_t)numFrames);
+	return ret;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Instance thread: runs the calls the host puts into the mailbox until the instance is destroyed
+ */
+static void *instanceThread(void *arg)
+{
+	workerInstance *inst = (workerInstance*)arg;
+	dbShared *shared = inst->sShared;
+
+	for (;;) {
+		while (!dbWait(&shared->sToWorker, inst->sSeen, &shared->sWorkerSleeping, gSpinCount))
+			;
+		inst->sSeen = shared->sToWorker;
+
+		switch (shared->sCommand) {
+			case kDbProcess:
+				shared->sResult = workerProcess(inst, (long)shared->sFrames);
+				break;
+			case kDbSetProperty:
+				shared->sResult = DiracSetProperty(shared->sSelector, dbGetLongDouble(shared->sValue), inst->sDirac);
+				break;
+			case kDbGetProperty:
+				dbPutLongDouble(shared->sValue, DiracGetProperty(shared->sSelector, inst->sDirac));
+				break;
+			case kDbReset:
+				DiracReset(shared->sFlag != 0, inst->sDirac);
+				break;
+			case kDbPeakCpuUsage:
+				dbPutLongDouble(shared->sValue, DiracPeakCpuUsagePercent(inst->sDirac));
+				break;
+			case kDbInputBufferSize:
+				shared->sResult = DiracGetInputBufferSizeInFrames(inst->sDirac);
+				break;
+			case kDbPrintSettings:
+				DiracPrintSettings(inst->sDirac);
+				fflush(stdout);
+				break;
+			case kDbSetBeganCallback:
+				DiracSetProcessingBeganCallback(shared->sFlag ? &workerProcessingBegan : NULL, (void*)inst, inst->sDirac);
+				break;
+			case kDbQuit:
+				return NULL;
+			default:
+				shared->sResult = kDiracErrorParamErr;
+				break;
+		}
+
+		// the host takes its results and has nothing to say until its next call
+		shared->sRequest = kDbDone;
+		dbPost(&shared->sToHost, &shared->sHostSleeping);
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Stops the thread of an instance and frees it. The host is waiting for our reply on the socket, so
+ the mailbox is ours
+ */
+static void destroyInstance(workerInstance *inst)
+{
+	if (inst->sThread) {
+		inst->sShared->sCommand = kDbQuit;
+		dbPost(&inst->sShared->sToWorker, &inst->sShared->sWorkerSleeping);
+		pthread_join(inst->sThread, NULL);
+	}
+	if (inst->sDirac)
+		DiracDestroy(inst->sDirac);
+	if (inst->sShared)
+		munmap(inst->sShared, inst->sSize);
+	delete[] inst->sPointers;
+	delete inst;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Maps the shared memory the host made for a new instance, creates the Dirac instance and starts its
+ thread. Returns the instance's id, or a Dirac error code
+ */
+static int32_t createInstance(dbControl *message)
+{
+	message->sText[sizeof(message->sText)-1] = 0;
+	long numChannels = message->sNumChannels;
+	if (numChannels < 1)
+		return kDiracErrorParamErr;
+
+	workerInstance *inst = new workerInstance;
+	memset(inst, 0, sizeof(workerInstance));
+	inst->sPointers = new float*[numChannels];
+
+	int fd = shm_open(message->sText, O_RDWR, 0);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < dbSharedSize(numChannels)) {
+		if (fd >= 0)
+			close(fd);
+		destroyInstance(inst);
+		return kDiracErrorParamErr;
+	}
+	inst->sSize = info.st_size;
+	void *memory = mmap(NULL, inst->sSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		destroyInstance(inst);
+		return kDiracErrorMemErr;
+	}
+	inst->sShared = (dbShared*)memory;
+	if (inst->sShared->sNumChannels != numChannels) {
+		destroyInstance(inst);
+		return kDiracErrorParamErr;
+	}
+	inst->sSeen = inst->sShared->sToWorker;
+
+	inst->sDirac = DiracCreate(message->sLambda, message->sQuality, numChannels, message->sSampleRate, &workerReadData, (void*)inst);
+	if (!inst->sDirac) {
+		destroyInstance(inst);
+		return kDiracErrorUnknownErr;
+	}
+	if (pthread_create(&inst->sThread, NULL, instanceThread, inst) != 0) {
+		inst->sThread = 0;
+		destroyInstance(inst);
+		return kDiracErrorUnknownErr;
+	}
+
+	inst->sId = gNextId++;
+	inst->sNext = gInstances;
+	gInstances = inst;
+	return inst->sId;
+}
+
+
+#pragma mark ---- Main program ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads or writes a whole control message. Returns false if the socket was closed
+ */
+static bool transfer(int fd, dbControl *message, bool sending)
+{
+	char *bytes = (char*)message;
+	size_t done = 0;
+	while (done < sizeof(dbControl)) {
+		ssize_t ret = sending ? send(fd, bytes+done, sizeof(dbControl)-done, MSG_NOSIGNAL) : recv(fd, bytes+done, sizeof(dbControl)-done, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		done += ret;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main (int argc, char **argv)
+{
+	if (argc != 3 || strcmp(argv[1], "--fd") != 0) {
+		printf("%s --fd <socket>\n", argv[0]);
+		printf(" Hosts Dirac instances for libDiracBridge, which starts it. Not meant to be run by hand\n");
+		return 1;
+	}
+	int fd = atoi(argv[2]);
+	gSpinCount = dbSpinCount();
+
+	// Serve the host until it closes the socket. Its instances go with it
+	dbControl message;
+	while (transfer(fd, &message, false)) {
+		switch (message.sCommand) {
+			case kDbHello:
+				if (message.sResult != DB_PROTOCOL_VERSION) {
+					printf("!!! DiracWorker speaks protocol version %d, the host %d\n", DB_PROTOCOL_VERSION, (int)message.sResult);
+					return 1;
+				}
+				snprintf(message.sText, sizeof(message.sText), "%s", DiracVersion());
+				break;
+			case kDbCreate:
+				message.sResult = createInstance(&message);
+				message.sInstance = message.sResult > 0 ? (int32_t)message.sResult : 0;
+				break;
+			case kDbDestroy: {
+				workerInstance **link = &gInstances;
+				while (*link && (*link)->sId != message.sInstance)
+					link = &(*link)->sNext;
+				message.sResult = kDiracErrorParamErr;
+				if (*link) {
+					workerInstance *inst = *link;
+					*link = inst->sNext;
+					destroyInstance(inst);
+					message.sResult = kDiracErrorNoErr;
+				}
+				break;
+			}
+			case kDbValidateStretchFactor:
+				dbPutLongDouble(message.sValue, DiracValidateStretchFactor(dbGetLongDouble(message.sValue)));
+				break;
+			case kDbErrorToString:
+				snprintf(message.sText, sizeof(message.sText), "%s", DiracErrorToString((long)message.sResult));
+				break;
+			default:
+				message.sResult = kDiracErrorParamErr;
+				break;
+		}
+		if (!transfer(fd, &message, true))
+			break;
+	}
+
+	// the host is gone, nobody waits for the instances any more
+	_exit(0);
+}
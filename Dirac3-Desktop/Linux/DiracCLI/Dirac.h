@@ -55,6 +55,11 @@ extern "C" {
 	DLL_DEF_TYPE void DiracDestroy(void *dirac);
 	DLL_DEF_TYPE void DiracSetProcessingBeganCallback(void (*processingCallback)(unsigned long position, void *userData), void *userData, void *dirac);
 	
+	// Returns the size of the core's input buffer in frames, which is the number of frames it asks the
+	// read callback for at a time. It depends on the time factor, so ask again after changing
+	// kDiracPropertyTimeFactor. Returns 0 if dirac is NULL
+	DLL_DEF_TYPE long DiracGetInputBufferSizeInFrames(void *dirac);
+	
 	// available in Dirac PRO only	
 	DLL_DEF_TYPE long DiracSetTuningTable(float *frequencyTable, long numFrequencies, void *dirac);
 
@@ -0,0 +1,440 @@
+/*
+ "DiracClient.cpp" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Abstract: Submits a job to a DiracCLI daemon (DiracCLI --daemon <socket>) and waits for it to
+ finish. Takes the same -L -Q -T -P -F -f options as DiracCLI, so pipeline scripts only need
+ to change the command they call. With --pcm the input is loaded into shared memory and the
+ daemon renders into shared memory as well, so it never touches the files itself.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+
+#include "MiniAiffStream.h"
+
+#define MAX_NUM_FILES		16
+
+// frames read from or written to the AIFF files at a time in --pcm mode
+#define PCM_CHUNK			65536
+
+// most channels the daemon accepts in --pcm mode, see MAX_PCM_CHANNELS in main.cpp
+#define MAX_PCM_CHANNELS	64
+
+
+// What to ask the daemon for
+typedef struct {
+	const char *sSocketPath;
+	const char *sLambda, *sQuality, *sTime, *sPitch, *sFormant;	/* as given, NULL = the daemon's default */
+	char *sInFileNames[MAX_NUM_FILES];
+	char *sOutFileNames[MAX_NUM_FILES];
+	int sNumInFiles, sNumOutFiles;
+	bool sPcm;
+} clientSettings;
+
+
+// A shared memory object we created and mapped
+typedef struct {
+	char sName[64];
+	float *sData;
+	size_t sSize;
+} sharedPcm;
+
+
+#pragma mark ---- Helpers ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void usage(char *s)
+{
+	printf("%s -s <socket> -{options} -f <infile> {<infile2> ...} {-o <outfile> {<outfile2> ...}}\n", s);
+	printf("%s -s <socket> --status | --shutdown\n", s);
+	printf(" Submits a job to a DiracCLI daemon and waits for it to finish\n\n");
+	printf(" options\n");
+	printf("   -s     <string>       : Socket the daemon listens on (DiracCLI --daemon <socket>)\n");
+	printf("   -L -Q -T -P -F        : As for DiracCLI, default is what the daemon was started with\n");
+	printf("   -f     <string>       : Input file(s), processed phase locked unless link groups\n");
+	printf("                           are given with braces\n");
+	printf("   -o     <string>       : Output file per input file\n");
+	printf("                           default=\"processed-\" next to each input file\n");
+	printf("   --pcm                 : Pass a single input and its output through shared memory\n");
+	printf("                           instead of files, -o is required. -T defaults to 1.0\n");
+	printf("   --status              : Print what the daemon has done so far\n");
+	printf("   --shutdown            : Stop the daemon once its running jobs are done\n");
+	printf("\n");
+	printf("   -h                    : print this message.\n\n");
+	exit(1);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns a copy of path that is absolute, the daemon does not run in our working directory
+ */
+static char *absolutePath(const char *path)
+{
+	// braces for link groups go in front of and after the path
+	const char *open = (path[0] == '{') ? "{" : "";
+	path += strlen(open);
+
+	char directory[4096] = "";
+	if (path[0] == 0 || strcmp(path, "}") == 0 || path[0] == '/' || !getcwd(directory, sizeof(directory)-1))
+		directory[0] = 0;
+	char *result = new char[strlen(directory)+strlen(path)+3];
+	sprintf(result, "%s%s%s%s", open, directory, directory[0] ? "/" : "", path);
+	return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Connects to the daemon. Returns the socket, or -1 on error
+ */
+static int connectDaemon(const char *socketPath)
+{
+	struct sockaddr_un address;
+	if (strlen(socketPath) >= sizeof(address.sun_path)) {
+		printf("!!! Socket path %s is too long\n", socketPath);
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+		printf("!!! Could not connect to %s: %s\n", socketPath, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Sends the request text and reads the daemon's replies, the last one into reply. Errors are
+ printed here, the caller prints the reply if all went well. Returns 0 if every reply was ok
+ */
+static int sendRequest(int fd, const char *request, char *reply, size_t replySize)
+{
+	size_t length = strlen(request);
+	for (size_t sent = 0; sent < length; ) {
+		ssize_t res = write(fd, request+sent, length-sent);
+		if (res <= 0) {
+			snprintf(reply, replySize, "error connection lost");
+			printf("%s\n", reply);
+			return -1;
+		}
+		sent += res;
+	}
+	shutdown(fd, SHUT_WR);
+
+	FILE *in = fdopen(fd, "r");
+	if (!in) {
+		snprintf(reply, replySize, "error out of memory");
+		printf("%s\n", reply);
+		return -1;
+	}
+	// errors about single lines of the request come before the reply to run
+	char line[1024];
+	snprintf(reply, replySize, "error no reply");
+	bool replied = false, failed = false;
+	while (fgets(line, sizeof(line), in)) {
+		line[strcspn(line, "\r\n")] = 0;
+		if (strncmp(line, "ok", 2) != 0) {
+			printf("%s\n", line);
+			failed = true;
+		}
+		snprintf(reply, replySize, "%s", line);
+		replied = true;
+	}
+	fclose(in);
+	if (!replied)
+		printf("%s\n", reply);
+	return (replied && !failed) ? 0 : -1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Creates and maps a shared memory object of size bytes. Returns false on error
+ */
+static bool createSharedPcm(sharedPcm *pcm, const char *suffix, size_t size)
+{
+	snprintf(pcm->sName, sizeof(pcm->sName), "/DiracClient.%ld.%s", (long)getpid(), suffix);
+	pcm->sData = NULL;
+	pcm->sSize = size;
+	int fd = shm_open(pcm->sName, O_RDWR|O_CREAT|O_EXCL, 0600);
+	if (fd < 0) {
+		printf("!!! Could not create %s: %s\n", pcm->sName, strerror(errno));
+		return false;
+	}
+	void *memory = MAP_FAILED;
+	if (ftruncate(fd, size) == 0)
+		memory = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		printf("!!! Could not map %lu bytes of %s: %s\n", (unsigned long)size, pcm->sName, strerror(errno));
+		shm_unlink(pcm->sName);
+		return false;
+	}
+	pcm->sData = (float*)memory;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void destroySharedPcm(sharedPcm *pcm)
+{
+	if (!pcm->sData)	return;
+	munmap(pcm->sData, pcm->sSize);
+	shm_unlink(pcm->sName);
+	pcm->sData = NULL;
+}
+
+
+#pragma mark ---- Jobs ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Appends the parameters that were given to the request
+ */
+static void addParameters(char *request, size_t size, clientSettings *settings)
+{
+	const char *names[] = {"lambda", "quality", "time", "pitch", "formant"};
+	const char *values[] = {settings->sLambda, settings->sQuality, settings->sTime, settings->sPitch, settings->sFormant};
+	for (int p = 0; p < 5; p++) {
+		if (values[p])
+			snprintf(request+strlen(request), size-strlen(request), "%s %s\n", names[p], values[p]);
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Has the daemon process the input files into the output files. Returns 0 on success
+ */
+static int runFileJob(int fd, clientSettings *settings)
+{
+	size_t size = 1024 + 2*MAX_NUM_FILES*4200;
+	char *request = new char[size];
+	request[0] = 0;
+	addParameters(request, size, settings);
+	for (int f = 0; f < settings->sNumInFiles; f++)
+		snprintf(request+strlen(request), size-strlen(request), "input %s\n", settings->sInFileNames[f]);
+	for (int f = 0; f < settings->sNumOutFiles; f++)
+		snprintf(request+strlen(request), size-strlen(request), "output %s\n", settings->sOutFileNames[f]);
+	strcat(request, "run\n");
+
+	char reply[1024];
+	int result = sendRequest(fd, request, reply, sizeof(reply));
+	if (result == 0)
+		printf("%s\n", reply);
+	delete[] request;
+	return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns in bytes how many bytes numFrames frames of numChannels channels of float take. The
+ product is formed in 64 bit, so it cannot wrap. Returns false if it does not fit into a size_t
+ */
+static bool pcmBytes(long numChannels, unsigned long long numFrames, size_t *bytes)
+{
+	unsigned long long frameBytes = (unsigned long long)numChannels * sizeof(float);
+	if (numChannels < 1 || numChannels > MAX_PCM_CHANNELS || numFrames > (unsigned long long)SIZE_MAX / frameBytes)
+		return false;
+	*bytes = (size_t)(numFrames * frameBytes);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Loads the input file into shared memory, has the daemon render into shared memory as well and
+ writes the output file from there. Returns 0 on success
+ */
+static int runPcmJob(int fd, clientSettings *settings)
+{
+	char *inFileName = settings->sInFileNames[0];
+	char *outFileName = settings->sOutFileNames[0];
+	sharedPcm in, out;
+	in.sData = out.sData = NULL;
+	mAiffFile *file = NULL;
+	mAiffWriter *writer = NULL;
+	float **audio = NULL;
+	int result = -1;
+
+	mAiffInfo info;
+	if (mAiffProbe(inFileName, &info) != 0 || info.sSampleRate <= 0.f || !info.sNumFrames) {
+		printf("!!! %s: invalid input file format\n", inFileName);
+		return -1;
+	}
+	long numChannels = info.sNumChannels;
+	// we size the output memory, so the time factor is always sent and is 1 unless given
+	if (!settings->sTime)
+		settings->sTime = "1.0";
+	long double time = strtold(settings->sTime, NULL);
+	long double outFrames = (long double)info.sNumFrames * time;
+	unsigned long numOutFrames = outFrames >= 0. && outFrames < (long double)ULONG_MAX ? (unsigned long)outFrames : ULONG_MAX;
+	size_t inBytes, outBytes;
+	char request[1024], reply[1024];
+	unsigned long done;
+
+	if (numOutFrames == ULONG_MAX || !pcmBytes(numChannels, info.sNumFrames, &inBytes) ||
+		!pcmBytes(numChannels, numOutFrames ? numOutFrames : 1, &outBytes)) {
+		printf("!!! %s: too many channels or frames for shared memory\n", inFileName);
+		return -1;
+	}
+	// the daemon wants planar audio, all frames of one channel after the other
+	if (!createSharedPcm(&in, "in", inBytes) || !createSharedPcm(&out, "out", outBytes))
+		goto done;
+	file = mAiffOpen(inFileName);
+	audio = new float*[numChannels];
+	if (!file)
+		goto done;
+	for (done = 0; done < info.sNumFrames; ) {
+		int numFrames = info.sNumFrames - done < PCM_CHUNK ? (int)(info.sNumFrames - done) : PCM_CHUNK;
+		for (long c = 0; c < numChannels; c++)
+			audio[c] = in.sData + c*info.sNumFrames + done;
+		int read = mAiffReadFrames(file, audio, numFrames, numChannels);
+		if (read <= 0)
+			break;
+		done += read;
+	}
+	mAiffClose(file);
+	if (done < info.sNumFrames) {
+		printf("!!! Error reading %s\n", inFileName);
+		goto done;
+	}
+
+	request[0] = 0;
+	addParameters(request, sizeof(request), settings);
+	snprintf(request+strlen(request), sizeof(request)-strlen(request), "pcm %s %ld %lu %.17g\npcm-output %s\nrun\n",
+			 in.sName, numChannels, info.sNumFrames, (double)info.sSampleRate, out.sName);
+	if (sendRequest(fd, request, reply, sizeof(reply)) != 0)
+		goto done;
+	printf("%s\n", reply);
+
+	writer = mAiffCreate(outFileName, info.sSampleRate, info.sWordlength, numChannels);
+	if (!writer) {
+		printf("!!! Could not create %s\n", outFileName);
+		goto done;
+	}
+	mAiffPreallocate(writer, numOutFrames);
+	for (done = 0; done < numOutFrames; ) {
+		int numFrames = numOutFrames - done < PCM_CHUNK ? (int)(numOutFrames - done) : PCM_CHUNK;
+		for (long c = 0; c < numChannels; c++)
+			audio[c] = out.sData + c*numOutFrames + done;
+		if (mAiffWriteFrames(writer, audio, numFrames, numChannels) != numFrames)
+			break;
+		done += numFrames;
+	}
+	if (mAiffCloseWriter(writer) != 0 || done < numOutFrames) {
+		printf("!!! Error writing %s\n", outFileName);
+		goto done;
+	}
+	result = 0;
+
+done:
+	delete[] audio;
+	destroySharedPcm(&out);
+	destroySharedPcm(&in);
+	return result;
+}
+
+
+#pragma mark ---- Main program ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+	clientSettings settings;
+	memset(&settings, 0, sizeof(settings));
+	const char *command = NULL;
+
+	if (argc < 2)
+		usage(argv[0]);
+
+	for (long i = 1; i < argc; i++) {
+		if (argv[i][0] != '-')
+			usage(argv[0]);
+		const char **value = NULL;
+		switch (argv[i][1]) {
+			case 's':	value = &settings.sSocketPath;	break;
+			case 'L':	value = &settings.sLambda;		break;
+			case 'Q':	value = &settings.sQuality;		break;
+			case 'T':	value = &settings.sTime;		break;
+			case 'P':	value = &settings.sPitch;		break;
+			case 'F':	value = &settings.sFormant;		break;
+			case 'f':
+			case 'o': {
+				char **names = argv[i][1] == 'f' ? settings.sInFileNames : settings.sOutFileNames;
+				int *numNames = argv[i][1] == 'f' ? &settings.sNumInFiles : &settings.sNumOutFiles;
+				while (i+1 < argc && argv[i+1][0] != '-' && *numNames < MAX_NUM_FILES)
+					names[(*numNames)++] = absolutePath(argv[++i]);
+				break;
+			}
+			case '-':
+				if (strcmp(argv[i], "--pcm") == 0)
+					settings.sPcm = true;
+				else if (strcmp(argv[i], "--status") == 0)
+					command = "status\n";
+				else if (strcmp(argv[i], "--shutdown") == 0)
+					command = "shutdown\n";
+				else
+					usage(argv[0]);
+				break;
+			default:
+				usage(argv[0]);
+		}
+		if (value) {
+			if (++i >= argc)
+				usage(argv[0]);
+			*value = argv[i];
+		}
+	}
+
+	if (!settings.sSocketPath) {
+		printf("!!! No daemon socket specified - exiting\n");
+		exit(-1);
+	}
+	if (!command && !settings.sNumInFiles) {
+		printf("!!! No input files specified - exiting\n");
+		exit(-1);
+	}
+	if (settings.sPcm && (settings.sNumInFiles != 1 || settings.sNumOutFiles != 1)) {
+		printf("!!! --pcm needs a single input and output file - exiting\n");
+		exit(-1);
+	}
+
+	int fd = connectDaemon(settings.sSocketPath);
+	if (fd < 0)
+		exit(-1);
+
+	int result;
+	if (command) {
+		char reply[1024];
+		result = sendRequest(fd, command, reply, sizeof(reply));
+		if (result == 0)
+			printf("%s\n", reply);
+	} else if (settings.sPcm)
+		result = runPcmJob(fd, &settings);
+	else
+		result = runFileJob(fd, &settings);
+
+	for (int f = 0; f < settings.sNumInFiles; f++)
+		delete[] settings.sInFileNames[f];
+	for (int f = 0; f < settings.sNumOutFiles; f++)
+		delete[] settings.sOutFileNames[f];
+	return result ? -1 : 0;
+}
@@ -0,0 +1,233 @@
+/*
+ "DiracPool.cpp" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#include "Dirac.h"
+#include "DiracPool.h"
+
+
+// An instance and what it is bound to. Dirac keeps the callback and userData it was created with,
+// so every instance reads through poolReadData() with its entry as userData, and rebinding it is
+// a matter of changing the entry
+typedef struct PoolEntry {
+	void *sDirac;
+	long sLambda, sQuality, sNumChannels;
+	float sSampleRate;
+	unsigned long long sBytes;
+	dpReadProc sReadProc;
+	void *sUserData;
+	struct PoolEntry *sPrev, *sNext;		/* in the idle list, most recently used first, or the busy list */
+} PoolEntry;
+
+struct DiracPool {
+	pthread_mutex_t sLock;
+	unsigned long long sMemoryCap;
+	PoolEntry *sIdle, *sBusy;
+	DiracPoolStats sStats;
+};
+
+
+#pragma mark ---- Helpers ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The read callback of every pooled instance, forwards to whatever the instance is bound to
+ */
+static long poolReadData(float **data, long numFrames, void *userData)
+{
+	PoolEntry *entry = (PoolEntry*)userData;
+	return entry->sReadProc(data, numFrames, entry->sUserData);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the number of bytes allocated on the heap. Dirac doesn't tell how much memory an
+ instance takes, so we look at how much the heap grows while one is created. Other threads
+ allocating at the same time make this an estimate, which is good enough for a cap
+ */
+static unsigned long long heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+#else
+	struct mallinfo info = mallinfo();
+#endif
+	return (unsigned long long)info.uordblks + (unsigned long long)info.hblkhd;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void unlinkEntry(PoolEntry **list, PoolEntry *entry)
+{
+	if (entry->sPrev)
+		entry->sPrev->sNext = entry->sNext;
+	else
+		*list = entry->sNext;
+	if (entry->sNext)
+		entry->sNext->sPrev = entry->sPrev;
+	entry->sPrev = entry->sNext = NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void pushEntry(PoolEntry **list, PoolEntry *entry)
+{
+	entry->sPrev = NULL;
+	entry->sNext = *list;
+	if (*list)
+		(*list)->sPrev = entry;
+	*list = entry;
+}
+
+
+#pragma mark ---- Pool ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+DiracPool *dpCreate(unsigned long long memoryCap)
+{
+	DiracPool *pool = (DiracPool*)calloc(1, sizeof(DiracPool));
+	if (!pool)	return NULL;
+	pthread_mutex_init(&pool->sLock, NULL);
+	pool->sMemoryCap = memoryCap;
+	return pool;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void *dpAcquire(DiracPool *pool, long lambda, long quality, long numChannels, float sampleRate, dpReadProc readProc, void *userData)
+{
+	if (!pool || !readProc)	return NULL;
+	
+	// the idle list is in order of use, so the first match is the warmest one
+	pthread_mutex_lock(&pool->sLock);
+	PoolEntry *entry = pool->sIdle;
+	while (entry && !(entry->sLambda == lambda && entry->sQuality == quality && 
+					  entry->sNumChannels == numChannels && entry->sSampleRate == sampleRate))
+		entry = entry->sNext;
+	if (entry) {
+		unlinkEntry(&pool->sIdle, entry);
+		pushEntry(&pool->sBusy, entry);
+		pool->sStats.sNumIdle--;
+		pool->sStats.sNumReused++;
+	}
+	pthread_mutex_unlock(&pool->sLock);
+	
+	if (entry) {
+		entry->sReadProc = readProc;
+		entry->sUserData = userData;
+		DiracReset(true, entry->sDirac);
+		return entry->sDirac;
+	}
+	
+	// nothing to reuse. Instances are created outside of the lock, that's the slow part
+	entry = (PoolEntry*)calloc(1, sizeof(PoolEntry));
+	if (!entry)	return NULL;
+	entry->sLambda		= lambda;
+	entry->sQuality		= quality;
+	entry->sNumChannels	= numChannels;
+	entry->sSampleRate	= sampleRate;
+	entry->sReadProc	= readProc;
+	entry->sUserData	= userData;
+	unsigned long long heapBefore = heapInUse();
+	entry->sDirac = DiracCreate(lambda, quality, numChannels, sampleRate, &poolReadData, entry);
+	unsigned long long heapAfter = heapInUse();
+	if (!entry->sDirac) {
+		free(entry);
+		return NULL;
+	}
+	entry->sBytes = heapAfter > heapBefore ? heapAfter - heapBefore : 0;
+	
+	pthread_mutex_lock(&pool->sLock);
+	pushEntry(&pool->sBusy, entry);
+	pool->sStats.sNumCreated++;
+	pool->sStats.sBytes += entry->sBytes;
+	pthread_mutex_unlock(&pool->sLock);
+	
+	return entry->sDirac;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void dpRelease(DiracPool *pool, void *dirac)
+{
+	if (!pool || !dirac)	return;
+	
+	PoolEntry *evicted = NULL;
+	pthread_mutex_lock(&pool->sLock);
+	PoolEntry *entry = pool->sBusy;
+	while (entry && entry->sDirac != dirac)
+		entry = entry->sNext;
+	if (entry) {
+		unlinkEntry(&pool->sBusy, entry);
+		pushEntry(&pool->sIdle, entry);
+		pool->sStats.sNumIdle++;
+		
+		// evict least recently used idle instances until we are below the cap, the one we just got
+		// back goes last. They are destroyed once we let go of the lock
+		if (pool->sStats.sBytes > pool->sMemoryCap || pool->sMemoryCap == 0) {
+			PoolEntry *last = pool->sIdle;
+			while (last->sNext)
+				last = last->sNext;
+			while (last && (pool->sStats.sBytes > pool->sMemoryCap || pool->sMemoryCap == 0)) {
+				PoolEntry *prev = last->sPrev;
+				unlinkEntry(&pool->sIdle, last);
+				pool->sStats.sNumIdle--;
+				pool->sStats.sBytes -= last->sBytes;
+				if (pool->sMemoryCap)
+					pool->sStats.sNumEvicted++;
+				last->sNext = evicted;
+				evicted = last;
+				last = prev;
+			}
+		}
+	}
+	pthread_mutex_unlock(&pool->sLock);
+	
+	if (!entry)
+		printf("!!! Dirac instance %p does not belong to the pool\n", dirac);
+	while (evicted) {
+		PoolEntry *next = evicted->sNext;
+		DiracDestroy(evicted->sDirac);
+		free(evicted);
+		evicted = next;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void dpGetStats(DiracPool *pool, DiracPoolStats *stats)
+{
+	if (!pool || !stats)	return;
+	pthread_mutex_lock(&pool->sLock);
+	*stats = pool->sStats;
+	pthread_mutex_unlock(&pool->sLock);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void dpDestroy(DiracPool *pool)
+{
+	if (!pool)	return;
+	
+	PoolEntry *entry = pool->sIdle;
+	while (entry) {
+		PoolEntry *next = entry->sNext;
+		DiracDestroy(entry->sDirac);
+		free(entry);
+		entry = next;
+	}
+	if (pool->sBusy)
+		printf("!!! Dirac pool destroyed with instances still in use\n");
+	pthread_mutex_destroy(&pool->sLock);
+	free(pool);
+}
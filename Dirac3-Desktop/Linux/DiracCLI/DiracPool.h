@@ -0,0 +1,75 @@
+/*
+ "DiracPool.h" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Abstract: Pool of warm Dirac instances. Creating an instance costs about as much as processing
+ a short clip, so instances that are done are kept and handed out again to the next job that asks
+ for the same lambda, quality, number of channels and sample rate. A recycled instance is cleared
+ with DiracReset() and bound to the new job's read callback, just like the region example reuses
+ its instance for every region. Idle instances are destroyed least recently used first when the
+ pool grows beyond its memory cap.
+
+ */
+
+#ifndef __DIRACPOOL__
+#define __DIRACPOOL__
+
+
+typedef struct DiracPool DiracPool;
+
+typedef long (*dpReadProc)(float **data, long numFrames, void *userData);
+
+typedef struct {
+	long sNumCreated;				/* instances created with DiracCreate() */
+	long sNumReused;				/* instances handed out again */
+	long sNumEvicted;				/* idle instances destroyed to stay below the memory cap */
+	long sNumIdle;					/* instances currently waiting in the pool */
+	unsigned long long sBytes;		/* estimated memory of all instances, busy or idle */
+} DiracPoolStats;
+
+
+//	-----------------------------------------------------------------------------------------
+//	Creates an empty pool. memoryCap is the estimated memory in bytes that busy and idle
+//	instances may use together before idle ones are destroyed. With a cap of 0 instances are
+//	destroyed as soon as they are released, just as if there was no pool.
+//	Returns NULL if out of memory.
+//
+DiracPool *dpCreate(unsigned long long memoryCap);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns an instance for the given parameters, the same as DiracCreate() would, that reads
+//	its input through readProc(data, numFrames, userData). Hands out the idle instance with
+//	the same parameters that was used most recently, if there is one, otherwise creates a
+//	new one. Time, pitch and formant factors must be set again.
+//	Returns NULL if no instance could be created.
+//
+void *dpAcquire(DiracPool *pool, long lambda, long quality, long numChannels, float sampleRate, dpReadProc readProc, void *userData);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Puts an instance returned by dpAcquire() back into the pool. It must not be used again.
+//
+void dpRelease(DiracPool *pool, void *dirac);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Fills in the pool statistics
+//
+void dpGetStats(DiracPool *pool, DiracPoolStats *stats);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Destroys all idle instances and the pool. All instances must have been released.
+//
+void dpDestroy(DiracPool *pool);
+//	-----------------------------------------------------------------------------------------
+
+
+#endif /* __DIRACPOOL__ */
@@ -0,0 +1,422 @@
+/*
+ "JobPool.cpp" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "JobPool.h"
+
+
+typedef struct {
+	long sNumJobs;
+	volatile long sNextJob;
+	jpJobProc sRunJob;
+	void *sUserData;
+} JobPool;
+
+
+#pragma mark ---- CPU quota ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads the first line of a file into line. Returns false if the file does not exist
+ */
+static bool readLine(const char *path, char *line, long size)
+{
+	FILE *f = fopen(path, "r");
+	if (!f)	return false;
+	bool ok = (fgets(line, (int)size, f) != NULL);
+	fclose(f);
+	return ok;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the CPU quota of our cgroup in CPUs (rounded up), or 0 if there is none
+ */
+static long cgroupCpuQuota()
+{
+	char line[4096], path[4096+64];
+
+	// cgroup v2: "<quota> <period>" or "max <period>" in cpu.max of our group, or of the root if
+	// our group is not visible (as in most containers)
+	path[0] = 0;
+	FILE *f = fopen("/proc/self/cgroup", "r");
+	if (f) {
+		while (fgets(line, sizeof(line), f)) {
+			if (strncmp(line, "0::", 3) == 0) {
+				line[strcspn(line, "\n")] = 0;
+				snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.max", line+3);
+				break;
+			}
+		}
+		fclose(f);
+	}
+	if ((path[0] && readLine(path, line, sizeof(line))) || readLine("/sys/fs/cgroup/cpu.max", line, sizeof(line))) {
+		long quota, period;
+		if (sscanf(line, "%ld %ld", &quota, &period) == 2 && quota > 0 && period > 0)
+			return (quota + period - 1) / period;
+		return 0;
+	}
+
+	// cgroup v1: quota is -1 if unlimited
+	const char *v1Dirs[] = { "/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct" };
+	for (unsigned long d = 0; d < sizeof(v1Dirs)/sizeof(v1Dirs[0]); d++) {
+		snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", v1Dirs[d]);
+		if (!readLine(path, line, sizeof(line)))
+			continue;
+		long quota = atol(line);
+		snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", v1Dirs[d]);
+		if (!readLine(path, line, sizeof(line)))
+			continue;
+		long period = atol(line);
+		if (quota > 0 && period > 0)
+			return (quota + period - 1) / period;
+		return 0;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long jpAvailableCpus(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1)
+		cpus = 1;
+
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+		long allowed = CPU_COUNT(&mask);
+		if (allowed > 0 && allowed < cpus)
+			cpus = allowed;
+	}
+
+	long quota = cgroupCpuQuota();
+	if (quota > 0 && quota < cpus)
+		cpus = quota;
+
+	return cpus;
+}
+
+
+#pragma mark ---- Pool ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Worker: takes the next job until there are none left
+ */
+static void *workerThread(void *arg)
+{
+	JobPool *pool = (JobPool*)arg;
+	for (;;) {
+		long job = __sync_fetch_and_add(&pool->sNextJob, 1);
+		if (job >= pool->sNumJobs)
+			break;
+		pool->sRunJob(job, pool->sUserData);
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long jpRun(long numJobs, long numThreads, jpJobProc runJob, void *userData)
+{
+	if (numJobs < 1 || !runJob)	return 0;
+	if (numThreads > numJobs)
+		numThreads = numJobs;
+	if (numThreads < 1)
+		numThreads = 1;
+
+	JobPool pool;
+	pool.sNumJobs	= numJobs;
+	pool.sNextJob	= 0;
+	pool.sRunJob	= runJob;
+	pool.sUserData	= userData;
+
+	// the calling thread is one of the workers
+	long numStarted = 0;
+	pthread_t *threads = numThreads > 1 ? (pthread_t*)malloc((numThreads-1)*sizeof(pthread_t)) : NULL;
+	for (long t = 0; threads && t < numThreads-1; t++) {
+		if (pthread_create(&threads[numStarted], NULL, workerThread, &pool) == 0)
+			numStarted++;
+	}
+	workerThread(&pool);
+	for (long t = 0; t < numStarted; t++)
+		pthread_join(threads[t], NULL);
+	free(threads);
+
+	return numStarted+1;
+}
+
+
+#pragma mark ---- Gang ----
+
+struct jpGang {
+	long sNumMembers, sNumStarted;
+	jpJobProc sRunMember;
+	void *sUserData;
+	pthread_t *sThreads;
+	pthread_mutex_t sLock;
+	pthread_cond_t sStart, sDone;
+	unsigned long sGeneration;			/* incremented for every jpGangRun() */
+	long sPending;						/* threads that have not finished the current run */
+	bool sQuit;
+};
+
+typedef struct {
+	jpGang *sGang;
+	long sMember;
+} GangMember;
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Gang thread: runs its member once for every new generation until told to quit
+ */
+static void *gangThread(void *arg)
+{
+	GangMember *member = (GangMember*)arg;
+	jpGang *gang = member->sGang;
+	unsigned long generation = 0;
+	
+	pthread_mutex_lock(&gang->sLock);
+	for (;;) {
+		while (gang->sGeneration == generation && !gang->sQuit)
+			pthread_cond_wait(&gang->sStart, &gang->sLock);
+		if (gang->sQuit)
+			break;
+		generation = gang->sGeneration;
+		pthread_mutex_unlock(&gang->sLock);
+		
+		gang->sRunMember(member->sMember, gang->sUserData);
+		
+		pthread_mutex_lock(&gang->sLock);
+		if (--gang->sPending == 0)
+			pthread_cond_signal(&gang->sDone);
+	}
+	pthread_mutex_unlock(&gang->sLock);
+	free(member);
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+jpGang *jpGangCreate(long numMembers, jpJobProc runMember, void *userData)
+{
+	if (numMembers < 1 || !runMember)	return NULL;
+	
+	jpGang *gang = (jpGang*)calloc(1, sizeof(jpGang));
+	if (!gang)	return NULL;
+	gang->sNumMembers	= numMembers;
+	gang->sRunMember	= runMember;
+	gang->sUserData		= userData;
+	pthread_mutex_init(&gang->sLock, NULL);
+	pthread_cond_init(&gang->sStart, NULL);
+	pthread_cond_init(&gang->sDone, NULL);
+	
+	// members are started in order, the ones after the first thread that fails are run by the caller
+	gang->sThreads = numMembers > 1 ? (pthread_t*)malloc((numMembers-1)*sizeof(pthread_t)) : NULL;
+	for (long m = 1; gang->sThreads && m < numMembers; m++) {
+		GangMember *member = (GangMember*)malloc(sizeof(GangMember));
+		if (!member)
+			break;
+		member->sGang	= gang;
+		member->sMember	= m;
+		if (pthread_create(&gang->sThreads[gang->sNumStarted], NULL, gangThread, member) != 0) {
+			free(member);
+			break;
+		}
+		gang->sNumStarted++;
+	}
+	return gang;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jpGangRun(jpGang *gang)
+{
+	if (!gang)	return;
+	
+	pthread_mutex_lock(&gang->sLock);
+	gang->sPending = gang->sNumStarted;
+	gang->sGeneration++;
+	pthread_cond_broadcast(&gang->sStart);
+	pthread_mutex_unlock(&gang->sLock);
+	
+	// member 0 and everybody without a thread
+	gang->sRunMember(0, gang->sUserData);
+	for (long m = gang->sNumStarted+1; m < gang->sNumMembers; m++)
+		gang->sRunMember(m, gang->sUserData);
+	
+	pthread_mutex_lock(&gang->sLock);
+	while (gang->sPending > 0)
+		pthread_cond_wait(&gang->sDone, &gang->sLock);
+	pthread_mutex_unlock(&gang->sLock);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jpGangDestroy(jpGang *gang)
+{
+	if (!gang)	return;
+	
+	pthread_mutex_lock(&gang->sLock);
+	gang->sQuit = true;
+	pthread_cond_broadcast(&gang->sStart);
+	pthread_mutex_unlock(&gang->sLock);
+	for (long t = 0; t < gang->sNumStarted; t++)
+		pthread_join(gang->sThreads[t], NULL);
+	
+	free(gang->sThreads);
+	pthread_cond_destroy(&gang->sDone);
+	pthread_cond_destroy(&gang->sStart);
+	pthread_mutex_destroy(&gang->sLock);
+	free(gang);
+}
+
+
+#pragma mark ---- Queue ----
+
+struct jpQueue {
+	long sNumThreads;
+	jpJobProc sRunJob;
+	void *sUserData;
+	pthread_t *sThreads;
+	pthread_mutex_t sLock;
+	pthread_cond_t sWork;
+	long *sJobs;						/* ring of submitted jobs */
+	long sSize, sFirst, sCount;
+	bool sQuit;
+};
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Queue thread: runs the oldest job in the queue until the queue is empty and told to quit
+ */
+static void *queueThread(void *arg)
+{
+	jpQueue *queue = (jpQueue*)arg;
+	
+	pthread_mutex_lock(&queue->sLock);
+	for (;;) {
+		while (!queue->sCount && !queue->sQuit)
+			pthread_cond_wait(&queue->sWork, &queue->sLock);
+		if (!queue->sCount)
+			break;
+		long job = queue->sJobs[queue->sFirst];
+		queue->sFirst = (queue->sFirst + 1) % queue->sSize;
+		queue->sCount--;
+		pthread_mutex_unlock(&queue->sLock);
+		
+		queue->sRunJob(job, queue->sUserData);
+		
+		pthread_mutex_lock(&queue->sLock);
+	}
+	pthread_mutex_unlock(&queue->sLock);
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+jpQueue *jpQueueCreate(long numThreads, jpJobProc runJob, void *userData)
+{
+	if (!runJob)	return NULL;
+	if (numThreads < 1)
+		numThreads = 1;
+	
+	jpQueue *queue = (jpQueue*)calloc(1, sizeof(jpQueue));
+	if (!queue)	return NULL;
+	queue->sRunJob		= runJob;
+	queue->sUserData	= userData;
+	queue->sSize		= 16;
+	queue->sJobs		= (long*)malloc(queue->sSize*sizeof(long));
+	queue->sThreads		= (pthread_t*)malloc(numThreads*sizeof(pthread_t));
+	if (!queue->sJobs || !queue->sThreads) {
+		free(queue->sJobs);
+		free(queue->sThreads);
+		free(queue);
+		return NULL;
+	}
+	pthread_mutex_init(&queue->sLock, NULL);
+	pthread_cond_init(&queue->sWork, NULL);
+	
+	for (long t = 0; t < numThreads; t++) {
+		if (pthread_create(&queue->sThreads[queue->sNumThreads], NULL, queueThread, queue) == 0)
+			queue->sNumThreads++;
+	}
+	if (!queue->sNumThreads) {
+		jpQueueDestroy(queue);
+		return NULL;
+	}
+	return queue;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int jpQueueSubmit(jpQueue *queue, long job)
+{
+	if (!queue)	return -1;
+	
+	pthread_mutex_lock(&queue->sLock);
+	if (queue->sCount == queue->sSize) {
+		// unroll the ring into a bigger one
+		long *jobs = (long*)malloc(2*queue->sSize*sizeof(long));
+		if (!jobs) {
+			pthread_mutex_unlock(&queue->sLock);
+			return -1;
+		}
+		for (long j = 0; j < queue->sCount; j++)
+			jobs[j] = queue->sJobs[(queue->sFirst + j) % queue->sSize];
+		free(queue->sJobs);
+		queue->sJobs = jobs;
+		queue->sFirst = 0;
+		queue->sSize *= 2;
+	}
+	queue->sJobs[(queue->sFirst + queue->sCount) % queue->sSize] = job;
+	queue->sCount++;
+	pthread_cond_signal(&queue->sWork);
+	pthread_mutex_unlock(&queue->sLock);
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long jpQueueGetPending(jpQueue *queue)
+{
+	if (!queue)	return 0;
+	
+	pthread_mutex_lock(&queue->sLock);
+	long pending = queue->sCount;
+	pthread_mutex_unlock(&queue->sLock);
+	return pending;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jpQueueDestroy(jpQueue *queue)
+{
+	if (!queue)	return;
+	
+	pthread_mutex_lock(&queue->sLock);
+	queue->sQuit = true;
+	pthread_cond_broadcast(&queue->sWork);
+	pthread_mutex_unlock(&queue->sLock);
+	for (long t = 0; t < queue->sNumThreads; t++)
+		pthread_join(queue->sThreads[t], NULL);
+	
+	free(queue->sThreads);
+	free(queue->sJobs);
+	pthread_cond_destroy(&queue->sWork);
+	pthread_mutex_destroy(&queue->sLock);
+	free(queue);
+}
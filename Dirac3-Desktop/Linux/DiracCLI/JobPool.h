@@ -0,0 +1,101 @@
+/*
+ "JobPool.h" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Abstract: Runs a number of independent jobs on a pool of worker threads. Used by DiracCLI's
+ batch mode to process many groups of input files at the same time, each with its own Dirac
+ instance. A gang is a fixed set of threads that run one step of work each, together, as often
+ as asked. DiracCLI uses it to process the link groups of a job block by block. A queue is a
+ fixed set of threads that run jobs as they are submitted, for as long as it exists. DiracCLI's
+ daemon mode uses it to serve its clients.
+
+ */
+
+#ifndef __JOBPOOL__
+#define __JOBPOOL__
+
+
+typedef void (*jpJobProc)(long job, void *userData);
+
+typedef struct jpGang jpGang;
+typedef struct jpQueue jpQueue;
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of CPUs this process may actually use. This is the smallest of the
+//	number of online CPUs, the number of CPUs in our affinity mask and the CPU quota of our
+//	cgroup (cgroup v1 and v2, rounded up). Always returns at least 1.
+//
+long jpAvailableCpus(void);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Calls runJob(job, userData) once for every job in 0...numJobs-1, on up to numThreads
+//	threads including the calling thread. Jobs are handed out in order as threads become
+//	free. Returns when all jobs are done.
+//	Returns the number of threads that were actually used.
+//
+long jpRun(long numJobs, long numThreads, jpJobProc runJob, void *userData);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Starts a thread for each of the members 1...numMembers-1 of a gang, member 0 is always
+//	the thread that calls jpGangRun(). Members whose thread could not be started are run by
+//	the calling thread as well, so a gang always works, just slower.
+//	Returns NULL if out of memory.
+//
+jpGang *jpGangCreate(long numMembers, jpJobProc runMember, void *userData);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Calls runMember(member, userData) once for every member, each on its own thread, and
+//	returns when all of them are done.
+//
+void jpGangRun(jpGang *gang);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Stops the gang's threads and frees it.
+//
+void jpGangDestroy(jpGang *gang);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Starts numThreads threads that call runJob(job, userData) for every job submitted to the
+//	queue, in the order they were submitted.
+//	Returns NULL if out of memory or if no thread could be started.
+//
+jpQueue *jpQueueCreate(long numThreads, jpJobProc runJob, void *userData);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Adds job to the queue. job is any value that tells runJob what to do.
+//	Returns 0 on success, -1 if out of memory.
+//
+int jpQueueSubmit(jpQueue *queue, long job);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of jobs submitted to the queue that have not been started yet.
+//
+long jpQueueGetPending(jpQueue *queue);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Runs all jobs that are still queued, then stops the queue's threads and frees it.
+//
+void jpQueueDestroy(jpQueue *queue);
+//	-----------------------------------------------------------------------------------------
+
+
+#endif /* __JOBPOOL__ */
@@ -0,0 +1,311 @@
+/*
+ "JobStats.cpp" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+#include "JobStats.h"
+
+
+// Times are counted in nanoseconds and the peak CPU usage in hundredths of a percent, so all
+// counters are integers that can be updated atomically
+struct JobStats {
+	char *sName;
+	long sNumFiles;
+	float sSampleRate;
+	unsigned long long sFramesTotal;
+
+	volatile unsigned long long sFramesIn, sFramesOut;
+	volatile unsigned long long sDspNanos, sInputWaitNanos, sOutputWaitNanos;
+	volatile unsigned long sPeakCpu;
+	volatile unsigned long long *sBytesWritten;
+
+	double sStartTime;				/* set by the reporter, under its lock */
+	JobStats *sNext;				/* next job of the reporter */
+};
+
+
+struct JobStatsReporter {
+	FILE *sOut;
+	double sInterval;
+	JobStats *sJobs;
+	bool sExit;
+	bool sRunning;					/* thread has not been joined yet */
+	pthread_t sThread;
+	pthread_mutex_t sLock;
+	pthread_cond_t sWake;
+};
+
+
+#pragma mark ---- Helpers ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Atomic read of a counter that other threads add to
+ */
+static inline unsigned long long load(volatile unsigned long long *counter)
+{
+	return __sync_fetch_and_add(counter, 0ULL);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline unsigned long long toNanos(double seconds)
+{
+	return seconds > 0. ? (unsigned long long)(seconds * 1e9 + 0.5) : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes s as a JSON string, with quotes
+ */
+static void writeJsonString(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(out, "\\u%04x", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes a line about stats to the reporter's output. event is "progress" or "done", result is
+ only written for "done". Called with the reporter locked
+ */
+static void writeLine(JobStatsReporter *reporter, JobStats *stats, const char *event, int result)
+{
+	JobStatsValues values;
+	jsRead(stats, &values);
+	double elapsed = now() - stats->sStartTime;
+	double outSeconds = stats->sSampleRate > 0.f ? (double)values.sFramesOut / stats->sSampleRate : 0.;
+	FILE *out = reporter->sOut;
+
+	fprintf(out, "{\"event\":\"%s\",\"job\":", event);
+	writeJsonString(out, stats->sName);
+	if (strcmp(event, "done") == 0)
+		fprintf(out, ",\"result\":%d", result);
+	fprintf(out, ",\"elapsed_seconds\":%.3f,\"frames_in\":%llu,\"frames_out\":%llu,\"frames_total\":%llu,\"progress\":%.4f",
+			elapsed, values.sFramesIn, values.sFramesOut, stats->sFramesTotal,
+			stats->sFramesTotal ? (double)values.sFramesOut / (double)stats->sFramesTotal : 0.);
+	fprintf(out, ",\"realtime_factor\":%.3f,\"dsp_seconds\":%.3f,\"input_wait_seconds\":%.3f,\"output_wait_seconds\":%.3f,\"peak_cpu_percent\":%.2f",
+			elapsed > 0. ? outSeconds / elapsed : 0., values.sDspSeconds, values.sInputWaitSeconds, values.sOutputWaitSeconds, values.sPeakCpuPercent);
+	fprintf(out, ",\"bytes_written\":[");
+	for (long v = 0; v < stats->sNumFiles; v++)
+		fprintf(out, "%s%llu", v ? "," : "", load(stats->sBytesWritten+v));
+	fprintf(out, "]}\n");
+	fflush(out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reporter thread: writes a progress line for every job each interval
+ */
+static void *reporterThread(void *arg)
+{
+	JobStatsReporter *reporter = (JobStatsReporter*)arg;
+
+	pthread_mutex_lock(&reporter->sLock);
+	while (!reporter->sExit) {
+		struct timespec wake;
+		clock_gettime(CLOCK_REALTIME, &wake);
+		double seconds = (double)wake.tv_sec + 1e-9*(double)wake.tv_nsec + reporter->sInterval;
+		wake.tv_sec = (time_t)seconds;
+		wake.tv_nsec = (long)((seconds - (double)wake.tv_sec) * 1e9);
+		int err = 0;
+		while (!reporter->sExit && err != ETIMEDOUT)
+			err = pthread_cond_timedwait(&reporter->sWake, &reporter->sLock, &wake);
+		if (reporter->sExit)
+			break;
+		for (JobStats *stats = reporter->sJobs; stats; stats = stats->sNext)
+			writeLine(reporter, stats, "progress", 0);
+	}
+	pthread_mutex_unlock(&reporter->sLock);
+	return NULL;
+}
+
+
+#pragma mark ---- Job statistics ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+JobStats *jsCreate(const char *name, long numFiles, float sampleRate, unsigned long long framesTotal)
+{
+	if (!name || numFiles < 1)	return NULL;
+
+	JobStats *stats = (JobStats*)calloc(1, sizeof(JobStats));
+	if (!stats)	return NULL;
+	stats->sName = (char*)malloc(strlen(name)+1);
+	stats->sBytesWritten = (unsigned long long*)calloc(numFiles, sizeof(unsigned long long));
+	if (!stats->sName || !stats->sBytesWritten) {
+		jsDestroy(stats);
+		return NULL;
+	}
+	strcpy(stats->sName, name);
+	stats->sNumFiles	= numFiles;
+	stats->sSampleRate	= sampleRate;
+	stats->sFramesTotal	= framesTotal;
+	stats->sStartTime	= now();
+	return stats;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jsAdd(JobStats *stats, const JobStatsValues *values)
+{
+	if (!stats || !values)	return;
+
+	if (values->sFramesIn)
+		__sync_fetch_and_add(&stats->sFramesIn, values->sFramesIn);
+	if (values->sFramesOut)
+		__sync_fetch_and_add(&stats->sFramesOut, values->sFramesOut);
+	if (values->sDspSeconds > 0.)
+		__sync_fetch_and_add(&stats->sDspNanos, toNanos(values->sDspSeconds));
+	if (values->sInputWaitSeconds > 0.)
+		__sync_fetch_and_add(&stats->sInputWaitNanos, toNanos(values->sInputWaitSeconds));
+	if (values->sOutputWaitSeconds > 0.)
+		__sync_fetch_and_add(&stats->sOutputWaitNanos, toNanos(values->sOutputWaitSeconds));
+
+	unsigned long peak = values->sPeakCpuPercent > 0.f ? (unsigned long)(values->sPeakCpuPercent * 100.f + 0.5f) : 0;
+	for (;;) {
+		unsigned long current = stats->sPeakCpu;
+		if (peak <= current || __sync_bool_compare_and_swap(&stats->sPeakCpu, current, peak))
+			break;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jsSetBytesWritten(JobStats *stats, long file, unsigned long long bytes)
+{
+	if (!stats || file < 0 || file >= stats->sNumFiles)	return;
+
+	volatile unsigned long long *counter = stats->sBytesWritten + file;
+	for (;;) {
+		unsigned long long current = load(counter);
+		if (__sync_bool_compare_and_swap(counter, current, bytes))
+			break;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jsRead(JobStats *stats, JobStatsValues *values)
+{
+	if (!values)	return;
+	memset(values, 0, sizeof(JobStatsValues));
+	if (!stats)	return;
+
+	values->sFramesIn			= load(&stats->sFramesIn);
+	values->sFramesOut			= load(&stats->sFramesOut);
+	values->sDspSeconds			= 1e-9 * (double)load(&stats->sDspNanos);
+	values->sInputWaitSeconds	= 1e-9 * (double)load(&stats->sInputWaitNanos);
+	values->sOutputWaitSeconds	= 1e-9 * (double)load(&stats->sOutputWaitNanos);
+	values->sPeakCpuPercent		= 0.01f * (float)__sync_fetch_and_add(&stats->sPeakCpu, 0UL);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jsDestroy(JobStats *stats)
+{
+	if (!stats)	return;
+	free(stats->sName);
+	free((void*)stats->sBytesWritten);
+	free(stats);
+}
+
+
+#pragma mark ---- Reporter ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+JobStatsReporter *jsReporterCreate(FILE *out, double intervalSeconds)
+{
+	if (!out)	return NULL;
+
+	JobStatsReporter *reporter = (JobStatsReporter*)calloc(1, sizeof(JobStatsReporter));
+	if (!reporter)	return NULL;
+	reporter->sOut = out;
+	reporter->sInterval = intervalSeconds;
+	pthread_mutex_init(&reporter->sLock, NULL);
+	pthread_cond_init(&reporter->sWake, NULL);
+
+	// without an interval there is nothing to do between the final lines
+	if (intervalSeconds > 0.) {
+		if (pthread_create(&reporter->sThread, NULL, reporterThread, reporter) != 0) {
+			jsReporterDestroy(reporter);
+			return NULL;
+		}
+		reporter->sRunning = true;
+	}
+	return reporter;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jsReporterAdd(JobStatsReporter *reporter, JobStats *stats)
+{
+	if (!reporter || !stats)	return;
+	pthread_mutex_lock(&reporter->sLock);
+	stats->sStartTime = now();
+	stats->sNext = reporter->sJobs;
+	reporter->sJobs = stats;
+	pthread_mutex_unlock(&reporter->sLock);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jsReporterRemove(JobStatsReporter *reporter, JobStats *stats, int result)
+{
+	if (!reporter || !stats)	return;
+	pthread_mutex_lock(&reporter->sLock);
+	JobStats **link = &reporter->sJobs;
+	while (*link && *link != stats)
+		link = &(*link)->sNext;
+	if (*link) {
+		*link = stats->sNext;
+		stats->sNext = NULL;
+		writeLine(reporter, stats, "done", result);
+	}
+	pthread_mutex_unlock(&reporter->sLock);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void jsReporterDestroy(JobStatsReporter *reporter)
+{
+	if (!reporter)	return;
+	if (reporter->sRunning) {
+		pthread_mutex_lock(&reporter->sLock);
+		reporter->sExit = true;
+		pthread_cond_signal(&reporter->sWake);
+		pthread_mutex_unlock(&reporter->sLock);
+		pthread_join(reporter->sThread, NULL);
+	}
+	pthread_cond_destroy(&reporter->sWake);
+	pthread_mutex_destroy(&reporter->sLock);
+	free(reporter);
+}
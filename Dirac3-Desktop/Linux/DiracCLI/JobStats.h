@@ -0,0 +1,102 @@
+/*
+ "JobStats.h" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Abstract: Machine readable progress and performance statistics. The processing threads of a
+ job add to its counters with atomic operations only, so they never wait for the reporter. A
+ reporter thread writes a JSON object per line for every running job at a fixed interval and a
+ final one when a job is done, for an orchestrator to read instead of the console output.
+
+ */
+
+#ifndef __JOBSTATS__
+#define __JOBSTATS__
+
+#include <stdio.h>
+
+
+typedef struct JobStats JobStats;
+typedef struct JobStatsReporter JobStatsReporter;
+
+
+// Counters of a job. Passed to jsAdd() as the amounts to add, returned by jsRead() as totals
+typedef struct {
+	unsigned long long sFramesIn;		/* input frames Dirac has read */
+	unsigned long long sFramesOut;		/* output frames that went to the output files */
+	double sDspSeconds;					/* time in DiracProcess() without waiting for input, summed over link groups */
+	double sInputWaitSeconds;			/* time Dirac's read callbacks took to deliver input */
+	double sOutputWaitSeconds;			/* time handing blocks to the writer took */
+	float sPeakCpuPercent;				/* highest DiracPeakCpuUsagePercent() of any instance, not added but maxed */
+} JobStatsValues;
+
+
+//	-----------------------------------------------------------------------------------------
+//	Creates the statistics of a job called name (usually its first input file) that writes
+//	numFiles output files and is going to produce framesTotal output frames at sampleRate.
+//	Returns NULL if out of memory.
+//
+JobStats *jsCreate(const char *name, long numFiles, float sampleRate, unsigned long long framesTotal);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Adds values to the counters of a job. Lock free, may be called by several threads at once.
+//
+void jsAdd(JobStats *stats, const JobStatsValues *values);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Sets the number of bytes written to output file number file so far. Lock free.
+//
+void jsSetBytesWritten(JobStats *stats, long file, unsigned long long bytes);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Reads the counters of a job. Each counter is read atomically, but not all of them at once.
+//
+void jsRead(JobStats *stats, JobStatsValues *values);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Frees the statistics of a job. It must have been removed from its reporter.
+//
+void jsDestroy(JobStats *stats);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Starts a thread that writes a progress line for every job added to it to out every
+//	intervalSeconds, 0 = only write a line when a job is done.
+//	Returns NULL if out of memory or if the thread could not be started.
+//
+JobStatsReporter *jsReporterCreate(FILE *out, double intervalSeconds);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Adds a job to the reporter, which starts its clock.
+//
+void jsReporterAdd(JobStatsReporter *reporter, JobStats *stats);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Removes a job from the reporter and writes its final line, with result 0 for success.
+//
+void jsReporterRemove(JobStatsReporter *reporter, JobStats *stats, int result);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Stops the reporter thread and frees it. Jobs still added to it are dropped.
+//
+void jsReporterDestroy(JobStatsReporter *reporter);
+//	-----------------------------------------------------------------------------------------
+
+
+#endif /* __JOBSTATS__ */
@@ -0,0 +1,647 @@
+/*
+ "PcmStream.cpp" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "PcmStream.h"
+#include "PcmConvert.h"
+
+
+// WAV format tags we read and write
+#define WAV_FORMAT_PCM			1
+#define WAV_FORMAT_FLOAT		3
+#define WAV_FORMAT_EXTENSIBLE	0xFFFE
+
+// bytes of the headers we write
+#define WAV_HEADER_BYTES		44		/* RIFF, fmt and data chunk headers */
+#define RF64_HEADER_BYTES		80		/* the same with a ds64 (or JUNK) chunk after RIFF */
+#define W64_HEADER_BYTES		104		/* riff, fmt and data chunk headers of Wave64 */
+
+// size of the ds64 chunk we write: RIFF size, data size, number of frames and an empty table
+#define DS64_BYTES				28
+
+// Wave64 chunk ids. The first four bytes are the RIFF ids they stand for
+static const unsigned char kW64Riff[16] = { 'r','i','f','f', 0x2E,0x91,0xCF,0x11, 0xA5,0xD6,0x28,0xDB,0x04,0xC1,0x00,0x00 };
+static const unsigned char kW64Wave[16] = { 'w','a','v','e', 0xF3,0xAC,0xD3,0x11, 0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+static const unsigned char kW64Fmt[16]  = { 'f','m','t',' ', 0xF3,0xAC,0xD3,0x11, 0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+static const unsigned char kW64Data[16] = { 'd','a','t','a', 0xF3,0xAC,0xD3,0x11, 0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+
+// size the headers we write give while the size of the stream is not known
+#define UNKNOWN_SIZE			(~0ULL)
+
+
+struct PcmStream {
+	int sFd;
+	PcmStreamFormat sFormat;
+	long sFrameBytes;
+	unsigned long long sBytesLeft;	/* sample bytes the reader thread has yet to read, owned by it */
+
+	unsigned char *sRing;
+	long sRingBytes;				/* a multiple of sFrameBytes */
+	unsigned long long sWriteCount, sReadCount;	/* bytes, under sLock */
+	bool sEnded;					/* the reader thread has seen the end of the stream */
+	int sError;
+	bool sExit;
+	bool sStarted;					/* lock and thread were created */
+
+	pthread_t sThread;
+	pthread_mutex_t sLock;
+	pthread_cond_t sDataAvailable, sSpaceAvailable;
+
+	float *sInterleaved;
+	long sInterleavedFrames;
+	long sUnderruns;
+};
+
+
+struct PcmStreamWriter {
+	int sFd;
+	PcmStreamFormat sFormat;
+	long sFrameBytes;
+	bool sSeekable;
+	long sHeaderBytes;
+	unsigned long long sBytesWritten;
+	float *sInterleaved;
+	unsigned char *sBytes;
+	long sCapacity;					/* frames sInterleaved and sBytes hold */
+};
+
+
+#pragma mark ---- Helpers ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads exactly numBytes bytes. Returns false at the end of the stream or on error
+ */
+static bool readFully(int fd, void *buffer, size_t numBytes)
+{
+	unsigned char *p = (unsigned char*)buffer;
+	while (numBytes) {
+		ssize_t ret = read(fd, p, numBytes);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		p += ret;
+		numBytes -= ret;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads and drops numBytes bytes, the stream can't be seeked
+ */
+static bool skipBytes(int fd, unsigned long long numBytes)
+{
+	unsigned char scratch[4096];
+	while (numBytes) {
+		size_t n = numBytes < sizeof(scratch) ? (size_t)numBytes : sizeof(scratch);
+		if (!readFully(fd, scratch, n))
+			return false;
+		numBytes -= n;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes exactly numBytes bytes. Returns 0, or -errno
+ */
+static int writeFully(int fd, const void *buffer, size_t numBytes)
+{
+	const unsigned char *p = (const unsigned char*)buffer;
+	while (numBytes) {
+		ssize_t ret = write(fd, p, numBytes);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			return -errno;
+		p += ret;
+		numBytes -= ret;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static unsigned long long getLE(const unsigned char *p, int numBytes)
+{
+	unsigned long long v = 0;
+	for (int i = numBytes-1; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void putLE(unsigned char *p, unsigned long long v, int numBytes)
+{
+	for (int i = 0; i < numBytes; i++, v >>= 8)
+		p[i] = (unsigned char)(v & 0xff);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Fills in format from the body of a fmt chunk, which is the same in all three containers
+ */
+static bool parseFormatChunk(const unsigned char *fmt, unsigned long numBytes, PcmStreamFormat *format)
+{
+	unsigned long tag = (unsigned long)getLE(fmt, 2);
+	if (tag == WAV_FORMAT_EXTENSIBLE && numBytes >= 26)
+		tag = (unsigned long)getLE(fmt+24, 2);
+	format->sNumChannels	= (long)getLE(fmt+2, 2);
+	format->sSampleRate		= (float)getLE(fmt+4, 4);
+	format->sWordlength		= (int)getLE(fmt+14, 2);
+	format->sFloat			= (tag == WAV_FORMAT_FLOAT);
+	if (tag != WAV_FORMAT_PCM && tag != WAV_FORMAT_FLOAT)
+		return false;
+	if (format->sFloat ? format->sWordlength != 32 : (format->sWordlength != 16 && format->sWordlength != 24 && format->sWordlength != 32))
+		return false;
+	if (format->sNumChannels < 1 || format->sSampleRate <= 0.f)
+		return false;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads a WAV or RF64 header, of which the first four bytes are in header already, up to the first
+ sample. Chunks other than ds64, fmt and data are skipped
+ */
+static bool readRiffHeader(int fd, unsigned char *header, PcmStreamFormat *format)
+{
+	bool rf64 = (memcmp(header, "RF64", 4) == 0);
+	if (!readFully(fd, header+4, 8) || (!rf64 && memcmp(header, "RIFF", 4) != 0) || memcmp(header+8, "WAVE", 4) != 0)
+		return false;
+	format->sContainer = rf64 ? kPcmRF64 : kPcmWav;
+
+	bool haveFormat = false;
+	unsigned long long ds64DataBytes = 0;
+	for (;;) {
+		if (!readFully(fd, header, 8))
+			return false;
+		unsigned long size = (unsigned long)getLE(header+4, 4);
+		unsigned long numRead = size < 40 ? size : 40;
+
+		if (memcmp(header, "ds64", 4) == 0) {
+			if (size < 24 || !readFully(fd, header, numRead) || !skipBytes(fd, size - numRead + (size & 1)))
+				return false;
+			ds64DataBytes = getLE(header+8, 8);
+		} else if (memcmp(header, "fmt ", 4) == 0) {
+			if (size < 16 || !readFully(fd, header, numRead) || !skipBytes(fd, size - numRead + (size & 1)))
+				return false;
+			if (!parseFormatChunk(header, numRead, format))
+				return false;
+			haveFormat = true;
+		} else if (memcmp(header, "data", 4) == 0) {
+			if (!haveFormat)
+				return false;
+			// in RF64 0xFFFFFFFF means "see ds64". Writers on a pipe can't know the size and put
+			// 0 or all ones there
+			unsigned long long dataBytes = (rf64 && size == 0xFFFFFFFFUL) ? ds64DataBytes : size;
+			if (!rf64 && size == 0xFFFFFFFFUL)
+				dataBytes = 0;
+			unsigned long frameBytes = format->sNumChannels * (format->sWordlength/8);
+			format->sNumFrames = (dataBytes == UNKNOWN_SIZE) ? 0 : dataBytes / frameBytes;
+			return true;
+		} else if (!skipBytes(fd, (unsigned long long)size + (size & 1)))
+			return false;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads a Wave64 header, of which the first four bytes are in header already, up to the first
+ sample. Chunk sizes include the 24 bytes of the chunk header, chunks start at multiples of 8
+ */
+static bool readW64Header(int fd, unsigned char *header, PcmStreamFormat *format)
+{
+	if (!readFully(fd, header+4, 36) || memcmp(header, kW64Riff, 16) != 0 || memcmp(header+24, kW64Wave, 16) != 0)
+		return false;
+	format->sContainer = kPcmW64;
+
+	bool haveFormat = false;
+	for (;;) {
+		if (!readFully(fd, header, 24))
+			return false;
+		unsigned long long size = getLE(header+16, 8);
+		bool isFormat = (memcmp(header, kW64Fmt, 16) == 0);
+		bool isData = (memcmp(header, kW64Data, 16) == 0);
+
+		if (isData) {
+			if (!haveFormat)
+				return false;
+			// writers on a pipe can't know the size and put 0 or all ones there
+			unsigned long frameBytes = format->sNumChannels * (format->sWordlength/8);
+			format->sNumFrames = (size <= 24 || size == UNKNOWN_SIZE) ? 0 : (size - 24) / frameBytes;
+			return true;
+		}
+		if (size < 24)
+			return false;
+		unsigned long long bodyBytes = size - 24;
+		unsigned long long padBytes = ((size + 7) & ~7ULL) - size;
+		if (isFormat) {
+			unsigned long numRead = bodyBytes < 40 ? (unsigned long)bodyBytes : 40;
+			if (bodyBytes < 16 || !readFully(fd, header, numRead) || !skipBytes(fd, bodyBytes - numRead + padBytes))
+				return false;
+			if (!parseFormatChunk(header, numRead, format))
+				return false;
+			haveFormat = true;
+		} else if (!skipBytes(fd, bodyBytes + padBytes))
+			return false;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads whichever header the stream starts with up to the first sample and fills in format
+ */
+static bool readHeader(int fd, PcmStreamFormat *format)
+{
+	unsigned char header[40];
+	if (!readFully(fd, header, 4))
+		return false;
+	if (memcmp(header, kW64Riff, 4) == 0)
+		return readW64Header(fd, header, format);
+	return readRiffHeader(fd, header, format);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Builds the header of writer's container for dataBytes bytes of samples, UNKNOWN_SIZE if we don't
+ know yet, and returns its size. A WAV header gets a ds64 chunk in place of its JUNK chunk, and
+ turns into RF64, once the samples no longer fit into 4 GB
+ */
+static long makeHeader(PcmStreamWriter *writer, unsigned char *header, unsigned long long dataBytes)
+{
+	PcmStreamFormat *format = &writer->sFormat;
+	bool known = (dataBytes != UNKNOWN_SIZE);
+
+	unsigned char fmt[16];
+	putLE(fmt, format->sFloat ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM, 2);
+	putLE(fmt+2, format->sNumChannels, 2);
+	putLE(fmt+4, (unsigned long)format->sSampleRate, 4);
+	putLE(fmt+8, (unsigned long)format->sSampleRate * writer->sFrameBytes, 4);
+	putLE(fmt+12, writer->sFrameBytes, 2);
+	putLE(fmt+14, format->sWordlength, 2);
+
+	if (format->sContainer == kPcmW64) {
+		memcpy(header, kW64Riff, 16);
+		putLE(header+16, known ? W64_HEADER_BYTES + ((dataBytes + 7) & ~7ULL) : UNKNOWN_SIZE, 8);
+		memcpy(header+24, kW64Wave, 16);
+		memcpy(header+40, kW64Fmt, 16);
+		putLE(header+56, 24 + sizeof(fmt), 8);
+		memcpy(header+64, fmt, sizeof(fmt));
+		memcpy(header+80, kW64Data, 16);
+		putLE(header+96, known ? 24 + dataBytes : UNKNOWN_SIZE, 8);
+		return W64_HEADER_BYTES;
+	}
+
+	// there is no point in reserving room for a ds64 chunk we can't go back to
+	long headerBytes = (format->sContainer == kPcmRF64 || writer->sSeekable) ? RF64_HEADER_BYTES : WAV_HEADER_BYTES;
+	unsigned long long riffBytes = headerBytes - 8 + dataBytes + (dataBytes & 1);
+	bool rf64 = (format->sContainer == kPcmRF64 || (known && riffBytes > 0xFFFFFFFFULL));
+
+	unsigned char *p = header;
+	memcpy(p, rf64 ? "RF64" : "RIFF", 4);
+	putLE(p+4, (rf64 || !known) ? 0xFFFFFFFFULL : riffBytes, 4);
+	memcpy(p+8, "WAVE", 4);
+	p += 12;
+	if (headerBytes == RF64_HEADER_BYTES) {
+		memcpy(p, rf64 ? "ds64" : "JUNK", 4);
+		putLE(p+4, DS64_BYTES, 4);
+		memset(p+8, 0, DS64_BYTES);
+		if (rf64) {
+			putLE(p+8, known ? riffBytes : UNKNOWN_SIZE, 8);
+			putLE(p+16, dataBytes, 8);
+			putLE(p+24, known ? dataBytes / writer->sFrameBytes : UNKNOWN_SIZE, 8);
+		}
+		p += 8 + DS64_BYTES;
+	}
+	memcpy(p, "fmt ", 4);
+	putLE(p+4, sizeof(fmt), 4);
+	memcpy(p+8, fmt, sizeof(fmt));
+	memcpy(p+24, "data", 4);
+	putLE(p+28, (rf64 || !known) ? 0xFFFFFFFFULL : dataBytes, 4);
+	return headerBytes;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Converts numBytes bytes of samples in the stream's format to float
+ */
+static void decodeSamples(PcmStreamFormat *format, float *dst, const unsigned char *src, long numBytes)
+{
+	if (format->sFloat)
+		memcpy(dst, src, numBytes);
+	else
+		pcmIntToFloat(dst, src, numBytes / (format->sWordlength/8), format->sWordlength, false);
+}
+
+
+#pragma mark ---- Reading ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reader thread: keeps the ring filled from the stream until it ends. It can only be cancelled
+ while it waits in read(), when it holds no lock
+ */
+static void *readerThread(void *arg)
+{
+	PcmStream *stream = (PcmStream*)arg;
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+	for (;;) {
+		pthread_mutex_lock(&stream->sLock);
+		while (!stream->sExit && stream->sWriteCount - stream->sReadCount == (unsigned long long)stream->sRingBytes)
+			pthread_cond_wait(&stream->sSpaceAvailable, &stream->sLock);
+		if (stream->sExit) {
+			pthread_mutex_unlock(&stream->sLock);
+			break;
+		}
+		long position = (long)(stream->sWriteCount % stream->sRingBytes);
+		long space = stream->sRingBytes - (long)(stream->sWriteCount - stream->sReadCount);
+		pthread_mutex_unlock(&stream->sLock);
+
+		// the free part of the ring belongs to us until we advance sWriteCount
+		long numBytes = stream->sRingBytes - position < space ? stream->sRingBytes - position : space;
+		if ((unsigned long long)numBytes > stream->sBytesLeft)
+			numBytes = (long)stream->sBytesLeft;
+		ssize_t ret = 0;
+		if (numBytes) {
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			do
+				ret = read(stream->sFd, stream->sRing + position, numBytes);
+			while (ret < 0 && errno == EINTR);
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		}
+		int error = ret < 0 ? -errno : 0;
+
+		pthread_mutex_lock(&stream->sLock);
+		if (ret > 0) {
+			stream->sWriteCount += ret;
+			stream->sBytesLeft -= ret;
+		} else {
+			stream->sEnded = true;
+			stream->sError = error;
+		}
+		bool ended = stream->sEnded;
+		pthread_cond_signal(&stream->sDataAvailable);
+		pthread_mutex_unlock(&stream->sLock);
+		if (ended)
+			break;
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+PcmStream *psOpen(int fd, PcmStreamFormat *format, long ringFrames)
+{
+	if (fd < 0 || !format || ringFrames < 1)
+		return NULL;
+	if (format->sContainer != kPcmRaw && !readHeader(fd, format)) {
+		close(fd);
+		return NULL;
+	}
+	if (format->sNumChannels < 1 || (format->sWordlength != 16 && format->sWordlength != 24 && format->sWordlength != 32)) {
+		close(fd);
+		return NULL;
+	}
+
+	PcmStream *stream = (PcmStream*)calloc(1, sizeof(PcmStream));
+	if (!stream) {
+		close(fd);
+		return NULL;
+	}
+	stream->sFd = fd;
+	stream->sFormat = *format;
+	stream->sFrameBytes = format->sNumChannels * (format->sWordlength/8);
+	stream->sBytesLeft = format->sNumFrames ? format->sNumFrames * stream->sFrameBytes : ~0ULL;
+	stream->sRingBytes = ringFrames * stream->sFrameBytes;
+	stream->sRing = (unsigned char*)malloc(stream->sRingBytes);
+	if (!stream->sRing) {
+		psClose(stream);
+		return NULL;
+	}
+
+	pthread_mutex_init(&stream->sLock, NULL);
+	pthread_cond_init(&stream->sDataAvailable, NULL);
+	pthread_cond_init(&stream->sSpaceAvailable, NULL);
+	if (pthread_create(&stream->sThread, NULL, readerThread, stream) != 0) {
+		pthread_cond_destroy(&stream->sSpaceAvailable);
+		pthread_cond_destroy(&stream->sDataAvailable);
+		pthread_mutex_destroy(&stream->sLock);
+		psClose(stream);
+		return NULL;
+	}
+	stream->sStarted = true;
+	return stream;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long psRead(PcmStream *stream, float **data, long numFrames)
+{
+	if (!stream || !data || numFrames < 0)	return -EINVAL;
+
+	long numChannels = stream->sFormat.sNumChannels;
+	if (numFrames > stream->sInterleavedFrames) {
+		free(stream->sInterleaved);
+		stream->sInterleaved = (float*)malloc(numFrames*numChannels*sizeof(float));
+		stream->sInterleavedFrames = stream->sInterleaved ? numFrames : 0;
+		if (!stream->sInterleaved)
+			return -ENOMEM;
+	}
+
+	long copied = 0;
+	long ringFrames = stream->sRingBytes / stream->sFrameBytes;
+	bool waited = false;
+	int error = 0;
+	while (copied < numFrames) {
+		long wanted = numFrames - copied < ringFrames ? numFrames - copied : ringFrames;
+		unsigned long long wantedBytes = (unsigned long long)wanted * stream->sFrameBytes;
+
+		pthread_mutex_lock(&stream->sLock);
+		while (stream->sWriteCount - stream->sReadCount < wantedBytes && !stream->sEnded) {
+			waited = true;
+			pthread_cond_wait(&stream->sDataAvailable, &stream->sLock);
+		}
+		unsigned long long available = stream->sWriteCount - stream->sReadCount;
+		long position = (long)(stream->sReadCount % stream->sRingBytes);
+		error = stream->sError;
+		pthread_mutex_unlock(&stream->sLock);
+
+		// a partial frame at the end of the stream is dropped
+		long take = available < wantedBytes ? (long)(available / stream->sFrameBytes) : wanted;
+		if (!take)
+			break;
+		long numBytes = take * stream->sFrameBytes;
+		long first = stream->sRingBytes - position < numBytes ? stream->sRingBytes - position : numBytes;
+		float *dst = stream->sInterleaved + copied*numChannels;
+		decodeSamples(&stream->sFormat, dst, stream->sRing + position, first);
+		if (numBytes > first)
+			decodeSamples(&stream->sFormat, dst + first/(stream->sFormat.sWordlength/8), stream->sRing, numBytes - first);
+		copied += take;
+
+		pthread_mutex_lock(&stream->sLock);
+		stream->sReadCount += numBytes;
+		pthread_cond_signal(&stream->sSpaceAvailable);
+		pthread_mutex_unlock(&stream->sLock);
+	}
+	if (waited)
+		stream->sUnderruns++;
+
+	pcmDeinterleave(data, stream->sInterleaved, copied, numChannels, numChannels);
+	for (long c = 0; c < numChannels; c++)
+		memset(data[c]+copied, 0, (numFrames-copied)*sizeof(float));
+
+	if (!copied && error)
+		return error;
+	return copied;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long psGetUnderruns(PcmStream *stream)
+{
+	return stream ? stream->sUnderruns : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void psClose(PcmStream *stream)
+{
+	if (!stream)	return;
+
+	if (stream->sStarted) {
+		// if we stop before the end of the stream the thread may be waiting for a pipe that is
+		// never closed
+		pthread_mutex_lock(&stream->sLock);
+		stream->sExit = true;
+		pthread_cond_signal(&stream->sSpaceAvailable);
+		pthread_mutex_unlock(&stream->sLock);
+		pthread_cancel(stream->sThread);
+		pthread_join(stream->sThread, NULL);
+		pthread_cond_destroy(&stream->sSpaceAvailable);
+		pthread_cond_destroy(&stream->sDataAvailable);
+		pthread_mutex_destroy(&stream->sLock);
+	}
+	close(stream->sFd);
+	free(stream->sInterleaved);
+	free(stream->sRing);
+	free(stream);
+}
+
+
+#pragma mark ---- Writing ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+PcmStreamWriter *psCreate(int fd, PcmStreamFormat *format)
+{
+	if (fd < 0 || !format || format->sNumChannels < 1 || (format->sWordlength != 16 && format->sWordlength != 24 && format->sWordlength != 32)) {
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+
+	PcmStreamWriter *writer = (PcmStreamWriter*)calloc(1, sizeof(PcmStreamWriter));
+	if (!writer) {
+		close(fd);
+		return NULL;
+	}
+	writer->sFd = fd;
+	writer->sFormat = *format;
+	writer->sFrameBytes = format->sNumChannels * (format->sWordlength/8);
+	struct stat info;
+	writer->sSeekable = fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && lseek(fd, 0, SEEK_CUR) >= 0;
+
+	if (format->sContainer != kPcmRaw) {
+		// the sizes are filled in by psCloseWriter() if it can seek back here
+		unsigned char header[W64_HEADER_BYTES];
+		writer->sHeaderBytes = makeHeader(writer, header, UNKNOWN_SIZE);
+		if (writeFully(fd, header, writer->sHeaderBytes) != 0) {
+			close(fd);
+			free(writer);
+			return NULL;
+		}
+		writer->sBytesWritten = writer->sHeaderBytes;
+	}
+	return writer;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+long psWrite(PcmStreamWriter *writer, float **data, long numFrames)
+{
+	if (!writer || !data || numFrames < 0)	return -EINVAL;
+
+	long numChannels = writer->sFormat.sNumChannels;
+	if (numFrames > writer->sCapacity) {
+		free(writer->sInterleaved);
+		free(writer->sBytes);
+		writer->sInterleaved = (float*)malloc(numFrames*numChannels*sizeof(float));
+		writer->sBytes = (unsigned char*)malloc(numFrames*writer->sFrameBytes);
+		writer->sCapacity = (writer->sInterleaved && writer->sBytes) ? numFrames : 0;
+		if (!writer->sCapacity)
+			return -ENOMEM;
+	}
+
+	pcmInterleave(writer->sInterleaved, data, numFrames, numChannels, numChannels);
+	const void *bytes = writer->sInterleaved;
+	if (!writer->sFormat.sFloat) {
+		pcmFloatToInt(writer->sBytes, writer->sInterleaved, numFrames*numChannels, writer->sFormat.sWordlength, false);
+		bytes = writer->sBytes;
+	}
+	int error = writeFully(writer->sFd, bytes, numFrames*writer->sFrameBytes);
+	if (error)
+		return error;
+	writer->sBytesWritten += numFrames*writer->sFrameBytes;
+	return numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+unsigned long long psGetBytesWritten(PcmStreamWriter *writer)
+{
+	return writer ? writer->sBytesWritten : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int psCloseWriter(PcmStreamWriter *writer)
+{
+	if (!writer)	return -EINVAL;
+
+	int error = 0;
+	if (writer->sFormat.sContainer != kPcmRaw && writer->sSeekable) {
+		// the last chunk is padded like any other, to 2 bytes in RIFF and 8 bytes in Wave64
+		unsigned long long dataBytes = writer->sBytesWritten - writer->sHeaderBytes;
+		unsigned char pad[8] = { 0 };
+		long padBytes = (writer->sFormat.sContainer == kPcmW64) ? (long)(((dataBytes + 7) & ~7ULL) - dataBytes) : (long)(dataBytes & 1);
+		if (padBytes)
+			error = writeFully(writer->sFd, pad, padBytes);
+
+		unsigned char header[W64_HEADER_BYTES];
+		long headerBytes = makeHeader(writer, header, dataBytes);
+		if (pwrite(writer->sFd, header, headerBytes, 0) != headerBytes && !error)
+			error = -errno;
+	}
+	if (close(writer->sFd) != 0 && !error)
+		error = -errno;
+	free(writer->sInterleaved);
+	free(writer->sBytes);
+	free(writer);
+	return error;
+}
@@ -0,0 +1,113 @@
+/*
+ "PcmStream.h" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Abstract: Interleaved PCM on pipes and files that can't be seeked, raw or with a WAV, RF64 or
+ Wave64 header. The latter two have 64 bit sizes, so streams are not limited to 4 GB.
+ A stream opened for reading is read ahead by a separate thread into a ring of raw bytes, so an
+ upstream decoder writing into the pipe does not wait for Dirac, and Dirac's read callback only
+ waits if the pipe runs dry. Samples are converted with the routines in PcmConvert.h.
+
+ */
+
+#ifndef __PCMSTREAM__
+#define __PCMSTREAM__
+
+
+typedef struct PcmStream PcmStream;
+typedef struct PcmStreamWriter PcmStreamWriter;
+
+// containers, see PcmStreamFormat::sContainer
+enum {
+	kPcmRaw = 0,					/* samples only */
+	kPcmWav,						/* RIFF WAVE, 4 GB at most */
+	kPcmRF64,						/* RF64 (EBU Tech 3306), WAV with 64 bit sizes in a ds64 chunk */
+	kPcmW64							/* Sony Wave64, 64 bit sizes and GUIDs for chunk ids */
+};
+
+typedef struct {
+	float sSampleRate;
+	long sNumChannels;
+	int sWordlength;				/* bits per sample: 16, 24 or 32 */
+	bool sFloat;					/* 32 bit float instead of integer samples */
+	int sContainer;					/* header in front of the samples */
+	unsigned long long sNumFrames;	/* frames in the stream, 0 = up to the end of the stream */
+} PcmStreamFormat;
+
+
+//	-----------------------------------------------------------------------------------------
+//	Starts reading the stream on fd, which the stream owns from now on. If format->sContainer
+//	is not kPcmRaw a WAV, RF64 or Wave64 header is read, whichever the stream starts with, and
+//	the rest of *format is filled in from it. Otherwise *format must describe the raw samples.
+//	Up to ringFrames frames are read ahead.
+//	Returns NULL if the header is none of these or not of a format listed above, the ring
+//	could not be allocated or the thread could not be started. fd is closed in that case.
+//
+PcmStream *psOpen(int fd, PcmStreamFormat *format, long ringFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Reads numFrames frames into data[0...numChannels-1][0...numFrames-1] as float in the range
+//	[-1.0, +1.0). Waits until they have arrived or the stream has ended. Frames past the end
+//	of the stream are set to zero.
+//	Returns the number of frames actually read (fewer at the end of the stream), or -errno if
+//	reading the stream failed.
+//
+long psRead(PcmStream *stream, float **data, long numFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of reads that had to wait for the stream.
+//
+long psGetUnderruns(PcmStream *stream);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Stops the reader thread, closes the stream's file descriptor and frees the ring.
+//
+void psClose(PcmStream *stream);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Starts writing a stream in the given format to fd, which the writer owns from now on. The
+//	header of format->sContainer is written first. Its sizes say "up to the end of the stream"
+//	unless fd can be seeked, in which case they are filled in by psCloseWriter(). A WAV file
+//	that can be seeked gets room for a ds64 chunk and turns into RF64 if it grows past 4 GB.
+//	Returns NULL if out of memory or the header could not be written. fd is closed in that case.
+//
+PcmStreamWriter *psCreate(int fd, PcmStreamFormat *format);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Interleaves and writes numFrames frames from data[0...numChannels-1]. Integer samples are
+//	clipped to [-1.0, +1.0). Waits until the frames could be written.
+//	Returns numFrames, or -errno if writing failed, -EPIPE if nobody reads the stream anymore.
+//
+long psWrite(PcmStreamWriter *writer, float **data, long numFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of bytes written so far, including the header.
+//
+unsigned long long psGetBytesWritten(PcmStreamWriter *writer);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Fills in the sizes in the header if it can, then closes the file descriptor, which
+//	tells whoever reads a pipe that the stream has ended.
+//	Returns 0, or -errno if writing or closing failed.
+//
+int psCloseWriter(PcmStreamWriter *writer);
+//	-----------------------------------------------------------------------------------------
+
+
+#endif /* __PCMSTREAM__ */
@@ -0,0 +1,267 @@
+/*
+ "WriteBehind.cpp" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "WriteBehind.h"
+
+
+struct WriteBehind {
+	mAiffWriter **sFiles;
+	long *sFileNumChannels;
+	long sNumFiles;
+	long sTotalNumChannels;
+
+	float ***sBlocks;				/* sBlocks[slot][channel][frame] */
+	long *sBlockFrames;
+	long sQueueDepth;
+	long sHead, sTail, sCount;
+	bool sDone;
+	bool sStarted;					/* lock and thread were created */
+	bool sRunning;					/* thread has not been joined yet */
+	int sError;
+
+	pthread_t sThread;
+	pthread_mutex_t sLock;
+	pthread_cond_t sNotEmpty, sNotFull;
+
+	WriteBehindStats sStats;
+	double sQueueDepthSum;
+	volatile unsigned long long *sFileBytes;	/* bytes written per file, read without the lock */
+};
+
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writer thread: takes blocks off the head of the queue and appends them to the output files
+ */
+static void *writerThread(void *arg)
+{
+	WriteBehind *wb = (WriteBehind*)arg;
+
+	for (;;) {
+		pthread_mutex_lock(&wb->sLock);
+		while (!wb->sCount && !wb->sDone)
+			pthread_cond_wait(&wb->sNotEmpty, &wb->sLock);
+		if (!wb->sCount) {
+			pthread_mutex_unlock(&wb->sLock);
+			break;
+		}
+		long slot = wb->sHead;
+		pthread_mutex_unlock(&wb->sLock);
+
+		// the slot at the head belongs to us until we advance sHead
+		float **block = wb->sBlocks[slot];
+		long numFrames = wb->sBlockFrames[slot];
+		double start = now();
+		long channel = 0;
+		int err = 0;
+		unsigned long long bytes = 0;
+		for (long v = 0; v < wb->sNumFiles; v++) {
+			unsigned long long before = mAiffGetBytesWritten(wb->sFiles[v]);
+			int ret = mAiffWriteFrames(wb->sFiles[v], block+channel, numFrames, wb->sFileNumChannels[v]);
+			if (ret < 0 && !err)
+				err = ret;
+			unsigned long long written = mAiffGetBytesWritten(wb->sFiles[v]) - before;
+			__sync_fetch_and_add(wb->sFileBytes+v, written);
+			bytes += written;
+			channel += wb->sFileNumChannels[v];
+		}
+		double elapsed = now() - start;
+
+		pthread_mutex_lock(&wb->sLock);
+		if (err && !wb->sError)
+			wb->sError = err;
+		wb->sStats.sWriteSeconds += elapsed;
+		wb->sStats.sBytesWritten += bytes;
+		wb->sHead = (wb->sHead+1) % wb->sQueueDepth;
+		wb->sCount--;
+		pthread_cond_signal(&wb->sNotFull);
+		pthread_mutex_unlock(&wb->sLock);
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+WriteBehind *wbCreate(mAiffWriter **files, long *fileNumChannels, long numFiles, long maxFramesPerBlock, long queueDepth)
+{
+	if (!files || !fileNumChannels || numFiles < 1 || maxFramesPerBlock < 1 || queueDepth < 1)
+		return NULL;
+
+	WriteBehind *wb = (WriteBehind*)calloc(1, sizeof(WriteBehind));
+	if (!wb)	return NULL;
+
+	wb->sFiles				= files;
+	wb->sFileNumChannels	= fileNumChannels;
+	wb->sNumFiles			= numFiles;
+	wb->sQueueDepth			= queueDepth;
+	for (long v = 0; v < numFiles; v++)
+		wb->sTotalNumChannels += fileNumChannels[v];
+
+	wb->sBlockFrames = (long*)calloc(queueDepth, sizeof(long));
+	wb->sBlocks = (float***)calloc(queueDepth, sizeof(float**));
+	wb->sFileBytes = (unsigned long long*)calloc(numFiles, sizeof(unsigned long long));
+	if (!wb->sBlockFrames || !wb->sBlocks || !wb->sFileBytes) {
+		wbDestroy(wb);
+		return NULL;
+	}
+	for (long b = 0; b < queueDepth; b++) {
+		wb->sBlocks[b] = (float**)calloc(wb->sTotalNumChannels, sizeof(float*));
+		if (!wb->sBlocks[b]) {
+			wbDestroy(wb);
+			return NULL;
+		}
+		for (long c = 0; c < wb->sTotalNumChannels; c++) {
+			wb->sBlocks[b][c] = (float*)malloc(maxFramesPerBlock*sizeof(float));
+			if (!wb->sBlocks[b][c]) {
+				wbDestroy(wb);
+				return NULL;
+			}
+		}
+	}
+
+	pthread_mutex_init(&wb->sLock, NULL);
+	pthread_cond_init(&wb->sNotEmpty, NULL);
+	pthread_cond_init(&wb->sNotFull, NULL);
+	wb->sStarted = true;
+	if (pthread_create(&wb->sThread, NULL, writerThread, wb) != 0) {
+		wbDestroy(wb);
+		return NULL;
+	}
+	wb->sRunning = true;
+	return wb;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int wbSubmit(WriteBehind *wb, float **audio, long numFrames)
+{
+	if (!wb || !wb->sRunning)	return -6;
+
+	pthread_mutex_lock(&wb->sLock);
+	wb->sQueueDepthSum += wb->sCount;
+	if (wb->sCount == wb->sQueueDepth) {
+		double start = now();
+		while (wb->sCount == wb->sQueueDepth)
+			pthread_cond_wait(&wb->sNotFull, &wb->sLock);
+		wb->sStats.sStallSeconds += now() - start;
+	}
+	long slot = wb->sTail;
+	int err = wb->sError;
+	pthread_mutex_unlock(&wb->sLock);
+
+	// the slot at the tail is free and only ever touched by the submitting thread
+	for (long c = 0; c < wb->sTotalNumChannels; c++)
+		memcpy(wb->sBlocks[slot][c], audio[c], numFrames*sizeof(float));
+	wb->sBlockFrames[slot] = numFrames;
+
+	pthread_mutex_lock(&wb->sLock);
+	wb->sTail = (wb->sTail+1) % wb->sQueueDepth;
+	wb->sCount++;
+	wb->sStats.sNumBlocks++;
+	if (wb->sCount > wb->sStats.sMaxQueueDepth)
+		wb->sStats.sMaxQueueDepth = wb->sCount;
+	pthread_cond_signal(&wb->sNotEmpty);
+	pthread_mutex_unlock(&wb->sLock);
+
+	return err;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int wbFlush(WriteBehind *wb)
+{
+	if (!wb || !wb->sRunning)	return -6;
+
+	// once the queue is empty the writer thread waits for us and leaves the files alone
+	pthread_mutex_lock(&wb->sLock);
+	while (wb->sCount)
+		pthread_cond_wait(&wb->sNotFull, &wb->sLock);
+	int err = wb->sError;
+	pthread_mutex_unlock(&wb->sLock);
+
+	for (long v = 0; v < wb->sNumFiles; v++) {
+		int ret = mAiffFlush(wb->sFiles[v]);
+		if (ret < 0 && !err)
+			err = ret;
+	}
+	return err;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int wbFinish(WriteBehind *wb)
+{
+	if (!wb)	return -6;
+	if (wb->sRunning) {
+		pthread_mutex_lock(&wb->sLock);
+		wb->sDone = true;
+		pthread_cond_signal(&wb->sNotEmpty);
+		pthread_mutex_unlock(&wb->sLock);
+		pthread_join(wb->sThread, NULL);
+		wb->sRunning = false;
+	}
+	return wb->sError;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void wbGetStats(WriteBehind *wb, WriteBehindStats *stats)
+{
+	if (!wb || !stats)	return;
+	pthread_mutex_lock(&wb->sLock);
+	*stats = wb->sStats;
+	stats->sAvgQueueDepth = wb->sStats.sNumBlocks ? wb->sQueueDepthSum / (double)wb->sStats.sNumBlocks : 0.;
+	pthread_mutex_unlock(&wb->sLock);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+unsigned long long wbGetFileBytesWritten(WriteBehind *wb, long file)
+{
+	if (!wb || file < 0 || file >= wb->sNumFiles)	return 0;
+	return __sync_fetch_and_add(wb->sFileBytes+file, 0ULL);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void wbDestroy(WriteBehind *wb)
+{
+	if (!wb)	return;
+	if (wb->sStarted) {
+		wbFinish(wb);
+		pthread_cond_destroy(&wb->sNotFull);
+		pthread_cond_destroy(&wb->sNotEmpty);
+		pthread_mutex_destroy(&wb->sLock);
+	}
+	if (wb->sBlocks) {
+		for (long b = 0; b < wb->sQueueDepth; b++) {
+			if (!wb->sBlocks[b])	continue;
+			for (long c = 0; c < wb->sTotalNumChannels; c++)
+				free(wb->sBlocks[b][c]);
+			free(wb->sBlocks[b]);
+		}
+		free(wb->sBlocks);
+	}
+	free(wb->sBlockFrames);
+	free((void*)wb->sFileBytes);
+	free(wb);
+}
@@ -0,0 +1,89 @@
+/*
+ "WriteBehind.h" DiracCLI Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Abstract: Write-behind output stage. Processed blocks are copied into a bounded queue and
+ written to the output files by a separate thread, so the processing loop does not wait for the
+ disk unless the queue is full.
+
+ */
+
+#ifndef __WRITEBEHIND__
+#define __WRITEBEHIND__
+
+#include "MiniAiffStream.h"
+
+
+typedef struct WriteBehind WriteBehind;
+
+typedef struct {
+	long sNumBlocks;				/* number of blocks submitted */
+	long sMaxQueueDepth;			/* highest number of blocks waiting to be written */
+	double sAvgQueueDepth;			/* average number of blocks waiting when a block was submitted */
+	unsigned long long sBytesWritten;
+	double sStallSeconds;			/* time the submitting thread spent waiting for a free slot */
+	double sWriteSeconds;			/* time the writer thread spent in mAiffWriteFrames() */
+} WriteBehindStats;
+
+
+//	-----------------------------------------------------------------------------------------
+//	Starts the writer thread. Each submitted block holds the channels of all numFiles files
+//	back to back, the first fileNumChannels[0] channels go to files[0] and so on. At most
+//	queueDepth blocks of up to maxFramesPerBlock frames are held in memory.
+//	The writers stay owned by the caller and must not be used until wbFinish() returns.
+//	Returns NULL if the queue could not be allocated or the thread could not be started.
+//
+WriteBehind *wbCreate(mAiffWriter **files, long *fileNumChannels, long numFiles, long maxFramesPerBlock, long queueDepth);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Copies numFrames frames from audio into the queue. Only blocks if the queue is full.
+//	Returns 0, or the error code of the first write that failed on the writer thread.
+//
+int wbSubmit(WriteBehind *wb, float **audio, long numFrames);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Waits until all queued blocks are written, then flushes the output files to disk with
+//	mAiffFlush(). The writer thread keeps running. Call it from the thread that submits.
+//	Returns 0, or the error code of the first write that failed.
+//
+int wbFlush(WriteBehind *wb);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Waits until all queued blocks are written and stops the writer thread.
+//	Returns 0, or the error code of the first write that failed.
+//
+int wbFinish(WriteBehind *wb);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Fills in the queue statistics. Valid at any time, final after wbFinish().
+//
+void wbGetStats(WriteBehind *wb, WriteBehindStats *stats);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Returns the number of bytes written to files[file] so far. Does not take the queue's lock,
+//	so it is cheap enough to call after every block.
+//
+unsigned long long wbGetFileBytesWritten(WriteBehind *wb, long file);
+//	-----------------------------------------------------------------------------------------
+
+
+//	-----------------------------------------------------------------------------------------
+//	Stops the writer thread if still running and frees the queue.
+//
+void wbDestroy(WriteBehind *wb);
+//	-----------------------------------------------------------------------------------------
+
+
+#endif /* __WRITEBEHIND__ */
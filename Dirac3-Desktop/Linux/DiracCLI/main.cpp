@@ -15,14 +15,94 @@
 #include <math.h>
 #include <string.h>
 #include <memory.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "MiniAiff.h"
+#include "MiniAiffStream.h"
+#include "MiniAiffPrefetch.h"
 #include "Dirac.h"
+#include "WriteBehind.h"
+#include "JobPool.h"
+#include "DiracPool.h"
+#include "BlockProfile.h"
+#include "DiracFeed.h"
+#include "JobStats.h"
+#include "PcmStream.h"
+#include "PhaseTimer.h"
 
 // this defines the maximum number of files that we can use on input. This is enough to process
 // 7.1 format and beyond. Increase accordingly if you need more
 #define MAX_NUM_FILES		16
 
+// default number of processed blocks the write-behind stage can hold before processing has to wait
+#define DEFAULT_QUEUE_DEPTH	32
+
+// default number of frames decoded ahead of Dirac's read position, per input file
+#define DEFAULT_READ_AHEAD	262144
+#define READ_AHEAD_CHUNK	16384
+
+// number of input files whose headers are read at the same time
+#define PROBE_THREADS		16
+
+// In segment mode every segment starts this much input ahead of its first output frame so that
+// Dirac has settled by the time we use its output, and neighbouring segments overlap by a short
+// crossfade
+#define SEGMENT_PREROLL_SECONDS		1.0
+#define SEGMENT_CROSSFADE_SECONDS	0.02
+
+// Dirac reads ahead of the output it produces. Past the end of the input we feed it this much
+// silence so it can finish its last output frames, then we report the end of the file
+#define END_PADDING_SECONDS	1.0
+
+// frames per DiracProcess() call if the block size profile has nothing better
+#define DEFAULT_BLOCK_SIZE	4096
+
+// block sizes tried by --tune, and seconds of audio processed per size and round
+#define TUNE_MIN_BLOCK_SIZE	256
+#define TUNE_MAX_BLOCK_SIZE	16384
+#define TUNE_SECONDS		5.0
+#define TUNE_SAMPLE_RATE	44100.f
+
+// seconds of audio processed per round when --rt-budget calibrates a lambda and quality, and the
+// lambda it uses if none is given with -L (kDiracLambda3, the best general purpose option)
+#define RT_BUDGET_SECONDS	1.0
+#define RT_BUDGET_LAMBDA	3
+#define RT_BUDGET_STEPS		4
+
+// a job with --checkpoint keeps its checkpoint next to its first output file, named like it with this appended
+#define CHECKPOINT_SUFFIX	".checkpoint"
+
+// default memory in MB that Dirac instances may use, busy and idle, before idle ones are destroyed
+#define DEFAULT_POOL_MEMORY	256
+
+// connections the daemon lets wait for a worker, and seconds a client may stay silent before it is dropped
+#define DAEMON_BACKLOG			64
+#define DAEMON_CLIENT_TIMEOUT	60
+
+// default seconds between the progress lines of a job with --stats
+#define DEFAULT_STATS_INTERVAL	1.0
+
+// time, pitch and formant factors above this are refused, as are lambdas and qualities out of range
+#define MAX_FACTOR			100.
+
+// most channels a shared memory job sent to the daemon may have
+#define MAX_PCM_CHANNELS	64
+
+// default bits per sample of the AIFF files shared memory jobs are written to
+#define DEFAULT_PCM_BITS	24
+
 #ifdef WIN32
 	#define strtold strtod
 #endif
@@ -34,14 +114,84 @@
 // you will want to replace this by a pointer to "this" in order to access your instance methods
 // and variables
 typedef struct {
-	unsigned long sReadPosition, sMaxFrames;
+	unsigned long long sReadPosition, sMaxFrames;
+	unsigned long long sEndPosition;	/* reads from here on report the end of the file */
 	long sTotalNumChannels, sNumFiles;
 	long *sInFileNumChannels;
-	char **sInFileNames;
+	mAiffPrefetch **sInFiles;
 	char **sOutFileNames;
+	double sReadSeconds;				/* time spent reading since the last linkGroupsCollectStats() */
+	unsigned long long sFramesRead;		/* input frames read since then, padding not counted */
+	PhaseTimer *sTimer;					/* the job's timer, NULL = not timed */
 } userDataStruct;
 
 
+// Processing settings from the command line, shared by all jobs
+typedef struct {
+	long double sTime, sPitch, sFormant;
+	int sLambda, sQuality;
+	long sQueueDepth, sReadAhead;
+	long sNumSegments;					/* number of segments each job is split into, 1 = serial */
+	long sNumThreads;					/* threads for jobs or segments, 0 = number of CPUs */
+	double sRtBudget;					/* realtime factor every job has to reach, 0 = use -L and -Q as given */
+	double sCheckpointSeconds;			/* wall clock time between checkpoints, 0 = none */
+	DiracPool *sPool;					/* where the jobs get their Dirac instances from */
+	JobStatsReporter *sStats;			/* where the jobs report progress and performance, NULL = none */
+	bool sVerbose;						/* print progress and statistics, only done with a single job */
+	int sPcmWordlength;					/* bits per sample of the output files of shared memory jobs */
+} settingsStruct;
+
+
+// One group of input files that are processed together and written in step. Unless link groups
+// are given with braces all files are processed phase locked in a single Dirac instance
+typedef struct {
+	char **sInFileNames;
+	char **sOutFileNames;				/* output file per input file, NULL = "processed-" next to the input */
+	int sNumFiles;
+	bool sStartsGroup[MAX_NUM_FILES];	/* file starts a new link group */
+	bool sHasGroups;					/* link groups were given with braces */
+	bool sInGroup, sNewGroup;			/* a brace is open / the next file starts a group, see addFileName() */
+	int sResult;						/* 0 if the job succeeded */
+	double sSeconds;					/* wall clock time the job took */
+	PhaseTimer *sTimer;					/* times reading, DSP and writing of the job on all its threads, NULL = not timed */
+	PhaseTimes sTimes;					/* what sTimer measured, filled in by runBatchJob() */
+} jobStruct;
+
+
+// Files of a job whose channels are processed phase locked, by their own Dirac instance
+typedef struct {
+	int sFirstFile, sNumFiles;
+	long sFirstChannel, sNumChannels;	/* where the group's channels are in the job's audio buffer */
+	userDataStruct sState;
+	void *sDirac;
+	DiracFeed *sFeed;					/* hands sDirac our input in whole input buffers */
+	long sNumProcessed;					/* what the last call to DiracProcess() returned */
+	unsigned long sReadStart;			/* input frame we started reading at */
+	volatile unsigned long sBeganPosition;	/* input frame Dirac last began processing at */
+	double sProcessSeconds;				/* time spent in DiracProcess() since the last linkGroupsCollectStats() */
+	float sPeakCpu;						/* highest DiracPeakCpuUsagePercent() since then */
+} linkGroupStruct;
+
+
+// One call to DiracProcess() for every link group, made by a gang of threads
+typedef struct {
+	linkGroupStruct *sGroups;
+	float **sAudio;
+	long sNumFrames;
+} groupBlockStruct;
+
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns a monotonic wall clock time in seconds, used to time the jobs and what they spend their time on
+ */
+static double wallClockSeconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 /*
  This is the callback function that supplies data from the input stream/file(s) whenever needed.
@@ -60,12 +210,28 @@ long myReadData(float **chdata, long numFrames, void *userData)
 	userDataStruct *state = (userDataStruct*)userData;
 	if (!state)	return 0;
 	
-	long channel = 0;
-	for (long v = 0; v < state->sNumFiles; v++) {
-		mAiffReadData(state->sInFileNames[v], chdata+channel, state->sReadPosition, numFrames, state->sInFileNumChannels[v]);
-		channel += state->sInFileNumChannels[v];
+	// Reads up to sEndPosition are zero padded past the end of the input. After that there is
+	// nothing left, not even silence
+	if (state->sReadPosition >= state->sEndPosition) {
+		for (long c = 0; c < state->sTotalNumChannels; c++)
+			memset(chdata[c], 0, numFrames*sizeof(float));
+		return 0;
+	}
+	
+	double start = wallClockSeconds();
+	{
+		// we are called from within DiracProcess(), this pauses its DSP scope
+		PhaseScope read(state->sTimer, kPhaseRead);
+		long channel = 0;
+		for (long v = 0; v < state->sNumFiles; v++) {
+			mAiffPrefetchRead(state->sInFiles[v], chdata+channel, numFrames);
+			channel += state->sInFileNumChannels[v];
+		}
 	}
+	state->sReadSeconds += wallClockSeconds() - start;
 	
+	if (state->sReadPosition < state->sMaxFrames)
+		state->sFramesRead += state->sMaxFrames - state->sReadPosition < (unsigned long long)numFrames ? state->sMaxFrames - state->sReadPosition : numFrames;
 	state->sReadPosition += numFrames;
 	
 	return res;	
@@ -74,13 +240,413 @@ long myReadData(float **chdata, long numFrames, void *userData)
 
 
 
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Called by Dirac whenever it begins processing at a new input position, which it counts from
+ where the link group started reading. A checkpoint records the latest one
+ */
+static void myProcessingBegan(unsigned long position, void *userData)
+{
+	linkGroupStruct *group = (linkGroupStruct*)userData;
+	group->sBeganPosition = group->sReadStart + position;
+}
+
+
+
+#pragma mark ---- Link groups ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Adds an input file to a job. A name starting with { opens a link group and a name ending with }
+ closes it, braces can also be given on their own. Files outside of braces are a group of their
+ own, but if no braces are used at all every file of the job is linked, just like before link
+ groups existed. Returns false if the job is full
+ */
+static bool addFileName(jobStruct *job, char *name)
+{
+	bool opens = (name[0] == '{');
+	if (opens)
+		name++;
+	long length = strlen(name);
+	bool closes = (length > 0 && name[length-1] == '}');
+	if (closes)
+		name[--length] = 0;
+	if (opens || closes)
+		job->sHasGroups = true;
+	if (opens)
+		job->sInGroup = job->sNewGroup = true;
+	
+	if (length) {
+		if (job->sNumFiles >= MAX_NUM_FILES)
+			return false;
+		job->sStartsGroup[job->sNumFiles] = job->sNewGroup || !job->sInGroup;
+		job->sInFileNames[job->sNumFiles++] = name;
+		job->sNewGroup = false;
+	}
+	if (closes)
+		job->sInGroup = false;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Splits the files of a job into link groups and returns their number
+ */
+static int getLinkGroups(jobStruct *job, long *fileChannelCounts, linkGroupStruct *groups)
+{
+	int numGroups = 0;
+	long channel = 0;
+	for (int v = 0; v < job->sNumFiles; v++) {
+		if (v == 0 || (job->sHasGroups && job->sStartsGroup[v])) {
+			linkGroupStruct *group = groups + numGroups++;
+			memset(group, 0, sizeof(linkGroupStruct));
+			group->sFirstFile = v;
+			group->sFirstChannel = channel;
+		}
+		groups[numGroups-1].sNumFiles++;
+		groups[numGroups-1].sNumChannels += fileChannelCounts[v];
+		channel += fileChannelCounts[v];
+	}
+	return numGroups;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Creates a Dirac instance for every link group that reads from inPrefetch, starting at readPosition.
+ Nothing is read before the first call to DiracProcess(), so the prefetchers may be started later,
+ sized with linkGroupsReadAhead(). Reading and processing are timed with timer unless it is NULL.
+ Returns false if an instance could not be created
+ */
+static bool createLinkGroupInstances(linkGroupStruct *groups, int numGroups, settingsStruct *settings, float sr, 
+									 mAiffPrefetch **inPrefetch, long *fileChannelCounts, unsigned long readPosition, unsigned long maxFrames,
+									 PhaseTimer *timer)
+{
+	for (int g = 0; g < numGroups; g++) {
+		linkGroupStruct *group = groups+g;
+		
+		// We stuff all our programs' state variables that we need to access in order to read from the file in a struct
+		// You will normally pass your instance pointer "this" as userData, but since this is not a class we cannot do this here
+		userDataStruct *state = &group->sState;
+		state->sTotalNumChannels	= group->sNumChannels;
+		state->sReadPosition		= readPosition;
+		state->sMaxFrames			= maxFrames;
+		state->sEndPosition			= maxFrames + (unsigned long long)(END_PADDING_SECONDS * sr);
+		state->sInFiles				= inPrefetch + group->sFirstFile;
+		state->sInFileNumChannels	= fileChannelCounts + group->sFirstFile;
+		state->sOutFileNames		= NULL;
+		state->sNumFiles			= group->sNumFiles;
+		state->sTimer				= timer;
+		
+		// Dirac reads through a feed, which calls myReadData() with whole input buffers only, most
+		// of the time straight into Dirac's own buffer
+		group->sFeed = dfCreate(group->sNumChannels, &myReadData, (void*)state);
+		if (!group->sFeed)
+			return false;
+		group->sDirac = dpAcquire(settings->sPool, kDiracLambdaPreview+settings->sLambda, kDiracQualityPreview+settings->sQuality, group->sNumChannels, sr, &dfReadData, (void*)group->sFeed);
+		if (!group->sDirac)
+			return false;
+		
+		// Pass the values to our DIRAC instance 	
+		DiracSetProperty(kDiracPropertyTimeFactor, settings->sTime, group->sDirac);
+		DiracSetProperty(kDiracPropertyPitchFactor, settings->sPitch, group->sDirac);
+		DiracSetProperty(kDiracPropertyFormantFactor, settings->sFormant, group->sDirac);
+		
+		// the input buffer size depends on the time factor
+		if (dfAttach(group->sFeed, group->sDirac) < 0)
+			return false;
+		
+		group->sReadStart = group->sBeganPosition = readPosition;
+		DiracSetProcessingBeganCallback(&myProcessingBegan, (void*)group, group->sDirac);
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the Dirac instances of all link groups to the pool
+ */
+static void destroyLinkGroupInstances(linkGroupStruct *groups, int numGroups, settingsStruct *settings)
+{
+	for (int g = 0; g < numGroups; g++) {
+		// the group goes away, the instance stays in the pool
+		if (groups[g].sDirac) {
+			DiracSetProcessingBeganCallback(NULL, NULL, groups[g].sDirac);
+			dpRelease(settings->sPool, groups[g].sDirac);
+		}
+		groups[g].sDirac = NULL;
+		dfDestroy(groups[g].sFeed);
+		groups[g].sFeed = NULL;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Processes one block of link group number group into its channels of the job's audio buffer
+ */
+static void processGroupBlock(long group, void *userData)
+{
+	groupBlockStruct *block = (groupBlockStruct*)userData;
+	linkGroupStruct *g = block->sGroups + group;
+	double start = wallClockSeconds();
+	{
+		PhaseScope dsp(g->sState.sTimer, kPhaseDsp);
+		g->sNumProcessed = DiracProcess(block->sAudio + g->sFirstChannel, block->sNumFrames, g->sDirac);
+	}
+	g->sProcessSeconds += wallClockSeconds() - start;
+	float peak = DiracPeakCpuUsagePercent(g->sDirac);
+	if (peak > g->sPeakCpu)
+		g->sPeakCpu = peak;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the number of frames the last block holds in all link groups. Less than asked for if
+ one of them has run out of input, which only happens if Dirac reads further ahead than we pad
+ */
+static long linkGroupsNumProcessed(linkGroupStruct *groups, int numGroups, long numFrames)
+{
+	for (int g = 0; g < numGroups; g++) {
+		if (groups[g].sNumProcessed < numFrames)
+			numFrames = groups[g].sNumProcessed > 0 ? groups[g].sNumProcessed : 0;
+	}
+	return numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the input frame all link groups have begun processing at
+ */
+static unsigned long linkGroupsBeganPosition(linkGroupStruct *groups, int numGroups)
+{
+	unsigned long position = groups[0].sBeganPosition;
+	for (int g = 1; g < numGroups; g++) {
+		if (groups[g].sBeganPosition < position)
+			position = groups[g].sBeganPosition;
+	}
+	return position;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Sums up what the link groups did since the last call for the job's statistics and starts counting
+ again. The input frames are those of the first group, the others read the same frames of other files
+ */
+static void linkGroupsCollectStats(linkGroupStruct *groups, int numGroups, JobStatsValues *values)
+{
+	memset(values, 0, sizeof(JobStatsValues));
+	values->sFramesIn = groups[0].sState.sFramesRead;
+	for (int g = 0; g < numGroups; g++) {
+		linkGroupStruct *group = groups+g;
+		
+		// Dirac reads from within DiracProcess(), waiting for input is not DSP time
+		values->sDspSeconds += group->sProcessSeconds - group->sState.sReadSeconds;
+		values->sInputWaitSeconds += group->sState.sReadSeconds;
+		if (group->sPeakCpu > values->sPeakCpuPercent)
+			values->sPeakCpuPercent = group->sPeakCpu;
+		group->sProcessSeconds = group->sState.sReadSeconds = 0.;
+		group->sState.sFramesRead = 0;
+		group->sPeakCpu = 0.f;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the number of channels of the widest link group
+ */
+static long linkGroupsMaxChannels(linkGroupStruct *groups, int numGroups)
+{
+	long numChannels = 0;
+	for (int g = 0; g < numGroups; g++) {
+		if (groups[g].sNumChannels > numChannels)
+			numChannels = groups[g].sNumChannels;
+	}
+	return numChannels;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the number of frames per DiracProcess() call from the block size profile. The widest link
+ group is the one that costs the most, so its channel count decides
+ */
+static long linkGroupsBlockSize(linkGroupStruct *groups, int numGroups, settingsStruct *settings)
+{
+	long numChannels = linkGroupsMaxChannels(groups, numGroups);
+	long blockSize = bpGetBlockSize(kDiracLambdaPreview+settings->sLambda, kDiracQualityPreview+settings->sQuality, numChannels, DEFAULT_BLOCK_SIZE);
+	
+	// All groups share sample rate and time factor, so their input buffers are the same size.
+	// Whole input buffers per call mean every call does whole steps of work
+	return dfAlignOutput(groups[0].sFeed, blockSize);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the ring and chunk size for the prefetchers of a job, rounded to whole input buffers of
+ its Dirac instances. With the ring a whole number of chunks and the chunks a whole number of input
+ buffers, neither decoding nor reading ever has to split at the end of the ring
+ */
+static void linkGroupsReadAhead(linkGroupStruct *groups, long readAhead, long *ringFrames, long *chunkFrames)
+{
+	long chunk = dfAlignInput(groups[0].sFeed, READ_AHEAD_CHUNK);
+	*chunkFrames = chunk;
+	*ringFrames = ((readAhead + chunk - 1) / chunk) * chunk;
+}
+
+
+
+#pragma mark ---- Realtime budget ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Fills in the lambdas and qualities --rt-budget chooses from, fastest first and best last, and
+ returns their number. Above the fastest setting the lambda from the command line is used
+ */
+static int rtBudgetSteps(settingsStruct *settings, int *lambdas, int *qualities)
+{
+	lambdas[0] = 0;
+	qualities[0] = 0;
+	for (int s = 1; s < RT_BUDGET_STEPS; s++) {
+		lambdas[s] = settings->sLambda;
+		qualities[s] = s;
+	}
+	return RT_BUDGET_STEPS;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Measures every lambda and quality of the budget with numChannels channels that the block size
+ profile has no measurement for yet. Returns the number of measurements, or -1 on error
+ */
+static int calibrateRtBudget(settingsStruct *settings, long numChannels)
+{
+	int lambdas[RT_BUDGET_STEPS], qualities[RT_BUDGET_STEPS];
+	int numSteps = rtBudgetSteps(settings, lambdas, qualities);
+	int measured = 0;
+	for (int s = 0; s < numSteps; s++) {
+		long lambda = kDiracLambdaPreview+lambdas[s], quality = kDiracQualityPreview+qualities[s];
+		if (bpGetPerformance(lambda, quality, numChannels, NULL, NULL) == 0)
+			continue;
+		printf("Calibrating lambda %d quality %d with %ld channels\n", lambdas[s], qualities[s], numChannels);
+		fflush(stdout);
+		long blockSize = bpGetBlockSize(lambda, quality, numChannels, DEFAULT_BLOCK_SIZE);
+		if (bpTune(lambda, quality, numChannels, TUNE_SAMPLE_RATE, &blockSize, 1, RT_BUDGET_SECONDS, NULL) < 0) {
+			printf("!!! Could not create a DIRAC instance with %ld channels\n", numChannels);
+			return -1;
+		}
+		measured++;
+	}
+	return measured;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the realtime factor (seconds of input per second of processing) that a job with
+ numChannels channels at sampleRate is estimated to reach with lambda and quality, going by
+ the average throughput or the slowest call, whichever is worse. Returns 0 if not measured.
+ Dirac's cost is taken to be proportional to the number of output frames
+ */
+static double rtBudgetFactor(long lambda, long quality, long numChannels, float sampleRate, long double time)
+{
+	double framesPerSecond;
+	float peakCpuPercent;
+	if (bpGetPerformance(lambda, quality, numChannels, &framesPerSecond, &peakCpuPercent) != 0)
+		return 0.;
+	double outFramesPerSecond = (double)sampleRate * (double)time;
+	double factor = framesPerSecond / outFramesPerSecond;
+	
+	// at 100% peak CPU the slowest call took as long as the audio it produced plays
+	if (peakCpuPercent > 0.f) {
+		double peakFactor = 100. * TUNE_SAMPLE_RATE / (peakCpuPercent * outFramesPerSecond);
+		if (peakFactor < factor)
+			factor = peakFactor;
+	}
+	return factor;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Sets the lambda and quality in settings to the best ones that still reach the realtime budget
+ for a job with numChannels channels at sampleRate, or to the fastest ones if none does. Returns
+ the estimated realtime factor, less than the budget if it cannot be met
+ */
+static double applyRtBudget(settingsStruct *settings, long numChannels, float sampleRate)
+{
+	int lambdas[RT_BUDGET_STEPS], qualities[RT_BUDGET_STEPS];
+	int numSteps = rtBudgetSteps(settings, lambdas, qualities);
+	int chosen = 0;
+	double chosenFactor = 0.;
+	for (int s = 0; s < numSteps; s++) {
+		double factor = rtBudgetFactor(kDiracLambdaPreview+lambdas[s], kDiracQualityPreview+qualities[s], numChannels, sampleRate, settings->sTime);
+		if (s == 0 || factor >= settings->sRtBudget) {
+			chosen = s;
+			chosenFactor = factor;
+		}
+	}
+	settings->sLambda = lambdas[chosen];
+	settings->sQuality = qualities[chosen];
+	return chosenFactor;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads the headers of a job's files and returns the number of channels of its widest link group,
+ or 0 if a file is not valid
+ */
+static long jobMaxChannels(jobStruct *job)
+{
+	mAiffInfo inFileInfo[MAX_NUM_FILES];
+	long fileChannelCounts[MAX_NUM_FILES];
+	linkGroupStruct groups[MAX_NUM_FILES];
+	
+	mAiffProbeFiles(job->sInFileNames, job->sNumFiles, inFileInfo, PROBE_THREADS);
+	for (int v = 0; v < job->sNumFiles; v++) {
+		if (inFileInfo[v].sSampleRate <= 0.)
+			return 0;
+		fileChannelCounts[v] = inFileInfo[v].sNumChannels;
+	}
+	int numGroups = getLinkGroups(job, fileChannelCounts, groups);
+	return linkGroupsMaxChannels(groups, numGroups);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Makes sure the block size profile has measurements of the budget's lambdas and qualities for
+ the channel counts of all jobs, measuring what is missing before any job starts and saving it
+ for the next run. Returns false if a measurement failed
+ */
+static bool prepareRtBudget(settingsStruct *settings, jobStruct *jobs, long numJobs)
+{
+	long *channelCounts = new long[numJobs];
+	long numChannelCounts = 0, j;
+	int measured = 0;
+	
+	for (j = 0; j < numJobs; j++) {
+		long numChannels = jobMaxChannels(jobs+j);
+		long c = 0;
+		while (c < numChannelCounts && channelCounts[c] != numChannels)
+			c++;
+		if (numChannels > 0 && c == numChannelCounts)
+			channelCounts[numChannelCounts++] = numChannels;
+	}
+	for (j = 0; j < numChannelCounts && measured >= 0; j++) {
+		int m = calibrateRtBudget(settings, channelCounts[j]);
+		measured = m < 0 ? -1 : measured + m;
+	}
+	delete[] channelCounts;
+	
+	if (measured > 0 && bpSave(NULL) != 0)
+		printf("!!! Could not write the block size profile, calibrating again next time\n");
+	return measured >= 0;
+}
+
+
+
 #pragma mark ---- Main program ----
 
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 /*
  Creates an output path from a given input path using the specified file name prefix
  */
-char *createOutputFilePath(char *inPath, char *prefix)
+char *createOutputFilePath(char *inPath, const char *prefix)
 {
 	char *pathToDirectory = NULL;
 	char *fileName = NULL;
@@ -128,6 +694,40 @@ char *createOutputFilePath(char *inPath, char *prefix)
 	return outFilePath;
 }
 
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Stops the statistics reporter and closes its file, unless that is stdout
+ */
+static void closeStats(settingsStruct *settings, FILE *file)
+{
+	jsReporterDestroy(settings->sStats);
+	settings->sStats = NULL;
+	if (file && file != stdout)
+		fclose(file);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns NULL if Dirac can process with settings, else what is wrong with them
+ */
+static const char *checkSettings(const settingsStruct *settings)
+{
+	if (settings->sLambda < 0 || settings->sLambda > kDiracLambdaTranscribe-kDiracLambdaPreview)
+		return "Lambda must be 0 to 6";
+	if (settings->sQuality < 0 || settings->sQuality > kDiracQualityBest-kDiracQualityPreview)
+		return "Quality must be 0 to 3";
+	// the negations are true for NaN as well
+	if (!(settings->sTime > 0. && settings->sTime <= MAX_FACTOR))
+		return "Time must be above 0 and at most 100";
+	if (!(settings->sPitch > 0. && settings->sPitch <= MAX_FACTOR))
+		return "Pitch must be above 0 and at most 100";
+	if (!(settings->sFormant > 0. && settings->sFormant <= MAX_FACTOR))
+		return "Formant must be above 0 and at most 100";
+	if (settings->sPcmWordlength != 16 && settings->sPcmWordlength != 24 && settings->sPcmWordlength != 32)
+		return "Pcm bits must be 16, 24 or 32";
+	return NULL;
+}
+
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 /*
  Prints usage and CLI parameters to stdout.
@@ -135,86 +735,2062 @@ char *createOutputFilePath(char *inPath, char *prefix)
 
 void usage(char *s)
 {
-	printf("%s -{options} -f <infile> {<infile2> <infile3> ...}\n",s);
-	printf(" <infile> must be in AIFF format\n\n");
+	printf("%s -{options} -f <infile> {<infile2> <infile3> ...} {-f <infile> ...}\n",s);
+	printf("%s -{options} -i <stream> {-o <stream>}\n",s);
+	printf(" <infile> must be in AIFF format, <stream> is WAV or raw PCM on a pipe or file\n\n");
 	printf(" options\n");
 	printf("   -L     <int>          : Lambda value (0-6). This sets Dirac's lambda parameter\n");
 	printf("                           default=0 (preview)\n");
 	printf("   -Q     <int>          : Quality (0-3), with higher values being slower and better\n");
 	printf("                           default=0 (preview)\n");
-	printf("   -T     <long double>  : Time stretch factor\n");
+	printf("   -T     <long double>  : Time stretch factor (above 0, at most 100)\n");
 	printf("                           default=1.0 (no change)\n");
-	printf("   -P     <long double>  : Pitch shift factor\n");
+	printf("   -P     <long double>  : Pitch shift factor (above 0, at most 100)\n");
 	printf("                           default=1.0 (no change)\n");
-	printf("   -F     <long double>  : Formant shift factor\n");
+	printf("   -F     <long double>  : Formant shift factor (above 0, at most 100)\n");
 	printf("                           default=1.0 (no change)\n");
-	printf("   -f     <string>       : Path to input file(s),\n");
+	printf("   -W     <int>          : Number of processed blocks that can wait to be written\n");
+	printf("                           default=%d\n", DEFAULT_QUEUE_DEPTH);
+	printf("   -R     <int>          : Number of frames read ahead of processing per input file\n");
+	printf("                           default=%d\n", DEFAULT_READ_AHEAD);
+	printf("   -f     <string>       : Path to input file(s), processed phase locked. Each -f starts\n");
+	printf("                           a new group of files, groups are processed independently\n");
+	printf("                           Files in braces, as in -f {L R} {C} {LFE} {Ls Rs}, are\n");
+	printf("                           linked only to each other, each link group is processed\n");
+	printf("                           on its own thread\n");
+	printf("   --batch <string>      : Path to a list of groups to process, one group per line with\n");
+	printf("                           the files of a group separated by tabs\n");
+	printf("   --jobs <int>          : Number of groups or segments processed at the same time\n");
+	printf("                           default=0 (number of CPUs available to the process)\n");
+	printf("   --pool-memory <int>   : Megabytes Dirac instances may use before idle ones that\n");
+	printf("                           are kept for reuse are destroyed, 0 = don't keep any\n");
+	printf("                           default=%d\n", DEFAULT_POOL_MEMORY);
+	printf("   --rt-budget <float>   : Use the best quality that still processes this many times\n");
+	printf("                           faster than realtime on this machine, with the lambda from\n");
+	printf("                           -L (default 3). Measured once and kept in the profile\n");
+	printf("   --tune <int>          : Measure which number of frames per call processes fastest\n");
+	printf("                           for 1 to <int> channels with the given -L and -Q on this\n");
+	printf("                           machine and save it to the block size profile\n");
+	printf("   --segments <int>      : Split a single group into this many segments that are\n");
+	printf("                           processed in parallel and crossfaded back together\n");
+	printf("                           default=1 (no split), 0 = one per CPU\n");
+	printf("   --checkpoint <float>  : Save how far each group got every this many seconds, so\n");
+	printf("                           an interrupted run started again with the same options\n");
+	printf("                           picks up there. Not with --segments\n");
+	printf("   --stats <string>      : Write progress and performance of every group as JSON lines\n");
+	printf("                           to this file instead of printing progress, - = stdout\n");
+	printf("   --stats-every <float> : Seconds between progress lines, 0 = only when a group is\n");
+	printf("                           done. default=%.1f\n", DEFAULT_STATS_INTERVAL);
+	printf("   --daemon <string>     : Listen for jobs on this Unix domain socket instead of\n");
+	printf("                           processing files, see DiracClient. The options above\n");
+	printf("                           are the defaults for every job, --jobs sets the number\n");
+	printf("                           of clients served at the same time\n");
+	printf("   --pcm-bits <int>      : Bits per sample (16, 24 or 32) of the AIFF files that\n");
+	printf("                           shared memory jobs of the daemon write. default=%d\n", DEFAULT_PCM_BITS);
+	printf("   -i     <string>       : Read interleaved PCM from this pipe or file instead of AIFF\n");
+	printf("                           files, - = stdin. WAV, RF64 or Wave64 unless --raw is given\n");
+	printf("   -o     <string>       : Where the output of -i goes, - = stdout (the default), in\n");
+	printf("                           the format of the input. Messages go to stderr then\n");
+	printf("   --raw <string>        : The input of -i is raw s16, s24, s32 or f32 little endian\n");
+	printf("   --channels <int>      : Number of channels of raw input, default=2\n");
+	printf("   --rate <float>        : Sample rate of raw input, default=44100\n");
+	printf("   --out-format <string> : wav, rf64, w64 or raw, the output of -i regardless of the\n");
+	printf("                           input. wav written to a file turns into rf64 past 4 GB\n");
 	printf("\n");
 	printf("   -h                    : print this message.\n\n");
 	exit(1);
 }
 
+#pragma mark ---- Segment mode ----
+
+
+// One piece of a long file, rendered by its own Dirac instance. Output frames are counted from
+// the start of the output file
+typedef struct {
+	unsigned long sReadStart;			/* first input frame we read, preroll included */
+	unsigned long sOutStart, sOutEnd;	/* output frames we render, crossfades included */
+	float **sHead, **sTail;				/* crossfade regions, mixed with our neighbours' when all segments are done */
+	int sResult;						/* 0 if the segment rendered and wrote fine */
+} segmentStruct;
+
+
+// Everything the segments of a job share
+typedef struct {
+	jobStruct *sJob;
+	settingsStruct *sSettings;
+	mAiffInfo *sInFileInfo;
+	long *sFileChannelCounts;
+	long sNumChannels;
+	unsigned long sMaxFrames;
+	mAiffWriter **sOutFiles;
+	segmentStruct *sSegments;
+	long sNumSegments;
+	unsigned long sCrossfadeFrames;
+	volatile long sNumDone;
+	JobStats *sStats;					/* the job's statistics, NULL = none */
+} segmentRenderStruct;
+
+
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Copies the frames of block (which holds output frames blockStart...blockEnd-1) that fall into
+ dstStart...dstEnd-1 to dst, which holds the frames from dstStart on
+ */
+static void copyOverlap(float **dst, unsigned long dstStart, unsigned long dstEnd, float **block, unsigned long blockStart, unsigned long blockEnd, long numChannels)
+{
+	unsigned long from = blockStart > dstStart ? blockStart : dstStart;
+	unsigned long to = blockEnd < dstEnd ? blockEnd : dstEnd;
+	if (from >= to)	return;
+	for (long c = 0; c < numChannels; c++)
+		memcpy(dst[c] + (from-dstStart), block[c] + (from-blockStart), (to-from)*sizeof(float));
+}
 
-int main (int argc, char **argv)
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Gains of frame i of an equal-power crossfade over numFrames frames
+ */
+static void equalPowerGains(unsigned long i, unsigned long numFrames, float *fadeOut, float *fadeIn)
 {
+	double phase = 0.5 * M_PI * ((double)i + 0.5) / (double)numFrames;
+	*fadeOut = (float)cos(phase);
+	*fadeIn = (float)sin(phase);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes numFrames frames of all channels of audio to the output files at output frame position
+ */
+static int writeFramesAt(segmentRenderStruct *render, float **audio, unsigned long position, long numFrames)
+{
+	PhaseScope write(render->sJob->sTimer, kPhaseWrite);
+	long channel = 0;
+	for (long v = 0; v < render->sJob->sNumFiles; v++) {
+		if (mAiffWriteFramesAt(render->sOutFiles[v], position, audio+channel, numFrames, render->sFileChannelCounts[v]) != numFrames)
+			return -5;
+		channel += render->sFileChannelCounts[v];
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Renders segment number index of a job on one of the pool's threads. Just like the region example
+ we start reading at the segment's read position, then throw away output until Dirac has settled
+ and we have arrived at the segment's first output frame. The middle of the segment goes straight
+ to the output files, the crossfade regions at either end are kept for later
+ */
+static void renderSegment(long index, void *userData)
+{
+	segmentRenderStruct *render = (segmentRenderStruct*)userData;
+	segmentStruct *segment = render->sSegments + index;
+	settingsStruct *settings = render->sSettings;
+	int numFiles = render->sJob->sNumFiles;
+	char **inFileNames = render->sJob->sInFileNames;
+	long numChannels = render->sNumChannels;
+	mAiffFile *inFiles[MAX_NUM_FILES];
+	mAiffPrefetch *inPrefetch[MAX_NUM_FILES];
+	linkGroupStruct groups[MAX_NUM_FILES];
+	int numGroups = getLinkGroups(render->sJob, render->sFileChannelCounts, groups);
+	float **audio = NULL;
+	float **block = new float*[numChannels];
+	int v;
 	
-	int numFiles = 0;
-	int numChannels = 0, v;
-	char *inFileNames[MAX_NUM_FILES];
-	char *outFileNames[MAX_NUM_FILES];
-	long fileChannelCounts[MAX_NUM_FILES];
-	unsigned long maxFrames = 0;
-	
-	/* options */
-	if(argc<2) {
-	    usage(argv[0]);
+	for ( v = 0; v < numFiles; v++) {
+		inFiles[v] = NULL;
+		inPrefetch[v] = NULL;
 	}
+	segment->sResult = -1;
 	
-	long double time = 1., pitch = 1., formant = 1.;
-	int lambda = 0;
-	int quality = 0;
+	{
+		if (!createLinkGroupInstances(groups, numGroups, settings, render->sInFileInfo[0].sSampleRate, inPrefetch, 
+									  render->sFileChannelCounts, segment->sReadStart, render->sMaxFrames, render->sJob->sTimer)) {
+			printf("!! ERROR !!\n\n\tCould not create DIRAC instance for %s\n\tCheck number of channels and sample rate!\n", inFileNames[0]);
+			goto done;
+		}
+		
+		// Every segment reads the input files on its own, starting at its read position
+		long ringFrames, chunkFrames;
+		linkGroupsReadAhead(groups, settings->sReadAhead, &ringFrames, &chunkFrames);
+		for ( v = 0; v < numFiles; v++) {
+			inFiles[v] = mAiffOpenMapped(inFileNames[v]);
+			if (!inFiles[v] || mAiffSeek(inFiles[v], segment->sReadStart) != 0) {
+				printf("!!! Could not open %s\n", inFileNames[v]);
+				goto done;
+			}
+			inPrefetch[v] = mAiffPrefetchCreate(inFiles[v], render->sFileChannelCounts[v], ringFrames, chunkFrames);
+			if (!inPrefetch[v]) {
+				printf("!!! Could not start reading %s\n", inFileNames[v]);
+				goto done;
+			}
+		}
+		
+		long numFramesPerCall = linkGroupsBlockSize(groups, numGroups, settings);
+		audio = mAiffAllocateAudioBuffer(numChannels, numFramesPerCall);
+		
+		// the segments keep the threads busy, so the link groups are processed one after the other here
+		groupBlockStruct groupBlock;
+		groupBlock.sGroups		= groups;
+		groupBlock.sAudio		= audio;
+		groupBlock.sNumFrames	= numFramesPerCall;
+		
+		// The first and last segment have no neighbour to crossfade with on the outside
+		unsigned long headEnd = index > 0 ? segment->sOutStart + render->sCrossfadeFrames : segment->sOutStart;
+		unsigned long tailStart = index < render->sNumSegments-1 ? segment->sOutEnd - render->sCrossfadeFrames : segment->sOutEnd;
+		
+		// output frame that corresponds to the first input frame we read
+		unsigned long position = (unsigned long)((long double)segment->sReadStart * settings->sTime + 0.5);
+		
+		int writeError = 0;
+		while (position < segment->sOutEnd && !writeError) {
+			long numFrames = numFramesPerCall;
+			if ((unsigned long)numFrames > segment->sOutEnd - position)
+				numFrames = segment->sOutEnd - position;
+			groupBlock.sNumFrames = numFrames;
+			for (int g = 0; g < numGroups; g++)
+				processGroupBlock(g, &groupBlock);
+			if (linkGroupsNumProcessed(groups, numGroups, numFrames) < numFrames) {
+				printf("!!! %s ended before segment %ld was done\n", inFileNames[0], index+1);
+				writeError = -1;
+				break;
+			}
+			unsigned long blockEnd = position + numFrames;
+			
+			copyOverlap(segment->sHead, segment->sOutStart, headEnd, audio, position, blockEnd, numChannels);
+			copyOverlap(segment->sTail, tailStart, segment->sOutEnd, audio, position, blockEnd, numChannels);
+			
+			unsigned long from = position > headEnd ? position : headEnd;
+			unsigned long to = blockEnd < tailStart ? blockEnd : tailStart;
+			double writeStart = wallClockSeconds();
+			if (from < to) {
+				for (long c = 0; c < numChannels; c++)
+					block[c] = audio[c] + (from-position);
+				writeError = writeFramesAt(render, block, from, to-from);
+			}
+			position = blockEnd;
+			
+			// the crossfades are counted when they are written, after all segments are done
+			if (render->sStats) {
+				JobStatsValues values;
+				linkGroupsCollectStats(groups, numGroups, &values);
+				values.sFramesOut = from < to ? to-from : 0;
+				values.sOutputWaitSeconds = wallClockSeconds() - writeStart;
+				jsAdd(render->sStats, &values);
+			}
+		}
+		if (writeError == -5)
+			printf("!!! Error writing output files for %s\n", inFileNames[0]);
+		segment->sResult = writeError;
+	}
 	
-	long i=1;
-	while(i<argc && argv[i][0]=='-'){
+done:
+	if (settings->sVerbose) {
+		long numDone = __sync_add_and_fetch(&render->sNumDone, 1);
+		printf("\tsegment %ld done (%ld of %ld)\n", index+1, numDone, render->sNumSegments);
+		fflush(stdout);
+	}
+	delete[] block;
+	if (audio)
+		mAiffDeallocateAudioBuffer(audio, numChannels);
+	destroyLinkGroupInstances(groups, numGroups, settings);
+	for ( v = 0; v < numFiles; v++) {
+		if (inPrefetch[v])
+			mAiffPrefetchDestroy(inPrefetch[v]);
+		if (inFiles[v])
+			mAiffClose(inFiles[v]);
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Renders a job in numSegments segments in parallel, each with its own Dirac instance, and splices
+ them with equal-power crossfades centered on the time scaled segment boundaries. The output files
+ must already be open. Progress goes to stats unless it is NULL. Returns 0 on success
+ */
+static int renderSegments(jobStruct *job, settingsStruct *settings, mAiffInfo *inFileInfo, long *fileChannelCounts, long numChannels, 
+						  unsigned long maxFrames, long numSegments, mAiffWriter **outFiles, JobStats *stats)
+{
+	long double time = settings->sTime;
+	float sr = inFileInfo[0].sSampleRate;
+	unsigned long outFrames = (unsigned long)((long double)maxFrames * time);
+	unsigned long crossfadeFrames = 2*(unsigned long)(0.5 * SEGMENT_CROSSFADE_SECONDS * sr);
+	unsigned long prerollFrames = (unsigned long)(SEGMENT_PREROLL_SECONDS * sr);
+	int result = 0;
+	long k;
+	
+	segmentStruct *segments = new segmentStruct[numSegments];
+	
+	// Segment k covers input frames k*maxFrames/numSegments and up. Its output starts half a
+	// crossfade ahead of the time scaled boundary and ends half a crossfade after the next one
+	for (k = 0; k < numSegments; k++) {
+		segmentStruct *segment = segments+k;
+		unsigned long inStart = (unsigned long)((long double)maxFrames * k / numSegments);
+		unsigned long inEnd = (unsigned long)((long double)maxFrames * (k+1) / numSegments);
+		unsigned long outStart = (unsigned long)((long double)inStart * time);
+		unsigned long outEnd = k < numSegments-1 ? (unsigned long)((long double)inEnd * time) : outFrames;
+		segment->sOutStart = k > 0 ? outStart - crossfadeFrames/2 : 0;
+		segment->sOutEnd = k < numSegments-1 ? outEnd + crossfadeFrames/2 : outFrames;
+		unsigned long firstInput = (unsigned long)((long double)segment->sOutStart / time);
+		segment->sReadStart = firstInput > prerollFrames ? firstInput - prerollFrames : 0;
+		segment->sHead = k > 0 ? mAiffAllocateAudioBuffer(numChannels, crossfadeFrames) : NULL;
+		segment->sTail = k < numSegments-1 ? mAiffAllocateAudioBuffer(numChannels, crossfadeFrames) : NULL;
+		segment->sResult = 0;
+	}
+	
+	segmentRenderStruct render;
+	render.sJob					= job;
+	render.sSettings			= settings;
+	render.sInFileInfo			= inFileInfo;
+	render.sFileChannelCounts	= fileChannelCounts;
+	render.sNumChannels			= numChannels;
+	render.sMaxFrames			= maxFrames;
+	render.sOutFiles			= outFiles;
+	render.sSegments			= segments;
+	render.sNumSegments			= numSegments;
+	render.sCrossfadeFrames		= crossfadeFrames;
+	render.sNumDone				= 0;
+	render.sStats				= stats;
+	
+	long numThreads = settings->sNumThreads > 0 ? settings->sNumThreads : jpAvailableCpus();
+	if (settings->sVerbose) {
+		printf("Running DIRAC version %s\n", DiracVersion());
+		printf("Rendering %ld segments on %ld threads (preroll %.2fs, crossfade %lu frames)\n", 
+			   numSegments, numThreads < numSegments ? numThreads : numSegments, SEGMENT_PREROLL_SECONDS, crossfadeFrames);
+		fflush(stdout);
+	}
+	jpRun(numSegments, numThreads, renderSegment, &render);
+	
+	for (k = 0; k < numSegments; k++) {
+		if (segments[k].sResult != 0)
+			result = segments[k].sResult;
+	}
+	
+	// Splice the segments: the tail of each segment fades out while the head of the next fades in
+	if (result == 0) {
+		float **mix = mAiffAllocateAudioBuffer(numChannels, crossfadeFrames);
+		for (k = 1; k < numSegments && result == 0; k++) {
+			for (unsigned long i = 0; i < crossfadeFrames; i++) {
+				float fadeOut, fadeIn;
+				equalPowerGains(i, crossfadeFrames, &fadeOut, &fadeIn);
+				for (long c = 0; c < numChannels; c++)
+					mix[c][i] = fadeOut*segments[k-1].sTail[c][i] + fadeIn*segments[k].sHead[c][i];
+			}
+			double writeStart = wallClockSeconds();
+			result = writeFramesAt(&render, mix, segments[k].sOutStart, crossfadeFrames);
+			if (stats && result == 0) {
+				JobStatsValues values;
+				memset(&values, 0, sizeof(values));
+				values.sFramesOut = crossfadeFrames;
+				values.sOutputWaitSeconds = wallClockSeconds() - writeStart;
+				jsAdd(stats, &values);
+			}
+		}
+		mAiffDeallocateAudioBuffer(mix, numChannels);
+		if (result != 0)
+			printf("!!! Error writing output files for %s\n", job->sInFileNames[0]);
+	}
+	
+	for (k = 0; k < numSegments; k++) {
+		if (segments[k].sHead)
+			mAiffDeallocateAudioBuffer(segments[k].sHead, numChannels);
+		if (segments[k].sTail)
+			mAiffDeallocateAudioBuffer(segments[k].sTail, numChannels);
+	}
+	delete[] segments;
+	return result;
+}
+
+
+#pragma mark ---- Checkpoints ----
+
+
+// Where an interrupted job picks up again, see --checkpoint
+typedef struct {
+	unsigned long sFramesFlushed;		/* output frames on disk in every output file */
+	unsigned long sInputPosition;		/* input frame Dirac last began processing at, see myProcessingBegan() */
+} checkpointStruct;
+
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Describes a job the way its checkpoint file starts: the parameters, the link groups and the
+ input files with their lengths and output files. A checkpoint is only used by a job that is
+ described the same way. Returns the text, free it with delete[]
+ */
+static char *describeCheckpointJob(jobStruct *job, settingsStruct *settings, mAiffInfo *inFileInfo, char **outFileNames, 
+								   linkGroupStruct *groups, int numGroups)
+{
+	size_t size = 512;
+	for (int v = 0; v < job->sNumFiles; v++)
+		size += strlen(job->sInFileNames[v]) + strlen(outFileNames[v]) + 64;
+	char *text = new char[size];
+	
+	size_t length = snprintf(text, size, "# DiracCLI checkpoint\nlambda %d\nquality %d\ntime %.21Lg\npitch %.21Lg\nformant %.21Lg\ngroups", 
+							 settings->sLambda, settings->sQuality, settings->sTime, settings->sPitch, settings->sFormant);
+	for (int g = 0; g < numGroups; g++)
+		length += snprintf(text+length, size-length, " %d", groups[g].sFirstFile);
+	length += snprintf(text+length, size-length, "\n");
+	for (int v = 0; v < job->sNumFiles; v++)
+		length += snprintf(text+length, size-length, "input %lu %s\noutput %s\n", inFileInfo[v].sNumFrames, job->sInFileNames[v], outFileNames[v]);
+	return text;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes the checkpoint of the job described by jobText to path. The file is written next to it
+ first and then renamed, so there always is a complete checkpoint. Returns 0 on success
+ */
+static int writeCheckpoint(char *path, char *jobText, checkpointStruct *checkpoint)
+{
+	char *tempPath = new char[strlen(path)+5];
+	sprintf(tempPath, "%s.tmp", path);
+	
+	FILE *f = fopen(tempPath, "w");
+	bool ok = (f != NULL);
+	if (f) {
+		ok = fprintf(f, "%sflushed %lu\nposition %lu\n", jobText, checkpoint->sFramesFlushed, checkpoint->sInputPosition) > 0;
+		ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+		ok = fclose(f) == 0 && ok;
+	}
+	if (ok)
+		ok = rename(tempPath, path) == 0;
+	if (!ok)
+		remove(tempPath);
+	delete[] tempPath;
+	return ok ? 0 : -1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads the checkpoint at path into checkpoint. Returns 1 if it belongs to the job described by
+ jobText, 0 if there is none and -1 if it belongs to a different job
+ */
+static int readCheckpoint(char *path, char *jobText, checkpointStruct *checkpoint)
+{
+	FILE *f = fopen(path, "r");
+	if (!f)	return 0;
+	
+	size_t jobLength = strlen(jobText);
+	char *text = new char[jobLength+256];
+	size_t length = fread(text, 1, jobLength+255, f);
+	fclose(f);
+	text[length] = 0;
+	
+	bool matches = (length > jobLength && memcmp(text, jobText, jobLength) == 0 && 
+					sscanf(text+jobLength, "flushed %lu position %lu", &checkpoint->sFramesFlushed, &checkpoint->sInputPosition) == 2);
+	delete[] text;
+	return matches ? 1 : -1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads crossfadeFrames frames from spliceStart on out of the output files of an interrupted
+ render into tail. The resumed render fades from them into its own output. Returns false if
+ an output file does not hold them
+ */
+static bool readResumeTail(char **outFileNames, int numFiles, long *fileChannelCounts, unsigned long spliceStart, unsigned long crossfadeFrames, float **tail)
+{
+	long channel = 0;
+	for (int v = 0; v < numFiles; v++) {
+		mAiffFile *file = mAiffOpen(outFileNames[v]);
+		bool ok = (file && mAiffSeek(file, spliceStart) == 0 && 
+				   mAiffReadFrames(file, tail+channel, crossfadeFrames, fileChannelCounts[v]) == (int)crossfadeFrames);
+		if (file)
+			mAiffClose(file);
+		if (!ok)
+			return false;
+		channel += fileChannelCounts[v];
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Fades audio, which holds numFrames output frames from blockStart on, in over the tail of an
+ interrupted render that starts at spliceStart. Returns the first frame of audio that goes to
+ the output files, the frames before spliceStart are preroll
+ */
+static long spliceResumedBlock(float **audio, unsigned long blockStart, long numFrames, float **tail, 
+							   unsigned long spliceStart, unsigned long crossfadeFrames, long numChannels)
+{
+	unsigned long blockEnd = blockStart + numFrames;
+	unsigned long spliceEnd = spliceStart + crossfadeFrames;
+	for (unsigned long i = blockStart > spliceStart ? blockStart : spliceStart; i < blockEnd && i < spliceEnd; i++) {
+		float fadeOut, fadeIn;
+		equalPowerGains(i-spliceStart, crossfadeFrames, &fadeOut, &fadeIn);
+		for (long c = 0; c < numChannels; c++)
+			audio[c][i-blockStart] = fadeOut*tail[c][i-spliceStart] + fadeIn*audio[c][i-blockStart];
+	}
+	if (blockStart >= spliceStart)
+		return 0;
+	return spliceStart < blockEnd ? (long)(spliceStart - blockStart) : numFrames;
+}
+
+
+#pragma mark ---- Jobs ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Processes one phase locked group of input files with its own Dirac instance. Returns 0 on success.
+ In verbose mode it prints everything DiracCLI always printed, otherwise only errors are printed so
+ that jobs running in parallel don't clutter the console
+ */
+int processJob(jobStruct *job, settingsStruct *settings)
+{
+	int numFiles = job->sNumFiles;
+	char **inFileNames = job->sInFileNames;
+	bool verbose = settings->sVerbose;
+	int numChannels = 0, v;
+	char *outFileNames[MAX_NUM_FILES];
+	mAiffFile *inFiles[MAX_NUM_FILES];
+	mAiffPrefetch *inPrefetch[MAX_NUM_FILES];
+	mAiffWriter *outFiles[MAX_NUM_FILES];
+	mAiffInfo inFileInfo[MAX_NUM_FILES];
+	long fileChannelCounts[MAX_NUM_FILES];
+	unsigned long maxFrames = 0;
+	long double time = settings->sTime;
+	long queueDepth = settings->sQueueDepth;
+	long readAhead = settings->sReadAhead;
+	linkGroupStruct groups[MAX_NUM_FILES];
+	int numGroups = 0;
+	settingsStruct jobSettings;
+	jpGang *gang = NULL;
+	float **audio = NULL;
+	float **block = NULL;
+	WriteBehind *writer = NULL;
+	char *checkpointFile = NULL, *checkpointJob = NULL;
+	float **resumeTail = NULL;
+	JobStats *stats = NULL;
+	unsigned long long fileBytes[MAX_NUM_FILES];
+	int result = -1;
+	
+	// everything we may have to clean up on the way out
+	for ( v = 0; v < MAX_NUM_FILES; v++) {
+		outFileNames[v] = NULL;
+		inFiles[v] = NULL;
+		inPrefetch[v] = NULL;
+		outFiles[v] = NULL;
+	}
+	
+	if (verbose) {
+		printf("\n------------------------------------------------------\n");
+		printf("total number of files to process = %d\n\n", numFiles);
+	}
+	
+	// read the format of all input files up front, in parallel
+	mAiffProbeFiles(inFileNames, numFiles, inFileInfo, PROBE_THREADS);
+	for ( v = 0; v < numFiles; v++) {
+		if (verbose)
+			printf("file #%d = %s\t\t", v, inFileNames[v]);
+		bool fileValid = (inFileInfo[v].sSampleRate > 0.);
+		if (fileValid) {
+			numChannels += (fileChannelCounts[v] = inFileInfo[v].sNumChannels);
+			unsigned long numFrames = inFileInfo[v].sNumFrames;
+			if (numFrames > maxFrames)
+				maxFrames = numFrames;
+			if (job->sOutFileNames) {
+				outFileNames[v] = new char[strlen(job->sOutFileNames[v])+1];
+				strcpy(outFileNames[v], job->sOutFileNames[v]);
+			} else
+				outFileNames[v] = createOutputFilePath(inFileNames[v], "processed-");
+			if (verbose)
+				printf("<OK>\t%d channels --> %s\n", (int)fileChannelCounts[v], outFileNames[v]);
+		} else {
+			if (verbose)
+				printf("!!! invalid !!!\n");
+			printf("!!! %s: invalid input file format\n", inFileNames[v]);
+			goto done;
+		}
+	}
+	
+	// split the files into link groups, each one is processed by its own Dirac instance
+	numGroups = getLinkGroups(job, fileChannelCounts, groups);
+	if (verbose) {
+		printf("\ntotal number of channels to process = %d\n", numChannels);
+		for (int g = 0; numGroups > 1 && g < numGroups; g++)
+			printf("link group #%d = files #%d-#%d, %ld channels\n", g, groups[g].sFirstFile, groups[g].sFirstFile+groups[g].sNumFiles-1, groups[g].sNumChannels);
+		printf("------------------------------------------------------\n\n");
+	}
+	
+	// With a realtime budget this job gets the best lambda and quality its widest link group can
+	// be processed with fast enough
+	if (settings->sRtBudget > 0.) {
+		jobSettings = *settings;
+		double factor = applyRtBudget(&jobSettings, linkGroupsMaxChannels(groups, numGroups), inFileInfo[0].sSampleRate);
+		settings = &jobSettings;
+		if (factor < settings->sRtBudget)
+			printf("!!! %s: the realtime budget of %.2fx cannot be met, using the fastest setting (%.2fx)\n", inFileNames[0], settings->sRtBudget, factor);
+		else if (verbose)
+			printf("Realtime budget %.2fx: lambda %d, quality %d (estimated %.2fx)\n", settings->sRtBudget, settings->sLambda, settings->sQuality, factor);
+	}
+	
+	{
+		// first file determines sample rate
+		float sr = inFileInfo[0].sSampleRate;
+		
+		unsigned long long expectedOutFrames = (unsigned long long)((long double)maxFrames * time);
+		
+		// The sizes in an AIFF header are 32 bit, so we'd rather not start what can't be written.
+		// Streams of RF64 or Wave64 through -i/-o don't have that limit
+		for ( v = 0; v < numFiles; v++) {
+			if (expectedOutFrames * fileChannelCounts[v] * ((inFileInfo[v].sWordlength+7)/8) > kMAiffMaxDataBytes) {
+				printf("!!! %s: %llu output frames do not fit into an AIFF file, use -i and -o with RF64 or Wave64\n", outFileNames[v], expectedOutFrames);
+				goto done;
+			}
+		}
+		
+		// Long files can be split into segments that are rendered in parallel. Each segment reads
+		// a second of preroll, so segments shorter than that would mostly be preroll
+		long numSegments = settings->sNumSegments;
+		if (numSegments < 1)
+			numSegments = jpAvailableCpus();
+		unsigned long prerollFrames = (unsigned long)(SEGMENT_PREROLL_SECONDS * sr);
+		if (numSegments > 1 && prerollFrames && maxFrames / numSegments < prerollFrames)
+			numSegments = maxFrames / prerollFrames;
+		
+		// With checkpoints an interrupted render picks up where its last checkpoint left off. Like a
+		// segment it reads a second of preroll, then fades over into what was written before
+		checkpointStruct checkpoint;
+		checkpoint.sFramesFlushed = checkpoint.sInputPosition = 0;
+		unsigned long crossfadeFrames = 2*(unsigned long)(0.5 * SEGMENT_CROSSFADE_SECONDS * sr);
+		unsigned long spliceStart = 0, readStart = 0;
+		if (settings->sCheckpointSeconds > 0. && numSegments <= 1) {
+			checkpointFile = new char[strlen(outFileNames[0])+strlen(CHECKPOINT_SUFFIX)+1];
+			sprintf(checkpointFile, "%s%s", outFileNames[0], CHECKPOINT_SUFFIX);
+			checkpointJob = describeCheckpointJob(job, settings, inFileInfo, outFileNames, groups, numGroups);
+			int found = readCheckpoint(checkpointFile, checkpointJob, &checkpoint);
+			if (found < 0)
+				printf("!!! %s belongs to a different job, starting over\n", checkpointFile);
+			if (found > 0 && checkpoint.sFramesFlushed > crossfadeFrames && checkpoint.sFramesFlushed < expectedOutFrames) {
+				spliceStart = checkpoint.sFramesFlushed - crossfadeFrames;
+				resumeTail = mAiffAllocateAudioBuffer(numChannels, crossfadeFrames);
+				if (readResumeTail(outFileNames, numFiles, fileChannelCounts, spliceStart, crossfadeFrames, resumeTail)) {
+					unsigned long firstInput = (unsigned long)((long double)spliceStart / time);
+					readStart = firstInput > prerollFrames ? firstInput - prerollFrames : 0;
+					if (verbose)
+						printf("Resuming at output frame %lu of %llu (Dirac had begun processing input frame %lu)\n", 
+							   checkpoint.sFramesFlushed, expectedOutFrames, checkpoint.sInputPosition);
+					
+					// should we be interrupted again before the next checkpoint, the files still hold
+					// what this one says once they are cut back to the start of the crossfade
+					checkpoint.sFramesFlushed = spliceStart;
+					if (writeCheckpoint(checkpointFile, checkpointJob, &checkpoint) != 0)
+						printf("!!! Could not write %s\n", checkpointFile);
+				} else {
+					printf("!!! %s: the output files do not match %s, starting over\n", inFileNames[0], checkpointFile);
+					mAiffDeallocateAudioBuffer(resumeTail, numChannels);
+					resumeTail = NULL;
+					spliceStart = 0;
+				}
+			}
+		}
+		
+		// With --stats the job reports how it is doing. A resumed render only counts what it
+		// renders itself
+		if (settings->sStats) {
+			stats = jsCreate(inFileNames[0], numFiles, sr, expectedOutFrames - spliceStart);
+			jsReporterAdd(settings->sStats, stats);
+		}
+		
+		// Initialize our output files. They stay open until we are done and we reserve the space
+		// we expect to write up front so the files don't get fragmented
+		for ( v = 0; v < numFiles; v++) {
+			if (resumeTail)
+				outFiles[v] = mAiffReopen(outFileNames[v], spliceStart);
+			else
+				outFiles[v] = mAiffCreate(outFileNames[v], 
+							  inFileInfo[v].sSampleRate, 
+							  inFileInfo[v].sWordlength, 
+							  inFileInfo[v].sNumChannels);
+			if (!outFiles[v]) {
+				printf("!!! Could not %s %s\n", resumeTail ? "reopen" : "create", outFileNames[v]);
+				goto done;
+			}
+			mAiffPreallocate(outFiles[v], expectedOutFrames);
+		}
+		
+		if (numSegments > 1) {
+			result = renderSegments(job, settings, inFileInfo, fileChannelCounts, numChannels, maxFrames, numSegments, outFiles, stats);
+			for ( v = 0; v < numFiles; v++) {
+				jsSetBytesWritten(stats, v, mAiffGetBytesWritten(outFiles[v]));
+				if (mAiffCloseWriter(outFiles[v]) != 0 && result == 0) {
+					printf("!!! Error writing output files for %s\n", inFileNames[0]);
+					result = -5;
+				}
+				outFiles[v] = NULL;
+			}
+			goto done;
+		}
+		
+		// Every link group gets its own Dirac instance
+		if (!createLinkGroupInstances(groups, numGroups, settings, sr, inPrefetch, fileChannelCounts, readStart, maxFrames, job->sTimer)) {
+			printf("!! ERROR !!\n\n\tCould not create DIRAC instance for %s\n\tCheck number of channels and sample rate!\n", inFileNames[0]);
+			goto done;
+		}
+		
+		// Open our input files once. A background thread per file decodes them through a memory
+		// mapped window into a ring buffer ahead of Dirac, so the read callback only copies
+		long chunkFrames;
+		linkGroupsReadAhead(groups, readAhead, &readAhead, &chunkFrames);
+		for ( v = 0; v < numFiles; v++) {
+			inFiles[v] = mAiffOpenMapped(inFileNames[v]);
+			if (!inFiles[v] || (readStart && mAiffSeek(inFiles[v], readStart) != 0)) {
+				printf("!!! Could not open %s\n", inFileNames[v]);
+				goto done;
+			}
+			inPrefetch[v] = mAiffPrefetchCreate(inFiles[v], fileChannelCounts[v], readAhead, chunkFrames);
+			if (!inPrefetch[v]) {
+				printf("!!! Could not start reading %s\n", inFileNames[v]);
+				goto done;
+			}
+		}
+		
+		if (verbose) {
+			// Print our settings to the console
+			DiracPrintSettings(groups[0].sDirac);
+			
+			printf("Running DIRAC version %s\nStarting processing\n", DiracVersion());
+		}
+		
+		// The number of frames per call that processes fastest on this machine, see --tune
+		long numFramesPerCall = linkGroupsBlockSize(groups, numGroups, settings);
+		if (verbose) {
+			DiracFeedStats feedStats;
+			dfGetStats(groups[0].sFeed, &feedStats);
+			printf("Processing %ld frames per call, input buffer %ld frames\n", numFramesPerCall, feedStats.sInputFrames);
+		}
+		
+		// Allocate buffer for output
+		audio = mAiffAllocateAudioBuffer(numChannels, numFramesPerCall);
+		block = new float*[numChannels];
+		long lastPercent = -1;
+		
+		// Processed blocks are handed to a writer thread so we don't wait for the disk here. The
+		// files' sizes are reported as what they held to begin with plus what the writer added
+		for ( v = 0; v < numFiles; v++)
+			fileBytes[v] = mAiffGetBytesWritten(outFiles[v]);
+		writer = wbCreate(outFiles, fileChannelCounts, numFiles, numFramesPerCall, queueDepth);
+		if (!writer) {
+			printf("!! ERROR !!\n\n\tCould not start the output writer\n");
+			goto done;
+		}
+		
+		// Link groups are processed at the same time, each on its own thread. They all fill in
+		// their channels of the same block, which then goes to the writer as a whole
+		groupBlockStruct groupBlock;
+		groupBlock.sGroups		= groups;
+		groupBlock.sAudio		= audio;
+		groupBlock.sNumFrames	= numFramesPerCall;
+		gang = jpGangCreate(numGroups, processGroupBlock, &groupBlock);
+		if (!gang) {
+			printf("!!! Out of memory\n");
+			goto done;
+		}
+		
+		// The output is exactly as long as the input times the time factor. Dirac compensates for
+		// its own latency, the input it needs beyond the end of the file is padded by the read
+		// callback. We stop once we have all output frames, the last block is usually a short one.
+		// A resumed render counts from the output frame that corresponds to its first input frame
+		int writeError = 0;
+		unsigned long long framesDone = resumeTail ? (unsigned long long)((long double)readStart * time + 0.5) : 0;
+		double nextCheckpoint = wallClockSeconds() + settings->sCheckpointSeconds;
+		while (framesDone < expectedOutFrames) {
+			long numFrames = numFramesPerCall;
+			if ((unsigned long long)numFrames > expectedOutFrames - framesDone)
+				numFrames = expectedOutFrames - framesDone;
+			
+			// Call the DIRAC process function with current time and pitch settings
+			// Returns: the number of frames in audio
+			groupBlock.sNumFrames = numFrames;
+			jpGangRun(gang);
+			numFrames = linkGroupsNumProcessed(groups, numGroups, numFrames);
+			
+			// a resumed render throws its preroll away and fades in over what was written before
+			long first = 0;
+			if (resumeTail && numFrames > 0)
+				first = spliceResumedBlock(audio, framesDone, numFrames, resumeTail, spliceStart, crossfadeFrames, numChannels);
+			for (long c = 0; c < numChannels; c++)
+				block[c] = audio[c] + first;
+			double writeStart = wallClockSeconds();
+			if (numFrames > first) {
+				PhaseScope write(job->sTimer, kPhaseWrite);
+				if (wbSubmit(writer, block, numFrames-first) != 0) {
+					printf("!!! Error writing output files for %s\n", inFileNames[0]);
+					writeError = -5;
+					break;
+				}
+			}
+			framesDone += numFrames;
+			
+			// Every so often everything written so far goes to disk and we note how far we got
+			if (checkpointFile && writeStart >= nextCheckpoint) {
+				PhaseScope write(job->sTimer, kPhaseWrite);
+				if (wbFlush(writer) == 0) {
+					checkpoint.sFramesFlushed = mAiffGetFramesWritten(outFiles[0]);
+					checkpoint.sInputPosition = linkGroupsBeganPosition(groups, numGroups);
+					if (writeCheckpoint(checkpointFile, checkpointJob, &checkpoint) != 0)
+						printf("!!! Could not write %s\n", checkpointFile);
+				}
+				nextCheckpoint = wallClockSeconds() + settings->sCheckpointSeconds;
+			}
+			
+			// Report what the block took. Only counters are updated here, the reporter thread
+			// writes them out
+			if (stats) {
+				JobStatsValues values;
+				linkGroupsCollectStats(groups, numGroups, &values);
+				values.sFramesOut = numFrames > first ? numFrames-first : 0;
+				values.sOutputWaitSeconds = wallClockSeconds() - writeStart;
+				jsAdd(stats, &values);
+				for ( v = 0; v < numFiles; v++)
+					jsSetBytesWritten(stats, v, fileBytes[v] + wbGetFileBytesWritten(writer, v));
+			}
+			
+			// print performance measurements, unless they go to the statistics
+			long percent = (long)(100.f*(double)framesDone / (double)expectedOutFrames);
+			if (verbose && !stats && lastPercent != percent) {
+				printf("\t%d%% done\n", (int)percent);
+				lastPercent = percent;
+				fflush(stdout);
+			}
+			
+			// Dirac ran out of input early
+			if (numFrames < groupBlock.sNumFrames) {
+				printf("!!! %s ended after %llu of %llu output frames\n", inFileNames[0], framesDone, expectedOutFrames);
+				writeError = -1;
+				break;
+			}
+		}
+		
+		// Wait for the writer to catch up and report how the output stage did
+		double finishStart = wallClockSeconds();
+		{
+			PhaseScope write(job->sTimer, kPhaseWrite);
+			if (wbFinish(writer) != 0)
+				writeError = -5;
+		}
+		if (stats) {
+			JobStatsValues values;
+			memset(&values, 0, sizeof(values));
+			values.sOutputWaitSeconds = wallClockSeconds() - finishStart;
+			jsAdd(stats, &values);
+			for ( v = 0; v < numFiles; v++)
+				jsSetBytesWritten(stats, v, fileBytes[v] + wbGetFileBytesWritten(writer, v));
+		}
+		if (verbose) {
+			WriteBehindStats writerStats;
+			wbGetStats(writer, &writerStats);
+			printf("\nOutput: %llu bytes written in %ld blocks, queue depth avg. %.2f / max %ld of %ld\n",
+				   writerStats.sBytesWritten, writerStats.sNumBlocks, writerStats.sAvgQueueDepth, writerStats.sMaxQueueDepth, queueDepth);
+			printf("Output: writer busy %.3fs, processing stalled on a full queue for %.3fs\n",
+				   writerStats.sWriteSeconds, writerStats.sStallSeconds);
+		}
+		wbDestroy(writer);
+		writer = NULL;
+		
+		// Finish our output files
+		for ( v = 0; v < numFiles; v++) {
+			PhaseScope write(job->sTimer, kPhaseWrite);
+			if (mAiffCloseWriter(outFiles[v]) != 0)
+				writeError = -5;
+			outFiles[v] = NULL;
+		}
+		if (writeError == -5)
+			printf("!!! Error writing output files for %s\n", inFileNames[0]);
+		
+		// Report how often processing had to wait for input
+		if (verbose) {
+			long underruns = 0;
+			for ( v = 0; v < numFiles; v++)
+				underruns += mAiffPrefetchGetUnderruns(inPrefetch[v]);
+			printf("Input: processing waited for the disk %ld times (read ahead %ld frames)\n", underruns, readAhead);
+			unsigned long directReads = 0, stagedReads = 0;
+			for (int g = 0; g < numGroups; g++) {
+				DiracFeedStats feedStats;
+				dfGetStats(groups[g].sFeed, &feedStats);
+				directReads += feedStats.sDirectReads;
+				stagedReads += feedStats.sStagedReads;
+			}
+			printf("Input: %lu reads went straight into Dirac's buffer, %lu were staged\n", directReads, stagedReads);
+		}
+		
+		// the job is done, there is nothing left to resume
+		if (checkpointFile && writeError == 0)
+			remove(checkpointFile);
+		
+		result = writeError;
+	}
+	
+done:
+	if (writer)
+		wbDestroy(writer);
+	for ( v = 0; v < numFiles; v++) {
+		if (outFiles[v])
+			mAiffCloseWriter(outFiles[v]);
+	}
+	
+	// a job that failed before it got going reports that it is done all the same
+	if (settings->sStats && !stats) {
+		stats = jsCreate(inFileNames[0], numFiles, 0.f, 0);
+		jsReporterAdd(settings->sStats, stats);
+	}
+	if (stats) {
+		jsReporterRemove(settings->sStats, stats, result);
+		jsDestroy(stats);
+	}
+	
+	// Free buffers
+	if (audio)
+		mAiffDeallocateAudioBuffer(audio, numChannels);
+	if (resumeTail)
+		mAiffDeallocateAudioBuffer(resumeTail, numChannels);
+	delete[] block;
+	delete[] checkpointFile;
+	delete[] checkpointJob;
+	
+	// destroy DIRAC instances
+	if (gang)
+		jpGangDestroy(gang);
+	destroyLinkGroupInstances(groups, numGroups, settings);
+	
+	// close our input files
+	for ( v = 0; v < numFiles; v++) {
+		if (inPrefetch[v])
+			mAiffPrefetchDestroy(inPrefetch[v]);
+		if (inFiles[v])
+			mAiffClose(inFiles[v]);
+	}
+	
+	// free our file names
+	for ( v = 0; v < numFiles; v++)
+		delete[] outFileNames[v];
+	
+	return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Runs job number index of a batch on one of the pool's threads and reports the outcome
+ */
+typedef struct {
+	jobStruct *sJobs;
+	long sNumJobs;
+	settingsStruct *sSettings;
+	volatile long sNumDone, sNumFailed;
+} batchStruct;
+
+static void runBatchJob(long index, void *userData)
+{
+	batchStruct *batch = (batchStruct*)userData;
+	jobStruct *job = batch->sJobs+index;
+	
+	// every job has a timer of its own, so jobs running next to each other don't mix up their times
+	PhaseTimer timer;
+	ptInit(&timer, job->sInFileNames[0]);
+	job->sTimer = &timer;
+	double start = wallClockSeconds();
+	job->sResult = processJob(job, batch->sSettings);
+	job->sSeconds = wallClockSeconds() - start;
+	ptGetTimes(&timer, &job->sTimes);
+	job->sTimer = NULL;
+	ptDispose(&timer);
+	
+	long numDone = __sync_add_and_fetch(&batch->sNumDone, 1);
+	if (job->sResult != 0)
+		__sync_add_and_fetch(&batch->sNumFailed, 1);
+	printf("[%ld/%ld] %s%s\t%s (%.2fs: read %.2fs, DSP %.2fs, write %.2fs)\n", numDone, batch->sNumJobs, job->sInFileNames[0], 
+		   job->sNumFiles > 1 ? " ..." : "", job->sResult ? "FAILED" : "OK", job->sSeconds, 
+		   job->sTimes.sSeconds[kPhaseRead], job->sTimes.sSeconds[kPhaseDsp], job->sTimes.sSeconds[kPhaseWrite]);
+	fflush(stdout);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Adds a new, empty group of input files to the list of jobs
+ */
+static jobStruct *addJob(jobStruct **jobs, long *numJobs)
+{
+	jobStruct *newJobs = (jobStruct*)realloc(*jobs, (*numJobs+1)*sizeof(jobStruct));
+	if (!newJobs) {
+		printf("!!! Out of memory - exiting\n");
+		exit(-1);
+	}
+	*jobs = newJobs;
+	jobStruct *job = newJobs + (*numJobs)++;
+	job->sInFileNames = new char*[MAX_NUM_FILES];
+	job->sOutFileNames = NULL;
+	job->sNumFiles = 0;
+	memset(job->sStartsGroup, 0, sizeof(job->sStartsGroup));
+	job->sHasGroups = job->sInGroup = job->sNewGroup = false;
+	job->sResult = 0;
+	job->sSeconds = 0.;
+	job->sTimer = NULL;
+	memset(&job->sTimes, 0, sizeof(job->sTimes));
+	return job;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Reads a batch list: one job per line, the files of a job separated by tabs. Empty lines and lines
+ starting with # are ignored
+ */
+static void readBatchList(char *path, jobStruct **jobs, long *numJobs)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		printf("!!! Could not open batch list %s - exiting\n", path);
+		exit(-1);
+	}
+	char line[65536];
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = 0;
+		if (!line[0] || line[0] == '#')
+			continue;
+		jobStruct *job = addJob(jobs, numJobs);
+		for (char *name = strtok(line, "\t"); name && job->sNumFiles < MAX_NUM_FILES; name = strtok(NULL, "\t")) {
+			if (!name[0])
+				continue;
+			int numFiles = job->sNumFiles;
+			char *copy = new char[strlen(name)+1];
+			strcpy(copy, name);
+			addFileName(job, copy);
+			if (job->sNumFiles == numFiles)
+				delete[] copy;
+		}
+		if (!job->sNumFiles) {
+			delete[] job->sInFileNames;
+			(*numJobs)--;
+		}
+	}
+	fclose(f);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Measures which block size processes fastest for 1...maxChannels channels with the lambda and
+ quality from the command line, and saves the results to the block size profile
+ */
+static int tuneBlockSizes(settingsStruct *settings, long maxChannels)
+{
+	long blockSizes[32];
+	double framesPerSecond[32];
+	int numBlockSizes = 0, b;
+	for (long size = TUNE_MIN_BLOCK_SIZE; size <= TUNE_MAX_BLOCK_SIZE; size *= 2)
+		blockSizes[numBlockSizes++] = size;
+	
+	printf("\nTuning frames per call for lambda %d and quality %d, this takes a while\n", settings->sLambda, settings->sQuality);
+	printf("Throughput in 1000 output frames per second:\n\n");
+	printf("channels");
+	for (b = 0; b < numBlockSizes; b++)
+		printf("%8ld", blockSizes[b]);
+	printf("    best\n");
+	
+	for (long numChannels = 1; numChannels <= maxChannels; numChannels++) {
+		long best = bpTune(kDiracLambdaPreview+settings->sLambda, kDiracQualityPreview+settings->sQuality, numChannels, TUNE_SAMPLE_RATE, 
+						   blockSizes, numBlockSizes, TUNE_SECONDS, framesPerSecond);
+		if (best < 0) {
+			printf("!!! Could not create a DIRAC instance with %ld channels\n", numChannels);
+			return -1;
+		}
+		printf("%8ld", numChannels);
+		for (b = 0; b < numBlockSizes; b++)
+			printf("%8.1f", framesPerSecond[b] / 1000.);
+		printf("%8ld\n", best);
+		fflush(stdout);
+	}
+	
+	if (bpSave(NULL) != 0) {
+		printf("!!! Could not write the block size profile\n");
+		return -1;
+	}
+	printf("\nBlock size profile saved\n");
+	return 0;
+}
+
+
+#pragma mark ---- Streams ----
+
+
+// A job given with -i: interleaved PCM read from a pipe or file and written to another one, raw or
+// with a WAV, RF64 or Wave64 header, instead of AIFF files. Frames are counted in 64 bit, so
+// recordings of any length stream through
+typedef struct {
+	char *sInPath, *sOutPath;			/* "-" = stdin and stdout */
+	PcmStreamFormat sFormat;			/* sContainer, or the format of raw input */
+	int sOutContainer;					/* kPcmRaw...kPcmW64, -1 = the same as the input */
+	int sStdoutFd;						/* where audio for stdout goes, see main() */
+} streamJobStruct;
+
+// names of the containers on the command line, in the order of kPcmRaw...kPcmW64
+static const char *containerNames[] = { "raw", "wav", "rf64", "w64" };
+
+
+// State of the read callback of a stream job
+typedef struct {
+	PcmStream *sStream;
+	long sNumChannels;
+	unsigned long long sFramesRead;		/* input frames read so far, padding not counted */
+	unsigned long long sPaddingLeft;	/* frames of silence still to feed Dirac past the end */
+	bool sEnded;						/* the input has ended */
+	long sError;						/* what psRead() returned if reading failed, else 0 */
+	double sReadSeconds;				/* time spent waiting for the input since the last block */
+} streamReadStruct;
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Read callback for stream jobs. Nobody knows how long the input is until it ends, then we pad
+ with silence just like myReadData() and report the end after that
+ */
+static long streamReadData(float **chdata, long numFrames, void *userData)
+{
+	streamReadStruct *state = (streamReadStruct*)userData;
+	if (!chdata || !state)	return 0;
+	
+	long numRead = 0;
+	if (!state->sEnded) {
+		double start = wallClockSeconds();
+		numRead = psRead(state->sStream, chdata, numFrames);
+		state->sReadSeconds += wallClockSeconds() - start;
+		if (numRead < 0) {
+			state->sError = numRead;
+			numRead = 0;
+		}
+		state->sFramesRead += numRead;
+		state->sEnded = (numRead < numFrames);
+	} else {
+		for (long c = 0; c < state->sNumChannels; c++)
+			memset(chdata[c], 0, numFrames*sizeof(float));
+	}
+	if (numRead == numFrames)
+		return numFrames;
+	
+	if (!state->sPaddingLeft)
+		return numRead;
+	unsigned long long padding = (unsigned long long)(numFrames - numRead);
+	state->sPaddingLeft -= padding < state->sPaddingLeft ? padding : state->sPaddingLeft;
+	return numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Processes a stream job. The output is written as it is produced, it ends up exactly as long as
+ the input times the time factor. Returns 0 on success
+ */
+static int processStreamJob(streamJobStruct *job, settingsStruct *settings)
+{
+	bool verbose = settings->sVerbose;
+	PcmStreamFormat format = job->sFormat, outFormat;
+	PcmStream *input = NULL;
+	PcmStreamWriter *output = NULL;
+	DiracFeed *feed = NULL;
+	void *dirac = NULL;
+	float **audio = NULL;
+	JobStats *stats = NULL;
+	streamReadStruct state;
+	unsigned long long framesDone = 0;
+	long numChannels = 0, numFramesPerCall = 0;
+	int inFd, outFd, result = -1;
+	double start = wallClockSeconds();
+	memset(&state, 0, sizeof(state));
+	
+	// the stream owns its descriptor from here on, stdin included
+	inFd = strcmp(job->sInPath, "-") == 0 ? STDIN_FILENO : open(job->sInPath, O_RDONLY);
+	if (inFd < 0) {
+		printf("!!! Could not open %s\n", job->sInPath);
+		goto done;
+	}
+	input = psOpen(inFd, &format, settings->sReadAhead);
+	if (!input) {
+		printf("!!! %s is not a WAV, RF64 or Wave64 stream of 16, 24 or 32 bit integer or 32 bit float samples\n", job->sInPath);
+		goto done;
+	}
+	numChannels = format.sNumChannels;
+	if (verbose)
+		printf("Input: %s, %ld channels, %.0f Hz, %d bit %s, %s\n", job->sInPath, numChannels, format.sSampleRate, format.sWordlength, 
+			   format.sFloat ? "float" : "integer", containerNames[format.sContainer]);
+	
+	// With a realtime budget the lambda and quality are picked now that we know the channels, the
+	// ones this machine has not been measured for yet are measured first
+	if (settings->sRtBudget > 0.) {
+		int measured = calibrateRtBudget(settings, numChannels);
+		if (measured < 0)
+			goto done;
+		if (measured > 0 && bpSave(NULL) != 0)
+			printf("!!! Could not write the block size profile, calibrating again next time\n");
+		double factor = applyRtBudget(settings, numChannels, format.sSampleRate);
+		if (factor < settings->sRtBudget)
+			printf("!!! %s: the realtime budget of %.2fx cannot be met, using the fastest setting (%.2fx)\n", job->sInPath, settings->sRtBudget, factor);
+		else if (verbose)
+			printf("Realtime budget %.2fx: lambda %d, quality %d (estimated %.2fx)\n", settings->sRtBudget, settings->sLambda, settings->sQuality, factor);
+	}
+	
+	outFormat = format;
+	if (job->sOutContainer >= 0)
+		outFormat.sContainer = job->sOutContainer;
+	outFd = strcmp(job->sOutPath, "-") == 0 ? job->sStdoutFd : open(job->sOutPath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (outFd < 0 || !(output = psCreate(outFd, &outFormat))) {
+		printf("!!! Could not write %s\n", job->sOutPath);
+		goto done;
+	}
+	
+	// Dirac reads through a feed, as it does for files
+	state.sStream		= input;
+	state.sNumChannels	= numChannels;
+	state.sPaddingLeft	= (unsigned long long)(END_PADDING_SECONDS * format.sSampleRate);
+	feed = dfCreate(numChannels, &streamReadData, (void*)&state);
+	if (feed)
+		dirac = dpAcquire(settings->sPool, kDiracLambdaPreview+settings->sLambda, kDiracQualityPreview+settings->sQuality, numChannels, format.sSampleRate, &dfReadData, (void*)feed);
+	if (!dirac) {
+		printf("!!! Could not create DIRAC instance for %s\n", job->sInPath);
+		goto done;
+	}
+	DiracSetProperty(kDiracPropertyTimeFactor, settings->sTime, dirac);
+	DiracSetProperty(kDiracPropertyPitchFactor, settings->sPitch, dirac);
+	DiracSetProperty(kDiracPropertyFormantFactor, settings->sFormant, dirac);
+	if (dfAttach(feed, dirac) < 0) {
+		printf("!!! Out of memory\n");
+		goto done;
+	}
+	numFramesPerCall = dfAlignOutput(feed, bpGetBlockSize(kDiracLambdaPreview+settings->sLambda, kDiracQualityPreview+settings->sQuality, numChannels, DEFAULT_BLOCK_SIZE));
+	audio = mAiffAllocateAudioBuffer(numChannels, numFramesPerCall);
+	
+	// the total is only known if a header told us
+	if (settings->sStats) {
+		stats = jsCreate(job->sInPath, 1, format.sSampleRate, (unsigned long long)((long double)format.sNumFrames * settings->sTime));
+		jsReporterAdd(settings->sStats, stats);
+	}
+	
+	// Once the input has ended we know how long the output is. Dirac has produced less than that
+	// by then, the padding gives it what it needs to finish
+	for (;;) {
+		unsigned long long expectedOutFrames = (unsigned long long)((long double)state.sFramesRead * settings->sTime);
+		if (state.sEnded && framesDone >= expectedOutFrames)
+			break;
+		
+		double processStart = wallClockSeconds();
+		unsigned long long framesBefore = state.sFramesRead;
+		state.sReadSeconds = 0.;
+		long numFrames = DiracProcess(audio, numFramesPerCall, dirac);
+		double processSeconds = wallClockSeconds() - processStart;
+		if (state.sError) {
+			printf("!!! Error reading %s: %s\n", job->sInPath, strerror((int)-state.sError));
+			goto done;
+		}
+		if (numFrames <= 0) {
+			printf("!!! %s ended after %llu output frames\n", job->sInPath, framesDone);
+			goto done;
+		}
+		if (state.sEnded) {
+			expectedOutFrames = (unsigned long long)((long double)state.sFramesRead * settings->sTime);
+			if ((unsigned long long)numFrames > expectedOutFrames - framesDone)
+				numFrames = framesDone < expectedOutFrames ? expectedOutFrames - framesDone : 0;
+		}
+		
+		// nobody reading our output anymore is an error like any other, we stop right away
+		double writeStart = wallClockSeconds();
+		long ret = numFrames ? psWrite(output, audio, numFrames) : 0;
+		if (ret < 0) {
+			printf("!!! Error writing %s: %s\n", job->sOutPath, strerror((int)-ret));
+			goto done;
+		}
+		framesDone += numFrames;
+		
+		if (stats) {
+			JobStatsValues values;
+			memset(&values, 0, sizeof(values));
+			values.sFramesIn			= state.sFramesRead - framesBefore;
+			values.sFramesOut			= numFrames;
+			values.sDspSeconds			= processSeconds - state.sReadSeconds;
+			values.sInputWaitSeconds	= state.sReadSeconds;
+			values.sOutputWaitSeconds	= wallClockSeconds() - writeStart;
+			values.sPeakCpuPercent		= DiracPeakCpuUsagePercent(dirac);
+			jsAdd(stats, &values);
+			jsSetBytesWritten(stats, 0, psGetBytesWritten(output));
+		}
+	}
+	
+	// closing the output tells whoever reads it that we are done
+	if (psCloseWriter(output) != 0) {
+		output = NULL;
+		printf("!!! Error writing %s\n", job->sOutPath);
+		goto done;
+	}
+	output = NULL;
+	result = 0;
+	
+	if (verbose) {
+		double elapsed = wallClockSeconds() - start;
+		printf("\nDone: %llu input frames, %llu output frames in %.2fs (%.2fx realtime)\n", state.sFramesRead, framesDone, elapsed, 
+			   elapsed > 0. ? (double)framesDone / format.sSampleRate / elapsed : 0.);
+		printf("Input: processing waited for the stream %ld times (read ahead %ld frames)\n", psGetUnderruns(input), settings->sReadAhead);
+	}
+	
+done:
+	if (stats) {
+		jsReporterRemove(settings->sStats, stats, result);
+		jsDestroy(stats);
+	}
+	if (output)
+		psCloseWriter(output);
+	if (dirac)
+		dpRelease(settings->sPool, dirac);
+	dfDestroy(feed);
+	if (audio)
+		mAiffDeallocateAudioBuffer(audio, numChannels);
+	psClose(input);
+	return result;
+}
+
+
+#pragma mark ---- Daemon ----
+
+// set by SIGINT, SIGTERM or a client's shutdown command, stops the daemon accepting clients
+static volatile sig_atomic_t gDaemonQuit = 0;
+
+
+// A job handed to the daemon in shared memory instead of files: planar 32 bit float PCM, all
+// frames of the first channel, then all frames of the second and so on
+typedef struct {
+	char sName[256];					/* shared memory object holding the input */
+	char sOutName[256];					/* shared memory object for the output, empty = write an AIFF file */
+	long sNumChannels;
+	unsigned long sNumFrames;
+	float sSampleRate;
+} pcmJobStruct;
+
+
+// State of the read callback of a shared memory job
+typedef struct {
+	const float *sPcm;
+	long sNumChannels;
+	unsigned long sNumFrames, sReadPosition, sEndPosition;
+} pcmReadStruct;
+
+
+// Everything one request on a daemon connection asks for
+typedef struct {
+	settingsStruct sSettings;
+	jobStruct sJob;
+	char *sOutFileNames[MAX_NUM_FILES];
+	int sNumOutFiles;
+	char *sStrings[2*MAX_NUM_FILES];	/* copies of the paths we were sent, freed with the request */
+	int sNumStrings;
+	pcmJobStruct sPcm;
+	bool sHasPcm;
+} requestStruct;
+
+
+// The daemon, shared by all connections
+typedef struct {
+	settingsStruct *sSettings;			/* defaults for every request */
+	int sListener;
+	jpQueue *sQueue;
+	volatile long sNumServed, sNumFailed;
+} daemonStruct;
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Read callback for shared memory jobs. Copies straight from the client's memory into Dirac's
+ buffer and pads with silence past the end, just like myReadData()
+ */
+static long pcmReadData(float **chdata, long numFrames, void *userData)
+{
+	pcmReadStruct *state = (pcmReadStruct*)userData;
+	if (!chdata || !state)	return 0;
+	
+	if (state->sReadPosition >= state->sEndPosition) {
+		for (long c = 0; c < state->sNumChannels; c++)
+			memset(chdata[c], 0, numFrames*sizeof(float));
+		return 0;
+	}
+	
+	long available = 0;
+	if (state->sReadPosition < state->sNumFrames)
+		available = state->sNumFrames - state->sReadPosition < (unsigned long)numFrames ? (long)(state->sNumFrames - state->sReadPosition) : numFrames;
+	for (long c = 0; c < state->sNumChannels; c++) {
+		if (available)
+			memcpy(chdata[c], state->sPcm + c*state->sNumFrames + state->sReadPosition, available*sizeof(float));
+		memset(chdata[c]+available, 0, (numFrames-available)*sizeof(float));
+	}
+	state->sReadPosition += numFrames;
+	return numFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns in bytes how many bytes numFrames frames of numChannels channels of float take. The
+ product is formed in 64 bit, so it cannot wrap. Returns false if it does not fit into a size_t
+ */
+static bool pcmBytes(long numChannels, unsigned long long numFrames, size_t *bytes)
+{
+	unsigned long long frameBytes = (unsigned long long)numChannels * sizeof(float);
+	if (numChannels < 1 || numChannels > MAX_PCM_CHANNELS || numFrames > (unsigned long long)SIZE_MAX / frameBytes)
+		return false;
+	*bytes = (size_t)(numFrames * frameBytes);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Maps the shared memory object name if it holds at least minSize bytes. Returns NULL on error,
+ otherwise the mapping, whose size is returned in size
+ */
+static void *mapSharedMemory(const char *name, size_t minSize, bool writable, size_t *size)
+{
+	int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, 0);
+	if (fd < 0)	return NULL;
+	
+	void *memory = MAP_FAILED;
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0 && (size_t)info.st_size >= minSize) {
+		*size = (size_t)info.st_size;
+		memory = mmap(NULL, *size, writable ? PROT_READ|PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	return memory == MAP_FAILED ? NULL : memory;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Processes a shared memory job. Dirac renders straight into the client's output memory, or into
+ outFileName if the job has no output memory. The number of output frames is returned in
+ numOutFrames. Returns 0 on success
+ */
+static int processPcmJob(pcmJobStruct *pcm, char *outFileName, settingsStruct *settings, unsigned long *numOutFrames)
+{
+	long numChannels = pcm->sNumChannels;
+	long double outFrames = (long double)pcm->sNumFrames * settings->sTime;
+	unsigned long expectedOutFrames = outFrames < (long double)ULONG_MAX ? (unsigned long)outFrames : ULONG_MAX;
+	unsigned long framesDone = 0;
+	size_t inBytes = 0, outBytes = 0;
+	size_t inSize = 0, outSize = 0;
+	float *in = NULL, *out = NULL;
+	float **audio = NULL;
+	float **outPointers = new float*[numChannels];
+	mAiffWriter *writer = NULL;
+	void *dirac = NULL;
+	long numFramesPerCall;
+	pcmReadStruct state;
+	int result = -1;
+	
+	// the sizes come from the client, a product that does not fit must not wrap to a small mapping
+	if (expectedOutFrames == ULONG_MAX || !pcmBytes(numChannels, pcm->sNumFrames, &inBytes) || !pcmBytes(numChannels, expectedOutFrames, &outBytes)) {
+		printf("!!! %s: %lu frames of %ld channels are too many\n", pcm->sName, pcm->sNumFrames, numChannels);
+		goto done;
+	}
+	in = (float*)mapSharedMemory(pcm->sName, inBytes, false, &inSize);
+	if (!in) {
+		printf("!!! Could not map %s with %lu frames of %ld channels\n", pcm->sName, pcm->sNumFrames, numChannels);
+		goto done;
+	}
+	if (pcm->sOutName[0]) {
+		out = (float*)mapSharedMemory(pcm->sOutName, outBytes, true, &outSize);
+		if (!out) {
+			printf("!!! Could not map %s with %lu frames of %ld channels\n", pcm->sOutName, expectedOutFrames, numChannels);
+			goto done;
+		}
+	} else {
+		writer = mAiffCreate(outFileName, pcm->sSampleRate, settings->sPcmWordlength, numChannels);
+		if (!writer) {
+			printf("!!! Could not create %s\n", outFileName);
+			goto done;
+		}
+		mAiffPreallocate(writer, expectedOutFrames);
+	}
+	
+	state.sPcm			= in;
+	state.sNumChannels	= numChannels;
+	state.sNumFrames	= pcm->sNumFrames;
+	state.sReadPosition	= 0;
+	state.sEndPosition	= pcm->sNumFrames + (unsigned long)(END_PADDING_SECONDS * pcm->sSampleRate);
+	dirac = dpAcquire(settings->sPool, kDiracLambdaPreview+settings->sLambda, kDiracQualityPreview+settings->sQuality, numChannels, pcm->sSampleRate, &pcmReadData, (void*)&state);
+	if (!dirac) {
+		printf("!!! Could not create DIRAC instance for %s\n", pcm->sName);
+		goto done;
+	}
+	DiracSetProperty(kDiracPropertyTimeFactor, settings->sTime, dirac);
+	DiracSetProperty(kDiracPropertyPitchFactor, settings->sPitch, dirac);
+	DiracSetProperty(kDiracPropertyFormantFactor, settings->sFormant, dirac);
+	
+	numFramesPerCall = bpGetBlockSize(kDiracLambdaPreview+settings->sLambda, kDiracQualityPreview+settings->sQuality, numChannels, DEFAULT_BLOCK_SIZE);
+	if (!out)
+		audio = mAiffAllocateAudioBuffer(numChannels, numFramesPerCall);
+	
+	while (framesDone < expectedOutFrames) {
+		long numFrames = numFramesPerCall;
+		if ((unsigned long)numFrames > expectedOutFrames - framesDone)
+			numFrames = expectedOutFrames - framesDone;
+		
+		// with output memory Dirac writes into the client's memory, there is nothing to copy
+		for (long c = 0; c < numChannels; c++)
+			outPointers[c] = out ? out + c*expectedOutFrames + framesDone : audio[c];
+		long ret = DiracProcess(outPointers, numFrames, dirac);
+		if (ret > 0 && writer && mAiffWriteFrames(writer, audio, ret, numChannels) != ret) {
+			printf("!!! Error writing %s\n", outFileName);
+			goto done;
+		}
+		if (ret > 0)
+			framesDone += ret;
+		if (ret < numFrames) {
+			printf("!!! %s ended after %lu of %lu output frames\n", pcm->sName, framesDone, expectedOutFrames);
+			goto done;
+		}
+	}
+	
+	if (writer) {
+		int error = mAiffCloseWriter(writer);
+		writer = NULL;
+		if (error != 0) {
+			printf("!!! Error writing %s\n", outFileName);
+			goto done;
+		}
+	}
+	result = 0;
+	
+done:
+	if (dirac)
+		dpRelease(settings->sPool, dirac);
+	if (writer)
+		mAiffCloseWriter(writer);
+	if (audio)
+		mAiffDeallocateAudioBuffer(audio, numChannels);
+	if (out)
+		munmap(out, outSize);
+	if (in)
+		munmap(in, inSize);
+	delete[] outPointers;
+	*numOutFrames = framesDone;
+	return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Sends a line to a client
+ */
+static void reply(int fd, const char *format, ...)
+{
+	char line[1024];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(line, sizeof(line)-1, format, args);
+	va_end(args);
+	if (length < 0)
+		return;
+	if (length > (int)sizeof(line)-2)
+		length = sizeof(line)-2;
+	line[length++] = '\n';
+	for (int sent = 0; sent < length; ) {
+		ssize_t res = write(fd, line+sent, length-sent);
+		if (res <= 0)
+			return;
+		sent += res;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Starts a new request with the daemon's defaults, freeing what the last one was sent
+ */
+static void resetRequest(requestStruct *request, daemonStruct *daemon)
+{
+	for (int s = 0; s < request->sNumStrings; s++)
+		delete[] request->sStrings[s];
+	request->sNumStrings = 0;
+	request->sSettings = *daemon->sSettings;
+	memset(request->sJob.sStartsGroup, 0, sizeof(request->sJob.sStartsGroup));
+	request->sJob.sNumFiles = 0;
+	request->sJob.sOutFileNames = NULL;
+	request->sJob.sHasGroups = request->sJob.sInGroup = request->sJob.sNewGroup = false;
+	request->sJob.sTimer = NULL;
+	request->sNumOutFiles = 0;
+	memset(&request->sPcm, 0, sizeof(request->sPcm));
+	request->sHasPcm = false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the number value holds, or invalid if it holds anything else
+ */
+static long double requestNumber(const char *value, long double invalid)
+{
+	char *end;
+	long double number = strtold(value, &end);
+	while (end != value && isspace((unsigned char)*end))
+		end++;
+	if (end == value || *end)
+		return invalid;
+	if (number < -1e9 || number > 1e9)		/* keeps the conversion to int defined */
+		return invalid;
+	return number;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns a copy of value that is freed with the request, or NULL if the request holds too many
+ */
+static char *requestString(requestStruct *request, const char *value)
+{
+	if (request->sNumStrings >= 2*MAX_NUM_FILES)
+		return NULL;
+	char *copy = new char[strlen(value)+1];
+	strcpy(copy, value);
+	request->sStrings[request->sNumStrings++] = copy;
+	return copy;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Runs what a request asked for and sends the outcome to the client. Returns 0 on success
+ */
+static int runRequest(int fd, requestStruct *request)
+{
+	double start = wallClockSeconds();
+	int result;
+	
+	const char *error = checkSettings(&request->sSettings);
+	if (error) {
+		reply(fd, "error %s", error);
+		return -1;
+	}
+	
+	if (request->sHasPcm) {
+		pcmJobStruct *pcm = &request->sPcm;
+		if (pcm->sNumChannels < 1 || !pcm->sNumFrames || pcm->sSampleRate <= 0.f) {
+			reply(fd, "error pcm needs a name, channels, frames and sample rate");
+			return -1;
+		}
+		if (pcm->sNumChannels > MAX_PCM_CHANNELS) {
+			reply(fd, "error pcm has more than %d channels", MAX_PCM_CHANNELS);
+			return -1;
+		}
+		size_t bytes;
+		long double outFrames = (long double)pcm->sNumFrames * request->sSettings.sTime;
+		if (!pcmBytes(pcm->sNumChannels, pcm->sNumFrames, &bytes) || outFrames >= (long double)ULONG_MAX ||
+			!pcmBytes(pcm->sNumChannels, (unsigned long long)outFrames, &bytes)) {
+			reply(fd, "error pcm has too many frames");
+			return -1;
+		}
+		if (!pcm->sOutName[0] && request->sNumOutFiles != 1) {
+			reply(fd, "error pcm needs pcm-output or a single output file");
+			return -1;
+		}
+		unsigned long numOutFrames = 0;
+		result = processPcmJob(pcm, request->sOutFileNames[0], &request->sSettings, &numOutFrames);
+		if (result == 0)
+			reply(fd, "ok %lu %.3f", numOutFrames, wallClockSeconds() - start);
+		else
+			reply(fd, "error processing %s failed after %lu frames", pcm->sName, numOutFrames);
+		return result;
+	}
+	
+	jobStruct *job = &request->sJob;
+	if (!job->sNumFiles) {
+		reply(fd, "error nothing to run, send input or pcm first");
+		return -1;
+	}
+	if (request->sNumOutFiles && request->sNumOutFiles != job->sNumFiles) {
+		reply(fd, "error %d outputs for %d inputs", request->sNumOutFiles, job->sNumFiles);
+		return -1;
+	}
+	job->sOutFileNames = request->sNumOutFiles ? request->sOutFileNames : NULL;
+	result = processJob(job, &request->sSettings);
+	if (result == 0)
+		reply(fd, "ok %.3f", wallClockSeconds() - start);
+	else
+		reply(fd, "error processing %s failed (%d)", job->sInFileNames[0], result);
+	return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Serves one client on one of the daemon's worker threads: reads requests line by line and
+ runs them, until the client hangs up or is silent for too long
+ */
+static void serveConnection(long connection, void *userData)
+{
+	daemonStruct *daemon = (daemonStruct*)userData;
+	int fd = (int)connection;
+	
+	struct timeval timeout;
+	timeout.tv_sec = DAEMON_CLIENT_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	
+	int readFd = dup(fd);
+	FILE *in = readFd >= 0 ? fdopen(readFd, "r") : NULL;
+	if (!in) {
+		if (readFd >= 0)
+			close(readFd);
+		close(fd);
+		return;
+	}
+	
+	requestStruct *request = new requestStruct;
+	request->sJob.sInFileNames = new char*[MAX_NUM_FILES];
+	request->sNumStrings = 0;
+	resetRequest(request, daemon);
+	
+	char line[4096], key[64];
+	while (fgets(line, sizeof(line), in)) {
+		line[strcspn(line, "\r\n")] = 0;
+		int valueStart = 0;
+		if (sscanf(line, "%63s %n", key, &valueStart) < 1 || key[0] == '#')
+			continue;
+		char *value = line + valueStart;
+		
+		// values that are not numbers are out of range, checkSettings() refuses them on run
+		if (strcmp(key, "lambda") == 0)
+			request->sSettings.sLambda = (int)requestNumber(value, -1.);
+		else if (strcmp(key, "quality") == 0)
+			request->sSettings.sQuality = (int)requestNumber(value, -1.);
+		else if (strcmp(key, "time") == 0)
+			request->sSettings.sTime = requestNumber(value, 0.);
+		else if (strcmp(key, "pitch") == 0)
+			request->sSettings.sPitch = requestNumber(value, 0.);
+		else if (strcmp(key, "formant") == 0)
+			request->sSettings.sFormant = requestNumber(value, 0.);
+		else if (strcmp(key, "bits") == 0)
+			request->sSettings.sPcmWordlength = (int)requestNumber(value, 0.);
+		else if (strcmp(key, "input") == 0) {
+			char *name = requestString(request, value);
+			if (!name || !addFileName(&request->sJob, name))
+				reply(fd, "error too many inputs");
+		} else if (strcmp(key, "output") == 0) {
+			char *name = requestString(request, value);
+			if (!name || request->sNumOutFiles >= MAX_NUM_FILES)
+				reply(fd, "error too many outputs");
+			else
+				request->sOutFileNames[request->sNumOutFiles++] = name;
+		} else if (strcmp(key, "pcm") == 0) {
+			pcmJobStruct *pcm = &request->sPcm;
+			request->sHasPcm = sscanf(value, "%255s %ld %lu %f", pcm->sName, &pcm->sNumChannels, &pcm->sNumFrames, &pcm->sSampleRate) == 4;
+			if (!request->sHasPcm)
+				reply(fd, "error pcm <name> <channels> <frames> <sample rate>");
+		} else if (strcmp(key, "pcm-output") == 0) {
+			if (sscanf(value, "%255s", request->sPcm.sOutName) != 1)
+				reply(fd, "error pcm-output <name>");
+		} else if (strcmp(key, "run") == 0) {
+			int result = runRequest(fd, request);
+			__sync_add_and_fetch(&daemon->sNumServed, 1);
+			if (result != 0)
+				__sync_add_and_fetch(&daemon->sNumFailed, 1);
+			resetRequest(request, daemon);
+		} else if (strcmp(key, "status") == 0) {
+			DiracPoolStats poolStats;
+			dpGetStats(daemon->sSettings->sPool, &poolStats);
+			reply(fd, "ok served %ld failed %ld waiting %ld instances %ld reused %ld idle %ld", daemon->sNumServed, daemon->sNumFailed, 
+				  jpQueueGetPending(daemon->sQueue), poolStats.sNumCreated, poolStats.sNumReused, poolStats.sNumIdle);
+		} else if (strcmp(key, "shutdown") == 0) {
+			gDaemonQuit = 1;
+			shutdown(daemon->sListener, SHUT_RDWR);
+			reply(fd, "ok");
+		} else
+			reply(fd, "error unknown command %s", key);
+	}
+	
+	resetRequest(request, daemon);
+	delete[] request->sJob.sInFileNames;
+	delete request;
+	fclose(in);
+	close(fd);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void stopDaemon(int)
+{
+	gDaemonQuit = 1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Listens on the Unix domain socket socketPath and serves clients on numThreads worker threads
+ until it is told to stop. The workers share the Dirac instance pool in settings, so instances
+ stay warm from one job to the next. Returns 0 on success
+ */
+static int runDaemon(char *socketPath, settingsStruct *settings, long numThreads)
+{
+	struct sockaddr_un address;
+	if (strlen(socketPath) >= sizeof(address.sun_path)) {
+		printf("!!! Socket path %s is too long\n", socketPath);
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath);
+	
+	// a socket left behind by a daemon that did not stop cleanly is replaced
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socketPath);
+	if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, DAEMON_BACKLOG) != 0) {
+		printf("!!! Could not listen on %s: %s\n", socketPath, strerror(errno));
+		if (listener >= 0)
+			close(listener);
+		return -1;
+	}
+	
+	daemonStruct daemon;
+	daemon.sSettings	= settings;
+	daemon.sListener	= listener;
+	daemon.sNumServed	= 0;
+	daemon.sNumFailed	= 0;
+	
+	// SIGINT and SIGTERM should interrupt accept() on this thread, so the workers block them
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = stopDaemon;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+	daemon.sQueue = jpQueueCreate(numThreads, serveConnection, &daemon);
+	pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+	if (!daemon.sQueue) {
+		printf("!!! Could not start the workers\n");
+		close(listener);
+		unlink(socketPath);
+		return -1;
+	}
+	
+	printf("Listening on %s with %ld workers\n", socketPath, numThreads);
+	printf("Running DIRAC version %s\n\n", DiracVersion());
+	fflush(stdout);
+	while (!gDaemonQuit) {
+		int fd = accept(listener, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break;
+		}
+		if (jpQueueSubmit(daemon.sQueue, fd) != 0)
+			close(fd);
+	}
+	
+	printf("Stopping, %ld clients are still waiting\n", jpQueueGetPending(daemon.sQueue));
+	fflush(stdout);
+	close(listener);
+	unlink(socketPath);
+	jpQueueDestroy(daemon.sQueue);
+	
+	DiracPoolStats poolStats;
+	dpGetStats(settings->sPool, &poolStats);
+	printf("Done: %ld jobs, %ld failed\n", daemon.sNumServed, daemon.sNumFailed);
+	printf("Dirac instances: %ld created, %ld reused, %ld evicted, %ld idle using about %.1f MB\n", 
+		   poolStats.sNumCreated, poolStats.sNumReused, poolStats.sNumEvicted, poolStats.sNumIdle, (double)poolStats.sBytes/1048576.);
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main (int argc, char **argv)
+{
+	
+	jobStruct *jobs = NULL;
+	long numJobs = 0;
+	long numThreads = 0;
+	long tuneChannels = 0;
+	char **listFileNames = new char*[argc];
+	long numListFiles = 0;
+	char *socketPath = NULL;
+	char *statsPath = NULL;
+	double statsInterval = DEFAULT_STATS_INTERVAL;
+	
+	streamJobStruct streamJob;
+	memset(&streamJob, 0, sizeof(streamJob));
+	streamJob.sOutPath				= (char*)"-";
+	streamJob.sFormat.sContainer	= kPcmWav;
+	streamJob.sFormat.sNumChannels	= 2;
+	streamJob.sFormat.sSampleRate	= 44100.f;
+	streamJob.sOutContainer			= -1;
+	streamJob.sStdoutFd				= STDOUT_FILENO;
+	
+	/* options */
+	if(argc<2) {
+	    usage(argv[0]);
+	}
+	
+	// Audio streamed to stdout must not have anything else in it. The audio gets a copy of stdout,
+	// stdout itself goes to stderr from here on, so everything we print ends up there
+	bool streamToStdout = true;
+	for (long a = 1; a+1 < argc; a++) {
+		if (strcmp(argv[a], "-o") == 0)
+			streamToStdout = (strcmp(argv[a+1], "-") == 0);
+	}
+	for (long a = 1; a < argc && streamToStdout; a++) {
+		if (strcmp(argv[a], "-i") == 0) {
+			fflush(stdout);
+			streamJob.sStdoutFd = dup(STDOUT_FILENO);
+			dup2(STDERR_FILENO, STDOUT_FILENO);
+			break;
+		}
+	}
+	
+	settingsStruct settings;
+	settings.sTime = settings.sPitch = settings.sFormant = 1.;
+	settings.sLambda = 0;
+	settings.sQuality = 0;
+	settings.sQueueDepth = DEFAULT_QUEUE_DEPTH;
+	settings.sReadAhead = DEFAULT_READ_AHEAD;
+	settings.sNumSegments = 1;
+	settings.sNumThreads = 0;
+	settings.sRtBudget = 0.;
+	settings.sCheckpointSeconds = 0.;
+	settings.sStats = NULL;
+	settings.sVerbose = true;
+	settings.sPcmWordlength = DEFAULT_PCM_BITS;
+	bool lambdaGiven = false;
+	long poolMemory = DEFAULT_POOL_MEMORY;
+	
+	long i=1;
+	while(i<argc && argv[i][0]=='-'){
 		switch(argv[i][1]){
 			case 'L':
 				++i; 
-				lambda=atoi(argv[i]);
-				printf("lambda = %d\n", lambda);
+				settings.sLambda=atoi(argv[i]);
+				lambdaGiven = true;
+				printf("lambda = %d\n", settings.sLambda);
 				break;
 			case 'Q':
 				++i;
-				quality=atoi(argv[i]);  
-				printf("quality = %d\n", quality);
+				settings.sQuality=atoi(argv[i]);  
+				printf("quality = %d\n", settings.sQuality);
 				break;
 			case 'T':
 				++i; 
-				time=strtold(argv[i], NULL);
-				printf("time = %Lf\n", time);
+				settings.sTime=strtold(argv[i], NULL);
+				printf("time = %Lf\n", settings.sTime);
 				break;
 			case 'P':
 				++i;
-				pitch=strtold(argv[i], NULL);  
-				printf("pitch = %Lf\n", pitch);
+				settings.sPitch=strtold(argv[i], NULL);  
+				printf("pitch = %Lf\n", settings.sPitch);
 				break;
 			case 'F':
 				++i;
-				formant=strtold(argv[i], NULL);  
-				printf("formant = %Lf\n", formant);
+				settings.sFormant=strtold(argv[i], NULL);  
+				printf("formant = %Lf\n", settings.sFormant);
+				break;
+			case 'W':
+				++i;
+				settings.sQueueDepth=atol(argv[i]);
+				if (settings.sQueueDepth < 1)
+					settings.sQueueDepth = 1;
+				printf("write queue depth = %ld\n", settings.sQueueDepth);
+				break;
+			case 'R':
+				++i;
+				settings.sReadAhead=atol(argv[i]);
+				printf("read ahead = %ld frames\n", settings.sReadAhead);
+				break;
+			case 'i':
+				++i;
+				streamJob.sInPath=argv[i];
+				printf("input stream = %s\n", streamJob.sInPath);
+				break;
+			case 'o':
+				++i;
+				streamJob.sOutPath=argv[i];
+				printf("output stream = %s\n", streamJob.sOutPath);
 				break;
-			case 'f':
+			case 'f': {
+				// every -f starts a new group of files, processed phase locked unless link groups are
+				// given with braces
+				jobStruct *job = addJob(&jobs, &numJobs);
 				++i;
 				while(i<argc && argv[i][0]!='-'){
-					inFileNames[numFiles] = argv[i];
-					numFiles++;
-					if (numFiles >= MAX_NUM_FILES)
+					int numFiles = job->sNumFiles;
+					if (!addFileName(job, argv[i]))
 						break;
 					
-					printf("file = %s\n", argv[i]);
+					if (job->sNumFiles > numFiles)
+						printf("file = %s\n", job->sInFileNames[numFiles]);
 					++i;
 				}
 				--i;
+				if (!job->sNumFiles) {
+					delete[] job->sInFileNames;
+					numJobs--;
+				}
+				break;
+			}
+			case '-':
+				if (strcmp(argv[i], "--jobs") == 0 && i+1 < argc) {
+					++i;
+					numThreads=atol(argv[i]);
+					printf("jobs = %ld\n", numThreads);
+				} else if (strcmp(argv[i], "--segments") == 0 && i+1 < argc) {
+					++i;
+					settings.sNumSegments=atol(argv[i]);
+					printf("segments = %ld\n", settings.sNumSegments);
+				} else if (strcmp(argv[i], "--pool-memory") == 0 && i+1 < argc) {
+					++i;
+					poolMemory=atol(argv[i]);
+					if (poolMemory < 0)
+						poolMemory = 0;
+					printf("pool memory = %ld MB\n", poolMemory);
+				} else if (strcmp(argv[i], "--tune") == 0 && i+1 < argc) {
+					++i;
+					tuneChannels=atol(argv[i]);
+					printf("tune = %ld channels\n", tuneChannels);
+				} else if (strcmp(argv[i], "--rt-budget") == 0 && i+1 < argc) {
+					++i;
+					settings.sRtBudget=atof(argv[i]);
+					printf("realtime budget = %.2fx\n", settings.sRtBudget);
+				} else if (strcmp(argv[i], "--batch") == 0 && i+1 < argc) {
+					++i;
+					listFileNames[numListFiles++] = argv[i];
+					printf("batch list = %s\n", argv[i]);
+				} else if (strcmp(argv[i], "--checkpoint") == 0 && i+1 < argc) {
+					++i;
+					settings.sCheckpointSeconds=atof(argv[i]);
+					printf("checkpoint every %.1fs\n", settings.sCheckpointSeconds);
+				} else if (strcmp(argv[i], "--stats") == 0 && i+1 < argc) {
+					++i;
+					statsPath=argv[i];
+					printf("statistics = %s\n", statsPath);
+				} else if (strcmp(argv[i], "--stats-every") == 0 && i+1 < argc) {
+					++i;
+					statsInterval=atof(argv[i]);
+					printf("statistics every %.1fs\n", statsInterval);
+				} else if (strcmp(argv[i], "--daemon") == 0 && i+1 < argc) {
+					++i;
+					socketPath=argv[i];
+					printf("daemon socket = %s\n", socketPath);
+				} else if (strcmp(argv[i], "--pcm-bits") == 0 && i+1 < argc) {
+					++i;
+					settings.sPcmWordlength=atoi(argv[i]);
+					printf("pcm output = %d bit\n", settings.sPcmWordlength);
+				} else if (strcmp(argv[i], "--raw") == 0 && i+1 < argc) {
+					++i;
+					PcmStreamFormat *format = &streamJob.sFormat;
+					format->sContainer = kPcmRaw;
+					format->sFloat = (strcmp(argv[i], "f32") == 0);
+					format->sWordlength = format->sFloat ? 32 : atoi(argv[i]+1);
+					if (argv[i][0] != (format->sFloat ? 'f' : 's') || (format->sWordlength != 16 && format->sWordlength != 24 && format->sWordlength != 32))
+						usage(argv[0]);
+					printf("raw input = %s\n", argv[i]);
+				} else if (strcmp(argv[i], "--channels") == 0 && i+1 < argc) {
+					++i;
+					streamJob.sFormat.sNumChannels=atol(argv[i]);
+					printf("channels = %ld\n", streamJob.sFormat.sNumChannels);
+				} else if (strcmp(argv[i], "--rate") == 0 && i+1 < argc) {
+					++i;
+					streamJob.sFormat.sSampleRate=atof(argv[i]);
+					printf("sample rate = %.0f\n", streamJob.sFormat.sSampleRate);
+				} else if (strcmp(argv[i], "--out-format") == 0 && i+1 < argc) {
+					++i;
+					streamJob.sOutContainer = -1;
+					for (int k = kPcmRaw; k <= kPcmW64; k++)
+						if (strcmp(argv[i], containerNames[k]) == 0)
+							streamJob.sOutContainer = k;
+					if (streamJob.sOutContainer < 0)
+						usage(argv[0]);
+					printf("output format = %s\n", argv[i]);
+				} else
+					usage(argv[0]);
 				break;
 			case 'h':
 				usage(argv[0]); 
@@ -223,115 +2799,163 @@ int main (int argc, char **argv)
 		++i;
 	}
 	
-	if (!numFiles) {
-		printf("!!! No input files specified - exiting\n");
-		exit(0);
-	}
-	
-	printf("\n------------------------------------------------------\n");
-	printf("total number of files to process = %d\n\n", numFiles);
-	for ( v = 0; v < numFiles; v++) {
-		printf("file #%d = %s\t\t", v, inFileNames[v]);
-		bool fileValid = (mAiffGetSampleRate(inFileNames[v]) > 0.);
-		if (fileValid) {
-			numChannels += (fileChannelCounts[v] = mAiffGetNumberOfChannels(inFileNames[v]));
-			unsigned long numFrames = mAiffGetNumberOfFrames(inFileNames[v]);
-			if (numFrames > maxFrames)
-				maxFrames = numFrames;
-			outFileNames[v] = createOutputFilePath(inFileNames[v], "processed-");
-			printf("<OK>\t%d channels --> %s\n", fileChannelCounts[v], outFileNames[v]);
-		} else {
-			printf("!!! invalid !!!\n");
-			printf("!!! Aborting due to invalid input file format\n");
-			exit(0);
-		}
+	const char *error = checkSettings(&settings);
+	if (error) {
+		printf("!!! %s - exiting\n", error);
+		exit(-1);
 	}
-	printf("\ntotal number of channels to process = %d\n", numChannels);
-	printf("------------------------------------------------------\n\n");
 	
+	// Block sizes that process fastest on this machine, measured by --tune
+	bpLoad(NULL);
+	if (tuneChannels > 0)
+		return tuneBlockSizes(&settings, tuneChannels) ? -1 : 0;
 	
-	// first file determines sample rate
-	float sr = mAiffGetSampleRate(inFileNames[0]);
+	for (long l = 0; l < numListFiles; l++)
+		readBatchList(listFileNames[l], &jobs, &numJobs);
+	delete[] listFileNames;
 	
-	// We stuff all our programs' state variables that we need to access in order to read from the file in a struct
-	// You will normally pass your instance pointer "this" as userData, but since this is not a class we cannot do this here
-	userDataStruct state;
-	state.sTotalNumChannels		= numChannels;
-	state.sReadPosition			= 0;
-	state.sMaxFrames			= maxFrames;
-	state.sInFileNames			= inFileNames;
-	state.sInFileNumChannels	= fileChannelCounts;
-	state.sOutFileNames			= outFileNames;
-	state.sNumFiles				= numFiles;
+	if (!numJobs && !socketPath && !streamJob.sInPath) {
+		printf("!!! No input files specified - exiting\n");
+		exit(0);
+	}
 	
+	if (settings.sReadAhead < 2*READ_AHEAD_CHUNK)
+		settings.sReadAhead = 2*READ_AHEAD_CHUNK;
 	
-	void *dirac = DiracCreate(kDiracLambdaPreview+lambda, kDiracQualityPreview+quality, numChannels, sr, &myReadData, (void*)&state);		// (1) fastest
-	if (!dirac) {
-		printf("!! ERROR !!\n\n\tCould not create DIRAC instance\n\tCheck number of channels and sample rate!\n");
-		exit(-1);
+	// segments are rendered out of order, there is no point up to which the output is complete
+	if (settings.sCheckpointSeconds > 0. && settings.sNumSegments != 1) {
+		printf("--checkpoint is ignored with --segments\n");
+		settings.sCheckpointSeconds = 0.;
 	}
 	
+	// The realtime budget picks the quality, and the lambda too unless it was given. Whatever
+	// this machine has not been measured for yet is measured now, while nothing else runs
+	if (settings.sRtBudget > 0. && socketPath) {
+		printf("--rt-budget is ignored in daemon mode\n");
+		settings.sRtBudget = 0.;
+	}
+	if (settings.sRtBudget > 0.) {
+		if (!lambdaGiven)
+			settings.sLambda = RT_BUDGET_LAMBDA;
+		if (!prepareRtBudget(&settings, jobs, numJobs))
+			exit(-1);
+	}
 	
+	// Jobs, link groups and segments with the same parameters reuse each other's Dirac instances
+	settings.sPool = dpCreate((unsigned long long)poolMemory << 20);
+	if (!settings.sPool) {
+		printf("!!! Out of memory - exiting\n");
+		exit(-1);
+	}
 	
-	// Initialize our output files
-	for ( v = 0; v < numFiles; v++) {
-		mAiffInitFile(outFileNames[v], 
-					  mAiffGetSampleRate(inFileNames[v]), 
-					  mAiffGetWordlength(inFileNames[v]), 
-					  mAiffGetNumberOfChannels(inFileNames[v]));
+	// With --stats all jobs report to the same reporter, which writes a JSON object per line
+	FILE *statsFile = NULL;
+	if (statsPath) {
+		statsFile = strcmp(statsPath, "-") == 0 ? stdout : fopen(statsPath, "w");
+		if (statsFile)
+			settings.sStats = jsReporterCreate(statsFile, statsInterval);
+		if (!settings.sStats) {
+			printf("!!! Could not write statistics to %s - exiting\n", statsPath);
+			exit(-1);
+		}
 	}
 	
-    // Pass the values to our DIRAC instance 	
-    DiracSetProperty(kDiracPropertyTimeFactor, time, dirac);
-    DiracSetProperty(kDiracPropertyPitchFactor, pitch, dirac);
-    DiracSetProperty(kDiracPropertyFormantFactor, formant, dirac);
+	// A stream is a job of its own, processed as it comes in
+	if (streamJob.sInPath && !socketPath) {
+		if (numJobs)
+			printf("Input files are ignored with -i\n");
+		if (settings.sNumSegments != 1 || settings.sCheckpointSeconds > 0.)
+			printf("--segments and --checkpoint are ignored with -i\n");
+		
+		// a reader that goes away makes writes fail, which ends the job, instead of killing us
+		signal(SIGPIPE, SIG_IGN);
+		int result = processStreamJob(&streamJob, &settings);
+		closeStats(&settings, statsFile);
+		dpDestroy(settings.sPool);
+		return result ? -1 : 0;
+	}
 	
-	// Print our settings to the console
-	DiracPrintSettings(dirac);
+	// Daemon mode: the command line only gives the defaults, the jobs come from the clients
+	if (socketPath) {
+		if (numJobs)
+			printf("Input files are ignored in daemon mode\n");
+		if (numThreads < 1)
+			numThreads = jpAvailableCpus();
+		settings.sNumThreads = numThreads;
+		settings.sNumSegments = 1;
+		settings.sVerbose = false;
+		int result = runDaemon(socketPath, &settings, numThreads);
+		closeStats(&settings, statsFile);
+		dpDestroy(settings.sPool);
+		return result ? -1 : 0;
+	}
 	
-    printf("Running DIRAC version %s\nStarting processing\n", DiracVersion());
+	// A single group of files is processed right here, just like it always was, unless it is
+	// split into segments
+	settings.sNumThreads = numThreads;
+	if (numJobs == 1) {
+		PhaseTimer timer;
+		ptInit(&timer, jobs->sInFileNames[0]);
+		jobs->sTimer = &timer;
+		int result = processJob(jobs, &settings);
+		if (settings.sVerbose) {
+			// the link groups and segments time themselves on threads of their own, this sums them up
+			const PhaseTimer *timers[] = { &timer };
+			printf("\nTime spent:\n");
+			ptPrintBreakdown(timers, NULL, 1);
+		}
+		jobs->sTimer = NULL;
+		ptDispose(&timer);
+		closeStats(&settings, statsFile);
+		dpDestroy(settings.sPool);
+		return result ? -1 : 0;
+	}
 	
-    // This is an arbitrary number of frames. Change as you see fit
-    long numFramesPerCall = 4096;
+	// Batch mode: every group gets its own Dirac instance, the groups are spread across a pool of
+	// threads. By default we use as many threads as we have CPUs available to us
+	long availableCpus = jpAvailableCpus();
+	if (numThreads < 1)
+		numThreads = availableCpus;
+	settings.sVerbose = false;
 	
-    // Allocate buffer for output
-	float **audio = mAiffAllocateAudioBuffer(numChannels, numFramesPerCall);
-	long lastPercent = -1;
-	for(;;) {
-		
-        // Call the DIRAC process function with current time and pitch settings
-        // Returns: the number of frames in audio
-        long ret = DiracProcess(audio, numFramesPerCall, dirac);
-		
-		// print performance measurements
-		long percent = (long)(100.f*(double)state.sReadPosition / (double)state.sMaxFrames);
-        if (lastPercent != percent) {
-            printf("\t%d%% done\n", (int)percent);
-            lastPercent = percent;
-			fflush(stdout);
-		}
-		
-		long channel = 0;
-		for ( v = 0; v < numFiles; v++) {
-			mAiffWriteData(outFileNames[v], audio+channel, numFramesPerCall, fileChannelCounts[v]);
-			channel += fileChannelCounts[v];
-		}
-		
-		if (state.sReadPosition > state.sMaxFrames + numFramesPerCall)
-			break;
-   	}
+	// the groups already keep all threads busy
+	if (settings.sNumSegments != 1) {
+		printf("--segments is ignored in batch mode\n");
+		settings.sNumSegments = 1;
+	}
 	
-	// Free buffers
-	mAiffDeallocateAudioBuffer(audio, numChannels);
+	batchStruct batch;
+	batch.sJobs			= jobs;
+	batch.sNumJobs		= numJobs;
+	batch.sSettings		= &settings;
+	batch.sNumDone		= 0;
+	batch.sNumFailed	= 0;
 	
-	// destroy DIRAC instance
-	DiracDestroy( dirac );
+	printf("\nProcessing %ld jobs on %ld threads (%ld CPUs available)\n", numJobs, numThreads < numJobs ? numThreads : numJobs, availableCpus);
+	printf("Running DIRAC version %s\n\n", DiracVersion());
+	double start = wallClockSeconds();
+	long threadsUsed = jpRun(numJobs, numThreads, runBatchJob, &batch);
+	double elapsed = wallClockSeconds() - start;
 	
-	// free our file names
-	for ( v = 0; v < numFiles; v++)
-		delete[] outFileNames[v];
+	double jobSeconds = 0.;
+	PhaseTimes phases;
+	memset(&phases, 0, sizeof(phases));
+	for (long j = 0; j < numJobs; j++) {
+		jobSeconds += jobs[j].sSeconds;
+		ptMergeTimes(&phases, &jobs[j].sTimes);
+	}
+	printf("\nDone: %ld jobs in %.2fs on %ld threads (%.2fs of processing, %.2fx), %ld failed\n", 
+		   numJobs, elapsed, threadsUsed, jobSeconds, elapsed > 0. ? jobSeconds/elapsed : 0., batch.sNumFailed);
+	printf("Time spent by all jobs: read %.2fs, DSP %.2fs, write %.2fs\n", 
+		   phases.sSeconds[kPhaseRead], phases.sSeconds[kPhaseDsp], phases.sSeconds[kPhaseWrite]);
+	DiracPoolStats poolStats;
+	dpGetStats(settings.sPool, &poolStats);
+	printf("Dirac instances: %ld created, %ld reused, %ld evicted, %ld idle using about %.1f MB\n", 
+		   poolStats.sNumCreated, poolStats.sNumReused, poolStats.sNumEvicted, poolStats.sNumIdle, (double)poolStats.sBytes/1048576.);
+	closeStats(&settings, statsFile);
+	dpDestroy(settings.sPool);
 	
-	return 0;
+	return batch.sNumFailed ? -1 : 0;
 }
 
 //---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
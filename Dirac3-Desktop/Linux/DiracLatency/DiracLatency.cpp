@@ -0,0 +1,689 @@
+/*
+ "DiracLatency.cpp" DiracLatency Source File - Disclaimer:
+
+ IMPORTANT:  This file and its contents are subject to the terms set forth in the
+ "License Agreement.txt" file that accompanies this distribution.
+
+ Measures how late Dirac (DiracCreate()/DiracProcess()) and DiracFx (DiracFxProcessFloat())
+ actually are, instead of trusting DiracFxLatencyFrames(), which is nominal and the same for
+ every setting, while the core API reports nothing at all. Clicks and chirps are rendered
+ through every combination of lambda, quality, time and pitch factor and sample rate asked
+ for. The chirps are cross-correlated with what they should have turned into, which gives the
+ group delay, and the clicks give the onset, where the first edge of an event is heard. The
+ results are written as a table, as CSV and as a C header the wrappers can compile in for
+ latency compensation.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#include "Dirac.h"
+
+
+// the events of the test signals: the first one after LEAD_IN_SECONDS, then one every
+// EVENT_SPACING_SECONDS of input. Events are searched for in a window around where they
+// would be without latency, reaching a quarter of the spacing before and half of it after
+#define NUM_EVENTS				6
+#define LEAD_IN_SECONDS			1.0
+#define EVENT_SPACING_SECONDS	2.0
+
+// the chirps sweep exponentially from CHIRP_LOW_HZ to CHIRP_HIGH_HZ, which must stay below
+// Nyquist when pitched up
+#define CHIRP_SECONDS			0.25
+#define CHIRP_LOW_HZ			200.
+#define CHIRP_HIGH_HZ			5000.
+
+// the onset of a click is where it first reaches this fraction (-20 dB) of its peak
+#define ONSET_THRESHOLD			0.1
+
+// an event quieter than this at its peak was not found
+#define SILENCE					1e-4
+
+// highest number of entries in a list given on the command line
+#define MAX_LIST				32
+
+enum {
+	kApiCore = 0,
+	kApiFx,
+	kNumApis
+};
+
+enum {
+	kSignalClicks = 0,
+	kSignalChirps,
+	kNumSignals
+};
+
+static const char *apiNames[kNumApis] = { "core", "fx" };
+
+
+// A list of values from the command line, e.g. "0,2,4" or "0-6"
+typedef struct {
+	double sValues[MAX_LIST];
+	long sCount;
+} listStruct;
+
+
+// The parameter matrix
+typedef struct {
+	listStruct sApis, sLambdas, sQualities, sTimes, sPitches, sRates;
+	long sBlockFrames;					/* frames per DiracProcess() call, input frames per DiracFxProcessFloat() call */
+} latencySettingsStruct;
+
+
+// One point of the matrix
+typedef struct {
+	int sApi;
+	int sLambda, sQuality;				/* sLambda is -1 for DiracFx, which has none */
+	double sTime, sPitch;
+	float sSampleRate;
+} configStruct;
+
+
+// What a combination measured, in output frames relative to where an event would be heard
+// without latency, i.e. time factor * its input position
+typedef struct {
+	long sNominal;						/* DiracFxLatencyFrames(), -1 for the core API */
+	long sGroupDelay, sGroupDelaySpread;	/* median and range over the chirps */
+	long sOnset, sOnsetSpread;			/* median and range over the clicks */
+	long sPeak;							/* median of where the clicks peak */
+	long sNumFound;						/* events found, of 2*NUM_EVENTS */
+	const char *sError;					/* NULL if measured */
+} resultStruct;
+
+
+// State of the read callback: the input signal, then silence
+typedef struct {
+	const float *sSignal;
+	long sSignalFrames;
+	long sPosition;
+} playerStruct;
+
+
+#pragma mark ---- Signals ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Input frame at which event k starts
+ */
+static long eventFrame(long k, float sr)
+{
+	return (long)((LEAD_IN_SECONDS + k * EVENT_SPACING_SECONDS) * sr);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ An exponential chirp from low*pitch to high*pitch Hz lasting seconds, with 5 ms fades at both
+ ends. With pitch and stretch set to the factors of a combination this is what a chirp of the
+ input should turn into
+ */
+static void makeChirp(float *chirp, long numFrames, double pitch, float sr)
+{
+	double seconds = numFrames / sr, fade = 0.005 * sr;
+	double rate = log(CHIRP_HIGH_HZ / CHIRP_LOW_HZ) / seconds;
+	for (long i = 0; i < numFrames; i++) {
+		double t = i / sr;
+		double phase = 2. * M_PI * pitch * CHIRP_LOW_HZ * (exp(rate * t) - 1.) / rate;
+		double gain = 0.5;
+		if (i < fade)
+			gain *= 0.5 - 0.5 * cos(M_PI * i / fade);
+		if (numFrames - 1 - i < fade)
+			gain *= 0.5 - 0.5 * cos(M_PI * (numFrames - 1 - i) / fade);
+		chirp[i] = (float)(gain * sin(phase));
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Fills signal[0...numFrames-1] with silence and NUM_EVENTS clicks (single frame impulses) or
+ chirps
+ */
+static void makeSignal(int kind, float *signal, long numFrames, float sr)
+{
+	long chirpFrames = (long)(CHIRP_SECONDS * sr);
+	float *chirp = new float[chirpFrames];
+	makeChirp(chirp, chirpFrames, 1., sr);
+
+	memset(signal, 0, numFrames*sizeof(float));
+	for (long k = 0; k < NUM_EVENTS; k++) {
+		long start = eventFrame(k, sr);
+		if (kind == kSignalClicks)
+			signal[start] = 0.5f;
+		else
+			memcpy(signal + start, chirp, chirpFrames*sizeof(float));
+	}
+	delete[] chirp;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Dirac's read callback
+ */
+static long myReadData(float **chdata, long numFrames, void *userData)
+{
+	playerStruct *player = (playerStruct*)userData;
+	for (long i = 0; i < numFrames; i++, player->sPosition++)
+		chdata[0][i] = player->sPosition < player->sSignalFrames ? player->sSignal[player->sPosition] : 0.f;
+	return numFrames;
+}
+
+
+#pragma mark ---- Measuring ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ In place radix 2 FFT of re/im[0...size-1], size a power of 2. inverse does not scale
+ */
+static void fft(double *re, double *im, long size, bool inverse)
+{
+	for (long i = 1, j = 0; i < size; i++) {
+		long bit = size >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			std::swap(re[i], re[j]);
+			std::swap(im[i], im[j]);
+		}
+	}
+	for (long length = 2; length <= size; length <<= 1) {
+		double angle = (inverse ? 2. : -2.) * M_PI / length;
+		double stepR = cos(angle), stepI = sin(angle), wr = 1., wi = 0.;
+		for (long k = 0; k < length/2; k++) {
+			for (long i = 0; i < size; i += length) {
+				double *ar = re + i + k, *ai = im + i + k, *br = ar + length/2, *bi = ai + length/2;
+				double tr = *br * wr - *bi * wi, ti = *br * wi + *bi * wr;
+				*br = *ar - tr;
+				*bi = *ai - ti;
+				*ar += tr;
+				*ai += ti;
+			}
+			double w = wr * stepR - wi * stepI;
+			wi = wr * stepI + wi * stepR;
+			wr = w;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Returns the lag in [0, numLags) at which reference[0...refFrames-1] fits out[0...] best,
+ where out has numLags+refFrames frames. Uses the envelope of the cross-correlation, so a
+ phase shift of the output does not pull the peak off by parts of a period
+ */
+static long bestLag(const float *out, long numLags, const float *reference, long refFrames)
+{
+	long size = 1;
+	while (size < numLags + refFrames)
+		size <<= 1;
+	double *xr = new double[size], *xi = new double[size], *rr = new double[size], *ri = new double[size];
+	for (long i = 0; i < size; i++) {
+		xr[i] = i < numLags + refFrames ? out[i] : 0.;
+		rr[i] = i < refFrames ? reference[i] : 0.;
+		xi[i] = ri[i] = 0.;
+	}
+	fft(xr, xi, size, false);
+	fft(rr, ri, size, false);
+
+	// X times conj(R), with the negative frequencies dropped for the analytic signal
+	for (long k = 0; k < size; k++) {
+		double gain = k == 0 || k == size/2 ? 1. : (k < size/2 ? 2. : 0.);
+		double re = xr[k] * rr[k] + xi[k] * ri[k], im = xi[k] * rr[k] - xr[k] * ri[k];
+		xr[k] = gain * re;
+		xi[k] = gain * im;
+	}
+	fft(xr, xi, size, true);
+
+	long best = 0;
+	double bestMagnitude = -1.;
+	for (long lag = 0; lag < numLags; lag++) {
+		double magnitude = xr[lag] * xr[lag] + xi[lag] * xi[lag];
+		if (magnitude > bestMagnitude) {
+			bestMagnitude = magnitude;
+			best = lag;
+		}
+	}
+	delete[] xr;
+	delete[] xi;
+	delete[] rr;
+	delete[] ri;
+	return best;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Renders signal[0...signalFrames-1] followed by silence through the combination into
+ out[0...outFrames-1]. Returns an error message, or NULL
+ */
+static const char *render(configStruct *config, long blockFrames, const float *signal, long signalFrames, float *out, long outFrames)
+{
+	playerStruct player;
+	player.sSignal = signal;
+	player.sSignalFrames = signalFrames;
+	player.sPosition = 0;
+	long done = 0;
+
+	if (config->sApi == kApiCore) {
+		void *dirac = DiracCreate(kDiracLambdaPreview+config->sLambda, kDiracQualityPreview+config->sQuality, 1, config->sSampleRate, &myReadData, (void*)&player);
+		if (!dirac)
+			return "could not create instance";
+		DiracSetProperty(kDiracPropertyTimeFactor, config->sTime, dirac);
+		DiracSetProperty(kDiracPropertyPitchFactor, config->sPitch, dirac);
+		while (done < outFrames) {
+			float *channel = out + done;
+			long ret = DiracProcess(&channel, std::min(blockFrames, outFrames - done), dirac);
+			if (ret <= 0)
+				break;
+			done += ret;
+		}
+		DiracDestroy(dirac);
+	} else {
+		void *fx = DiracFxCreate(kDiracQualityPreview+config->sQuality, config->sSampleRate, 1);
+		if (!fx)
+			return "could not create instance";
+		long maxOut = DiracFxMaxOutputBufferFramesRequired(config->sTime, config->sPitch, blockFrames);
+		float *in = new float[blockFrames], *block = new float[maxOut];
+		long calls = 0, maxCalls = 2 * (long)(outFrames / (blockFrames * config->sTime)) + 2;
+		while (done < outFrames && calls++ < maxCalls) {
+			myReadData(&in, blockFrames, &player);
+			long ret = DiracFxProcessFloat(config->sTime, config->sPitch, &in, &block, blockFrames, fx);
+			if (ret < 0)
+				break;
+			ret = std::min(ret, outFrames - done);
+			memcpy(out + done, block, ret*sizeof(float));
+			done += ret;
+		}
+		delete[] in;
+		delete[] block;
+		DiracFxDestroy(fx);
+	}
+	if (done < outFrames)
+		return "processing failed";
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void sortFrames(long *values, long count)
+{
+	for (long i = 1; i < count; i++)
+		for (long j = i; j > 0 && values[j-1] > values[j]; j--)
+			std::swap(values[j-1], values[j]);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Measures one point of the matrix, signals[] holding the clicks and chirps at its sample rate
+ */
+static void measure(configStruct *config, long blockFrames, float **signals, long signalFrames, resultStruct *result)
+{
+	float sr = config->sSampleRate;
+	memset(result, 0, sizeof(resultStruct));
+	result->sNominal = config->sApi == kApiFx ? DiracFxLatencyFrames(sr) : -1;
+
+	// the search windows around each event, in output frames
+	double spacing = config->sTime * EVENT_SPACING_SECONDS * sr;
+	long before = (long)(0.25 * spacing), after = (long)(0.5 * spacing);
+	long refFrames = (long)(CHIRP_SECONDS * config->sTime * sr);
+	long outFrames = (long)(config->sTime * signalFrames) + after + refFrames;
+	float *out = new float[outFrames];
+	float *reference = new float[refFrames];
+	makeChirp(reference, refFrames, config->sPitch, sr);
+
+	long onsets[NUM_EVENTS], peaks[NUM_EVENTS], delays[NUM_EVENTS];
+	long numClicks = 0, numChirps = 0;
+
+	for (int kind = 0; kind < kNumSignals && !result->sError; kind++) {
+		result->sError = render(config, blockFrames, signals[kind], signalFrames, out, outFrames);
+		for (long k = 0; k < NUM_EVENTS && !result->sError; k++) {
+			long expected = (long)(config->sTime * eventFrame(k, sr));
+			long start = std::max(0L, expected - before), end = expected + after;
+			float peak = 0.f;
+			long peakAt = start;
+			for (long i = start; i < end; i++)
+				if (fabsf(out[i]) > peak) {
+					peak = fabsf(out[i]);
+					peakAt = i;
+				}
+			if (peak < SILENCE)
+				continue;
+
+			if (kind == kSignalClicks) {
+				long onset = start;
+				while (fabsf(out[onset]) < ONSET_THRESHOLD * peak)
+					onset++;
+				onsets[numClicks] = onset - expected;
+				peaks[numClicks++] = peakAt - expected;
+			} else
+				delays[numChirps++] = start + bestLag(out + start, end - start, reference, refFrames) - expected;
+		}
+	}
+	delete[] out;
+	delete[] reference;
+	if (result->sError)
+		return;
+
+	result->sNumFound = numClicks + numChirps;
+	if (!numClicks || !numChirps) {
+		result->sError = "output is silent";
+		return;
+	}
+	sortFrames(onsets, numClicks);
+	sortFrames(peaks, numClicks);
+	sortFrames(delays, numChirps);
+	result->sOnset = onsets[numClicks/2];
+	result->sOnsetSpread = onsets[numClicks-1] - onsets[0];
+	result->sPeak = peaks[numClicks/2];
+	result->sGroupDelay = delays[numChirps/2];
+	result->sGroupDelaySpread = delays[numChirps-1] - delays[0];
+}
+
+
+#pragma mark ---- Output ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void writeCsvHeader(FILE *out)
+{
+	fprintf(out, "api,lambda,quality,time,pitch,sample_rate,nominal_frames,group_delay_frames,group_delay_spread,onset_frames,onset_spread,peak_frames,events_found,error\n");
+	fflush(out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Writes one row for a combination. Values that don't apply are left empty
+ */
+static void writeCsvResult(FILE *out, configStruct *config, resultStruct *result)
+{
+	fprintf(out, "%s,", apiNames[config->sApi]);
+	if (config->sLambda >= 0)
+		fprintf(out, "%d", config->sLambda);
+	fprintf(out, ",%d,%.4f,%.4f,%.0f,", config->sQuality, config->sTime, config->sPitch, config->sSampleRate);
+	if (result->sNominal >= 0)
+		fprintf(out, "%ld", result->sNominal);
+	if (result->sError)
+		fprintf(out, ",,,,,,%ld,%s\n", result->sNumFound, result->sError);
+	else
+		fprintf(out, ",%ld,%ld,%ld,%ld,%ld,%ld,\n", result->sGroupDelay, result->sGroupDelaySpread, result->sOnset, result->sOnsetSpread, result->sPeak,
+				result->sNumFound);
+	fflush(out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The start of the C header: the type of the table and the opening of the array
+ */
+static void writeHeaderStart(FILE *out)
+{
+	char date[32];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%d", gmtime(&now));
+
+	fprintf(out, "/*\n \"DiracMeasuredLatency.h\" Source File - Disclaimer:\n\n");
+	fprintf(out, " IMPORTANT:  This file and its contents are subject to the terms set forth in the\n");
+	fprintf(out, " \"License Agreement.txt\" file that accompanies this distribution.\n\n");
+	fprintf(out, " Abstract: Latencies of Dirac %s as measured by DiracLatency on %s. Generated, do not edit.\n\n */\n\n", DiracVersion(), date);
+	fprintf(out, "#ifndef __DIRACMEASUREDLATENCY__\n#define __DIRACMEASUREDLATENCY__\n\n#include <math.h>\n#include <stddef.h>\n\n\n");
+	fprintf(out, "typedef struct {\n");
+	fprintf(out, "\tint sApi;\t\t\t\t\t\t/* 0 = DiracCreate()/DiracProcess(), 1 = DiracFx */\n");
+	fprintf(out, "\tint sLambda, sQuality;\t\t\t/* 0 = kDiracLambdaPreview/kDiracQualityPreview ..., sLambda is -1 for DiracFx */\n");
+	fprintf(out, "\tfloat sTime, sPitch, sSampleRate;\n");
+	fprintf(out, "\tlong sGroupDelayFrames;\t\t\t/* output frames from time factor * input position to where an event is heard */\n");
+	fprintf(out, "\tlong sOnsetFrames;\t\t\t\t/* the same to where its first edge is heard, may be negative */\n");
+	fprintf(out, "} DiracMeasuredLatency;\n\n");
+	fprintf(out, "static const DiracMeasuredLatency kDiracMeasuredLatency[] = {\n");
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void writeHeaderResult(FILE *out, configStruct *config, resultStruct *result)
+{
+	if (result->sError)
+		return;
+	fprintf(out, "\t{ %d, %d, %d, %.4ff, %.4ff, %.1ff, %ld, %ld },\n", config->sApi, config->sLambda, config->sQuality, config->sTime, config->sPitch,
+			config->sSampleRate, result->sGroupDelay, result->sOnset);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ The end of the array and the lookup
+ */
+static void writeHeaderEnd(FILE *out)
+{
+	fprintf(out, "\t{ -1, 0, 0, 0.f, 0.f, 0.f, 0, 0 }\n};\n\n\n");
+	fprintf(out, "//\t-----------------------------------------------------------------------------------------\n");
+	fprintf(out, "//\tReturns the measured group delay in output frames for the given settings, taken from the\n");
+	fprintf(out, "//\tentry with the same api, lambda and quality that is closest in sample rate, then in time and\n");
+	fprintf(out, "//\tpitch factor. Measure the rates and factors you use, nothing is interpolated.\n");
+	fprintf(out, "//\tReturns -1 if nothing was measured for this api, lambda and quality.\n//\n");
+	fprintf(out, "static long DiracMeasuredLatencyFrames(int api, int lambda, int quality, float time, float pitch, float sampleRate)\n{\n");
+	fprintf(out, "\tconst DiracMeasuredLatency *best = NULL;\n\tdouble bestDistance = 0.;\n");
+	fprintf(out, "\tfor (const DiracMeasuredLatency *e = kDiracMeasuredLatency; e->sApi >= 0; e++) {\n");
+	fprintf(out, "\t\tif (e->sApi != api || e->sQuality != quality || (api == 0 && e->sLambda != lambda))\n\t\t\tcontinue;\n");
+	fprintf(out, "\t\tdouble distance = 1000. * fabs(log(e->sSampleRate / sampleRate)) + fabs(log(e->sTime / time)) + fabs(log(e->sPitch / pitch));\n");
+	fprintf(out, "\t\tif (!best || distance < bestDistance) {\n\t\t\tbest = e;\n\t\t\tbestDistance = distance;\n\t\t}\n\t}\n");
+	fprintf(out, "\treturn best ? best->sGroupDelayFrames : -1;\n}\n");
+	fprintf(out, "//\t-----------------------------------------------------------------------------------------\n\n\n");
+	fprintf(out, "#endif /* __DIRACMEASUREDLATENCY__ */\n");
+}
+
+
+#pragma mark ---- Main program ----
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Parses a comma separated list of numbers, where integer lists may also have ranges like 0-6.
+ Returns false if the list is empty, too long or not made of numbers
+ */
+static bool parseList(const char *text, listStruct *list, bool ranges)
+{
+	list->sCount = 0;
+	while (*text) {
+		char *end;
+		double from = strtod(text, &end), to = from;
+		if (end == text)
+			return false;
+		if (ranges && *end == '-') {
+			text = end+1;
+			to = strtod(text, &end);
+			if (end == text || to < from)
+				return false;
+		}
+		for (double v = from; v <= to; v += 1.) {
+			if (list->sCount >= MAX_LIST)
+				return false;
+			list->sValues[list->sCount++] = v;
+		}
+		if (*end && *end != ',')
+			return false;
+		text = *end ? end+1 : end;
+	}
+	return list->sCount > 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+ Parses a comma separated list of names into their indices in names[]
+ */
+static bool parseNames(const char *text, const char **names, int numNames, listStruct *list)
+{
+	list->sCount = 0;
+	while (*text) {
+		size_t length = strcspn(text, ",");
+		int found = -1;
+		for (int k = 0; k < numNames; k++)
+			if (strlen(names[k]) == length && strncmp(text, names[k], length) == 0)
+				found = k;
+		if (found < 0 || list->sCount >= MAX_LIST)
+			return false;
+		list->sValues[list->sCount++] = found;
+		text += length;
+		if (*text)
+			text++;
+	}
+	return list->sCount > 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void usage(char *s)
+{
+	printf("%s -{options}\n", s);
+	printf(" options, lists are comma separated, integer lists may have ranges like 0-6\n");
+	printf("   -L     <list>         : Lambda values (0-6) of Dirac, default=0-6\n");
+	printf("   -Q     <list>         : Qualities (0-3), default=0-3\n");
+	printf("   -T     <list>         : Time stretch factors, default=0.5,0.8,1,1.25,2\n");
+	printf("   -P     <list>         : Pitch shift factors, default=0.5,1,2\n");
+	printf("   -r     <list>         : Sample rates in Hz, default=44100\n");
+	printf("   -B     <int>          : Frames per call, default=1024\n");
+	printf("   --api <list>          : core (DiracProcess) and/or fx (DiracFxProcessFloat),\n");
+	printf("                           default=core,fx\n");
+	printf("   --csv <string>        : Write the results as CSV to this file, - = stdout\n");
+	printf("   --header <string>     : Write the results as a C header with a lookup function\n");
+	printf("\n");
+	printf("   -h                    : print this message.\n\n");
+	exit(1);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main (int argc, char **argv)
+{
+	latencySettingsStruct settings;
+	parseList("0-1", &settings.sApis, true);
+	parseList("0-6", &settings.sLambdas, true);
+	parseList("0-3", &settings.sQualities, true);
+	parseList("0.5,0.8,1,1.25,2", &settings.sTimes, false);
+	parseList("0.5,1,2", &settings.sPitches, false);
+	parseList("44100", &settings.sRates, false);
+	settings.sBlockFrames = 1024;
+	const char *csvPath = NULL, *headerPath = NULL;
+
+	for (long i = 1; i < argc; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == 'h' || i+1 >= argc)
+			usage(argv[0]);
+		const char *option = argv[i], *value = argv[++i];
+		bool ok = true;
+		if (strcmp(option, "-L") == 0)				ok = parseList(value, &settings.sLambdas, true);
+		else if (strcmp(option, "-Q") == 0)			ok = parseList(value, &settings.sQualities, true);
+		else if (strcmp(option, "-T") == 0)			ok = parseList(value, &settings.sTimes, false);
+		else if (strcmp(option, "-P") == 0)			ok = parseList(value, &settings.sPitches, false);
+		else if (strcmp(option, "-r") == 0)			ok = parseList(value, &settings.sRates, false);
+		else if (strcmp(option, "-B") == 0)			settings.sBlockFrames = atol(value);
+		else if (strcmp(option, "--api") == 0)		ok = parseNames(value, apiNames, kNumApis, &settings.sApis);
+		else if (strcmp(option, "--csv") == 0)		csvPath = value;
+		else if (strcmp(option, "--header") == 0)	headerPath = value;
+		else										ok = false;
+		if (!ok)
+			usage(argv[0]);
+	}
+	if (settings.sBlockFrames < 1)
+		usage(argv[0]);
+	for (long k = 0; k < settings.sLambdas.sCount; k++)
+		if (settings.sLambdas.sValues[k] < 0 || settings.sLambdas.sValues[k] > 6)		usage(argv[0]);
+	for (long k = 0; k < settings.sQualities.sCount; k++)
+		if (settings.sQualities.sValues[k] < 0 || settings.sQualities.sValues[k] > 3)	usage(argv[0]);
+	for (long k = 0; k < settings.sTimes.sCount; k++)
+		if (settings.sTimes.sValues[k] <= 0.)											usage(argv[0]);
+	for (long k = 0; k < settings.sRates.sCount; k++)
+		if (settings.sRates.sValues[k] < 8000.)										usage(argv[0]);
+
+	// the chirps must not alias when pitched up
+	for (long k = 0; k < settings.sPitches.sCount; k++)
+		for (long r = 0; r < settings.sRates.sCount; r++)
+			if (settings.sPitches.sValues[k] <= 0. || settings.sPitches.sValues[k] * CHIRP_HIGH_HZ > 0.45 * settings.sRates.sValues[r]) {
+				printf("!!! Pitch factor %g is too high for %g Hz, the test chirp would reach %g Hz\n", settings.sPitches.sValues[k], settings.sRates.sValues[r],
+					   settings.sPitches.sValues[k] * CHIRP_HIGH_HZ);
+				return -1;
+			}
+
+	// with results on stdout our own messages go to stderr
+	FILE *csv = NULL, *header = NULL;
+	if (csvPath)
+		csv = strcmp(csvPath, "-") == 0 ? stdout : fopen(csvPath, "w");
+	if (headerPath)
+		header = strcmp(headerPath, "-") == 0 ? stdout : fopen(headerPath, "w");
+	if ((csvPath && !csv) || (headerPath && !header)) {
+		printf("!!! Could not create %s\n", (csvPath && !csv) ? csvPath : headerPath);
+		return -1;
+	}
+	FILE *log = (csv == stdout || header == stdout) ? stderr : stdout;
+
+	long numConfigs = 0;
+	for (long a = 0; a < settings.sApis.sCount; a++)
+		numConfigs += (settings.sApis.sValues[a] == kApiCore ? settings.sLambdas.sCount : 1) * settings.sQualities.sCount * settings.sTimes.sCount *
+					  settings.sPitches.sCount * settings.sRates.sCount;
+	fprintf(log, "DiracLatency: Dirac %s, %ld combinations, in output frames relative to time factor * input position\n\n", DiracVersion(), numConfigs);
+	fprintf(log, "%-4s %6s %7s %6s %6s %6s  %7s  %-18s  %-18s  %6s\n", "api", "lambda", "quality", "time", "pitch", "rate", "nominal",
+			"group delay/spread", "onset/spread", "peak");
+	if (csv)
+		writeCsvHeader(csv);
+	if (header)
+		writeHeaderStart(header);
+
+	long signalFrames = 0, numFailed = 0;
+	float *signals[kNumSignals] = { NULL, NULL };
+
+	for (long r = 0; r < settings.sRates.sCount; r++) {
+		float sr = (float)settings.sRates.sValues[r];
+		signalFrames = eventFrame(NUM_EVENTS, sr);
+		for (int kind = 0; kind < kNumSignals; kind++) {
+			delete[] signals[kind];
+			signals[kind] = new float[signalFrames];
+			makeSignal(kind, signals[kind], signalFrames, sr);
+		}
+		for (long a = 0; a < settings.sApis.sCount; a++) {
+			int api = (int)settings.sApis.sValues[a];
+			long numLambdas = api == kApiCore ? settings.sLambdas.sCount : 1;
+			for (long l = 0; l < numLambdas; l++)
+			for (long q = 0; q < settings.sQualities.sCount; q++)
+			for (long t = 0; t < settings.sTimes.sCount; t++)
+			for (long p = 0; p < settings.sPitches.sCount; p++) {
+				configStruct config;
+				config.sApi				= api;
+				config.sLambda			= api == kApiCore ? (int)settings.sLambdas.sValues[l] : -1;
+				config.sQuality			= (int)settings.sQualities.sValues[q];
+				config.sTime			= settings.sTimes.sValues[t];
+				config.sPitch			= settings.sPitches.sValues[p];
+				config.sSampleRate		= sr;
+
+				resultStruct result;
+				measure(&config, settings.sBlockFrames, signals, signalFrames, &result);
+				if (csv)
+					writeCsvResult(csv, &config, &result);
+				if (header)
+					writeHeaderResult(header, &config, &result);
+
+				fprintf(log, "%-4s %6d %7d %6.3f %6.3f %6.0f  ", apiNames[api], config.sLambda, config.sQuality, config.sTime, config.sPitch, sr);
+				if (result.sNominal >= 0)
+					fprintf(log, "%7ld  ", result.sNominal);
+				else
+					fprintf(log, "%7s  ", "-");
+				if (result.sError) {
+					numFailed++;
+					fprintf(log, "!!! %s\n", result.sError);
+				} else
+					fprintf(log, "%8ld / %-7ld  %8ld / %-7ld  %6ld\n", result.sGroupDelay, result.sGroupDelaySpread, result.sOnset, result.sOnsetSpread,
+							result.sPeak);
+				fflush(log);
+			}
+		}
+	}
+
+	fprintf(log, "\nDone: %ld combinations, %ld failed\n", numConfigs, numFailed);
+	for (int kind = 0; kind < kNumSignals; kind++)
+		delete[] signals[kind];
+	if (header) {
+		writeHeaderEnd(header);
+		if (header != stdout)
+			fclose(header);
+	}
+	if (csv && csv != stdout)
+		fclose(csv);
+	return numFailed ? 1 : 0;
+}
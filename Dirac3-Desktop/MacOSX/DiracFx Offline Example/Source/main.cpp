@@ -14,11 +14,9 @@
 #include <stdlib.h>
 #include <math.h>
 #include "MiniAiff.h"
+#include "MiniAiffStream.h"
 #include "Dirac.h"
-
-//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-double gExecTimeTotal = 0.;
-//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "PhaseTimer.h"
 
 
 int main()
@@ -46,6 +44,15 @@ int main()
 	unsigned long inputNumFrames = mAiffGetNumberOfFrames(infileName);
 	if (sampleRate <= 0.f) {printf("Error opening input file\n"); exit(-1);}
 	
+	/* Times reading, DSP and writing for this instance only, */
+	/* so it stays correct with several instances on several threads */
+	PhaseTimer timer;
+	ptInit(&timer, infileName);
+	
+	/* Open the input file once, we read from it sequentially below */
+	mAiffFile *inFile = mAiffOpen(infileName);
+	if (!inFile) {printf("Error opening input file\n"); exit(-1);}
+	
 	/* Instantiate our DiracFx object */
 	void *diracFx = DiracFxCreate(kDiracQualityGood, sampleRate, numChannels);
 	if (!diracFx) {
@@ -82,7 +89,7 @@ int main()
 														DiracFxMaxOutputBufferFramesRequired(time, pitch, latencyFrames));
 	
 	/* Read the first chunk from the file */
-	mAiffReadData(infileName, latencyBufferIn, 0, latencyFrames, numChannels);
+	mAiffReadFrames(inFile, latencyBufferIn, latencyFrames, numChannels);
 	
 	/* The first block is processed manually to account for the latency */
 	DiracFxProcessFloat(time, pitch, latencyBufferIn,
@@ -97,22 +104,29 @@ int main()
 	double bavg = 0;
 	for(;;) {
 		
-		/* read chunk at position inputFramesProcessed */
-		mAiffReadData(infileName, audioIn, inputFramesProcessed, numFrames, 
-					  numChannels);
+		/* read the next chunk, this is at position inputFramesProcessed */
+		{
+			PhaseScope timeRead(&timer, kPhaseRead);	// ............................. time reading ........................................
+			mAiffReadFrames(inFile, audioIn, numFrames, numChannels);
+		}
 		
-		DiracStartClock();								// ............................. start timer ..........................................
-		
-		/* Call the process function with current time and pitch settings */
-		/* Returns: the number of frames in audioOut */
-        long ret = DiracFxProcessFloat(time, pitch, audioIn, audioOut, 
-									   numFrames, diracFx);
+		long ret;
+		{
+			PhaseScope timeDsp(&timer, kPhaseDsp);		// ............................. time DSP ............................................
+			
+			/* Call the process function with current time and pitch settings */
+			/* Returns: the number of frames in audioOut */
+			ret = DiracFxProcessFloat(time, pitch, audioIn, audioOut, 
+									  numFrames, diracFx);
+		}
 		
 		bavg += (numFrames/sampleRate);
-		gExecTimeTotal += DiracClockTimeSeconds();		// ............................. stop timer ..........................................
 		
 		/* Write data to the output file */
-        mAiffWriteData(oufileName, audioOut, ret, numChannels);
+		{
+			PhaseScope timeWrite(&timer, kPhaseWrite);	// ............................. time writing ........................................
+			mAiffWriteData(oufileName, audioOut, ret, numChannels);
+		}
 		
 		/* Increase our input position */
         inputFramesProcessed += numFrames;
@@ -123,7 +137,15 @@ int main()
    	}
 	/* ***************** END MAIN PROCESSING LOOP ******************* */
 	
-	printf("Avg. algorithm speed vs. realtime = %3.2fx : 1 (DSP only) = %3.1f%% CPU load\n", bavg/gExecTimeTotal, 100.*(gExecTimeTotal/bavg));
+	PhaseTimes times;
+	ptGetTimes(&timer, &times);
+	double dspSeconds = times.sSeconds[kPhaseDsp];
+	printf("Avg. algorithm speed vs. realtime = %3.2fx : 1 (DSP only) = %3.1f%% CPU load\n", bavg/dspSeconds, 100.*(dspSeconds/bavg));
+	
+	/* Where the time went */
+	const PhaseTimer *timers[] = { &timer };
+	ptPrintBreakdown(timers, &bavg, 1);
+	ptDispose(&timer);
 	
 	
 	/* ***************** CLEAN UP ******************* */
@@ -136,6 +158,9 @@ int main()
 	/* Destroy DiracFx instance */
 	DiracFxDestroy( diracFx );
 	
+	/* Close our input file */
+	mAiffClose(inFile);
+	
 	/* We're done! */
     printf("\nDone!\n");
 	
@@ -55,7 +55,7 @@ COMPONENT_ENTRY(DiracFxAU)
 //	DiracFxAU::DiracFxAU
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 DiracFxAU::DiracFxAU(AudioUnit component)
-	: AUEffectBase(component)
+	: AUEffectBase(component), mCallbackTimingEnabled(false)
 {
 	CreateElements();
 	Globals()->UseIndexedParameters(kNumberOfParameters);
@@ -125,6 +125,18 @@ OSStatus			DiracFxAU::GetPropertyInfo (AudioUnitPropertyID	inID,
                                                         UInt32 &		outDataSize,
                                                         Boolean &		outWritable)
 {
+	if (inScope == kAudioUnitScope_Global) {
+		switch (inID) {
+			case kDiracFxAUProperty_CallbackTiming:
+				outDataSize = sizeof(CallbackTimingSnapshot);
+				outWritable = false;
+				return noErr;
+			case kDiracFxAUProperty_CallbackTimingEnabled:
+				outDataSize = sizeof(UInt32);
+				outWritable = true;
+				return noErr;
+		}
+	}
 	return AUEffectBase::GetPropertyInfo (inID, inScope, inElement, outDataSize, outWritable);
 }
 
@@ -136,9 +148,51 @@ OSStatus			DiracFxAU::GetProperty(	AudioUnitPropertyID inID,
                                                         AudioUnitElement 	inElement,
                                                         void *			outData )
 {
+	if (inScope == kAudioUnitScope_Global) {
+		switch (inID) {
+			case kDiracFxAUProperty_CallbackTiming:
+			{
+				// one kernel per channel, they render one after the other in the same call
+				CallbackTimingSnapshot *sum = (CallbackTimingSnapshot*)outData;
+				CallbackTimingSnapshot *snapshot = new CallbackTimingSnapshot;
+				memset(sum, 0, sizeof(CallbackTimingSnapshot));
+				for (KernelList::iterator it = mKernelList.begin(); it != mKernelList.end(); ++it) {
+					DiracFxAUKernel *kernel = (DiracFxAUKernel*)*it;
+					if (kernel && ctSnapshot(kernel->GetTiming(), snapshot))
+						ctMerge(sum, snapshot);
+				}
+				delete snapshot;
+				return noErr;
+			}
+			case kDiracFxAUProperty_CallbackTimingEnabled:
+				*(UInt32*)outData = mCallbackTimingEnabled ? 1 : 0;
+				return noErr;
+		}
+	}
 	return AUEffectBase::GetProperty (inID, inScope, inElement, outData);
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	DiracFxAU::SetProperty
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			DiracFxAU::SetProperty(	AudioUnitPropertyID inID,
+                                                        AudioUnitScope 		inScope,
+                                                        AudioUnitElement 	inElement,
+                                                        const void *		inData,
+                                                        UInt32 			inDataSize )
+{
+	if (inScope == kAudioUnitScope_Global && inID == kDiracFxAUProperty_CallbackTimingEnabled) {
+		if (inDataSize != sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+		mCallbackTimingEnabled = *(const UInt32*)inData != 0;
+		for (KernelList::iterator it = mKernelList.begin(); it != mKernelList.end(); ++it) {
+			DiracFxAUKernel *kernel = (DiracFxAUKernel*)*it;
+			if (kernel) ctSetEnabled(kernel->GetTiming(), mCallbackTimingEnabled);
+		}
+		return noErr;
+	}
+	return AUEffectBase::SetProperty (inID, inScope, inElement, inData, inDataSize);
+}
+
 
 #pragma mark ____DiracFxAUEffectKernel
 
@@ -164,6 +218,8 @@ void		DiracFxAU::DiracFxAUKernel::Process(	const Float32 	*inSourceP,
 	float pitch = powf(2.f, cent / 1200.f);
 	float *sourceP = (float*)inSourceP;
 	float *destP = (float*)inDestP;
+	unsigned long long timingStart = ctBegin(&mTiming);
 	DiracFxProcessFloatInterleaved(1., pitch, sourceP, destP, nSampleFrames, mDiracFx);
+	ctEnd(&mTiming, timingStart, nSampleFrames);
 }
 
@@ -42,6 +42,7 @@
 #include "AUEffectBase.h"
 #include "DiracFxAUVersion.h"
 #include "Dirac.h"
+#include "CallbackTiming.h"
 
 #if AU_DEBUG_DISPATCHER
 	#include "AUDebugDispatcher.h"
@@ -65,6 +66,12 @@ enum {
 	kNumberOfParameters=1
 };
 
+// custom properties, global scope
+enum {
+	kDiracFxAUProperty_CallbackTiming = 64000,			// CallbackTimingSnapshot, read only: timing of Process() over all channels
+	kDiracFxAUProperty_CallbackTimingEnabled = 64001	// UInt32, read/write: 1 records the timing, 0 (default) does not
+};
+
 #pragma mark ____DiracFxAU
 class DiracFxAU : public AUEffectBase
 {
@@ -74,7 +81,12 @@ public:
 	virtual ~DiracFxAU () { delete mDebugDispatcher; }
 #endif
 	
-	virtual AUKernelBase *		NewKernel() { return new DiracFxAUKernel(this); }
+	virtual AUKernelBase *		NewKernel() 
+	{
+		DiracFxAUKernel *kernel = new DiracFxAUKernel(this);
+		ctSetEnabled(kernel->GetTiming(), mCallbackTimingEnabled);
+		return kernel;
+	}
 	
 	virtual	OSStatus			GetParameterValueStrings(AudioUnitScope			inScope,
 														 AudioUnitParameterID		inParameterID,
@@ -95,6 +107,12 @@ public:
 											AudioUnitElement 		inElement,
 											void *			outData);
 	
+	virtual OSStatus			SetProperty(AudioUnitPropertyID inID,
+											AudioUnitScope 		inScope,
+											AudioUnitElement 		inElement,
+											const void *			inData,
+											UInt32 			inDataSize);
+	
 	virtual Float64				GetLatency() {return DiracFxLatencyFrames(GetSampleRate()) / GetSampleRate();}
 
  	virtual	bool				SupportsTail () { return false; }
@@ -105,6 +123,8 @@ public:
     
 	
 protected:
+	bool mCallbackTimingEnabled;
+	
 		class DiracFxAUKernel : public AUKernelBase		// most of the real work happens here
 	{
 public:
@@ -112,6 +132,7 @@ public:
 		: AUKernelBase(inAudioUnit)
 		{
 			mDiracFx = DiracFxCreate(kDiracQualityBest, GetSampleRate(), 1);
+			ctInit(&mTiming, GetSampleRate());
 		}
 		
 		~DiracFxAUKernel()
@@ -130,10 +151,14 @@ public:
 		
         virtual void		Reset();
 		
+		// how long Process() takes, written by the render thread
+		CallbackTiming *	GetTiming() { return &mTiming; }
+		
 
 	private: //state variables...
 	
 		void *mDiracFx;
+		CallbackTiming mTiming;
 	};
 };
 
@@ -20,13 +20,12 @@
 #include <string.h>
 #include <math.h>
 #include "MiniAiff.h"
+#include "MiniAiffStream.h"
 #include "Dirac.h"
+#include "BlockProfile.h"
+#include "PhaseTimer.h"
 
 
-//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-double gExecTimeTotal = 0.;
-//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-
 #pragma mark ---- Callback and structs ----
 
 
@@ -36,7 +35,8 @@ double gExecTimeTotal = 0.;
 typedef struct {
 	unsigned long sReadPosition;
 	long sNumChannels;
-	char *sInFileName;
+	mAiffFile *sInFile;
+	PhaseTimer *sTimer;				// times this instance, see PhaseTimer.h
 } userDataStruct;
 
 
@@ -57,15 +57,13 @@ long myReadData(float **chdata, long numFrames, void *userData)
 	userDataStruct *state = (userDataStruct*)userData;
 	if (!state)	return 0;
 
-	// we want to exclude the time it takes to read in the data from disk or memory, so we stop the clock until 
-	// we've read in the requested amount of data
-	gExecTimeTotal += DiracClockTimeSeconds(); 		// ............................. stop timer ..........................................
+	// we want to exclude the time it takes to read in the data from disk or memory, so it is timed as a phase
+	// of its own. This pauses the DSP scope that DiracProcess() was called in until we return
+	PhaseScope timeRead(state->sTimer, kPhaseRead);	// ............................. time reading ........................................
 	
-	long res = mAiffReadData(state->sInFileName, chdata, state->sReadPosition, numFrames, state->sNumChannels);
+	long res = mAiffReadFrames(state->sInFile, chdata, numFrames, state->sNumChannels);
 	state->sReadPosition += numFrames;
 	
-	DiracStartClock();								// ............................. start timer ..........................................
-	
 	return res;	
 	
 }
@@ -98,8 +96,17 @@ int main()
 	userDataStruct state;
 	state.sNumChannels = numChannels;
 	state.sReadPosition = 0;
-	state.sInFileName = new char[strlen(infileName)+1];
-	memmove(state.sInFileName, infileName, (strlen(infileName)+1)*sizeof(char));
+	
+	// Times reading, DSP and writing for this instance only, so it stays correct with several instances on several threads
+	PhaseTimer timer;
+	ptInit(&timer, infileName);
+	state.sTimer = &timer;
+	
+	state.sInFile = mAiffOpen(infileName);		// opened once, the callback reads from it sequentially
+	if (!state.sInFile) {
+		printf("ERROR: Could not open input file\n");
+		exit(-1);
+	}
 	
 
     // First we set up DIRAC to process numChannels of audio
@@ -139,8 +146,10 @@ int main()
     unsigned long newOutframe = numf*time;
     long lastPercent = -1;
 	
-    // This is an arbitrary number of frames. Change as you see fit
-    long numFrames = 8192;
+    // The number of frames per call that DiracCLI --tune found fastest on this machine for the
+    // lambda and quality we passed to DiracCreate() above, or 8192 if it has not been measured
+	bpLoad(NULL);
+    long numFrames = bpGetBlockSize(kDiracLambdaPreview, kDiracQualityPreview, numChannels, 8192);
 	
     // Allocate buffer for output
 	float **audio = mAiffAllocateAudioBuffer(numChannels, numFrames);
@@ -152,24 +161,31 @@ int main()
 	for(;;) {
 		
 		
-		DiracStartClock();								// ............................. start timer ..........................................
-		
-        // Call the DIRAC process function with current time and pitch settings
-        // Returns: the number of frames in audio
-        long ret = DiracProcess(audio, numFrames, dirac);
+		long ret;
+		{
+			PhaseScope timeDsp(&timer, kPhaseDsp);		// ............................. time DSP ............................................
+			
+			// Call the DIRAC process function with current time and pitch settings
+			// Returns: the number of frames in audio
+			ret = DiracProcess(audio, numFrames, dirac);
+		}
 		bavg += (numFrames/sr);
-		gExecTimeTotal += DiracClockTimeSeconds();		// ............................. stop timer ..........................................
 
 		// print performance measurements
 		long percent = 100.f*(double)outframes / (double)newOutframe;
         if (lastPercent != percent) {
-            printf("\t%d%% done, avg. algorithm speed vs. realtime = %3.2f : 1 (DSP only), CPU load (peak, DSP+disk): %3.2f%%\n", (int)percent, bavg/gExecTimeTotal, DiracPeakCpuUsagePercent(dirac));
+			PhaseTimes times;
+			ptGetTimes(&timer, &times);
+            printf("\t%d%% done, avg. algorithm speed vs. realtime = %3.2f : 1 (DSP only), CPU load (peak, DSP+disk): %3.2f%%\n", (int)percent, bavg/times.sSeconds[kPhaseDsp], DiracPeakCpuUsagePercent(dirac));
             lastPercent = percent;
 			fflush(stdout);
 		}
 		
         // Write the data to the output file
-        mAiffWriteData(oufileName, audio, numFrames, numChannels);
+		{
+			PhaseScope timeWrite(&timer, kPhaseWrite);	// ............................. time writing ........................................
+			mAiffWriteData(oufileName, audio, numFrames, numChannels);
+		}
 		
         // Increase our counter for the percentage
         outframes += numFrames;
@@ -179,14 +195,20 @@ int main()
    	}
 	
 	
+	// where the time went
+	printf("\n");
+	const PhaseTimer *timers[] = { &timer };
+	ptPrintBreakdown(timers, &bavg, 1);
+	ptDispose(&timer);
+	
     // Free buffers
 	mAiffDeallocateAudioBuffer(audio, numChannels);
 	
 	// destroy DIRAC instance
 	DiracDestroy( dirac );
 	
-	// free our file name
-	delete[] state.sInFileName;
+	// close our input file
+	mAiffClose(state.sInFile);
 	
     // Done!
     printf("\nDone!\n");
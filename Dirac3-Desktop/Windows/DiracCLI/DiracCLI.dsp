@@ -89,6 +89,18 @@ LINK32=link.exe
 
 SOURCE=.\Source\main.cpp
 # End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\MiniAiffStream.cpp"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\BlockProfile.cpp"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\PhaseTimer.cpp"
+# End Source File
 # End Group
 # Begin Group "Header-Dateien"
 
@@ -101,6 +113,26 @@ SOURCE="..\..\Common Files\Dirac.h"
 
 SOURCE="..\..\Common Files\MiniAiff.h"
 # End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\MiniAiffStream.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\PcmConvert.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\BlockProfile.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\PhaseTimer.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\CallbackTiming.h"
+# End Source File
 # End Group
 # Begin Group "Ressourcendateien"
 
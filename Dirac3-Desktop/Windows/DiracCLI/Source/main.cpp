@@ -17,12 +17,21 @@
 #include <memory.h>
 
 #include "MiniAiff.h"
+#include "MiniAiffStream.h"
 #include "Dirac.h"
+#include "BlockProfile.h"
 
 // this defines the maximum number of files that we can use on input. This is enough to process
 // 7.1 format and beyond. Increase accordingly if you need more
 #define MAX_NUM_FILES		16
 
+// Dirac reads ahead of the output it produces. Past the end of the input we feed it this much
+// silence so it can finish its last output frames, then we report the end of the file
+#define END_PADDING_SECONDS	1.0
+
+// number of input files whose headers are read at the same time
+#define PROBE_THREADS		16
+
 #ifdef WIN32
 	#define strtold strtod
 #endif
@@ -35,9 +44,10 @@
 // and variables
 typedef struct {
 	unsigned long sReadPosition, sMaxFrames;
+	unsigned long sEndPosition;			/* reads from here on report the end of the file */
 	long sTotalNumChannels, sNumFiles;
 	long *sInFileNumChannels;
-	char **sInFileNames;
+	mAiffFile **sInFiles;
 	char **sOutFileNames;
 } userDataStruct;
 
@@ -60,9 +70,17 @@ long myReadData(float **chdata, long numFrames, void *userData)
 	userDataStruct *state = (userDataStruct*)userData;
 	if (!state)	return 0;
 	
+	// Reads up to sEndPosition are zero padded past the end of the input. After that there is
+	// nothing left, not even silence
+	if (state->sReadPosition >= state->sEndPosition) {
+		for (long c = 0; c < state->sTotalNumChannels; c++)
+			memset(chdata[c], 0, numFrames*sizeof(float));
+		return 0;
+	}
+	
 	long channel = 0;
 	for (long v = 0; v < state->sNumFiles; v++) {
-		mAiffReadData(state->sInFileNames[v], chdata+channel, state->sReadPosition, numFrames, state->sInFileNumChannels[v]);
+		mAiffReadFrames(state->sInFiles[v], chdata+channel, numFrames, state->sInFileNumChannels[v]);
 		channel += state->sInFileNumChannels[v];
 	}
 	
@@ -163,6 +181,8 @@ int main (int argc, char **argv)
 	int numChannels = 0, v;
 	char *inFileNames[MAX_NUM_FILES];
 	char *outFileNames[MAX_NUM_FILES];
+	mAiffFile *inFiles[MAX_NUM_FILES];
+	mAiffInfo inFileInfo[MAX_NUM_FILES];
 	long fileChannelCounts[MAX_NUM_FILES];
 	unsigned long maxFrames = 0;
 	
@@ -230,12 +250,15 @@ int main (int argc, char **argv)
 	
 	printf("\n------------------------------------------------------\n");
 	printf("total number of files to process = %d\n\n", numFiles);
+	
+	// read the format of all input files up front, in parallel
+	mAiffProbeFiles(inFileNames, numFiles, inFileInfo, PROBE_THREADS);
 	for ( v = 0; v < numFiles; v++) {
 		printf("file #%d = %s\t\t", v, inFileNames[v]);
-		bool fileValid = (mAiffGetSampleRate(inFileNames[v]) > 0.);
+		bool fileValid = (inFileInfo[v].sSampleRate > 0.);
 		if (fileValid) {
-			numChannels += (fileChannelCounts[v] = mAiffGetNumberOfChannels(inFileNames[v]));
-			unsigned long numFrames = mAiffGetNumberOfFrames(inFileNames[v]);
+			numChannels += (fileChannelCounts[v] = inFileInfo[v].sNumChannels);
+			unsigned long numFrames = inFileInfo[v].sNumFrames;
 			if (numFrames > maxFrames)
 				maxFrames = numFrames;
 			outFileNames[v] = createOutputFilePath(inFileNames[v], "processed-");
@@ -251,7 +274,16 @@ int main (int argc, char **argv)
 	
 	
 	// first file determines sample rate
-	float sr = mAiffGetSampleRate(inFileNames[0]);
+	float sr = inFileInfo[0].sSampleRate;
+	
+	// Open our input files once. The read callback then reads from them sequentially
+	for ( v = 0; v < numFiles; v++) {
+		inFiles[v] = mAiffOpen(inFileNames[v]);
+		if (!inFiles[v]) {
+			printf("!!! Could not open %s - exiting\n", inFileNames[v]);
+			exit(-1);
+		}
+	}
 	
 	// We stuff all our programs' state variables that we need to access in order to read from the file in a struct
 	// You will normally pass your instance pointer "this" as userData, but since this is not a class we cannot do this here
@@ -259,7 +291,8 @@ int main (int argc, char **argv)
 	state.sTotalNumChannels		= numChannels;
 	state.sReadPosition			= 0;
 	state.sMaxFrames			= maxFrames;
-	state.sInFileNames			= inFileNames;
+	state.sEndPosition			= maxFrames + (unsigned long)(END_PADDING_SECONDS * sr);
+	state.sInFiles				= inFiles;
 	state.sInFileNumChannels	= fileChannelCounts;
 	state.sOutFileNames			= outFileNames;
 	state.sNumFiles				= numFiles;
@@ -276,9 +309,9 @@ int main (int argc, char **argv)
 	// Initialize our output files
 	for ( v = 0; v < numFiles; v++) {
 		mAiffInitFile(outFileNames[v], 
-					  mAiffGetSampleRate(inFileNames[v]), 
-					  mAiffGetWordlength(inFileNames[v]), 
-					  mAiffGetNumberOfChannels(inFileNames[v]));
+					  inFileInfo[v].sSampleRate, 
+					  inFileInfo[v].sWordlength, 
+					  inFileInfo[v].sNumChannels);
 	}
 	
     // Pass the values to our DIRAC instance 	
@@ -291,35 +324,52 @@ int main (int argc, char **argv)
 	
     printf("Running DIRAC version %s\nStarting processing\n", DiracVersion());
 	
-    // This is an arbitrary number of frames. Change as you see fit
-    long numFramesPerCall = 4096;
+    // The number of frames per call that DiracCLI --tune found fastest on this machine for our
+    // lambda, quality and number of channels, or 4096 if it has not been measured
+	bpLoad(NULL);
+    long numFramesPerCall = bpGetBlockSize(kDiracLambdaPreview+lambda, kDiracQualityPreview+quality, numChannels, 4096);
 	
     // Allocate buffer for output
 	float **audio = mAiffAllocateAudioBuffer(numChannels, numFramesPerCall);
 	long lastPercent = -1;
-	for(;;) {
+	
+	// The output is exactly as long as the input times the time factor. Dirac compensates for its
+	// own latency, the input it needs beyond the end of the file is padded by the read callback.
+	// We stop once we have all output frames, the last block is usually a short one
+	unsigned long outFrames = (unsigned long)((long double)maxFrames * time);
+	unsigned long framesDone = 0;
+	while (framesDone < outFrames) {
+		long numFrames = numFramesPerCall;
+		if ((unsigned long)numFrames > outFrames - framesDone)
+			numFrames = outFrames - framesDone;
 		
         // Call the DIRAC process function with current time and pitch settings
         // Returns: the number of frames in audio
-        long ret = DiracProcess(audio, numFramesPerCall, dirac);
+        long ret = DiracProcess(audio, numFrames, dirac);
 		
-		// print performance measurements
-		long percent = (long)(100.f*(double)state.sReadPosition / (double)state.sMaxFrames);
-        if (lastPercent != percent) {
-            printf("\t%d%% done\n", (int)percent);
-            lastPercent = percent;
-			fflush(stdout);
-		}
+		// Dirac ran out of input early
+		if (ret <= 0)
+			break;
+		if (ret < numFrames)
+			numFrames = ret;
 		
 		long channel = 0;
 		for ( v = 0; v < numFiles; v++) {
-			mAiffWriteData(outFileNames[v], audio+channel, numFramesPerCall, fileChannelCounts[v]);
+			mAiffWriteData(outFileNames[v], audio+channel, numFrames, fileChannelCounts[v]);
 			channel += fileChannelCounts[v];
 		}
+		framesDone += numFrames;
 		
-		if (state.sReadPosition > state.sMaxFrames + numFramesPerCall)
-			break;
+		// print performance measurements
+		long percent = (long)(100.f*(double)framesDone / (double)outFrames);
+        if (lastPercent != percent) {
+            printf("\t%d%% done\n", (int)percent);
+            lastPercent = percent;
+			fflush(stdout);
+		}
    	}
+	if (framesDone < outFrames)
+		printf("!!! Input ended after %lu of %lu output frames\n", framesDone, outFrames);
 	
 	// Free buffers
 	mAiffDeallocateAudioBuffer(audio, numChannels);
@@ -327,6 +377,10 @@ int main (int argc, char **argv)
 	// destroy DIRAC instance
 	DiracDestroy( dirac );
 	
+	// close our input files
+	for ( v = 0; v < numFiles; v++)
+		mAiffClose(inFiles[v]);
+	
 	// free our file names
 	for ( v = 0; v < numFiles; v++)
 		delete[] outFileNames[v];
@@ -19,6 +19,8 @@
 #include <string.h>
 #include <math.h>
 #include "MiniAiff.h"
+#include "MiniAiffStream.h"
+#include "MiniAiffPrefetch.h"
 #include "Dirac.h"
 
 
@@ -39,9 +41,9 @@ typedef struct {
 // you will want to replace this by a pointer to "this" in order to access your instance methods
 // and variables
 typedef struct {
-	long sReadPosition;
 	long sNumChannels;
-	char *sInFileName;
+	mAiffFile *sInFile;
+	mAiffPrefetch *sPrefetch;
 } userDataStruct;
 
 
@@ -61,8 +63,7 @@ long myReadData(float **chdata, long numFrames, void *userData)
 	userDataStruct *state = (userDataStruct*)userData;
 	if (!state)	return 0;
 	
-	long res = mAiffReadData(state->sInFileName, chdata, state->sReadPosition, numFrames, state->sNumChannels);
-	state->sReadPosition += numFrames;
+	long res = mAiffPrefetchRead(state->sPrefetch, chdata, numFrames);
 	
 	return res;	
 	
@@ -120,9 +121,17 @@ int main()
 	// You will normally pass your instance pointer "this" as userData, but since this is not a class we cannot do this here
 	userDataStruct state;
 	state.sNumChannels = numChannels;
-	state.sReadPosition = 0;
-	state.sInFileName = new char[strlen(infileName)+1];
-	memmove(state.sInFileName, infileName, (strlen(infileName)+1)*sizeof(char));
+	state.sInFile = mAiffOpen(infileName);		// opened once, the callback reads from it sequentially
+	if (!state.sInFile) {
+		printf("ERROR: Could not open input file\n");
+		exit(-1);
+	}
+	// a background thread decodes the file ahead of Dirac, so the callback only has to copy
+	state.sPrefetch = mAiffPrefetchCreate(state.sInFile, numChannels, 65536, 4096);
+	if (!state.sPrefetch) {
+		printf("ERROR: Could not start reading input file\n");
+		exit(-1);
+	}
 	
 
     // First we set up DIRAC to process numChannels of audio
@@ -174,7 +183,7 @@ int main()
 		float **audio = mAiffAllocateAudioBuffer(numChannels, numOutFrames);
 		
 		/* set read position to begin of region */
-		state.sReadPosition = regions[i].sStartFrameInFile;
+		mAiffPrefetchSeek(state.sPrefetch, regions[i].sStartFrameInFile);
 		
 		/* process region */
 		DiracProcess(audio, numOutFrames, dirac);
@@ -198,8 +207,10 @@ int main()
 	// destroy DIRAC instance
 	DiracDestroy( dirac );
 	
-	// free our file name
-	delete[] state.sInFileName;
+	// close our input file. If the callback ever had to wait for the disk, a larger read ahead helps
+	printf("Read ahead underruns: %ld\n", mAiffPrefetchGetUnderruns(state.sPrefetch));
+	mAiffPrefetchDestroy(state.sPrefetch);
+	mAiffClose(state.sInFile);
 	
     // Done!
     printf("\nDone!\n");
@@ -42,7 +42,7 @@ RSC=rc.exe
 # PROP Ignore_Export_Lib 0
 # PROP Target_Dir ""
 # ADD BASE CPP /nologo /W3 /GX /O2 /D "WIN32" /D "NDEBUG" /D "_CONSOLE" /D "_MBCS" /YX /FD /c
-# ADD CPP /nologo /GX /O2 /I ".\..\..\Common Files" /D "WIN32" /D "NDEBUG" /D "_CONSOLE" /D "_MBCS" /YX /FD /c
+# ADD CPP /nologo /MT /GX /O2 /I ".\..\..\Common Files" /D "WIN32" /D "NDEBUG" /D "_CONSOLE" /D "_MBCS" /YX /FD /c
 # ADD BASE RSC /l 0x407 /d "NDEBUG"
 # ADD RSC /l 0x407 /d "NDEBUG"
 BSC32=bscmake.exe
@@ -66,7 +66,7 @@ LINK32=link.exe
 # PROP Ignore_Export_Lib 0
 # PROP Target_Dir ""
 # ADD BASE CPP /nologo /W3 /Gm /GX /ZI /Od /D "WIN32" /D "_DEBUG" /D "_CONSOLE" /D "_MBCS" /YX /FD /GZ /c
-# ADD CPP /nologo /W3 /Gm /GX /ZI /Od /I ".\..\..\Common Files" /D "WIN32" /D "_DEBUG" /D "_CONSOLE" /D "_MBCS" /YX /FD /GZ /c
+# ADD CPP /nologo /MTd /W3 /Gm /GX /ZI /Od /I ".\..\..\Common Files" /D "WIN32" /D "_DEBUG" /D "_CONSOLE" /D "_MBCS" /YX /FD /GZ /c
 # ADD BASE RSC /l 0x407 /d "_DEBUG"
 # ADD RSC /l 0x407 /d "_DEBUG"
 BSC32=bscmake.exe
@@ -89,6 +89,22 @@ LINK32=link.exe
 
 SOURCE=.\Source\main.cpp
 # End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\MiniAiffStream.cpp"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\MiniAiffPrefetch.cpp"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\BlockProfile.cpp"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\PhaseTimer.cpp"
+# End Source File
 # End Group
 # Begin Group "Header-Dateien"
 
@@ -101,6 +117,30 @@ SOURCE="..\..\Common Files\Dirac.h"
 
 SOURCE="..\..\Common Files\MiniAiff.h"
 # End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\MiniAiffStream.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\MiniAiffPrefetch.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\PcmConvert.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\BlockProfile.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\PhaseTimer.h"
+# End Source File
+# Begin Source File
+
+SOURCE="..\..\Common Files\CallbackTiming.h"
+# End Source File
 # End Group
 # Begin Group "Ressourcendateien"
 